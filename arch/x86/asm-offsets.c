@@ -1,8 +1,19 @@
+#include "jit/deopt.h"
 #include "vm/class.h"
+#include "vm/method.h"
 #include <stdio.h>
 
 int main(void)
 {
 	printf("#define VTABLE_OFFSET \t%lu\n", (unsigned long) (offsetof(struct vm_class, vtable) + offsetof(struct vtable, native_ptr)));
+	printf("#define ITABLE_OFFSET \t%lu\n", (unsigned long) offsetof(struct vm_class, itable));
+	printf("#define ITABLE_INDEX_OFFSET \t%lu\n", (unsigned long) offsetof(struct vm_method, itable_index));
+	printf("#define DEOPT_REGS_RESULT_LO \t%lu\n", (unsigned long) offsetof(struct deopt_regs, result_lo));
+	printf("#define DEOPT_REGS_RESULT_HI \t%lu\n", (unsigned long) offsetof(struct deopt_regs, result_hi));
+	printf("#define DEOPT_REGS_FP_TYPE \t%lu\n", (unsigned long) offsetof(struct deopt_regs, fp_type));
+	printf("#define DEOPT_REGS_TARGET \t%lu\n", (unsigned long) offsetof(struct deopt_regs, target));
+	printf("#define DEOPT_REGS_SP \t%lu\n", (unsigned long) offsetof(struct deopt_regs, sp));
+	printf("#define DEOPT_FP_FLOAT \t%d\n", DEOPT_FP_FLOAT);
+	printf("#define DEOPT_FP_DOUBLE \t%d\n", DEOPT_FP_DOUBLE);
 	return 0;
 }
@@ -7,8 +7,10 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "arch/registers.h"
+#include "arch/stack-frame.h"
 
 #include "jit/args.h"
 
@@ -141,16 +143,31 @@ void native_call(struct vm_method *method, void *target,
 	}
 }
 
+/**
+ * Copies call arguments of @method from native stack frame @frame into
+ * @args array. The @frame must point to the frame set up by the code
+ * emitted by emit_interp_bridge().
+ */
+void native_call_get_args(struct vm_method *method, void *frame,
+			  unsigned long *args)
+{
+	struct native_stack_frame *f = frame;
+
+	memcpy(args, f->args, method->args_count * sizeof(unsigned long));
+}
+
 #else /* CONFIG_X86_32 */
 
 /**
  * Calls @method which address is obtained from a memory
  * pointed by @target. Function returns call result which
- * is supposed to be saved to %rax.
+ * is supposed to be saved to %rax. Contents of %xmm0 after
+ * the call are stored to @xmm_result if it is not NULL.
  */
 static unsigned long native_call_gp(struct vm_method *method,
 				    const void *target,
-				    unsigned long *args)
+				    unsigned long *args,
+				    unsigned long *xmm_result)
 {
 	int i;
 	size_t reg_count = 0;
@@ -218,6 +235,7 @@ static unsigned long native_call_gp(struct vm_method *method,
 
 		"	call *%[target]			\n"
 		"	addq %[stack_size], %%rsp	\n"
+		"	movsd %%xmm0, 0x00(%[fregs])	\n"
 		: "=a" (result)
 		: [target] "m" (target),
 		  [regs] "r" (regs),
@@ -230,6 +248,9 @@ static unsigned long native_call_gp(struct vm_method *method,
 
 	free(stack);
 
+	if (xmm_result)
+		*xmm_result = fregs[0];
+
 	return result;
 }
 
@@ -246,33 +267,43 @@ void native_call(struct vm_method *method,
 {
 	switch (method->return_type.vm_type) {
 	case J_VOID:
-		native_call_gp(method, target, args);
+		native_call_gp(method, target, args, NULL);
 		break;
 	case J_REFERENCE:
-		result->l = (jobject) native_call_gp(method, target, args);
+		result->l = (jobject) native_call_gp(method, target, args, NULL);
 		break;
 	case J_INT:
-		result->i = (jint) native_call_gp(method, target, args);
+		result->i = (jint) native_call_gp(method, target, args, NULL);
 		break;
 	case J_CHAR:
-		result->c = (jchar) native_call_gp(method, target, args);
+		result->c = (jchar) native_call_gp(method, target, args, NULL);
 		break;
 	case J_BYTE:
-		result->b = (jbyte) native_call_gp(method, target, args);
+		result->b = (jbyte) native_call_gp(method, target, args, NULL);
 		break;
 	case J_SHORT:
-		result->s = (jshort) native_call_gp(method, target, args);
+		result->s = (jshort) native_call_gp(method, target, args, NULL);
 		break;
 	case J_BOOLEAN:
-		result->z = (jboolean) native_call_gp(method, target, args);
+		result->z = (jboolean) native_call_gp(method, target, args, NULL);
 		break;
 	case J_LONG:
-		result->j = (jlong) native_call_gp(method, target, args);
+		result->j = (jlong) native_call_gp(method, target, args, NULL);
 		break;
-	case J_DOUBLE:
-	case J_FLOAT:
-		error("not implemented");
+	case J_DOUBLE: {
+		unsigned long value;
+
+		native_call_gp(method, target, args, &value);
+		memcpy(&result->d, &value, sizeof(result->d));
+		break;
+	}
+	case J_FLOAT: {
+		unsigned long value;
+
+		native_call_gp(method, target, args, &value);
+		memcpy(&result->f, &value, sizeof(result->f));
 		break;
+	}
 	case J_RETURN_ADDRESS:
 	case VM_TYPE_MAX:
 	default:
@@ -281,4 +312,41 @@ void native_call(struct vm_method *method,
 	}
 }
 
+/**
+ * Copies call arguments of @method from native stack frame @frame into
+ * @args array. The @frame must point to the frame set up by the code
+ * emitted by emit_interp_bridge() which saves argument registers right
+ * below the frame pointer. This is the reverse of native_call_gp().
+ */
+void native_call_get_args(struct vm_method *method, void *frame,
+			  unsigned long *args)
+{
+	struct native_stack_frame *f = frame;
+	struct vm_args_map *map = method->args_map;
+	unsigned long *regs, *fregs;
+	size_t reg_count = 0;
+	size_t freg_count = 0;
+	size_t stack_count = 0;
+	int i;
+
+	/* See emit_save_arg_regs() for the layout */
+	regs	= (unsigned long *) frame - 1;
+	fregs	= (unsigned long *) frame - 7;
+
+	for (i = 0; i < method->args_count; i++) {
+		if (map[i].reg == MACH_REG_UNASSIGNED)
+			args[i] = f->args[stack_count++];
+		else {
+			if (map[i].type == J_DOUBLE || map[i].type == J_FLOAT)
+				args[i] = *(fregs - freg_count++);
+			else
+				args[i] = *(regs - reg_count++);
+		}
+
+		/* Skip duplicate slots. */
+		if (map[i].type == J_LONG || map[i].type == J_DOUBLE)
+			args[++i] = 0;
+	}
+}
+
 #endif /* CONFIG_X86_32 */
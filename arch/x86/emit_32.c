@@ -27,16 +27,23 @@
 #include "jit/statement.h"
 #include "jit/compiler.h"
 #include "jit/exception.h"
+#include "jit/instruction.h"
 #include "jit/emit-code.h"
 #include "jit/debug.h"
+#include "jit/osr.h"
 #include "jit/text.h"
 
 #include "lib/buffer.h"
 #include "lib/list.h"
 
 #include "vm/backtrace.h"
+#include "vm/class.h"
+#include "vm/heap.h"
 #include "vm/method.h"
+#include "vm/monitor.h"
 #include "vm/object.h"
+#include "vm/thread.h"
+#include "vm/tlab.h"
 
 #include <stdbool.h>
 #include <assert.h>
@@ -505,6 +512,11 @@ static void emit_mov_imm_memlocal(struct insn *insn, struct buffer *buf, struct
 	__emit_mov_imm_membase(buf, insn->src.imm, MACH_REG_EBP, slot_offset(insn->dest.slot));
 }
 
+void emit_clear_slot(struct buffer *buf, struct stack_slot *slot)
+{
+	__emit_mov_imm_membase(buf, 0, MACH_REG_EBP, slot_offset(slot));
+}
+
 static void __emit_mov_reg_membase(struct buffer *buf, enum machine_reg src,
 				   enum machine_reg base, unsigned long disp)
 {
@@ -937,24 +949,362 @@ void emit_trampoline(struct compilation_unit *cu,
 	jit_text_unlock();
 }
 
-void emit_lock(struct buffer *buf, struct vm_object *obj)
+/*
+ * Emits code which runs @vmm in the interpreter. The @target is one of the
+ * interpreter bridge functions returned by vm_interp_bridge_ptr() and it
+ * gets call arguments from the frame set up here.
+ */
+void emit_interp_bridge(struct buffer *buf, struct vm_method *vmm,
+			void *target)
+{
+	jit_text_lock();
+
+	buf->buf = jit_text_ptr();
+
+	__emit_push_reg(buf, MACH_REG_EBP);
+	__emit_mov_reg_reg(buf, MACH_REG_ESP, MACH_REG_EBP);
+
+	__emit_push_reg(buf, MACH_REG_EBP);
+	__emit_push_imm(buf, (unsigned long) vmm);
+	__emit_call(buf, target);
+	__emit_add_imm_reg(buf, 0x08, MACH_REG_ESP);
+
+	/*
+	 * The stack layout matches the one of trampoline here so
+	 * throw_from_trampoline() can be used to unwind the exception.
+	 */
+	emit(buf, 0x65);
+	__emit_memdisp_reg(buf, 0x8b,
+			   get_thread_local_offset(&trampoline_exception_guard),
+			   MACH_REG_ECX);
+	__emit_test_membase_reg(buf, MACH_REG_ECX, 0, MACH_REG_ECX);
+
+	__emit_pop_reg(buf, MACH_REG_EBP);
+	emit_ret(buf);
+
+	jit_text_reserve(buffer_offset(buf));
+	jit_text_unlock();
+}
+
+/* Emits a forward "jcc rel32" and returns the offset past it for fixup. */
+static unsigned long __emit_jcc_forward(struct buffer *buf, unsigned char cond)
+{
+	emit(buf, 0x0f);
+	emit(buf, cond);
+	emit_imm32(buf, 0);
+
+	return buffer_offset(buf);
+}
+
+static unsigned long __emit_jmp_forward(struct buffer *buf)
+{
+	emit(buf, 0xe9);
+	emit_imm32(buf, 0);
+
+	return buffer_offset(buf);
+}
+
+static void fixup_forward_branches(struct buffer *buf, unsigned long *offsets,
+				   unsigned int nr)
+{
+	for (unsigned int i = 0; i < nr; i++)
+		fixup_branch_target(buffer_ptr(buf) + offsets[i] - 4, buffer_current(buf));
+}
+
+#define MONITOR_RECORD_OFFSET	offsetof(struct vm_object, monitor_record)
+#define SPARE_MONITOR_REC_OFFSET offsetof(struct vm_exec_env, spare_monitor_rec)
+#define IN_BIAS_UPDATE_OFFSET	offsetof(struct vm_exec_env, in_bias_update)
+
+/*
+ * Emits the case of lock_reserved() where @obj is reserved for the current
+ * thread: the spare monitor record is marked biased and installed with a
+ * plain store. The thread can be stopped anywhere in here so the check is
+ * done with .in_bias_update set. Clobbers EAX and @rec. Returns the branch
+ * taken after the monitor is locked in @done.
+ */
+static unsigned int __emit_monitor_enter_reserved(struct buffer *buf, enum machine_reg obj,
+						  enum machine_reg rec, unsigned long *slow,
+						  unsigned long *done)
 {
-	__emit_push_imm(buf, (unsigned long)obj);
+	unsigned long ee_offset = get_thread_local_offset(&current_exec_env);
+	unsigned long abort[2];
+
+	/* mov gs:(current_exec_env), %rec */
+	emit(buf, 0x65);
+	__emit_memdisp_reg(buf, 0x8b, ee_offset, rec);
+
+	/* movl $1, in_bias_update(%rec) */
+	__emit_mov_imm_membase(buf, 1, rec, IN_BIAS_UPDATE_OFFSET);
+
+	/* lea VM_MONITOR_RESERVED(%rec), %eax; cmp %eax, monitor_record(%obj) */
+	__emit_membase_reg(buf, 0x8d, rec, VM_MONITOR_RESERVED, MACH_REG_EAX);
+	__emit_membase_reg(buf, 0x39, obj, MONITOR_RECORD_OFFSET, MACH_REG_EAX);
+	abort[0] = __emit_jcc_forward(buf, 0x85);
+
+	/* mov spare_monitor_rec(%rec), %eax */
+	__emit_membase_reg(buf, 0x8b, rec, SPARE_MONITOR_REC_OFFSET, MACH_REG_EAX);
+	__emit_reg_reg(buf, 0x85, MACH_REG_EAX, MACH_REG_EAX);
+	abort[1] = __emit_jcc_forward(buf, 0x84);
+
+	/* movb $1, biased(%eax) */
+	__emit_membase(buf, 0xc6, MACH_REG_EAX, offsetof(struct vm_monitor_record, biased), 0);
+	emit(buf, 0x01);
+
+	/* mov %eax, monitor_record(%obj) */
+	__emit_membase_reg(buf, 0x89, obj, MONITOR_RECORD_OFFSET, MACH_REG_EAX);
+
+	__emit_mov_imm_membase(buf, 0, rec, SPARE_MONITOR_REC_OFFSET);
+	__emit_mov_imm_membase(buf, 0, rec, IN_BIAS_UPDATE_OFFSET);
+	*done = __emit_jmp_forward(buf);
+
+	fixup_forward_branches(buf, abort, ARRAY_SIZE(abort));
+	__emit_mov_imm_membase(buf, 0, rec, IN_BIAS_UPDATE_OFFSET);
+	slow[0] = __emit_jmp_forward(buf);
+
+	return 1;
+}
+
+/*
+ * Emits the uncontended case of vm_object_lock() for the object in @obj:
+ * the spare monitor record of the current thread is installed with
+ * cmpxchg. Objects of classes whose instances are reserved for the
+ * locking thread are only locked here if they are reserved for the
+ * current thread already. Clobbers EAX and @rec. Returns the number of
+ * branches to the slow path stored in @slow.
+ */
+static unsigned int __emit_monitor_enter_fast(struct buffer *buf, enum machine_reg obj,
+					      enum machine_reg rec, unsigned long *slow)
+{
+	unsigned long ee_offset = get_thread_local_offset(&current_exec_env);
+	unsigned long revoked, done = 0;
+	unsigned int nr_slow = 0;
+
+	if (opt_use_biased_locking) {
+		/* mov class(%obj), %eax */
+		__emit_membase_reg(buf, 0x8b, obj, offsetof(struct vm_object, class), MACH_REG_EAX);
+		__emit_reg_reg(buf, 0x85, MACH_REG_EAX, MACH_REG_EAX);
+		slow[nr_slow++] = __emit_jcc_forward(buf, 0x84);
+
+		/* cmpb $0, bias_revoked(%eax) */
+		__emit_membase(buf, 0x80, MACH_REG_EAX, offsetof(struct vm_class, bias_revoked), 7);
+		emit(buf, 0x00);
+		revoked = __emit_jcc_forward(buf, 0x85);
+
+		nr_slow += __emit_monitor_enter_reserved(buf, obj, rec, slow + nr_slow, &done);
+
+		fixup_forward_branches(buf, &revoked, 1);
+	}
+
+	/* mov gs:(current_exec_env), %rec */
+	emit(buf, 0x65);
+	__emit_memdisp_reg(buf, 0x8b, ee_offset, rec);
+
+	/* mov spare_monitor_rec(%rec), %rec */
+	__emit_membase_reg(buf, 0x8b, rec, SPARE_MONITOR_REC_OFFSET, rec);
+	__emit_reg_reg(buf, 0x85, rec, rec);
+	slow[nr_slow++] = __emit_jcc_forward(buf, 0x84);
+
+	/* lock cmpxchg %rec, monitor_record(%obj) */
+	__emit_reg_reg(buf, 0x31, MACH_REG_EAX, MACH_REG_EAX);
+	emit(buf, 0xf0);
+	emit(buf, 0x0f);
+	__emit_membase_reg(buf, 0xb1, obj, MONITOR_RECORD_OFFSET, rec);
+	slow[nr_slow++] = __emit_jcc_forward(buf, 0x85);
+
+	/* The object owns the spare record now. */
+	emit(buf, 0x65);
+	__emit_memdisp_reg(buf, 0x8b, ee_offset, rec);
+	__emit_mov_imm_membase(buf, 0, rec, SPARE_MONITOR_REC_OFFSET);
+
+	if (done)
+		fixup_forward_branches(buf, &done, 1);
+
+	return nr_slow;
+}
+
+/*
+ * Emits the case of vm_object_unlock() where the current thread holds
+ * the monitor of @obj once, the record is not biased and no thread is
+ * blocked or waiting on it. The monitor is deflated and its record
+ * becomes the spare record of the thread again. Threads that blocked
+ * while the monitor was deflated are flushed by the code at the branch
+ * stored in @flush. Clobbers @rec and @ee.
+ */
+static unsigned int __emit_monitor_exit_fast(struct buffer *buf, enum machine_reg obj,
+					     enum machine_reg rec, enum machine_reg ee,
+					     unsigned long *slow, unsigned long *flush)
+{
+	unsigned int nr_slow = 0;
+
+	if (opt_use_biased_locking) {
+		/* testb $VM_MONITOR_RESERVED, monitor_record(%obj) */
+		__emit_membase(buf, 0xf6, obj, MONITOR_RECORD_OFFSET, 0);
+		emit(buf, VM_MONITOR_RESERVED);
+		slow[nr_slow++] = __emit_jcc_forward(buf, 0x85);
+	}
+
+	/* mov monitor_record(%obj), %rec */
+	__emit_membase_reg(buf, 0x8b, obj, MONITOR_RECORD_OFFSET, rec);
+	__emit_reg_reg(buf, 0x85, rec, rec);
+	slow[nr_slow++] = __emit_jcc_forward(buf, 0x84);
+
+	/* mov gs:(current_exec_env), %ee */
+	emit(buf, 0x65);
+	__emit_memdisp_reg(buf, 0x8b, get_thread_local_offset(&current_exec_env), ee);
+
+	/* cmp %ee, owner(%rec) */
+	__emit_membase_reg(buf, 0x39, rec, offsetof(struct vm_monitor_record, owner), ee);
+	slow[nr_slow++] = __emit_jcc_forward(buf, 0x85);
+
+	/* cmpl $1, lock_count(%rec) */
+	__emit_membase(buf, 0x83, rec, offsetof(struct vm_monitor_record, lock_count), 7);
+	emit(buf, 0x01);
+	slow[nr_slow++] = __emit_jcc_forward(buf, 0x85);
+
+	if (opt_use_biased_locking) {
+		/* cmpb $0, biased(%rec) */
+		__emit_membase(buf, 0x80, rec, offsetof(struct vm_monitor_record, biased), 7);
+		emit(buf, 0x00);
+		slow[nr_slow++] = __emit_jcc_forward(buf, 0x85);
+	}
+
+	/* cmpl $0, spare_monitor_rec(%ee) */
+	__emit_membase(buf, 0x83, ee, SPARE_MONITOR_REC_OFFSET, 7);
+	emit(buf, 0x00);
+	slow[nr_slow++] = __emit_jcc_forward(buf, 0x85);
+
+	/* cmpl $0, nr_blocked(%rec) */
+	__emit_membase(buf, 0x83, rec, offsetof(struct vm_monitor_record, nr_blocked), 7);
+	emit(buf, 0x00);
+	slow[nr_slow++] = __emit_jcc_forward(buf, 0x85);
+
+	/* cmpl $0, nr_waiting(%rec) */
+	__emit_membase(buf, 0x83, rec, offsetof(struct vm_monitor_record, nr_waiting), 7);
+	emit(buf, 0x00);
+	slow[nr_slow++] = __emit_jcc_forward(buf, 0x85);
+
+	/* Speculative deflation, see vm_object_unlock() */
+	__emit_mov_imm_membase(buf, 0, obj, MONITOR_RECORD_OFFSET);
+
+	/* lock addl $0, (%esp) */
+	emit(buf, 0xf0);
+	__emit_membase(buf, 0x83, MACH_REG_ESP, 0, 0);
+	emit(buf, 0x00);
+
+	__emit_membase(buf, 0x83, rec, offsetof(struct vm_monitor_record, nr_blocked), 7);
+	emit(buf, 0x00);
+	*flush = __emit_jcc_forward(buf, 0x85);
+
+	/* mov %rec, spare_monitor_rec(%ee) */
+	__emit_membase_reg(buf, 0x89, ee, SPARE_MONITOR_REC_OFFSET, rec);
+
+	return nr_slow;
+}
+
+#define MAX_MONITOR_SLOW_BRANCHES	8
+
+/*
+ * The object is pushed on the stack as the argument of vm_object_lock()
+ * by the instruction selector. The call is the last instruction so that
+ * its return address maps to this instruction.
+ */
+static void emit_monitor_enter_reg(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	unsigned long slow[MAX_MONITOR_SLOW_BRANCHES];
+	unsigned long done;
+	unsigned int nr_slow;
+
+	__emit_mov_reg_reg(buf, mach_reg(&insn->operand.reg), MACH_REG_ECX);
+
+	nr_slow = __emit_monitor_enter_fast(buf, MACH_REG_ECX, MACH_REG_EDX, slow);
+	done = __emit_jmp_forward(buf);
+
+	fixup_forward_branches(buf, slow, nr_slow);
+	__emit_call(buf, vm_object_lock);
+
+	fixup_forward_branches(buf, &done, 1);
+}
+
+static void emit_monitor_exit_reg(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	unsigned long slow[MAX_MONITOR_SLOW_BRANCHES];
+	unsigned long done[2];
+	unsigned long flush;
+	unsigned int nr_slow;
+
+	__emit_mov_reg_reg(buf, mach_reg(&insn->operand.reg), MACH_REG_ECX);
+
+	nr_slow = __emit_monitor_exit_fast(buf, MACH_REG_ECX, MACH_REG_EDX, MACH_REG_EAX, slow, &flush);
+	done[0] = __emit_jmp_forward(buf);
+
+	fixup_forward_branches(buf, &flush, 1);
+	__emit_push_reg(buf, MACH_REG_EDX);
+	__emit_call(buf, vm_monitor_record_flush);
+	__emit_add_imm_reg(buf, PTR_SIZE, MACH_REG_ESP);
+	done[1] = __emit_jmp_forward(buf);
+
+	fixup_forward_branches(buf, slow, nr_slow);
+	__emit_call(buf, vm_object_unlock);
+
+	fixup_forward_branches(buf, done, 2);
+}
+
+/*
+ * Locks the object in ECX in the prologue of synchronized methods.
+ */
+static void emit_lock_ecx(struct buffer *buf)
+{
+	unsigned long slow[MAX_MONITOR_SLOW_BRANCHES];
+	unsigned long done;
+	unsigned int nr_slow;
+
+	nr_slow = __emit_monitor_enter_fast(buf, MACH_REG_ECX, MACH_REG_EDX, slow);
+	done = __emit_jmp_forward(buf);
+
+	fixup_forward_branches(buf, slow, nr_slow);
+	__emit_push_reg(buf, MACH_REG_ECX);
 	__emit_call(buf, vm_object_lock);
 	__emit_add_imm_reg(buf, PTR_SIZE, MACH_REG_xSP);
 
 	__emit_push_reg(buf, MACH_REG_EAX);
 	emit_exception_test(buf, MACH_REG_EAX);
 	__emit_pop_reg(buf, MACH_REG_EAX);
+
+	fixup_forward_branches(buf, &done, 1);
 }
 
-void emit_unlock(struct buffer *buf, struct vm_object *obj)
+/*
+ * Unlocks the object in ECX in the epilogue of synchronized methods. The
+ * callee-saved registers are restored after this so the fast path uses
+ * them as scratch registers and leaves the return value in EAX:EDX alone.
+ */
+static void emit_unlock_ecx(struct buffer *buf)
 {
+	unsigned long slow[MAX_MONITOR_SLOW_BRANCHES];
+	unsigned long done[2];
+	unsigned long flush;
+	unsigned int nr_slow;
+
+	nr_slow = __emit_monitor_exit_fast(buf, MACH_REG_ECX, MACH_REG_ESI, MACH_REG_EDI, slow, &flush);
+	done[0] = __emit_jmp_forward(buf);
+
+	fixup_forward_branches(buf, &flush, 1);
+	__emit_push_reg(buf, MACH_REG_EAX);
+	__emit_push_reg(buf, MACH_REG_EDX);
+	__emit_push_reg(buf, MACH_REG_ESI);
+	__emit_call(buf, vm_monitor_record_flush);
+	__emit_add_imm_reg(buf, PTR_SIZE, MACH_REG_ESP);
+	__emit_pop_reg(buf, MACH_REG_EDX);
+	__emit_pop_reg(buf, MACH_REG_EAX);
+	done[1] = __emit_jmp_forward(buf);
+
+	fixup_forward_branches(buf, slow, nr_slow);
+
 	/* Save caller-saved registers which contain method's return value */
 	__emit_push_reg(buf, MACH_REG_EAX);
 	__emit_push_reg(buf, MACH_REG_EDX);
 
-	__emit_push_imm(buf, (unsigned long)obj);
+	__emit_push_reg(buf, MACH_REG_ECX);
 	__emit_call(buf, vm_object_unlock);
 	__emit_add_imm_reg(buf, PTR_SIZE, MACH_REG_ESP);
 
@@ -962,6 +1312,20 @@ void emit_unlock(struct buffer *buf, struct vm_object *obj)
 
 	__emit_pop_reg(buf, MACH_REG_EDX);
 	__emit_pop_reg(buf, MACH_REG_EAX);
+
+	fixup_forward_branches(buf, done, 2);
+}
+
+void emit_lock(struct buffer *buf, struct vm_object *obj)
+{
+	__emit_mov_imm_reg(buf, (unsigned long) obj, MACH_REG_ECX);
+	emit_lock_ecx(buf);
+}
+
+void emit_unlock(struct buffer *buf, struct vm_object *obj)
+{
+	__emit_mov_imm_reg(buf, (unsigned long) obj, MACH_REG_ECX);
+	emit_unlock_ecx(buf);
 }
 
 void emit_lock_this(struct buffer *buf, unsigned long frame_size)
@@ -970,13 +1334,8 @@ void emit_lock_this(struct buffer *buf, unsigned long frame_size)
 
 	this_arg_offset = offsetof(struct jit_stack_frame, args);
 
-	__emit_push_membase(buf, MACH_REG_EBP, this_arg_offset);
-	__emit_call(buf, vm_object_lock);
-	__emit_add_imm_reg(buf, PTR_SIZE, MACH_REG_ESP);
-
-	__emit_push_reg(buf, MACH_REG_EAX);
-	emit_exception_test(buf, MACH_REG_EAX);
-	__emit_pop_reg(buf, MACH_REG_EAX);
+	__emit_membase_reg(buf, 0x8b, MACH_REG_EBP, this_arg_offset, MACH_REG_ECX);
+	emit_lock_ecx(buf);
 }
 
 void emit_unlock_this(struct buffer *buf, unsigned long frame_size)
@@ -985,18 +1344,8 @@ void emit_unlock_this(struct buffer *buf, unsigned long frame_size)
 
 	this_arg_offset = offsetof(struct jit_stack_frame, args);
 
-	/* Save caller-saved registers which contain method's return value */
-	__emit_push_reg(buf, MACH_REG_EAX);
-	__emit_push_reg(buf, MACH_REG_EDX);
-
-	__emit_push_membase(buf, MACH_REG_EBP, this_arg_offset);
-	__emit_call(buf, vm_object_unlock);
-	__emit_add_imm_reg(buf, PTR_SIZE, MACH_REG_ESP);
-
-	emit_exception_test(buf, MACH_REG_EAX);
-
-	__emit_pop_reg(buf, MACH_REG_EDX);
-	__emit_pop_reg(buf, MACH_REG_EAX);
+	__emit_membase_reg(buf, 0x8b, MACH_REG_EBP, this_arg_offset, MACH_REG_ECX);
+	emit_unlock_ecx(buf);
 }
 
 void *emit_ic_check(struct buffer *buf)
@@ -1028,6 +1377,269 @@ void emit_ic_miss_handler(struct buffer *buf, void *ic_check, struct vm_method *
 	emit_indirect_jump_reg(buf, MACH_REG_EAX);
 }
 
+/*
+ * Loads the head of a thread-local free list into the destination register
+ * and calls tlab_refill() if the list is empty. The call is the last
+ * instruction so that its return address maps to this instruction.
+ */
+static void emit_tlab_alloc(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	enum machine_reg dest = mach_reg(&insn->dest.reg);
+
+	__emit_membase_reg(buf, 0x8b, mach_reg(&insn->src.base_reg), insn->src.disp, dest);
+	__emit_reg_reg(buf, 0x85, dest, dest);
+
+	/* jnz past the call */
+	emit(buf, 0x75);
+	emit(buf, 0x05);
+	__emit_call(buf, tlab_refill);
+}
+
+/*
+ * Replaces the object reference in the destination register with 1 if the
+ * display entry at the source displacement of its class holds the class
+ * in the source base register, and with 0 otherwise.
+ */
+static void emit_instanceof_membase_reg(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	enum machine_reg class = mach_reg(&insn->src.base_reg);
+	enum machine_reg obj = mach_reg(&insn->dest.reg);
+	unsigned long done;
+
+	/* null is not an instance of anything */
+	__emit_reg_reg(buf, 0x85, obj, obj);
+	done = __emit_jcc_forward(buf, 0x84);
+
+	__emit_membase_reg(buf, 0x8b, obj, offsetof(struct vm_object, class), obj);
+	__emit_membase_reg(buf, 0x8b, obj, insn->src.disp, obj);
+
+	/* %obj = (%obj == %class) */
+	__emit_reg_reg(buf, 0x29, class, obj);
+	__emit_cmp_imm_reg(buf, 0, 1, obj);
+	__emit_reg_reg(buf, 0x19, obj, obj);
+	emit_alu_imm_reg(buf, 0x04, 1, obj);
+
+	fixup_forward_branches(buf, &done, 1);
+}
+
+/*
+ * The object and the class are pushed on the stack as the arguments of
+ * vm_object_check_cast() by the instruction selector. The call is only
+ * made when the display check fails and is the last instruction so that
+ * its return address maps to this instruction.
+ */
+static void emit_checkcast_imm(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	struct vm_class *vmc = (struct vm_class *) insn->operand.imm;
+	unsigned long done[2];
+
+	__emit_membase_reg(buf, 0x8b, MACH_REG_ESP, 0, MACH_REG_EAX);
+	__emit_reg_reg(buf, 0x85, MACH_REG_EAX, MACH_REG_EAX);
+	done[0] = __emit_jcc_forward(buf, 0x84);
+
+	__emit_membase_reg(buf, 0x8b, MACH_REG_EAX, offsetof(struct vm_object, class), MACH_REG_EAX);
+
+	/* cmpl $vmc, display(%eax) */
+	__emit_membase(buf, 0x81, MACH_REG_EAX, vm_class_display_offset(vmc), 7);
+	emit_imm32(buf, (unsigned long) vmc);
+	done[1] = __emit_jcc_forward(buf, 0x84);
+
+	__emit_call(buf, vm_object_check_cast);
+
+	fixup_forward_branches(buf, done, 2);
+}
+
+/*
+ * The array and the stored reference are pushed on the stack as the
+ * arguments of array_store_check() by the instruction selector. Storing
+ * null, an object of exactly the element class, or anything into an
+ * array of java/lang/Object is accepted inline. Everything else goes
+ * through array_store_check() which is the last instruction so that its
+ * return address maps to this instruction.
+ */
+static void emit_array_store_check(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	unsigned long done[3];
+
+	/* mov 4(%esp), %eax */
+	__emit_membase_reg(buf, 0x8b, MACH_REG_ESP, PTR_SIZE, MACH_REG_EAX);
+	__emit_reg_reg(buf, 0x85, MACH_REG_EAX, MACH_REG_EAX);
+	done[0] = __emit_jcc_forward(buf, 0x84);
+
+	__emit_membase_reg(buf, 0x8b, MACH_REG_EAX, offsetof(struct vm_object, class), MACH_REG_EAX);
+
+	/* mov (%esp), %ecx */
+	__emit_membase_reg(buf, 0x8b, MACH_REG_ESP, 0, MACH_REG_ECX);
+	__emit_membase_reg(buf, 0x8b, MACH_REG_ECX, offsetof(struct vm_object, class), MACH_REG_ECX);
+	__emit_membase_reg(buf, 0x8b, MACH_REG_ECX, offsetof(struct vm_class, array_element_class), MACH_REG_ECX);
+
+	__emit_reg_reg(buf, 0x39, MACH_REG_EAX, MACH_REG_ECX);
+	done[1] = __emit_jcc_forward(buf, 0x84);
+
+	/* java/lang/Object is the only class at depth 0 of the display */
+	__emit_membase(buf, 0x83, MACH_REG_ECX, offsetof(struct vm_class, display_depth), 7);
+	emit(buf, 0x00);
+	done[2] = __emit_jcc_forward(buf, 0x84);
+
+	__emit_call(buf, array_store_check);
+
+	fixup_forward_branches(buf, done, 3);
+}
+
+static void emit_array_check(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	/* open-coded "jae" to the stub emitted by emit_array_check_stubs() */
+	emit(buf, 0x0f);
+	emit(buf, 0x83);
+	emit_imm32(buf, 0);
+}
+
+/*
+ * Emits out-of-line stubs for the failing side of array bounds checks in
+ * @bb. The stubs pass the array reference, the index and the address
+ * past the check to array_check_failed() which throws the exception.
+ */
+void emit_array_check_stubs(struct buffer *buf, struct basic_block *bb)
+{
+	struct insn *insn;
+
+	for_each_insn(insn, &bb->insn_list) {
+		unsigned char *jae_addr;
+
+		if (!insn_is_array_check(insn))
+			continue;
+
+		jae_addr = buffer_ptr(buf) + insn->mach_offset;
+
+		fixup_branch_target(jae_addr + 2, buffer_current(buf));
+
+		__emit_push_reg(buf, mach_reg(&insn->dest.reg));
+		__emit_push_reg(buf, mach_reg(&insn->src.reg));
+		__emit_push_imm(buf, (long) jae_addr + PREFIX_SIZE + BRANCH_INSN_SIZE);
+		__emit_jmp(buf, (unsigned long) array_check_failed);
+	}
+}
+
+/*
+ * Marks the card of the address in the source register dirty:
+ *
+ *	mov	src, tmp
+ *	shr	$GC_CARD_SHIFT, tmp
+ *	movb	$GC_CARD_DIRTY, gc_card_table_bias(tmp)
+ */
+static void emit_card_mark(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	enum machine_reg src = mach_reg(&insn->src.reg);
+	enum machine_reg tmp = mach_reg(&insn->dest.reg);
+
+	__emit_mov_reg_reg(buf, src, tmp);
+
+	emit(buf, 0xc1);
+	emit(buf, x86_encode_mod_rm(0x03, 0x05, x86_encode_reg(tmp)));
+	emit(buf, GC_CARD_SHIFT);
+
+	__emit_membase(buf, 0xc6, tmp, gc_card_table_bias, 0);
+	emit(buf, GC_CARD_DIRTY);
+}
+
+/*
+ * Emits a polymorphic inline cache stub that compares the receiver class
+ * in %ecx against each cached class and jumps directly to the matching
+ * target. Classes that are not in the cache fall through to
+ * resolve_ic_miss().
+ */
+void *emit_ic_pic_stub(struct vm_method *vmm, struct vm_class **classes,
+		       void **targets, unsigned int nr_entries)
+{
+	static struct buffer_operations exec_buf_ops = {
+		.expand = NULL,
+		.free   = NULL,
+	};
+	struct buffer *buf;
+	unsigned int i;
+
+	buf = __alloc_buffer(&exec_buf_ops);
+	if (!buf)
+		return NULL;
+
+	jit_text_lock();
+
+	buf->buf = jit_text_ptr();
+
+	for (i = 0; i < nr_entries; i++) {
+		void *je_addr;
+
+		__emit_cmp_imm_reg(buf, 1, (long) classes[i], MACH_REG_ECX);
+
+		/* open-coded "je" */
+		emit(buf, 0x0f);
+		emit(buf, 0x84);
+
+		je_addr = buffer_current(buf);
+		emit_imm32(buf, 0);
+
+		fixup_branch_target(je_addr, targets[i]);
+	}
+
+	__emit_push_membase(buf, MACH_REG_ESP, 0);
+	__emit_push_imm(buf, (long)vmm);
+	__emit_push_reg(buf, MACH_REG_ECX);
+	__emit_call(buf, resolve_ic_miss);
+	__emit_add_imm_reg(buf, 12, MACH_REG_ESP);
+	emit_indirect_jump_reg(buf, MACH_REG_EAX);
+
+	jit_text_reserve(buffer_offset(buf));
+	jit_text_unlock();
+
+	return buffer_ptr(buf);
+}
+
+/*
+ * Emits a stub that devirtualized calls of @vmm are redirected to when
+ * class hierarchy analysis invalidates their code. The stub is entered
+ * with the arguments of the call on the stack and jumps to the method
+ * that invokevirtual or invokeinterface would call for the receiver.
+ */
+void *emit_cha_dispatch_stub(struct vm_method *vmm)
+{
+	static struct buffer_operations exec_buf_ops = {
+		.expand = NULL,
+		.free   = NULL,
+	};
+	struct buffer *buf;
+
+	buf = __alloc_buffer(&exec_buf_ops);
+	if (!buf)
+		return NULL;
+
+	jit_text_lock();
+
+	buf->buf = jit_text_ptr();
+
+	/* receiver class */
+	__emit_membase_reg(buf, 0x8b, MACH_REG_ESP, 4, MACH_REG_ECX);
+	__emit_membase_reg(buf, 0x8b, MACH_REG_ECX, offsetof(struct vm_object, class), MACH_REG_ECX);
+
+	if (vm_class_is_interface(vmm->class)) {
+		/* hidden parameter to the conflict resolution stub */
+		__emit_mov_imm_reg(buf, (long) vmm, MACH_REG_EAX);
+
+		/* jmp *itable[i](%ecx) */
+		__emit_membase(buf, 0xff, MACH_REG_ECX,
+			       offsetof(struct vm_class, itable) + vmm->itable_index * sizeof(void *), 4);
+	} else {
+		__emit_membase_reg(buf, 0x8b, MACH_REG_ECX, offsetof(struct vm_class, vtable), MACH_REG_ECX);
+
+		/* jmp *vtable[i](%ecx) */
+		__emit_membase(buf, 0xff, MACH_REG_ECX, vmm->virtual_index * sizeof(void *), 4);
+	}
+
+	jit_text_reserve(buffer_offset(buf));
+	jit_text_unlock();
+
+	return buffer_ptr(buf);
+}
+
 extern void jni_trampoline(void);
 
 void emit_jni_trampoline(struct buffer *buf, struct vm_method *vmm,
@@ -1191,8 +1803,12 @@ static emit_fn_t emitters[] = {
 	DECL_EMITTER(INSN_ADD_IMM_REG, insn_encode),
 	DECL_EMITTER(INSN_ADD_REG_REG, insn_encode),
 	DECL_EMITTER(INSN_AND_REG_REG, insn_encode),
+	DECL_EMITTER(INSN_ARRAY_CHECK_REG_REG, emit_array_check),
+	DECL_EMITTER(INSN_ARRAY_STORE_CHECK, emit_array_store_check),
 	DECL_EMITTER(INSN_CALL_REG, insn_encode),
 	DECL_EMITTER(INSN_CALL_REL, emit_call),
+	DECL_EMITTER(INSN_CARD_MARK_REG_REG, emit_card_mark),
+	DECL_EMITTER(INSN_CHECKCAST_IMM, emit_checkcast_imm),
 	DECL_EMITTER(INSN_CLTD_REG_REG, insn_encode),
 	DECL_EMITTER(INSN_DIVSD_XMM_XMM, insn_encode),
 	DECL_EMITTER(INSN_DIVSS_XMM_XMM, insn_encode),
@@ -1200,6 +1816,7 @@ static emit_fn_t emitters[] = {
 	DECL_EMITTER(INSN_FLD_MEMLOCAL, insn_encode),
 	DECL_EMITTER(INSN_FSTP_64_MEMLOCAL, insn_encode),
 	DECL_EMITTER(INSN_FSTP_MEMLOCAL, insn_encode),
+	DECL_EMITTER(INSN_INSTANCEOF_MEMBASE_REG, emit_instanceof_membase_reg),
 	DECL_EMITTER(INSN_JE_BRANCH, emit_je_branch),
 	DECL_EMITTER(INSN_JGE_BRANCH, emit_jge_branch),
 	DECL_EMITTER(INSN_JG_BRANCH, emit_jg_branch),
@@ -1308,6 +1925,9 @@ static emit_fn_t emitters[] = {
 	DECL_EMITTER(INSN_SUB_MEMBASE_REG, insn_encode),
 	DECL_EMITTER(INSN_TEST_IMM_MEMDISP, emit_test_imm_memdisp),
 	DECL_EMITTER(INSN_TEST_MEMBASE_REG, insn_encode),
+	DECL_EMITTER(INSN_TLAB_ALLOC_MEMBASE_REG, emit_tlab_alloc),
+	DECL_EMITTER(INSN_MONITOR_ENTER_REG, emit_monitor_enter_reg),
+	DECL_EMITTER(INSN_MONITOR_EXIT_REG, emit_monitor_exit_reg),
 	DECL_EMITTER(INSN_SAVE_CALLER_REGS, emit_pseudo),
 	DECL_EMITTER(INSN_RESTORE_CALLER_REGS, emit_pseudo),
 	DECL_EMITTER(INSN_RESTORE_CALLER_REGS_I32, emit_pseudo),
@@ -1339,3 +1959,50 @@ void emit_nop(struct buffer *buf)
 {
 	emit(buf, 0x90);
 }
+
+/*
+ * Emits a 5-byte nop that fixup_method_entry() can atomically replace with
+ * a jump. The nop is aligned so that its first two bytes can be written
+ * with a single store.
+ */
+void *emit_patchable_entry(struct buffer *buf)
+{
+	void *entry;
+
+	while (buffer_offset(buf) & 1)
+		emit(buf, 0x90);
+
+	entry = buffer_current(buf);
+
+	/* nopl 0x0(%eax,%eax,1) */
+	emit(buf, 0x0f);
+	emit(buf, 0x1f);
+	emit(buf, 0x44);
+	emit(buf, 0x00);
+	emit(buf, 0x00);
+
+	return entry;
+}
+
+/*
+ * Emits the on-stack replacement entry of a method. It sets up the frame
+ * like the normal entry and jumps to the address returned by
+ * osr_migrate_frame(). See jit/osr.c.
+ */
+void *emit_osr_entry(struct buffer *buf, struct stack_frame *frame,
+		     unsigned long frame_size)
+{
+	void *entry;
+
+	entry = buffer_current(buf);
+
+	emit_prolog(buf, frame, frame_size);
+
+	__emit_push_reg(buf, MACH_REG_EBP);
+	__emit_call(buf, osr_migrate_frame);
+	__emit_add_imm_reg(buf, 0x04, MACH_REG_ESP);
+
+	emit_indirect_jump_reg(buf, MACH_REG_EAX);
+
+	return entry;
+}
@@ -29,14 +29,20 @@
 #include "jit/debug.h"
 #include "jit/exception.h"
 #include "jit/emit-code.h"
+#include "jit/instruction.h"
 #include "jit/text.h"
 
 #include "lib/buffer.h"
 #include "lib/list.h"
 
 #include "vm/backtrace.h"
+#include "vm/class.h"
+#include "vm/heap.h"
 #include "vm/method.h"
+#include "vm/monitor.h"
 #include "vm/object.h"
+#include "vm/thread.h"
+#include "vm/tlab.h"
 
 #include <stdbool.h>
 #include <assert.h>
@@ -1050,6 +1056,13 @@ static void emit_mov_imm_memlocal(struct insn *insn, struct buffer *buf, struct
 	__emit_mov_imm_membase(buf, insn->src.imm, MACH_REG_RBP, slot_offset(insn->dest.slot));
 }
 
+void emit_clear_slot(struct buffer *buf, struct stack_slot *slot)
+{
+	/* movq $0, disp(%rbp) */
+	__emit_membase(buf, 1, 0xc7, MACH_REG_RBP, slot_offset(slot), 0);
+	emit_imm32(buf, 0);
+}
+
 static void emit_conv_fpu_to_gpr(struct insn *insn, struct buffer *buf, struct basic_block *bb)
 {
 	enum machine_reg src, dest;
@@ -1373,46 +1386,286 @@ static void emit_exception_test(struct buffer *buf, enum machine_reg reg)
 	__emit64_test_membase_reg(buf, reg, 0, reg);
 }
 
-void emit_lock(struct buffer *buf, struct vm_object *obj)
+/* Emits a forward "jcc rel32" and returns the offset past it for fixup. */
+static unsigned long __emit_jcc_forward(struct buffer *buf, unsigned char cond)
 {
-	emit_save_arg_regs(buf);
+	emit(buf, 0x0f);
+	emit(buf, cond);
+	emit_imm32(buf, 0);
 
-	__emit_mov_imm_reg(buf, (unsigned long) obj, MACH_REG_RDI);
-	__emit_call(buf, vm_object_lock);
+	return buffer_offset(buf);
+}
 
-	emit_restore_arg_regs(buf);
+static unsigned long __emit_jmp_forward(struct buffer *buf)
+{
+	emit(buf, 0xe9);
+	emit_imm32(buf, 0);
 
-	/* 16-byte stack alignment: */
-	__emit64_sub_imm_reg(buf, 0x08, MACH_REG_RSP);
-	__emit_push_reg(buf, MACH_REG_RAX);
-	emit_exception_test(buf, MACH_REG_RAX);
-	__emit_pop_reg(buf, MACH_REG_RAX);
-	__emit_add_imm_reg(buf, 0x08, MACH_REG_RSP);
+	return buffer_offset(buf);
 }
 
-void emit_unlock(struct buffer *buf, struct vm_object *obj)
+static void fixup_forward_branches(struct buffer *buf, unsigned long *offsets,
+				   unsigned int nr)
 {
-	/* 16-byte stack alignment: */
-	__emit64_sub_imm_reg(buf, 0x08, MACH_REG_RSP);
-	__emit_push_reg(buf, MACH_REG_RAX);
-	emit_save_arg_regs(buf);
+	for (unsigned int i = 0; i < nr; i++)
+		fixup_branch_target(buffer_ptr(buf) + offsets[i] - 4, buffer_current(buf));
+}
 
-	__emit_mov_imm_reg(buf, (unsigned long) obj, MACH_REG_RDI);
-	__emit_call(buf, vm_object_unlock);
+static void __emit_load_exec_env(struct buffer *buf, enum machine_reg reg)
+{
+	/* mov fs:(current_exec_env), %reg */
+	emit(buf, 0x64);
+	__emit_memdisp_reg(buf, 1, 0x8b, get_thread_local_offset(&current_exec_env), reg);
+}
 
-	emit_exception_test(buf, MACH_REG_RAX);
+#define MONITOR_RECORD_OFFSET	offsetof(struct vm_object, monitor_record)
+#define SPARE_MONITOR_REC_OFFSET offsetof(struct vm_exec_env, spare_monitor_rec)
+#define IN_BIAS_UPDATE_OFFSET	offsetof(struct vm_exec_env, in_bias_update)
 
-	emit_restore_arg_regs(buf);
-	__emit_pop_reg(buf, MACH_REG_RAX);
-	__emit_add_imm_reg(buf, 0x08, MACH_REG_RSP);
+/*
+ * Emits the case of lock_reserved() where @obj is reserved for the current
+ * thread: the spare monitor record is marked biased and installed with a
+ * plain store. The thread can be stopped anywhere in here so the check is
+ * done with .in_bias_update set. Clobbers RAX and @rec. Returns the branch
+ * taken after the monitor is locked in @done.
+ */
+static unsigned int __emit_monitor_enter_reserved(struct buffer *buf, enum machine_reg obj,
+						  enum machine_reg rec, unsigned long *slow,
+						  unsigned long *done)
+{
+	unsigned long abort[2];
+
+	__emit_load_exec_env(buf, rec);
+
+	/* movl $1, in_bias_update(%rec) */
+	__emit_membase(buf, 0, 0xc7, rec, IN_BIAS_UPDATE_OFFSET, 0);
+	emit_imm32(buf, 1);
+
+	/* lea VM_MONITOR_RESERVED(%rec), %rax; cmp %rax, monitor_record(%obj) */
+	__emit_membase_reg(buf, 1, 0x8d, rec, VM_MONITOR_RESERVED, MACH_REG_RAX);
+	__emit_reg_membase(buf, 1, 0x39, MACH_REG_RAX, obj, MONITOR_RECORD_OFFSET);
+	abort[0] = __emit_jcc_forward(buf, 0x85);
+
+	/* mov spare_monitor_rec(%rec), %rax */
+	__emit64_mov_membase_reg(buf, rec, SPARE_MONITOR_REC_OFFSET, MACH_REG_RAX);
+	__emit_reg_reg(buf, 1, 0x85, MACH_REG_RAX, MACH_REG_RAX);
+	abort[1] = __emit_jcc_forward(buf, 0x84);
+
+	/* movb $1, biased(%rax) */
+	__emit_membase(buf, 0, 0xc6, MACH_REG_RAX, offsetof(struct vm_monitor_record, biased), 0);
+	emit(buf, 0x01);
+
+	/* mov %rax, monitor_record(%obj) */
+	__emit_reg_membase(buf, 1, 0x89, MACH_REG_RAX, obj, MONITOR_RECORD_OFFSET);
+
+	__emit_membase(buf, 1, 0xc7, rec, SPARE_MONITOR_REC_OFFSET, 0);
+	emit_imm32(buf, 0);
+	__emit_membase(buf, 0, 0xc7, rec, IN_BIAS_UPDATE_OFFSET, 0);
+	emit_imm32(buf, 0);
+	*done = __emit_jmp_forward(buf);
+
+	fixup_forward_branches(buf, abort, ARRAY_SIZE(abort));
+	__emit_membase(buf, 0, 0xc7, rec, IN_BIAS_UPDATE_OFFSET, 0);
+	emit_imm32(buf, 0);
+	slow[0] = __emit_jmp_forward(buf);
+
+	return 1;
 }
 
-void emit_lock_this(struct buffer *buf, unsigned long frame_size)
+/*
+ * Emits the uncontended case of vm_object_lock() for the object in @obj:
+ * the spare monitor record of the current thread is installed with
+ * cmpxchg. Objects of classes whose instances are reserved for the
+ * locking thread are only locked here if they are reserved for the
+ * current thread already. Clobbers RAX and @rec. Returns the number of
+ * branches to the slow path stored in @slow.
+ */
+static unsigned int __emit_monitor_enter_fast(struct buffer *buf, enum machine_reg obj,
+					      enum machine_reg rec, unsigned long *slow)
 {
-	unsigned long this_offset = frame_size + 8 * NR_CALLEE_SAVE_REGS + 8;
+	unsigned char cmpxchg[] = { 0x0f, 0xb1 };
+	unsigned long revoked, done = 0;
+	unsigned int nr_slow = 0;
+
+	if (opt_use_biased_locking) {
+		/* mov class(%obj), %rax */
+		__emit64_mov_membase_reg(buf, obj, offsetof(struct vm_object, class), MACH_REG_RAX);
+		__emit_reg_reg(buf, 1, 0x85, MACH_REG_RAX, MACH_REG_RAX);
+		slow[nr_slow++] = __emit_jcc_forward(buf, 0x84);
+
+		/* cmpb $0, bias_revoked(%rax) */
+		__emit_membase(buf, 0, 0x80, MACH_REG_RAX, offsetof(struct vm_class, bias_revoked), 7);
+		emit(buf, 0x00);
+		revoked = __emit_jcc_forward(buf, 0x85);
+
+		nr_slow += __emit_monitor_enter_reserved(buf, obj, rec, slow + nr_slow, &done);
+
+		fixup_forward_branches(buf, &revoked, 1);
+	}
+
+	__emit_load_exec_env(buf, rec);
+
+	/* mov spare_monitor_rec(%rec), %rec */
+	__emit64_mov_membase_reg(buf, rec, SPARE_MONITOR_REC_OFFSET, rec);
+	__emit_reg_reg(buf, 1, 0x85, rec, rec);
+	slow[nr_slow++] = __emit_jcc_forward(buf, 0x84);
+
+	/* lock cmpxchg %rec, monitor_record(%obj) */
+	__emit_reg_reg(buf, 1, 0x31, MACH_REG_RAX, MACH_REG_RAX);
+	emit(buf, 0xf0);
+	__emit_lopc_reg_membase(buf, 1, cmpxchg, 2, rec, obj, MONITOR_RECORD_OFFSET);
+	slow[nr_slow++] = __emit_jcc_forward(buf, 0x85);
+
+	/* The object owns the spare record now. */
+	__emit_load_exec_env(buf, rec);
+	__emit_membase(buf, 1, 0xc7, rec, SPARE_MONITOR_REC_OFFSET, 0);
+	emit_imm32(buf, 0);
+
+	if (done)
+		fixup_forward_branches(buf, &done, 1);
+
+	return nr_slow;
+}
+
+/*
+ * Emits the case of vm_object_unlock() where the current thread holds
+ * the monitor of @obj once, the record is not biased and no thread is
+ * blocked or waiting on it. The monitor is deflated and its record
+ * becomes the spare record of the thread again. Threads that blocked
+ * while the monitor was deflated are flushed by the code at the branch
+ * stored in @flush. Clobbers @rec and @ee.
+ */
+static unsigned int __emit_monitor_exit_fast(struct buffer *buf, enum machine_reg obj,
+					     enum machine_reg rec, enum machine_reg ee,
+					     unsigned long *slow, unsigned long *flush)
+{
+	unsigned int nr_slow = 0;
+
+	if (opt_use_biased_locking) {
+		/* testb $VM_MONITOR_RESERVED, monitor_record(%obj) */
+		__emit_membase(buf, 0, 0xf6, obj, MONITOR_RECORD_OFFSET, 0);
+		emit(buf, VM_MONITOR_RESERVED);
+		slow[nr_slow++] = __emit_jcc_forward(buf, 0x85);
+	}
+
+	/* mov monitor_record(%obj), %rec */
+	__emit64_mov_membase_reg(buf, obj, MONITOR_RECORD_OFFSET, rec);
+	__emit_reg_reg(buf, 1, 0x85, rec, rec);
+	slow[nr_slow++] = __emit_jcc_forward(buf, 0x84);
 
-	__emit64_mov_membase_reg(buf, MACH_REG_RBP, - this_offset, MACH_REG_RDI);
+	__emit_load_exec_env(buf, ee);
+
+	/* cmp %ee, owner(%rec) */
+	__emit_reg_membase(buf, 1, 0x39, ee, rec, offsetof(struct vm_monitor_record, owner));
+	slow[nr_slow++] = __emit_jcc_forward(buf, 0x85);
+
+	/* cmpl $1, lock_count(%rec) */
+	__emit_membase(buf, 0, 0x83, rec, offsetof(struct vm_monitor_record, lock_count), 7);
+	emit(buf, 0x01);
+	slow[nr_slow++] = __emit_jcc_forward(buf, 0x85);
+
+	if (opt_use_biased_locking) {
+		/* cmpb $0, biased(%rec) */
+		__emit_membase(buf, 0, 0x80, rec, offsetof(struct vm_monitor_record, biased), 7);
+		emit(buf, 0x00);
+		slow[nr_slow++] = __emit_jcc_forward(buf, 0x85);
+	}
+
+	/* cmpq $0, spare_monitor_rec(%ee) */
+	__emit_membase(buf, 1, 0x83, ee, SPARE_MONITOR_REC_OFFSET, 7);
+	emit(buf, 0x00);
+	slow[nr_slow++] = __emit_jcc_forward(buf, 0x85);
+
+	/* cmpl $0, nr_blocked(%rec) */
+	__emit_membase(buf, 0, 0x83, rec, offsetof(struct vm_monitor_record, nr_blocked), 7);
+	emit(buf, 0x00);
+	slow[nr_slow++] = __emit_jcc_forward(buf, 0x85);
+
+	/* cmpl $0, nr_waiting(%rec) */
+	__emit_membase(buf, 0, 0x83, rec, offsetof(struct vm_monitor_record, nr_waiting), 7);
+	emit(buf, 0x00);
+	slow[nr_slow++] = __emit_jcc_forward(buf, 0x85);
+
+	/* Speculative deflation, see vm_object_unlock() */
+	__emit_membase(buf, 1, 0xc7, obj, MONITOR_RECORD_OFFSET, 0);
+	emit_imm32(buf, 0);
+
+	/* mfence */
+	emit(buf, 0x0f);
+	emit(buf, 0xae);
+	emit(buf, 0xf0);
+
+	__emit_membase(buf, 0, 0x83, rec, offsetof(struct vm_monitor_record, nr_blocked), 7);
+	emit(buf, 0x00);
+	*flush = __emit_jcc_forward(buf, 0x85);
+
+	/* mov %rec, spare_monitor_rec(%ee) */
+	__emit_reg_membase(buf, 1, 0x89, rec, ee, SPARE_MONITOR_REC_OFFSET);
+
+	return nr_slow;
+}
+
+#define MAX_MONITOR_SLOW_BRANCHES	8
+
+/*
+ * The object is passed in RDI as the argument of vm_object_lock() by the
+ * instruction selector. The call is the last instruction so that its
+ * return address maps to this instruction.
+ */
+static void emit_monitor_enter_reg(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	enum machine_reg obj = mach_reg(&insn->operand.reg);
+	unsigned long slow[MAX_MONITOR_SLOW_BRANCHES];
+	unsigned long done;
+	unsigned int nr_slow;
+
+	nr_slow = __emit_monitor_enter_fast(buf, obj, MACH_REG_R10, slow);
+	done = __emit_jmp_forward(buf);
+
+	fixup_forward_branches(buf, slow, nr_slow);
+	__emit_call(buf, vm_object_lock);
+
+	fixup_forward_branches(buf, &done, 1);
+}
+
+static void emit_monitor_exit_reg(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	enum machine_reg obj = mach_reg(&insn->operand.reg);
+	unsigned long slow[MAX_MONITOR_SLOW_BRANCHES];
+	unsigned long done[2];
+	unsigned long flush;
+	unsigned int nr_slow;
+
+	nr_slow = __emit_monitor_exit_fast(buf, obj, MACH_REG_R10, MACH_REG_R11, slow, &flush);
+	done[0] = __emit_jmp_forward(buf);
+
+	fixup_forward_branches(buf, &flush, 1);
+	__emit_mov_reg_reg(buf, MACH_REG_R10, MACH_REG_RDI);
+	__emit_call(buf, vm_monitor_record_flush);
+	done[1] = __emit_jmp_forward(buf);
+
+	fixup_forward_branches(buf, slow, nr_slow);
+	__emit_call(buf, vm_object_unlock);
+
+	fixup_forward_branches(buf, done, 2);
+}
+
+/*
+ * Locks the object in R11 in the prologue of synchronized methods. The
+ * fast path doesn't touch the argument registers.
+ */
+static void emit_lock_r11(struct buffer *buf)
+{
+	unsigned long slow[MAX_MONITOR_SLOW_BRANCHES];
+	unsigned long done;
+	unsigned int nr_slow;
+
+	nr_slow = __emit_monitor_enter_fast(buf, MACH_REG_R11, MACH_REG_R10, slow);
+	done = __emit_jmp_forward(buf);
+
+	fixup_forward_branches(buf, slow, nr_slow);
 	emit_save_arg_regs(buf);
+	__emit_mov_reg_reg(buf, MACH_REG_R11, MACH_REG_RDI);
 	__emit_call(buf, vm_object_lock);
 	emit_restore_arg_regs(buf);
 
@@ -1422,17 +1675,43 @@ void emit_lock_this(struct buffer *buf, unsigned long frame_size)
 	emit_exception_test(buf, MACH_REG_RAX);
 	__emit_pop_reg(buf, MACH_REG_RAX);
 	__emit_add_imm_reg(buf, 0x08, MACH_REG_RSP);
+
+	fixup_forward_branches(buf, &done, 1);
 }
 
-void emit_unlock_this(struct buffer *buf, unsigned long frame_size)
+/*
+ * Unlocks the object in R11 in the epilogue of synchronized methods. The
+ * fast path leaves the return value in RAX and XMM0 alone.
+ */
+static void emit_unlock_r11(struct buffer *buf)
 {
-	unsigned long this_offset = frame_size + 8 * NR_CALLEE_SAVE_REGS + 8;
+	unsigned long slow[MAX_MONITOR_SLOW_BRANCHES];
+	unsigned long done[2];
+	unsigned long flush;
+	unsigned int nr_slow;
+
+	nr_slow = __emit_monitor_exit_fast(buf, MACH_REG_R11, MACH_REG_R10, MACH_REG_RCX, slow, &flush);
+	done[0] = __emit_jmp_forward(buf);
 
-	__emit64_mov_membase_reg(buf, MACH_REG_RBP, - this_offset, MACH_REG_RDI);
+	fixup_forward_branches(buf, &flush, 1);
 	/* 16-byte stack alignment: */
 	__emit64_sub_imm_reg(buf, 0x08, MACH_REG_RSP);
 	__emit_push_reg(buf, MACH_REG_RAX);
 	emit_save_arg_regs(buf);
+	__emit_mov_reg_reg(buf, MACH_REG_R10, MACH_REG_RDI);
+	__emit_call(buf, vm_monitor_record_flush);
+	emit_restore_arg_regs(buf);
+	__emit_pop_reg(buf, MACH_REG_RAX);
+	__emit_add_imm_reg(buf, 0x08, MACH_REG_RSP);
+	done[1] = __emit_jmp_forward(buf);
+
+	fixup_forward_branches(buf, slow, nr_slow);
+	/* 16-byte stack alignment: */
+	__emit64_sub_imm_reg(buf, 0x08, MACH_REG_RSP);
+	__emit_push_reg(buf, MACH_REG_RAX);
+	emit_save_arg_regs(buf);
+
+	__emit_mov_reg_reg(buf, MACH_REG_R11, MACH_REG_RDI);
 	__emit_call(buf, vm_object_unlock);
 
 	emit_exception_test(buf, MACH_REG_RAX);
@@ -1440,6 +1719,36 @@ void emit_unlock_this(struct buffer *buf, unsigned long frame_size)
 	emit_restore_arg_regs(buf);
 	__emit_pop_reg(buf, MACH_REG_RAX);
 	__emit_add_imm_reg(buf, 0x08, MACH_REG_RSP);
+
+	fixup_forward_branches(buf, done, 2);
+}
+
+void emit_lock(struct buffer *buf, struct vm_object *obj)
+{
+	__emit_mov_imm_reg(buf, (unsigned long) obj, MACH_REG_R11);
+	emit_lock_r11(buf);
+}
+
+void emit_unlock(struct buffer *buf, struct vm_object *obj)
+{
+	__emit_mov_imm_reg(buf, (unsigned long) obj, MACH_REG_R11);
+	emit_unlock_r11(buf);
+}
+
+void emit_lock_this(struct buffer *buf, unsigned long frame_size)
+{
+	unsigned long this_offset = frame_size + 8 * NR_CALLEE_SAVE_REGS + 8;
+
+	__emit64_mov_membase_reg(buf, MACH_REG_RBP, - this_offset, MACH_REG_R11);
+	emit_lock_r11(buf);
+}
+
+void emit_unlock_this(struct buffer *buf, unsigned long frame_size)
+{
+	unsigned long this_offset = frame_size + 8 * NR_CALLEE_SAVE_REGS + 8;
+
+	__emit64_mov_membase_reg(buf, MACH_REG_RBP, - this_offset, MACH_REG_R11);
+	emit_unlock_r11(buf);
 }
 
 
@@ -1452,6 +1761,224 @@ void emit_ic_miss_handler(struct buffer *buf, void *ic_check, struct vm_method *
 {
 }
 
+void *emit_ic_pic_stub(struct vm_method *vmm, struct vm_class **classes,
+		       void **targets, unsigned int nr_entries)
+{
+	return NULL;
+}
+
+/*
+ * Emits a stub that devirtualized calls of @vmm are redirected to when
+ * class hierarchy analysis invalidates their code. The stub is entered
+ * with the receiver in RDI and jumps to the method that invokevirtual or
+ * invokeinterface would call for it. R11 is not used to pass arguments.
+ */
+void *emit_cha_dispatch_stub(struct vm_method *vmm)
+{
+	static struct buffer_operations exec_buf_ops = {
+		.expand = NULL,
+		.free   = NULL,
+	};
+	struct buffer *buf;
+
+	buf = __alloc_buffer(&exec_buf_ops);
+	if (!buf)
+		return NULL;
+
+	jit_text_lock();
+
+	buf->buf = jit_text_ptr();
+
+	/* receiver class */
+	__emit64_mov_membase_reg(buf, MACH_REG_RDI, offsetof(struct vm_object, class), MACH_REG_R11);
+
+	if (vm_class_is_interface(vmm->class)) {
+		/* hidden parameter to the conflict resolution stub */
+		__emit_mov_imm_reg(buf, (long) vmm, MACH_REG_RAX);
+
+		/* jmp *itable[i](%r11) */
+		__emit_membase(buf, 0, 0xff, MACH_REG_R11,
+			       offsetof(struct vm_class, itable) + vmm->itable_index * sizeof(void *), 4);
+	} else {
+		__emit64_mov_membase_reg(buf, MACH_REG_R11, offsetof(struct vm_class, vtable), MACH_REG_R11);
+
+		/* jmp *vtable[i](%r11) */
+		__emit_membase(buf, 0, 0xff, MACH_REG_R11, vmm->virtual_index * sizeof(void *), 4);
+	}
+
+	jit_text_reserve(buffer_offset(buf));
+	jit_text_unlock();
+
+	return buffer_ptr(buf);
+}
+
+/*
+ * Loads the head of a thread-local free list into the destination register
+ * and calls tlab_refill() if the list is empty. The call is the last
+ * instruction so that its return address maps to this instruction.
+ */
+static void emit_tlab_alloc(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	enum machine_reg dest = mach_reg(&insn->dest.reg);
+
+	__emit64_mov_membase_reg(buf, mach_reg(&insn->src.base_reg), insn->src.disp, dest);
+	__emit_reg_reg(buf, 1, 0x85, dest, dest);
+
+	/* jnz past the call */
+	emit(buf, 0x75);
+	emit(buf, 0x05);
+	__emit_call(buf, tlab_refill);
+}
+
+/*
+ * Replaces the object reference in the destination register with 1 if the
+ * display entry at the source displacement of its class holds the class
+ * in the source base register, and with 0 otherwise.
+ */
+static void emit_instanceof_membase_reg(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	enum machine_reg class = mach_reg(&insn->src.base_reg);
+	enum machine_reg obj = mach_reg(&insn->dest.reg);
+	unsigned long done;
+
+	/* null is not an instance of anything */
+	__emit_reg_reg(buf, 1, 0x85, obj, obj);
+	done = __emit_jcc_forward(buf, 0x84);
+
+	__emit64_mov_membase_reg(buf, obj, offsetof(struct vm_object, class), obj);
+	__emit64_mov_membase_reg(buf, obj, insn->src.disp, obj);
+
+	/* %obj = (%obj == %class) */
+	__emit_reg_reg(buf, 1, 0x29, class, obj);
+	__emit_cmp_imm_reg(buf, 1, 1, obj);
+	__emit_reg_reg(buf, 1, 0x19, obj, obj);
+	emit_alu_imm_reg(buf, 1, 0x04, 1, obj);
+
+	fixup_forward_branches(buf, &done, 1);
+}
+
+/*
+ * The object and the class are passed in RDI and RSI as the arguments of
+ * vm_object_check_cast() by the instruction selector. The call is only
+ * made when the display check fails and is the last instruction so that
+ * its return address maps to this instruction.
+ */
+static void emit_checkcast_imm(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	struct vm_class *vmc = (struct vm_class *) insn->operand.imm;
+	unsigned long done[2];
+
+	__emit_reg_reg(buf, 1, 0x85, MACH_REG_RDI, MACH_REG_RDI);
+	done[0] = __emit_jcc_forward(buf, 0x84);
+
+	__emit64_mov_membase_reg(buf, MACH_REG_RDI, offsetof(struct vm_object, class), MACH_REG_RAX);
+
+	/* cmp %rsi, display(%rax) */
+	__emit_reg_membase(buf, 1, 0x39, MACH_REG_RSI, MACH_REG_RAX, vm_class_display_offset(vmc));
+	done[1] = __emit_jcc_forward(buf, 0x84);
+
+	__emit_call(buf, vm_object_check_cast);
+
+	fixup_forward_branches(buf, done, 2);
+}
+
+/*
+ * The array and the stored reference are passed in RDI and RSI as the
+ * arguments of array_store_check() by the instruction selector. Storing
+ * null, an object of exactly the element class, or anything into an
+ * array of java/lang/Object is accepted inline. Everything else goes
+ * through array_store_check() which is the last instruction so that its
+ * return address maps to this instruction.
+ */
+static void emit_array_store_check(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	unsigned long done[3];
+
+	__emit_reg_reg(buf, 1, 0x85, MACH_REG_RSI, MACH_REG_RSI);
+	done[0] = __emit_jcc_forward(buf, 0x84);
+
+	__emit64_mov_membase_reg(buf, MACH_REG_RSI, offsetof(struct vm_object, class), MACH_REG_RAX);
+	__emit64_mov_membase_reg(buf, MACH_REG_RDI, offsetof(struct vm_object, class), MACH_REG_R10);
+	__emit64_mov_membase_reg(buf, MACH_REG_R10, offsetof(struct vm_class, array_element_class), MACH_REG_R10);
+
+	__emit_reg_reg(buf, 1, 0x39, MACH_REG_RAX, MACH_REG_R10);
+	done[1] = __emit_jcc_forward(buf, 0x84);
+
+	/* java/lang/Object is the only class at depth 0 of the display */
+	__emit_membase(buf, 0, 0x83, MACH_REG_R10, offsetof(struct vm_class, display_depth), 7);
+	emit(buf, 0x00);
+	done[2] = __emit_jcc_forward(buf, 0x84);
+
+	__emit_call(buf, array_store_check);
+
+	fixup_forward_branches(buf, done, 3);
+}
+
+static void emit_array_check(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	/* open-coded "jae" to the stub emitted by emit_array_check_stubs() */
+	emit(buf, 0x0f);
+	emit(buf, 0x83);
+	emit_imm32(buf, 0);
+}
+
+/*
+ * Emits out-of-line stubs for the failing side of array bounds checks in
+ * @bb. The stubs pass the array reference, the index and the address
+ * past the check to array_check_failed() which throws the exception.
+ */
+void emit_array_check_stubs(struct buffer *buf, struct basic_block *bb)
+{
+	struct insn *insn;
+
+	for_each_insn(insn, &bb->insn_list) {
+		unsigned char *jae_addr;
+
+		if (!insn_is_array_check(insn))
+			continue;
+
+		jae_addr = buffer_ptr(buf) + insn->mach_offset;
+
+		fixup_branch_target(jae_addr + 2, buffer_current(buf));
+
+		__emit_push_reg(buf, mach_reg(&insn->dest.reg));
+		__emit_push_reg(buf, mach_reg(&insn->src.reg));
+		__emit_mov_imm_reg(buf, (long) jae_addr + PREFIX_SIZE + BRANCH_INSN_SIZE, MACH_REG_RAX);
+		__emit_push_reg(buf, MACH_REG_RAX);
+		__emit_jmp(buf, (unsigned long) array_check_failed);
+	}
+}
+
+/*
+ * Marks the card of the address in the source register dirty:
+ *
+ *	mov	src, tmp
+ *	shr	$GC_CARD_SHIFT, tmp
+ *	movb	$GC_CARD_DIRTY, gc_card_table_bias(tmp)
+ *
+ * The heap is mapped so that gc_card_table_bias fits in a 32-bit
+ * displacement.
+ */
+static void emit_card_mark(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	enum machine_reg src = mach_reg(&insn->src.reg);
+	enum machine_reg tmp = mach_reg(&insn->dest.reg);
+	unsigned char rex_pfx = REX_W;
+
+	__emit_mov_reg_reg(buf, src, tmp);
+
+	if (reg_high(x86_encode_reg(tmp)))
+		rex_pfx |= REX_B;
+
+	emit(buf, rex_pfx);
+	emit(buf, 0xc1);
+	emit(buf, x86_encode_mod_rm(0x03, 0x05, reg_low(x86_encode_reg(tmp))));
+	emit(buf, GC_CARD_SHIFT);
+
+	__emit_membase(buf, 0, 0xc6, tmp, gc_card_table_bias, 0);
+	emit(buf, GC_CARD_DIRTY);
+}
+
 extern void jni_trampoline(void);
 
 void emit_jni_trampoline(struct buffer *buf, struct vm_method *vmm,
@@ -1476,6 +2003,46 @@ void emit_jni_trampoline(struct buffer *buf, struct vm_method *vmm,
 	jit_text_unlock();
 }
 
+/*
+ * Emits code which runs @vmm in the interpreter. The code is entered with
+ * the same register and stack state as the method's compiled code would be
+ * so we save argument registers in the same layout as the trampoline does
+ * and let native_call_get_args() pick them up. The @target is one of the
+ * interpreter bridge functions returned by vm_interp_bridge_ptr().
+ */
+void emit_interp_bridge(struct buffer *buf, struct vm_method *vmm,
+			void *target)
+{
+	jit_text_lock();
+
+	buf->buf = jit_text_ptr();
+
+	__emit_push_reg(buf, MACH_REG_RBP);
+	__emit_mov_reg_reg(buf, MACH_REG_RSP, MACH_REG_RBP);
+
+	emit_save_arg_regs(buf);
+
+	__emit_mov_imm_reg(buf, (unsigned long) vmm, MACH_REG_RDI);
+	__emit_mov_reg_reg(buf, MACH_REG_RBP, MACH_REG_RSI);
+	__emit_call(buf, target);
+
+	/*
+	 * The stack layout matches the one of trampoline here so
+	 * throw_from_trampoline() can be used to unwind the exception.
+	 */
+	emit(buf, 0x64);
+	__emit_memdisp_reg(buf, 1, 0x8b,
+			   get_thread_local_offset(&trampoline_exception_guard),
+			   MACH_REG_RCX);
+	__emit64_test_membase_reg(buf, MACH_REG_RCX, 0, MACH_REG_RCX);
+
+	emit_leave(buf);
+	emit_ret(buf);
+
+	jit_text_reserve(buffer_offset(buf));
+	jit_text_unlock();
+}
+
 /* The regparm(1) makes GCC get the first argument from %ecx and the rest
  * from the stack. This is convenient, because we use %ecx for passing the
  * hidden "method" parameter. Interfaces are invoked on objects, so we also
@@ -1617,8 +2184,12 @@ static emit_fn_t emitters[] = {
 	DECL_EMITTER(INSN_ADD_IMM_REG, insn_encode),
 	DECL_EMITTER(INSN_ADD_REG_REG, insn_encode),
 	DECL_EMITTER(INSN_AND_REG_REG, insn_encode),
+	DECL_EMITTER(INSN_ARRAY_CHECK_REG_REG, emit_array_check),
+	DECL_EMITTER(INSN_ARRAY_STORE_CHECK, emit_array_store_check),
 	DECL_EMITTER(INSN_CALL_REG, insn_encode),
 	DECL_EMITTER(INSN_CALL_REL, emit_call),
+	DECL_EMITTER(INSN_CARD_MARK_REG_REG, emit_card_mark),
+	DECL_EMITTER(INSN_CHECKCAST_IMM, emit_checkcast_imm),
 	DECL_EMITTER(INSN_CLTD_REG_REG, insn_encode),
 	DECL_EMITTER(INSN_DIVSD_XMM_XMM, insn_encode),
 	DECL_EMITTER(INSN_DIVSS_XMM_XMM, insn_encode),
@@ -1626,6 +2197,7 @@ static emit_fn_t emitters[] = {
 	DECL_EMITTER(INSN_FLD_MEMLOCAL, insn_encode),
 	DECL_EMITTER(INSN_FSTP_64_MEMLOCAL, insn_encode),
 	DECL_EMITTER(INSN_FSTP_MEMLOCAL, insn_encode),
+	DECL_EMITTER(INSN_INSTANCEOF_MEMBASE_REG, emit_instanceof_membase_reg),
 	DECL_EMITTER(INSN_JE_BRANCH, emit_je_branch),
 	DECL_EMITTER(INSN_JGE_BRANCH, emit_jge_branch),
 	DECL_EMITTER(INSN_JG_BRANCH, emit_jg_branch),
@@ -1704,6 +2276,9 @@ static emit_fn_t emitters[] = {
 	DECL_EMITTER(INSN_MUL_REG_REG, emit_mul_reg_reg),
 	DECL_EMITTER(INSN_PUSH_IMM, emit_push_imm),
 	DECL_EMITTER(INSN_TEST_MEMBASE_REG, emit_test_membase_reg),
+	DECL_EMITTER(INSN_TLAB_ALLOC_MEMBASE_REG, emit_tlab_alloc),
+	DECL_EMITTER(INSN_MONITOR_ENTER_REG, emit_monitor_enter_reg),
+	DECL_EMITTER(INSN_MONITOR_EXIT_REG, emit_monitor_exit_reg),
 	DECL_EMITTER(INSN_TEST_IMM_MEMDISP, emit_test_imm_memdisp),
 	DECL_EMITTER(INSN_SAVE_CALLER_REGS, emit_pseudo),
 	DECL_EMITTER(INSN_RESTORE_CALLER_REGS, emit_pseudo),
@@ -1736,3 +2311,37 @@ void emit_nop(struct buffer *buf)
 {
 	emit(buf, 0x90);
 }
+
+/*
+ * Emits a 5-byte nop that fixup_method_entry() can atomically replace with
+ * a jump. The nop is aligned so that its first two bytes can be written
+ * with a single store.
+ */
+void *emit_patchable_entry(struct buffer *buf)
+{
+	void *entry;
+
+	while (buffer_offset(buf) & 1)
+		emit(buf, 0x90);
+
+	entry = buffer_current(buf);
+
+	/* nopl 0x0(%eax,%eax,1) */
+	emit(buf, 0x0f);
+	emit(buf, 0x1f);
+	emit(buf, 0x44);
+	emit(buf, 0x00);
+	emit(buf, 0x00);
+
+	return entry;
+}
+
+/*
+ * On-stack replacement is not supported because arguments are passed in
+ * registers. See jit/osr.c.
+ */
+void *emit_osr_entry(struct buffer *buf, struct stack_frame *frame,
+		     unsigned long frame_size)
+{
+	return NULL;
+}
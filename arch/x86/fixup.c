@@ -1,8 +1,10 @@
 #include "jit/cu-mapping.h"
 #include "jit/compiler.h"
+#include "jit/deopt.h"
 #include "arch/encode.h"
 #include "lib/list.h"
 #include "vm/class.h"
+#include "vm/die.h"
 
 #include "valgrind/valgrind.h"
 
@@ -61,6 +63,97 @@ void fixup_direct_calls(struct jit_trampoline *t, unsigned long target)
 	pthread_mutex_unlock(&t->mutex);
 }
 
+/*
+ * Redirects the devirtualized call at @site to @target. The call is no
+ * longer fixed up when the method behind trampoline @t gets compiled.
+ */
+void fixup_cha_call_site(struct jit_trampoline *t, void *site, void *target)
+{
+	struct fixup_site *this, *next;
+
+	pthread_mutex_lock(&t->mutex);
+
+	list_for_each_entry_safe(this, next, &t->fixup_site_list, list_node) {
+		if (fixup_site_addr(this) != site)
+			continue;
+
+		list_del(&this->list_node);
+		free_fixup_site(this);
+	}
+
+	cpu_write_u32(site + 1, x86_call_disp(site, target));
+
+	VALGRIND_DISCARD_TRANSLATIONS(site, X86_CALL_INSN_SIZE);
+
+	pthread_mutex_unlock(&t->mutex);
+}
+
+/*
+ * Replaces the 5-byte nop at @site (see emit_patchable_entry()) with a
+ * relative jump or call to @target. The first two bytes are replaced with a
+ * jump to itself before the displacement is written so that a thread
+ * executing the site never sees a partially written instruction.
+ */
+static void patch_rel32_insn(void *site, unsigned char opc, void *target)
+{
+	unsigned char *p = site;
+	unsigned long disp;
+
+	disp = x86_call_disp(site, target);
+
+	/* jmp . */
+	cpu_write_u16(p, 0xfeeb);
+	barrier();
+
+	p[2] = (disp >> 8) & 0xff;
+	p[3] = (disp >> 16) & 0xff;
+	p[4] = (disp >> 24) & 0xff;
+	barrier();
+
+	cpu_write_u16(p, opc | (disp & 0xff) << 8);
+
+	VALGRIND_DISCARD_TRANSLATIONS(site, X86_CALL_INSN_SIZE);
+}
+
+/*
+ * This patches the patchable entry of a method with a jump to @target.
+ */
+void fixup_method_entry(void *entry, void *target)
+{
+	/* jmp <target> */
+	patch_rel32_insn(entry, 0xe9, target);
+}
+
+/*
+ * This patches a deoptimization site (see jit/deopt.c) with a call to the
+ * trampoline that moves the frame to the interpreter. The trampoline
+ * picks up the return value of the call before the site so it depends on
+ * @return_type.
+ */
+void fixup_deopt_site(void *site, enum vm_type return_type)
+{
+#ifdef CONFIG_X86_32
+	void *target;
+
+	switch (return_type) {
+	case J_FLOAT:
+		target = deopt_trampoline_float;
+		break;
+	case J_DOUBLE:
+		target = deopt_trampoline_double;
+		break;
+	default:
+		target = deopt_trampoline;
+		break;
+	}
+
+	/* call <target> */
+	patch_rel32_insn(site, 0xe8, target);
+#else
+	die("deoptimization is not supported");
+#endif
+}
+
 static void do_fixup_static(void *site_addr, int skip_count, void *new_target)
 {
 	void *p = site_addr + skip_count;
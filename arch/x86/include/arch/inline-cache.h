@@ -8,6 +8,9 @@
 #define IC_IMM_REG	MACH_REG_xAX
 #define IC_CLASS_REG	MACH_REG_xCX
 
+/* Maximum number of receiver classes in a polymorphic inline cache */
+#define IC_MAX_PIC_ENTRIES	4
+
 struct vm_class;
 struct vm_method;
 struct compilation_unit;
@@ -20,5 +23,6 @@ void *resolve_ic_miss(struct vm_class *vmc, struct vm_method *vmm, void *callsit
 
 void ic_start(void);
 void ic_vcall_stub(void);
+void ic_itable_stub(void);
 
 #endif /* INLINE_CACHE_H */
@@ -99,8 +99,12 @@ enum insn_type {
 	INSN_ADD_REG_REG,
 	INSN_AND_MEMBASE_REG,
 	INSN_AND_REG_REG,
+	INSN_ARRAY_CHECK_REG_REG,
+	INSN_ARRAY_STORE_CHECK,
 	INSN_CALL_REG,
 	INSN_CALL_REL,
+	INSN_CARD_MARK_REG_REG,
+	INSN_CHECKCAST_IMM,
 	INSN_CLTD_REG_REG,	/* CDQ in Intel manuals */
 	INSN_CMP_IMM_REG,
 	INSN_CMP_MEMBASE_REG,
@@ -128,6 +132,7 @@ enum insn_type {
 	INSN_FSTP_MEMBASE,
 	INSN_FSTP_MEMLOCAL,
 	INSN_IC_CALL,
+	INSN_INSTANCEOF_MEMBASE_REG,
 	INSN_JE_BRANCH,
 	INSN_JGE_BRANCH,
 	INSN_JG_BRANCH,
@@ -137,6 +142,8 @@ enum insn_type {
 	INSN_JMP_MEMBASE,
 	INSN_JMP_MEMINDEX,
 	INSN_JNE_BRANCH,
+	INSN_MONITOR_ENTER_REG,
+	INSN_MONITOR_EXIT_REG,
 	INSN_MOVSD_MEMBASE_XMM,
 	INSN_MOVSD_MEMDISP_XMM,
 	INSN_MOVSD_MEMINDEX_XMM,
@@ -209,6 +216,7 @@ enum insn_type {
 	INSN_SUB_REG_REG,
 	INSN_TEST_IMM_MEMDISP,
 	INSN_TEST_MEMBASE_REG,
+	INSN_TLAB_ALLOC_MEMBASE_REG,
 	INSN_XORPD_XMM_XMM,
 	INSN_XOR_MEMBASE_REG,
 	INSN_XOR_REG_REG,
@@ -231,6 +239,9 @@ enum insn_flag_type {
 	INSN_FLAG_KNOWN_BC_OFFSET	= 1U << 2,
 	INSN_FLAG_BACKPATCH_BRANCH	= 1U << 3,
 	INSN_FLAG_BACKPATCH_RESOLUTION	= 1U << 4,
+	INSN_FLAG_DEOPT_POINT		= 1U << 5,
+	INSN_FLAG_VOLATILE		= 1U << 6,
+	INSN_FLAG_SAFEPOINT_POLL	= 1U << 7,
 };
 
 struct insn {
@@ -321,7 +332,10 @@ unsigned long nr_srcs_phi(struct insn *insn);
 
 static inline bool insn_is_call(struct insn *insn)
 {
-	return insn->type == INSN_IC_CALL || insn->type == INSN_CALL_REG || insn->type == INSN_CALL_REL;
+	return insn->type == INSN_IC_CALL || insn->type == INSN_CALL_REG || insn->type == INSN_CALL_REL
+		|| insn->type == INSN_TLAB_ALLOC_MEMBASE_REG || insn->type == INSN_CHECKCAST_IMM
+		|| insn->type == INSN_ARRAY_STORE_CHECK
+		|| insn->type == INSN_MONITOR_ENTER_REG || insn->type == INSN_MONITOR_EXIT_REG;
 }
 
 static inline bool insn_is_call_to(struct insn *insn, void *target)
@@ -332,6 +346,11 @@ static inline bool insn_is_call_to(struct insn *insn, void *target)
 	return insn->operand.rel == (unsigned long) target;
 }
 
+static inline bool insn_is_array_check(struct insn *insn)
+{
+	return insn->type == INSN_ARRAY_CHECK_REG_REG;
+}
+
 static inline bool insn_is_jmp_branch(struct insn *insn)
 {
 	return insn->type == INSN_JMP_BRANCH;
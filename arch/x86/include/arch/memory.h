@@ -22,6 +22,16 @@
 
 #define barrier() __asm__ __volatile__("": : :"memory")
 
+/*
+ * Hint for busy-wait loops.
+ */
+#define cpu_relax() asm volatile("rep; nop" ::: "memory")
+
+static inline void cpu_write_u16(unsigned char *p, uint16_t val)
+{
+	*((uint16_t*)p) = val;
+}
+
 static inline void cpu_write_u32(unsigned char *p, uint32_t val)
 {
 	*((uint32_t*)p) = val;
@@ -87,15 +87,17 @@ static inline bool reg_supports_type(enum machine_reg reg, enum vm_type type)
 
 struct register_state {
 	uint64_t			ip;
+	unsigned long			sp;
+	unsigned long			bp;
 	union {
-		unsigned long		regs[6];
+		unsigned long		regs[NR_GP_REGISTERS];	/* indexed by enum machine_reg */
 		struct {
 			unsigned long	eax;
-			unsigned long	ebx;
 			unsigned long	ecx;
-			unsigned long	edi;
 			unsigned long	edx;
+			unsigned long	ebx;
 			unsigned long	esi;
+			unsigned long	edi;
 		};
 	};
 };
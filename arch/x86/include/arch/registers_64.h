@@ -104,13 +104,15 @@ bool reg_supports_type(enum machine_reg reg, enum vm_type type);
 
 struct register_state {
 	uint64_t			ip;
+	unsigned long			sp;
+	unsigned long			bp;
 	union {
-		unsigned long		regs[14];
+		unsigned long		regs[NR_GP_REGISTERS];	/* indexed by enum machine_reg */
 		struct {
 			unsigned long	rax;
-			unsigned long	rbx;
 			unsigned long	rcx;
 			unsigned long	rdx;
+			unsigned long	rbx;
 			unsigned long	rsi;
 			unsigned long	rdi;
 			unsigned long	r8;
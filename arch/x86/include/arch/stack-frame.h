@@ -20,6 +20,8 @@ struct native_stack_frame {
 
 #define NR_TRAMPOLINE_LOCALS	0
 
+#define STACK_RED_ZONE_SIZE	0
+
 struct jit_stack_frame {
 	void *prev; /* previous stack frame link */
 	unsigned long return_address;
@@ -30,6 +32,9 @@ struct jit_stack_frame {
 
 #define NR_TRAMPOLINE_LOCALS	14
 
+/* Leaf functions may keep data below the stack pointer. */
+#define STACK_RED_ZONE_SIZE	128
+
 struct jit_stack_frame {
 	void *prev; /* previous stack frame link */
 	unsigned long return_address;
@@ -44,5 +49,9 @@ unsigned long slot_offset_64(struct stack_slot *slot);
 unsigned long frame_locals_size(struct stack_frame *frame);
 unsigned long cu_frame_locals_offset(struct compilation_unit *cu);
 unsigned long cu_frame_total_offset(struct compilation_unit *cu);
+void **frame_slot_ptr(struct compilation_unit *cu, void *frame, unsigned long index);
+void **frame_callee_save_ptr(struct compilation_unit *cu, void *frame, unsigned int i);
+void *frame_bottom(struct compilation_unit *cu, void *frame);
+void *frame_args_end(struct compilation_unit *cu, void *frame);
 
 #endif
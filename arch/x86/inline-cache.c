@@ -5,8 +5,12 @@
 #include "jit/inline-cache.h"
 #include "jit/instruction.h"
 #include "jit/cu-mapping.h"
+#include "jit/emit-code.h"
+
+#include "lib/hash-map.h"
 
 #include "vm/method.h"
+#include "vm/stdlib.h"
 #include "vm/class.h"
 #include "vm/trace.h"
 #include "vm/die.h"
@@ -17,6 +21,7 @@
 #include <stdbool.h>
 #include <pthread.h>
 #include <assert.h>
+#include <stdlib.h>
 
 #define X86_MOV_IMM_REG_INSN_SIZE 	5
 #define X86_MOV_IMM_REG_IMM_OFFSET 	1
@@ -27,8 +32,27 @@ struct x86_ic {
 	unsigned long		imm;
 };
 
+enum ic_state {
+	IC_STATE_UNLINKED,
+	IC_STATE_MONOMORPHIC,
+	IC_STATE_POLYMORPHIC,
+	IC_STATE_MEGAMORPHIC,
+};
+
+struct x86_ic_site {
+	struct vm_method	*method;
+	enum ic_state		state;
+	unsigned int		nr_entries;
+	struct vm_class		*classes[IC_MAX_PIC_ENTRIES];
+	void			*targets[IC_MAX_PIC_ENTRIES];
+	unsigned long		nr_misses;
+	unsigned long		nr_transitions;
+};
+
 static pthread_mutex_t ic_patch_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/* Maps call site addresses to struct x86_ic_site */
+static struct hash_map *ic_sites;
 
 static void ic_from_callsite(struct x86_ic *ic, unsigned long callsite)
 {
@@ -85,6 +109,84 @@ bool ic_supports_method(struct vm_method *vmm)
 		&& !vm_class_is_primitive_class(vmm->class);
 }
 
+/*
+ * Returns the per-call-site inline cache state for @callsite. Must be
+ * called with ic_patch_lock held.
+ */
+static struct x86_ic_site *get_ic_site(void *callsite)
+{
+	struct x86_ic_site *site;
+
+	if (!ic_sites) {
+		ic_sites = alloc_hash_map(&pointer_key);
+		if (!ic_sites)
+			return NULL;
+	}
+
+	if (hash_map_get(ic_sites, callsite, (void **) &site) == 0)
+		return site;
+
+	site = zalloc(sizeof *site);
+	if (!site)
+		return NULL;
+
+	if (hash_map_put(ic_sites, callsite, site)) {
+		free(site);
+		return NULL;
+	}
+
+	return site;
+}
+
+static bool ic_site_has_class(struct x86_ic_site *site, struct vm_class *vmc)
+{
+	unsigned int i;
+
+	for (i = 0; i < site->nr_entries; i++) {
+		if (site->classes[i] == vmc)
+			return true;
+	}
+
+	return false;
+}
+
+static const char *ic_state_names[] = {
+	[IC_STATE_UNLINKED]	= "unlinked",
+	[IC_STATE_MONOMORPHIC]	= "monomorphic",
+	[IC_STATE_POLYMORPHIC]	= "polymorphic",
+	[IC_STATE_MEGAMORPHIC]	= "megamorphic",
+};
+
+static void trace_ic_transition(struct x86_ic_site *site, void *callsite,
+				enum ic_state state, struct vm_class *vmc)
+{
+	struct compilation_unit *cu;
+
+	cu = jit_lookup_cu((unsigned long) callsite);
+
+	trace_printf("[ic] %p", callsite);
+	if (cu) {
+		trace_printf(" in %s.%s%s", cu->method->class->name,
+			     cu->method->name, cu->method->type);
+	}
+
+	trace_printf(": %s -> %s (class %s, %u entries, %lu misses, %lu transitions)\n",
+		     ic_state_names[site->state], ic_state_names[state],
+		     vmc->name, site->nr_entries, site->nr_misses,
+		     site->nr_transitions + 1);
+	trace_flush();
+}
+
+static void ic_set_state(struct x86_ic_site *site, void *callsite,
+			 enum ic_state state, struct vm_class *vmc)
+{
+	if (opt_trace_ic)
+		trace_ic_transition(site, callsite, state, vmc);
+
+	site->state = state;
+	site->nr_transitions++;
+}
+
 static void ic_set_to_monomorphic(struct vm_class *vmc, struct vm_method *vmm, void *callsite)
 {
 	struct x86_ic ic;
@@ -101,14 +203,8 @@ static void ic_set_to_monomorphic(struct vm_class *vmc, struct vm_method *vmm, v
 	assert(is_valid_ic(&ic));
 	assert(ic_entry_point);
 
-	if (pthread_mutex_lock(&ic_patch_lock) != 0)
-		die("Failed to lock ic_patch_lock\n");
-
 	cpu_write_u32((void *) ic.fn, x86_call_disp(callsite, ic_entry_point));
 	cpu_write_u32((void *) ic.imm, (unsigned long) vmc);
-
-	if (pthread_mutex_unlock(&ic_patch_lock) != 0)
-		die("Failed to unlock ic_patch_lock\n");
 }
 
 static void ic_set_to_megamorphic(struct vm_method *vmm, void *callsite)
@@ -121,20 +217,166 @@ static void ic_set_to_megamorphic(struct vm_method *vmm, void *callsite)
 	ic_from_callsite(&ic, (unsigned long)callsite);
 	assert(is_valid_ic(&ic));
 
+	/*
+	 * Patch the immediate first so that a concurrent caller that still
+	 * goes through the old target takes the miss path instead of
+	 * jumping to the dispatch stub with a class pointer as its operand.
+	 */
+	if (vm_class_is_interface(vmm->class)) {
+		/* ic_itable_stub expects the interface method in IC_IMM_REG */
+		cpu_write_u32((void *) ic.imm, (unsigned long) vmm);
+		cpu_write_u32((void *) ic.fn, x86_call_disp(callsite, ic_itable_stub));
+	} else {
+		cpu_write_u32((void *) ic.imm, (uint32_t)(vmm->virtual_index * sizeof(void *)));
+		cpu_write_u32((void *) ic.fn, x86_call_disp(callsite, ic_vcall_stub));
+	}
+}
+
+static bool ic_set_to_polymorphic(struct x86_ic_site *site, struct vm_method *vmm, void *callsite)
+{
+	struct x86_ic ic;
+	void *stub;
+
+	assert(vmm);
+	assert(callsite);
+
+	ic_from_callsite(&ic, (unsigned long)callsite);
+	assert(is_valid_ic(&ic));
+
+	stub = emit_ic_pic_stub(vmm, site->classes, site->targets, site->nr_entries);
+	if (!stub)
+		return false;
+
+	cpu_write_u32((void *) ic.fn, x86_call_disp(callsite, stub));
+
+	return true;
+}
+
+/*
+ * Moves the inline cache at @callsite to its next state after a lookup of
+ * @vmm for receiver class @vmc resolved to @c_vmm. Call sites start
+ * unlinked, become monomorphic on the first call, polymorphic when a
+ * second receiver class is seen and megamorphic once more than
+ * IC_MAX_PIC_ENTRIES receiver classes have been seen.
+ */
+static void ic_update(void *callsite, struct vm_class *vmc,
+		      struct vm_method *vmm, struct vm_method *c_vmm)
+{
+	struct x86_ic_site *site;
+
+	if (pthread_mutex_lock(&ic_patch_lock) != 0)
+		die("Failed to lock ic_patch_lock\n");
+
+	site = get_ic_site(callsite);
+	if (!site) {
+		ic_set_to_megamorphic(vmm, callsite);
+		goto out_unlock;
+	}
+
+	if (!site->method)
+		site->method = vmm;
+	vmm = site->method;
+
+	if (site->state != IC_STATE_UNLINKED)
+		site->nr_misses++;
+
+	/*
+	 * Another thread can miss on a stale call target while we are
+	 * patching the call site so ignore misses for cached classes.
+	 */
+	if (site->state == IC_STATE_MEGAMORPHIC || ic_site_has_class(site, vmc))
+		goto out_unlock;
+
+	if (!vm_method_is_compiled(c_vmm))
+		goto out_unlock;
+
+	if (site->nr_entries == IC_MAX_PIC_ENTRIES) {
+		ic_set_state(site, callsite, IC_STATE_MEGAMORPHIC, vmc);
+		ic_set_to_megamorphic(vmm, callsite);
+		goto out_unlock;
+	}
+
+	site->classes[site->nr_entries] = vmc;
+	site->targets[site->nr_entries] = vm_method_entry_point(c_vmm);
+	site->nr_entries++;
+
+	if (site->state == IC_STATE_UNLINKED) {
+		ic_set_state(site, callsite, IC_STATE_MONOMORPHIC, vmc);
+		ic_set_to_monomorphic(vmc, c_vmm, callsite);
+	} else if (ic_set_to_polymorphic(site, vmm, callsite)) {
+		if (site->state != IC_STATE_POLYMORPHIC)
+			ic_set_state(site, callsite, IC_STATE_POLYMORPHIC, vmc);
+	} else {
+		ic_set_state(site, callsite, IC_STATE_MEGAMORPHIC, vmc);
+		ic_set_to_megamorphic(vmm, callsite);
+	}
+
+out_unlock:
+	if (pthread_mutex_unlock(&ic_patch_lock) != 0)
+		die("Failed to unlock ic_patch_lock\n");
+}
+
+/*
+ * Returns the method invoked at @callsite. The miss handler of a
+ * monomorphic call target passes the target method which is not the
+ * invoked method for interface call sites.
+ */
+static struct vm_method *ic_site_method(void *callsite, struct vm_method *vmm)
+{
+	struct x86_ic_site *site;
+
 	if (pthread_mutex_lock(&ic_patch_lock) != 0)
 		die("Failed to lock ic_patch_lock\n");
-	cpu_write_u32((void *) ic.fn, x86_call_disp(callsite, ic_vcall_stub));
-	cpu_write_u32((void *) ic.imm, (uint32_t)(vmm->virtual_index * sizeof(void *)));
+
+	if (ic_sites && hash_map_get(ic_sites, callsite, (void **) &site) == 0 && site->method)
+		vmm = site->method;
+
 	if (pthread_mutex_unlock(&ic_patch_lock) != 0)
 		die("Failed to unlock ic_patch_lock\n");
+
+	return vmm;
+}
+
+/*
+ * Returns the method that @vmc dispatches @vmm to. If the class has no
+ * implementation, an abstract method is returned whose trampoline throws
+ * AbstractMethodError; such a target must not be cached.
+ */
+static struct vm_method *ic_lookup_method(struct vm_class *vmc, struct vm_method *vmm)
+{
+	struct vm_method *impl;
+	struct compilation_unit *cu;
+	void *entry_point;
+
+	/*
+	 * Interface methods don't have a vtable index that is valid for
+	 * every receiver class so look up the implementing method first.
+	 */
+	if (vm_class_is_interface(vmm->class)) {
+		impl = vm_class_get_method_recursive(vmc, vmm->name, vmm->type);
+		if (!impl)
+			return vmm;
+
+		vmm = impl;
+	}
+
+	if (vm_method_is_abstract(vmm))
+		return vmm;
+
+	entry_point = ic_lookup_vtable(vmc, vmm);
+	assert(entry_point);
+
+	cu = jit_lookup_cu((unsigned long)entry_point);
+	assert(cu);
+	assert(cu->method);
+
+	return cu->method;
 }
 
 void *do_ic_setup(struct vm_class *vmc, struct vm_method *i_vmm, void *return_addr)
 {
 	void *callsite = return_addr - X86_CALL_INSN_SIZE;
-	struct compilation_unit *cu;
 	struct vm_method *c_vmm;
-	void *entry_point;
 	struct x86_ic ic;
 
 	assert(vmc);
@@ -144,19 +386,10 @@ void *do_ic_setup(struct vm_class *vmc, struct vm_method *i_vmm, void *return_ad
 	ic_from_callsite(&ic, (unsigned long) callsite);
 	assert(is_valid_ic(&ic));
 
-	entry_point = ic_lookup_vtable(vmc, i_vmm);
-	assert(entry_point);
-
-	cu = jit_lookup_cu((unsigned long)entry_point);
-	assert(cu);
+	c_vmm = ic_lookup_method(vmc, i_vmm);
 
-	c_vmm = cu->method;
-
-	assert(c_vmm);
-
-	if (vm_method_is_compiled(c_vmm)) {
-		ic_set_to_monomorphic(vmc, c_vmm, callsite);
-	}
+	if (!vm_method_is_abstract(c_vmm))
+		ic_update(callsite, vmc, i_vmm, c_vmm);
 
 	return vm_method_call_ptr(c_vmm);
 }
@@ -204,6 +437,9 @@ int convert_ic_calls(struct compilation_unit *cu)
 		if (!call_insn)
 			return -ENOMEM;
 
+		call_insn->flags |= insn->flags & (INSN_FLAG_DEOPT_POINT | INSN_FLAG_SAFEPOINT);
+		call_insn->lir_pos = insn->lir_pos;
+
 		bc_offset = insn_get_bc_offset(insn);
 		insn_set_bc_offset(class_insn, bc_offset);
 		insn_set_bc_offset(imm_insn, bc_offset);
@@ -224,8 +460,14 @@ int convert_ic_calls(struct compilation_unit *cu)
 void *resolve_ic_miss(struct vm_class *vmc, struct vm_method *vmm, void *return_addr)
 {
 	void *callsite = return_addr - X86_CALL_INSN_SIZE;
+	struct vm_method *c_vmm;
 
-	ic_set_to_megamorphic(vmm, callsite);
+	vmm = ic_site_method(callsite, vmm);
 
-	return ic_lookup_vtable(vmc, vmm);
+	c_vmm = ic_lookup_method(vmc, vmm);
+
+	if (!vm_method_is_abstract(c_vmm))
+		ic_update(callsite, vmc, vmm, c_vmm);
+
+	return vm_method_call_ptr(c_vmm);
 }
@@ -774,8 +774,12 @@ static unsigned long insn_flags[] = {
 	[INSN_ADD_REG_REG]			= USE_SRC | USE_DST | DEF_DST,
 	[INSN_AND_MEMBASE_REG]			= USE_SRC | USE_DST | DEF_DST,
 	[INSN_AND_REG_REG]			= USE_SRC | USE_DST | DEF_DST,
+	[INSN_ARRAY_CHECK_REG_REG]		= USE_SRC | USE_DST,
+	[INSN_ARRAY_STORE_CHECK]		= USE_NONE | DEF_NONE | TYPE_CALL,
 	[INSN_CALL_REG]				= USE_DST | DEF_NONE | TYPE_CALL,
 	[INSN_CALL_REL]				= USE_NONE | DEF_NONE | TYPE_CALL,
+	[INSN_CARD_MARK_REG_REG]		= USE_SRC | DEF_DST,
+	[INSN_CHECKCAST_IMM]			= USE_NONE | DEF_NONE | TYPE_CALL,
 	[INSN_CLTD_REG_REG]			= USE_SRC | DEF_SRC | DEF_DST,
 	[INSN_CMP_IMM_REG]			= USE_DST,
 	[INSN_CMP_MEMBASE_REG]			= USE_SRC | USE_DST,
@@ -803,6 +807,7 @@ static unsigned long insn_flags[] = {
 	[INSN_FSTP_MEMBASE]			= USE_SRC | DEF_NONE,
 	[INSN_FSTP_MEMLOCAL]			= USE_FP | DEF_NONE,
 	[INSN_IC_CALL]				= USE_SRC | DEF_xAX | DEF_xCX | TYPE_CALL,
+	[INSN_INSTANCEOF_MEMBASE_REG]		= USE_SRC | USE_DST | DEF_DST,
 	[INSN_JE_BRANCH]			= USE_NONE | DEF_NONE | TYPE_BRANCH,
 	[INSN_JGE_BRANCH]			= USE_NONE | DEF_NONE | TYPE_BRANCH,
 	[INSN_JG_BRANCH]			= USE_NONE | DEF_NONE | TYPE_BRANCH,
@@ -812,6 +817,8 @@ static unsigned long insn_flags[] = {
 	[INSN_JMP_MEMBASE]			= USE_DST | DEF_NONE | TYPE_BRANCH,
 	[INSN_JMP_MEMINDEX]			= USE_IDX_DST | USE_DST | DEF_NONE | TYPE_BRANCH,
 	[INSN_JNE_BRANCH]			= USE_NONE | DEF_NONE | TYPE_BRANCH,
+	[INSN_MONITOR_ENTER_REG]		= USE_SRC | DEF_NONE | TYPE_CALL,
+	[INSN_MONITOR_EXIT_REG]			= USE_SRC | DEF_NONE | TYPE_CALL,
 	[INSN_MOVSD_MEMBASE_XMM]		= USE_SRC | DEF_DST,
 	[INSN_MOVSD_MEMDISP_XMM]		= USE_NONE | DEF_DST,
 	[INSN_MOVSD_MEMINDEX_XMM]		= USE_SRC | USE_IDX_SRC | DEF_DST,
@@ -884,6 +891,7 @@ static unsigned long insn_flags[] = {
 	[INSN_SUB_REG_REG]			= USE_SRC | USE_DST | DEF_DST,
 	[INSN_TEST_IMM_MEMDISP]			= USE_NONE | DEF_NONE,
 	[INSN_TEST_MEMBASE_REG]			= USE_SRC | USE_DST | DEF_NONE,
+	[INSN_TLAB_ALLOC_MEMBASE_REG]		= USE_SRC | DEF_DST | TYPE_CALL,
 	[INSN_XORPD_XMM_XMM]			= USE_SRC | USE_DST | DEF_DST,
 	[INSN_XOR_MEMBASE_REG]			= USE_SRC | USE_DST | DEF_DST,
 	[INSN_XOR_REG_REG]			= USE_SRC | USE_DST | DEF_DST,
@@ -14,6 +14,7 @@
 #include "jit/compiler.h"
 #include "jit/vars.h"
 
+#include "vm/class.h"
 #include "vm/method.h"
 #include "vm/die.h"
 
@@ -362,6 +363,12 @@ static int print_fstp_memlocal(struct string *str, struct insn *insn)
 	return print_memlocal(str, &insn->operand);
 }
 
+static int print_instanceof_membase_reg(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_membase_reg(str, insn);
+}
+
 static int print_ic_call(struct string *str, struct insn *insn)
 {
 	print_func_name(str);
@@ -407,6 +414,17 @@ static int print_and_reg_reg(struct string *str, struct insn *insn)
 	return print_reg_reg(str, insn);
 }
 
+static int print_array_check_reg_reg(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_reg_reg(str, insn);
+}
+
+static int print_array_store_check(struct string *str, struct insn *insn)
+{
+	return print_func_name(str);
+}
+
 static int print_call_reg(struct string *str, struct insn *insn)
 {
 	print_func_name(str);
@@ -421,6 +439,19 @@ static int print_call_rel(struct string *str, struct insn *insn)
 	return print_rel(str, &insn->operand);
 }
 
+static int print_card_mark_reg_reg(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_reg_reg(str, insn);
+}
+
+static int print_checkcast_imm(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	print_imm(str, &insn->operand);
+	return str_append(str, "<%s>", ((struct vm_class *)insn->operand.imm)->name);
+}
+
 static int print_cltd_reg_reg(struct string *str, struct insn *insn)	/* CDQ in Intel manuals*/
 {
 	print_func_name(str);
@@ -457,6 +488,18 @@ static int print_div_reg_reg(struct string *str, struct insn *insn)
 	return print_reg_reg(str, insn);
 }
 
+static int print_monitor_enter_reg(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_reg(str, &insn->operand);
+}
+
+static int print_monitor_exit_reg(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_reg(str, &insn->operand);
+}
+
 static int print_movss_membase_xmm(struct string *str, struct insn *insn)
 {
 	print_func_name(str);
@@ -932,6 +975,12 @@ static int print_test_membase_reg(struct string *str, struct insn *insn)
 	return print_membase_reg(str, insn);
 }
 
+static int print_tlab_alloc_membase_reg(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_membase_reg(str, insn);
+}
+
 static int print_xor_membase_reg(struct string *str, struct insn *insn)
 {
 	print_func_name(str);
@@ -999,8 +1048,12 @@ static print_insn_fn insn_printers[] = {
 	[INSN_ADD_REG_REG] = print_add_reg_reg,
 	[INSN_AND_MEMBASE_REG] = print_and_membase_reg,
 	[INSN_AND_REG_REG] = print_and_reg_reg,
+	[INSN_ARRAY_CHECK_REG_REG] = print_array_check_reg_reg,
+	[INSN_ARRAY_STORE_CHECK] = print_array_store_check,
 	[INSN_CALL_REG] = print_call_reg,
 	[INSN_CALL_REL] = print_call_rel,
+	[INSN_CARD_MARK_REG_REG] = print_card_mark_reg_reg,
+	[INSN_CHECKCAST_IMM] = print_checkcast_imm,
 	[INSN_CLTD_REG_REG] = print_cltd_reg_reg,	/* CDQ in Intel manuals*/
 	[INSN_CMP_IMM_REG] = print_cmp_imm_reg,
 	[INSN_CMP_MEMBASE_REG] = print_cmp_membase_reg,
@@ -1028,6 +1081,7 @@ static print_insn_fn insn_printers[] = {
 	[INSN_FSTP_MEMBASE] = print_fstp_membase,
 	[INSN_FSTP_MEMLOCAL] = print_fstp_memlocal,
 	[INSN_IC_CALL] = print_ic_call,
+	[INSN_INSTANCEOF_MEMBASE_REG] = print_instanceof_membase_reg,
 	[INSN_JE_BRANCH] = print_je_branch,
 	[INSN_JGE_BRANCH] = print_jge_branch,
 	[INSN_JG_BRANCH] = print_jg_branch,
@@ -1037,6 +1091,8 @@ static print_insn_fn insn_printers[] = {
 	[INSN_JMP_MEMBASE] = print_jmp_membase,
 	[INSN_JMP_MEMINDEX] = print_jmp_memindex,
 	[INSN_JNE_BRANCH] = print_jne_branch,
+	[INSN_MONITOR_ENTER_REG] = print_monitor_enter_reg,
+	[INSN_MONITOR_EXIT_REG] = print_monitor_exit_reg,
 	[INSN_MOVSD_MEMBASE_XMM] = print_movsd_membase_xmm,
 	[INSN_MOVSD_MEMDISP_XMM] = print_movsd_memdisp_xmm,
 	[INSN_MOVSD_MEMINDEX_XMM] = print_movsd_memindex_xmm,
@@ -1106,6 +1162,7 @@ static print_insn_fn insn_printers[] = {
 	[INSN_SUB_REG_REG] = print_sub_reg_reg,
 	[INSN_TEST_IMM_MEMDISP] = print_test_imm_memdisp,
 	[INSN_TEST_MEMBASE_REG] = print_test_membase_reg,
+	[INSN_TLAB_ALLOC_MEMBASE_REG] = print_tlab_alloc_membase_reg,
 	[INSN_XORPD_XMM_XMM] = print_xor_64_xmm_reg_reg,
 	[INSN_XORPS_XMM_XMM] = print_xor_xmm_reg_reg,
 	[INSN_XOR_MEMBASE_REG] = print_xor_membase_reg,
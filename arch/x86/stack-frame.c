@@ -125,6 +125,45 @@ unsigned long cu_frame_total_offset(struct compilation_unit *cu)
 	       cu_frame_misc_size(cu);
 }
 
+/*
+ * Returns the address of the word of stack slot @index in @frame, a frame
+ * of @cu.
+ */
+void **frame_slot_ptr(struct compilation_unit *cu, void *frame,
+		      unsigned long index)
+{
+	return frame + index_to_offset(index, 1, cu->stack_frame->nr_args);
+}
+
+/*
+ * Returns the address where the prologue of @cu saved the register
+ * callee_save_regs[@i] of the caller of @frame.
+ */
+void **frame_callee_save_ptr(struct compilation_unit *cu, void *frame,
+			     unsigned int i)
+{
+	return frame - cu_frame_locals_offset(cu) -
+		(i + 1) * sizeof(unsigned long);
+}
+
+/*
+ * Returns the lowest address of the part of @frame that the prologue of
+ * @cu reserves.
+ */
+void *frame_bottom(struct compilation_unit *cu, void *frame)
+{
+	return frame - cu_frame_total_offset(cu);
+}
+
+/*
+ * Returns the address right after the stack arguments of @frame.
+ */
+void *frame_args_end(struct compilation_unit *cu, void *frame)
+{
+	return frame + ARGS_START_OFFSET +
+		__index_to_offset(cu->stack_frame->nr_args);
+}
+
 /*
  * Checks whether given native function was called from jit trampoline
  * code. It checks whether return address points after a relative call
@@ -479,6 +479,7 @@ GC_stop_func stop_func;
 {
     register int i;
     int dummy;
+    unsigned long pause_start;
 #   if defined(PRINTTIMES) || defined(CONDPRINT)
 	CLOCK_TYPE start_time, current_time;
 #   endif
@@ -492,6 +493,11 @@ GC_stop_func stop_func;
 #   if defined(REGISTER_LIBRARIES_EARLY)
         GC_cond_register_dynamic_libraries();
 #   endif
+    pause_start = GC_usecs();
+    GC_last_marker_busy_usecs = 0;
+    GC_last_collection_start_usecs = pause_start;
+    GC_last_bytes_allocd = WORDS_TO_BYTES(GC_words_allocd);
+    GC_last_heap_in_use_before = USED_HEAP_SIZE;
     STOP_WORLD();
     IF_THREADS(GC_world_stopped = TRUE);
 #   ifdef CONDPRINT
@@ -560,6 +566,8 @@ GC_stop_func stop_func;
     
     IF_THREADS(GC_world_stopped = FALSE);
     START_WORLD();
+    GC_last_pause_usecs = GC_usecs() - pause_start;
+    if (!GC_parallel) GC_last_marker_busy_usecs = GC_last_pause_usecs;
 #   ifdef PRINTTIMES
 	GET_TIME(current_time);
 	GC_printf1("World-stopped marking took %lu msecs\n",
@@ -757,6 +765,10 @@ void GC_finish_collection()
 	           MS_TIME_DIFF(finalize_time,start_time),
 	           MS_TIME_DIFF(done_time,finalize_time));
 #   endif
+    GC_last_heap_in_use_after = USED_HEAP_SIZE;
+    if (GC_collection_end_call_back != (void (*) GC_PROTO((void)))0) {
+	(*GC_collection_end_call_back)();
+    }
 }
 
 /* Externally callable routine to invoke full, stop-world collection */
@@ -79,6 +79,34 @@ GC_API int GC_parallel;	/* GC is parallelized for performance on	*/
 			/* If GC_parallel is set, incremental		*/
 			/* collection is only partially functional,	*/
 			/* and may not be desirable.			*/
+
+GC_API long GC_markers;	/* Number of threads that mark in parallel,	*/
+			/* including the collecting thread.  Only	*/
+			/* meaningful if GC_parallel is set.		*/
+
+GC_API unsigned long GC_last_collection_start_usecs;
+			/* Wall clock time at which the world was	*/
+			/* stopped for the last collection, as returned	*/
+			/* by gettimeofday(), in microseconds.		*/
+
+GC_API unsigned long GC_last_pause_usecs;
+			/* Time the world was stopped during the last	*/
+			/* world-stopped mark phase, in microseconds.	*/
+
+GC_API unsigned long GC_last_marker_busy_usecs;
+			/* Time all mark threads together spent marking	*/
+			/* during the last world-stopped mark phase, in	*/
+			/* microseconds.  Equal to GC_last_pause_usecs	*/
+			/* if GC_parallel is not set.			*/
+
+GC_API GC_word GC_last_bytes_allocd;
+			/* Bytes allocated between the previous	and the	*/
+			/* last collection.				*/
+
+GC_API GC_word GC_last_heap_in_use_before;
+GC_API GC_word GC_last_heap_in_use_after;
+			/* Heap size minus the size of free heap	*/
+			/* blocks before and after the last collection.	*/
 			
 
 /* Public R/W variables */
@@ -92,6 +120,13 @@ GC_API GC_PTR (*GC_oom_fn) GC_PROTO((size_t bytes_requested));
 			/* pointer to a previously allocated heap 	*/
 			/* object.					*/
 
+GC_API void (*GC_collection_end_call_back) GC_PROTO((void));
+			/* Called at the end of each collection, after	*/
+			/* the world is restarted and the sweep is	*/
+			/* initiated.  The allocation lock is held, so	*/
+			/* it must not allocate from the collected	*/
+			/* heap.					*/
+
 GC_API int GC_find_leak;
 			/* Do not actually garbage collect, but simply	*/
 			/* report inaccessible memory that was not	*/
@@ -1412,6 +1412,8 @@ struct hblk * GC_push_next_marked_uncollectable GC_PROTO((struct hblk * h));
 GC_bool GC_stopped_mark GC_PROTO((GC_stop_func stop_func));
  			/* Stop world and mark from all roots	*/
   			/* and rescuers.			*/
+unsigned long GC_usecs GC_PROTO((void));
+			/* Wall clock time in microseconds.	*/
 void GC_clear_hdr_marks GC_PROTO((hdr * hhdr));
 				    /* Clear the mark bits in a header */
 void GC_set_hdr_marks GC_PROTO((hdr * hhdr));
@@ -965,6 +965,8 @@ long GC_markers = 2;		/* Normally changed by thread-library-	*/
 void GC_mark_local(mse *local_mark_stack, int id)
 {
     mse * my_first_nonempty;
+    unsigned long busy_usecs = 0;	/* Excludes waiting for work.	*/
+    unsigned long start;
 
     GC_acquire_mark_lock();
     GC_active_count++;
@@ -1028,6 +1030,7 @@ void GC_mark_local(mse *local_mark_stack, int id)
 		    /* both conditions actually held simultaneously.	*/
 		    GC_helper_count--;
 		    if (0 == GC_helper_count) need_to_notify = TRUE;
+		    GC_last_marker_busy_usecs += busy_usecs;
 #		    ifdef PRINTSTATS
 		      GC_printf1(
 		        "Finished mark helper %lu\n", (unsigned long)id);
@@ -1048,12 +1051,14 @@ void GC_mark_local(mse *local_mark_stack, int id)
 	}
 	n_to_get = ENTRIES_TO_GET;
 	if (n_on_stack < 2 * ENTRIES_TO_GET) n_to_get = 1;
+	start = GC_usecs();
 	local_top = GC_steal_mark_stack(my_first_nonempty, my_top,
 					local_mark_stack, n_to_get,
 				        &my_first_nonempty);
         GC_ASSERT(my_first_nonempty >= GC_mark_stack && 
 	          my_first_nonempty <= GC_mark_stack_top + 1);
 	GC_do_local_mark(local_mark_stack, local_top);
+	busy_usecs += GC_usecs() - start;
     }
 }
 
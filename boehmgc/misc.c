@@ -19,6 +19,7 @@
 #include <limits.h>
 #ifndef _WIN32_WCE
 #include <signal.h>
+#include <sys/time.h>
 #endif
 
 #define I_HIDE_POINTERS	/* To make GC_call_with_alloc_lock visible */
@@ -100,6 +101,32 @@ void (*GC_print_all_smashed) GC_PROTO((void)) = (void (*) GC_PROTO((void)))0;
 
 void (*GC_start_call_back) GC_PROTO((void)) = (void (*) GC_PROTO((void)))0;
 
+void (*GC_collection_end_call_back) GC_PROTO((void)) = (void (*) GC_PROTO((void)))0;
+
+#ifndef PARALLEL_MARK
+  long GC_markers = 1;
+#endif
+
+unsigned long GC_last_collection_start_usecs = 0;
+
+unsigned long GC_last_pause_usecs = 0;
+
+unsigned long GC_last_marker_busy_usecs = 0;
+
+GC_word GC_last_bytes_allocd = 0;
+
+GC_word GC_last_heap_in_use_before = 0;
+
+GC_word GC_last_heap_in_use_after = 0;
+
+unsigned long GC_usecs()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, 0);
+    return (unsigned long)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
 ptr_t GC_stackbottom = 0;
 
 #ifdef IA64
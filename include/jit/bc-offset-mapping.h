@@ -19,6 +19,7 @@ void print_bytecode_offset(unsigned long bc_offset, struct string *str);
 void tree_patch_bc_offset(struct tree_node *node, unsigned long bc_offset);
 bool all_insn_have_bytecode_offset(struct compilation_unit *cu);
 int bytecode_offset_to_line_no(struct vm_method *mb, unsigned long bc_offset);
+int cu_bytecode_offset_to_line_no(struct compilation_unit *cu, unsigned long bc_offset);
 int build_bc_offset_map(struct compilation_unit *cu);
 
 static inline void insn_set_bc_offset(struct insn *insn, unsigned long offset)
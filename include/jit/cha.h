@@ -0,0 +1,39 @@
+#ifndef JATO_JIT_CHA_H
+#define JATO_JIT_CHA_H
+
+#include "lib/list.h"
+
+#include <stdbool.h>
+
+struct compilation_unit;
+struct vm_method;
+struct vm_class;
+struct insn;
+
+extern bool opt_use_cha;
+
+/*
+ * A direct call to @target that was devirtualized from a call of @vmm.
+ * When the code is invalidated, the call is redirected to a stub that
+ * dispatches on the receiver like invokevirtual or invokeinterface of @vmm.
+ */
+struct cha_call_site {
+	struct insn		*call_insn;
+	unsigned long		mach_offset;
+	struct vm_method	*target;
+	struct vm_method	*vmm;
+	struct list_head	node;
+};
+
+struct vm_method *cha_unique_target(struct compilation_unit *cu, struct vm_method *vmm);
+struct vm_method *cha_unique_interface_target(struct compilation_unit *cu, struct vm_method *vmm);
+
+void cha_class_linked(struct vm_class *vmc);
+void cha_code_installed(struct compilation_unit *cu);
+void cha_remove_dependencies(struct compilation_unit *cu);
+
+int cha_add_call_site(struct compilation_unit *cu, struct insn *call_insn,
+		      struct vm_method *target, struct vm_method *vmm);
+void cha_free_call_sites(struct compilation_unit *cu);
+
+#endif /* JATO_JIT_CHA_H */
@@ -19,15 +19,22 @@
 #include <pthread.h>
 #include <semaphore.h>
 
+struct cafebabe_line_number_table_attribute;
+struct cafebabe_code_attribute;
 struct buffer;
+struct deopt_site;
+struct gc_maps;
+struct osr_entry;
 struct vm_method;
 struct insn;
 enum machine_reg;
 
 enum compilation_state {
 	COMPILATION_STATE_INITIAL,
+	COMPILATION_STATE_QUEUED,
 	COMPILATION_STATE_COMPILING,
 	COMPILATION_STATE_COMPILED,
+	COMPILATION_STATE_INVALIDATED,
 };
 
 enum {
@@ -114,7 +121,6 @@ struct compilation_unit {
 	struct list_head static_fixup_site_list;
 	struct list_head call_fixup_site_list;
 	struct list_head tableswitch_list;
-	struct list_head lookupswitch_list;
 	struct list_head ic_call_list;
 
 	/*
@@ -130,6 +136,92 @@ struct compilation_unit {
 	void *entry_point;
 	void *ic_entry_point;
 
+	/*
+	 * Points to code which runs the method in the interpreter.
+	 * It is used by the trampoline until the method gets hot
+	 * enough to be compiled.
+	 */
+	void *interp_bridge;
+
+	/*
+	 * These are used for background compilation. See
+	 * jit/compile-queue.c for details.
+	 */
+	struct list_head compile_queue_node;
+	unsigned long compile_priority;
+	bool async_compile_failed;
+
+	/*
+	 * The bytecode that is compiled and its line number table. They are
+	 * the method's own attributes unless methods were inlined into it.
+	 * The inlined copies are allocated from @inline_arena; the method's
+	 * attributes are left untouched because interpreter frames may be
+	 * running them.
+	 */
+	struct cafebabe_code_attribute *code_attribute;
+	struct cafebabe_line_number_table_attribute *line_number_table_attribute;
+
+	/*
+	 * Maps bytecode offset to the chain of methods inlined at that
+	 * offset. See jit/inliner.c for details.
+	 */
+	struct inline_frame **inline_frames;
+	unsigned long nr_inline_frames;
+	struct arena *inline_arena;
+
+	/*
+	 * Maps bytecode offsets in @inline_orig_code, the code of the
+	 * method before inlining, to offsets in the inlined code.
+	 */
+	unsigned long *inline_pc_map;
+	const unsigned char *inline_orig_code;
+
+	/*
+	 * Class hierarchy analysis dependencies of the compiled code. If
+	 * @cha_invalid is set, a class that invalidates the code was linked
+	 * during compilation. @replaced_cu points to the unit whose code was
+	 * invalidated and is replaced by this unit. See jit/cha.c for
+	 * details.
+	 */
+	struct list_head cha_dependency_list;
+	bool cha_dependent;
+	bool cha_invalid;
+	struct compilation_unit *replaced_cu;
+
+	/*
+	 * Devirtualized calls of the code. See struct cha_call_site.
+	 */
+	struct list_head cha_call_site_list;
+
+	/*
+	 * Number of allocations replaced by temporaries. See jit/escape.c.
+	 */
+	unsigned long nr_eliminated_allocs;
+
+	/*
+	 * Number of monitor statements removed. See jit/lock-elision.c.
+	 */
+	unsigned long nr_elided_locks;
+
+	/*
+	 * Deoptimization and on-stack replacement state. @local_kinds is
+	 * NULL if the local variables of the method can not be mapped
+	 * between compiled and interpreted frames. See jit/deopt.c and
+	 * jit/osr.c for details.
+	 */
+	unsigned char *local_kinds;
+	struct deopt_site *deopt_sites;
+	unsigned long nr_deopt_sites;
+	struct osr_entry *osr_entries;
+	unsigned long nr_osr_entries;
+	void *osr_entry_point;
+
+	/*
+	 * Stack maps for exact garbage collection or NULL if the frames
+	 * of this unit must be scanned conservatively. See jit/gc-map.c.
+	 */
+	struct gc_maps *gc_maps;
+
 	/*
 	 * This maps bytecode offset to every native address
 	 * inside JIT code.
@@ -0,0 +1,13 @@
+#ifndef _JIT_COMPILE_QUEUE
+#define _JIT_COMPILE_QUEUE
+
+#include <stdbool.h>
+
+struct compilation_unit;
+
+extern unsigned int opt_ci_compiler_count;
+
+int init_compile_queue(void);
+bool compile_queue_submit(struct compilation_unit *cu);
+
+#endif
@@ -63,6 +63,8 @@ void do_convert_statement(struct basic_block *bb, struct statement *stmt,
 int compile(struct compilation_unit *);
 int analyze_control_flow(struct compilation_unit *);
 int convert_to_ir(struct compilation_unit *);
+int escape_analysis(struct compilation_unit *);
+int eliminate_locks(struct compilation_unit *);
 int analyze_liveness(struct compilation_unit *);
 int select_instructions(struct compilation_unit *cu);
 int compute_dfns(struct compilation_unit *cu);
@@ -73,11 +75,14 @@ int ssa_to_lir(struct compilation_unit *cu);
 int dce(struct compilation_unit *cu);
 void imm_copy_propagation(struct compilation_unit *cu);
 void abc_removal(struct compilation_unit *cu);
+int gvn(struct compilation_unit *cu);
+int licm(struct compilation_unit *cu);
 int allocate_registers(struct compilation_unit *cu);
 int mark_clobbers(struct compilation_unit *cu);
 int insert_spill_reload_insns(struct compilation_unit *cu);
 int emit_machine_code(struct compilation_unit *);
 void *jit_magic_trampoline(struct compilation_unit *);
+void *jit_compile_method(struct compilation_unit *);
 void jit_no_such_method_stub(void);
 
 struct jit_trampoline *alloc_jit_trampoline(void);
@@ -111,6 +116,9 @@ bool is_native(unsigned long eip);
 bool is_on_heap(unsigned long addr);
 
 void fixup_direct_calls(struct jit_trampoline *trampoline, unsigned long target);
+void fixup_method_entry(void *entry, void *target);
+void fixup_deopt_site(void *site, enum vm_type return_type);
+void fixup_cha_call_site(struct jit_trampoline *t, void *site, void *target);
 
 extern bool opt_trace_method;
 extern regex_t method_trace_regex;
@@ -135,6 +143,15 @@ extern bool opt_trace_compile;
 extern bool opt_print_compilation;
 
 extern bool opt_ssa_enable;
+
+/* Highest level accepted by -XX:OptLevel */
+#define MAX_OPT_LEVEL	2
+
+extern unsigned long opt_level;
+extern bool opt_escape_analysis;
+extern bool opt_trace_escape;
+extern bool opt_eliminate_locks;
+extern bool opt_trace_locks;
 extern bool running_on_valgrind;
 
 extern bool opt_llvm_enable;
@@ -163,6 +180,7 @@ void trace_exception_handler(struct compilation_unit *, unsigned char *);
 void trace_exception_unwind(struct jit_stack_frame *);
 void trace_exception_unwind_to_native(struct jit_stack_frame *);
 void trace_bytecode(struct vm_method *);
+void trace_cu_bytecode(struct compilation_unit *);
 void trace_return_value(struct vm_method *, unsigned long long);
 void print_method(struct vm_method *);
 void print_compilation(struct vm_method *);
@@ -0,0 +1,67 @@
+#ifndef JATO_JIT_DEOPT_H
+#define JATO_JIT_DEOPT_H
+
+#include "vm/types.h"
+
+#include <stdbool.h>
+
+struct compilation_unit;
+struct jit_stack_frame;
+
+extern bool opt_trace_deopt;
+
+/*
+ * Kinds of local variable slots of a method. See compute_local_kinds().
+ */
+enum local_kind {
+	LOCAL_UNUSED,
+	LOCAL_WORD,
+	LOCAL_DOUBLE,		/* first slot of a double */
+	LOCAL_DOUBLE_HIGH,	/* second slot of a double */
+};
+
+/*
+ * A point right after a call in compiled code where the frame can be
+ * transferred to the interpreter.
+ */
+struct deopt_site {
+	unsigned long		mach_offset;
+	unsigned long		bc_offset;
+	enum vm_type		return_type;	/* of the call */
+};
+
+enum deopt_fp_type {
+	DEOPT_FP_NONE,
+	DEOPT_FP_FLOAT,
+	DEOPT_FP_DOUBLE,
+};
+
+/*
+ * Register state exchanged between the deoptimization trampolines and
+ * deopt_resume(). On entry @result_lo and @result_hi hold the value
+ * returned by the call before the deopt site. On return they hold the
+ * return value of the method and @fp_type tells whether it must be
+ * loaded to the FPU stack before jumping to @target with the stack
+ * pointer set to @sp.
+ */
+struct deopt_regs {
+	unsigned long		result_lo;
+	unsigned long		result_hi;
+	unsigned long		fp_type;
+	void			*target;
+	void			*sp;
+};
+
+int compute_local_kinds(struct compilation_unit *cu);
+void read_frame_locals(struct compilation_unit *cu, struct jit_stack_frame *frame, unsigned long *locals);
+void write_frame_locals(struct compilation_unit *cu, struct jit_stack_frame *frame, unsigned long *locals, unsigned long nr_locals);
+
+void add_deopt_site(struct compilation_unit *cu, unsigned long mach_offset, unsigned long bc_offset);
+void deopt_invalidate(struct compilation_unit *cu);
+void deopt_resume(struct deopt_regs *regs, void *site, struct jit_stack_frame *frame);
+
+void deopt_trampoline(void);
+void deopt_trampoline_float(void);
+void deopt_trampoline_double(void);
+
+#endif /* JATO_JIT_DEOPT_H */
@@ -9,6 +9,7 @@ struct basic_block;
 struct buffer;
 struct insn;
 struct vm_object;
+struct vm_class;
 struct vm_jni_env;
 struct vm_method;
 
@@ -24,11 +25,18 @@ extern void emit_unlock_this(struct buffer *, unsigned long);
 extern void emit_body(struct basic_block *, struct buffer *);
 extern void emit_insn(struct buffer *, struct basic_block *, struct insn *);
 extern void emit_nop(struct buffer *buf);
+extern void *emit_patchable_entry(struct buffer *);
+extern void *emit_osr_entry(struct buffer *, struct stack_frame *, unsigned long);
+extern void emit_clear_slot(struct buffer *, struct stack_slot *);
+extern void emit_array_check_stubs(struct buffer *, struct basic_block *);
 extern void backpatch_branch_target(struct buffer *buf, struct insn *insn,
 				    unsigned long target_offset);
 extern void emit_jni_trampoline(struct buffer *, struct vm_method *, void *);
+extern void emit_interp_bridge(struct buffer *, struct vm_method *, void *);
 
 extern void *emit_ic_check(struct buffer *);
 extern void emit_ic_miss_handler(struct buffer *, void *, struct vm_method *);
+extern void *emit_ic_pic_stub(struct vm_method *, struct vm_class **, void **, unsigned int);
+extern void *emit_cha_dispatch_stub(struct vm_method *);
 
 #endif /* JATO_EMIT_CODE_H */
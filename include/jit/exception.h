@@ -39,7 +39,7 @@ extern void *exceptions_guard_page;
 extern void *trampoline_exceptions_guard_page;
 
 struct cafebabe_code_attribute_exception *
-lookup_eh_entry(struct vm_method *method, unsigned long target);
+lookup_eh_entry(struct compilation_unit *cu, unsigned long target);
 
 unsigned char *throw_from_jit(struct compilation_unit *cu,
 			      struct jit_stack_frame *frame,
@@ -50,9 +50,13 @@ unsigned char *throw_from_jit_checked(struct compilation_unit *cu,
 int insert_exception_spill_insns(struct compilation_unit *cu);
 unsigned char *throw_exception(struct compilation_unit *cu,
 			       struct vm_object *exception);
+unsigned char *throw_array_index_out_of_bounds(struct jit_stack_frame *frame,
+					       unsigned char *native_ptr,
+					       struct vm_object *array, jint index);
 void throw_from_trampoline(void *ctx, struct vm_object *exception);
 void unwind(void);
 void exception_check(void);
+void array_check_failed(void);
 void signal_exception(struct vm_object *obj);
 void signal_new_exception_v(struct vm_class *vmc, const char *template, va_list args);
 void signal_new_exception(struct vm_class *vmc, const char *template, ...);
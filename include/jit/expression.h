@@ -12,7 +12,6 @@
 
 #include "arch/instruction.h"
 
-struct lookupswitch;
 struct parse_context;
 
 enum expression_type {
@@ -50,7 +49,6 @@ enum expression_type {
 	EXPR_NULL_CHECK,
 	EXPR_ARRAY_SIZE_CHECK,
 	EXPR_MIMIC_STACK_SLOT,
-	EXPR_LOOKUPSWITCH_BSEARCH,
 	EXPR_TRUNCATION,
 	EXPR_LAST,	/* Not a real type. Keep this last. */
 };
@@ -264,12 +262,6 @@ struct expression {
 			char entry;
 			int slot_ndx;
 		};
-
-		/* EXPR_LOOKUPSWITCH_BSEARCH */
-		struct  {
-			struct tree_node *key;
-			struct lookupswitch *lookupswitch_table;
-		};
 	};
 };
 
@@ -339,7 +331,6 @@ struct expression *null_check_expr(struct expression *);
 struct expression *array_size_check_expr(struct expression *);
 struct expression *dup_expr(struct parse_context *, struct expression *);
 struct expression *get_pure_expr(struct parse_context *, struct expression *);
-struct expression *lookupswitch_bsearch_expr(struct expression *, struct lookupswitch *);
 struct expression *truncation_expr(enum vm_type, struct expression *);
 unsigned long nr_args(struct expression *);
 int expr_nr_kids(struct expression *);
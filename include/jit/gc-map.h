@@ -4,10 +4,78 @@
 #include <arch/registers.h>
 #include <vm/system.h>
 
+#include <stdbool.h>
+
+struct compilation_unit;
+struct basic_block;
+struct buffer;
+struct insn;
+
 #define GC_REGISTER_MAP_SIZE	DIV_ROUND_UP(NR_GP_REGISTERS, BITS_PER_LONG)
 
+/*
+ * Live references at one safepoint of a method. Bit N of a spill map
+ * stands for spill slot N of the frame, counted from the first slot after
+ * the local variables. @spill_map holds two maps of
+ * gc_maps.spill_map_words words each: the slots that hold the current
+ * value of a reference variable and the slots that might hold an older
+ * one.
+ */
 struct gc_map {
 	unsigned long		register_map[GC_REGISTER_MAP_SIZE];	/* references in registers */
+	unsigned long		spill_map[];				/* references in spill slots */
+};
+
+/*
+ * A safepoint poll or a call. @start and @end are the machine code
+ * offsets of the instruction.
+ */
+struct gc_site {
+	unsigned long		start;
+	unsigned long		end;
+	struct gc_map		*map;
 };
 
+/*
+ * Stack maps of a compilation unit. Local variable slots are classified
+ * once for the whole method: slots in @ref_locals only ever hold
+ * references and slots in @ambiguous_locals hold references and primitive
+ * values at different times.
+ */
+struct gc_maps {
+	unsigned long		*ref_locals;
+	unsigned long		*ambiguous_locals;
+	unsigned long		*ref_spill_slots;	/* spill slots of reference variables */
+
+	unsigned long		spill_map_words;
+	unsigned long		map_size;
+	struct gc_map		**maps;			/* unique maps */
+	unsigned long		nr_maps;
+
+	struct gc_site		*polls;
+	unsigned long		nr_polls;
+	struct gc_site		*calls;
+	unsigned long		nr_calls;
+};
+
+enum gc_root_kind {
+	GC_ROOT_EXACT,		/* always holds a reference or NULL */
+	GC_ROOT_AMBIGUOUS,	/* might hold a reference */
+};
+
+typedef void (*gc_root_fn)(void **root, enum gc_root_kind kind, void *arg);
+
+int gc_maps_prepare(struct compilation_unit *cu);
+void emit_gc_maps_prolog(struct compilation_unit *cu, struct buffer *buf);
+void gc_maps_add_site(struct compilation_unit *cu, struct basic_block *bb,
+		      struct insn *insn, unsigned long lir_pos,
+		      unsigned long start, unsigned long end);
+void gc_maps_clear_frame(struct compilation_unit *cu, void *frame);
+void free_gc_maps(struct gc_maps *maps);
+
+struct gc_map *gc_map_lookup_poll(struct compilation_unit *cu, unsigned long addr);
+struct gc_map *gc_map_lookup_call(struct compilation_unit *cu, unsigned long return_addr);
+void gc_map_scan_slots(struct compilation_unit *cu, struct gc_map *map,
+		       void *frame, gc_root_fn fn, void *arg);
+
 #endif
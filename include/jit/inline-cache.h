@@ -6,6 +6,7 @@
 #include "jit/vars.h"
 
 extern bool opt_ic_enabled;
+extern bool opt_trace_ic;
 
 struct ic_call {
 	struct insn *insn;
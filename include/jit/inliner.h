@@ -0,0 +1,26 @@
+#ifndef JIT_INLINER_H
+#define JIT_INLINER_H
+
+struct compilation_unit;
+struct vm_method;
+
+extern unsigned long opt_inline_max_size;
+extern unsigned long opt_inline_max_level;
+
+/*
+ * Describes a method whose bytecode has been inlined into a compiled
+ * method. @bc_offset is the bytecode offset in @method and @caller is
+ * the frame @method was inlined into or NULL if it was inlined
+ * directly into the compiled method.
+ */
+struct inline_frame {
+	struct vm_method	*method;
+	unsigned long		bc_offset;
+	struct inline_frame	*caller;
+};
+
+int inline_methods(struct compilation_unit *cu);
+struct inline_frame *cu_inline_frame(struct compilation_unit *cu, unsigned long bc_offset);
+void free_inline_frames(struct compilation_unit *cu);
+
+#endif /* JIT_INLINER_H */
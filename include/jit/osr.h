@@ -0,0 +1,29 @@
+#ifndef JATO_JIT_OSR_H
+#define JATO_JIT_OSR_H
+
+#include "vm/jni.h"
+
+#include <stdbool.h>
+
+struct compilation_unit;
+struct jit_stack_frame;
+struct vm_method;
+
+extern bool opt_use_osr;
+
+/*
+ * A loop header in compiled code where a frame that is running in the
+ * interpreter can continue.
+ */
+struct osr_entry {
+	unsigned long		bc_offset;
+	unsigned long		mach_offset;
+};
+
+void add_osr_entries(struct compilation_unit *cu);
+int osr_enter(struct vm_method *vmm, const unsigned char *code,
+	      unsigned long pc, unsigned long *locals, unsigned long nr_locals,
+	      union jvalue *result);
+void *osr_migrate_frame(struct jit_stack_frame *frame);
+
+#endif /* JATO_JIT_OSR_H */
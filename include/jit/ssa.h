@@ -40,6 +40,7 @@ struct reg_value_acc {
  */
 void recompute_insn_positions(struct compilation_unit *);
 void remove_insn(struct insn *insn);
+bool cu_has_eh_bbs(struct compilation_unit *);
 
 /*
  * Functions defined in jit/liveness.c
@@ -41,6 +41,7 @@ struct stack_frame {
 
 struct stack_frame *alloc_stack_frame(unsigned long nr_args, unsigned long nr_local_slots);
 void free_stack_frame(struct stack_frame *frame);
+int stack_frame_grow_locals(struct stack_frame *frame, unsigned long nr_local_slots);
 
 struct stack_slot *get_local_slot(struct stack_frame *frame, unsigned long index);
 struct stack_slot *get_spill_slot_32(struct stack_frame *frame);
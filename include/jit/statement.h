@@ -6,9 +6,6 @@
 #include <stddef.h>
 #include "vm/vm.h"
 
-struct tableswitch_info;
-struct lookupswitch_info;
-
 enum statement_type {
 	STMT_STORE = OP_LAST,
 	STMT_IF,
@@ -23,7 +20,6 @@ enum statement_type {
 	STMT_CHECKCAST,
 	STMT_ARRAY_STORE_CHECK,
 	STMT_TABLESWITCH,
-	STMT_LOOKUPSWITCH_JUMP,
 	STMT_BEFORE_ARGS,
 	STMT_INVOKE,
 	STMT_INVOKEINTERFACE,
@@ -48,25 +44,6 @@ struct tableswitch {
 	struct list_head list_node;
 };
 
-struct lookupswitch_pair {
-	int32_t match;
-	union {
-		struct basic_block *bb_target;
-		void *target;
-	};
-} __attribute__((packed));
-
-struct lookupswitch {
-	uint32_t count;
-
-	/* basic block containing this lookupswitch. */
-	struct basic_block *src;
-
-	struct lookupswitch_pair *pairs;
-
-	struct list_head list_node;
-};
-
 struct statement {
 	union {
 		struct tree_node node;
@@ -102,9 +79,6 @@ struct statement {
 			struct tree_node *index;
 			struct tableswitch *table;
 		};
-		struct /* STMT_LOOKUPSWITCH_JUMP */ {
-			struct tree_node *lookupswitch_target;
-		};
 
 		struct /* STMT_BEFORE_ARGS, STMT_INVOKE, STMT_INVOKEVIRTUAL, STMT_INVOKEINTERFACE */ {
 			struct tree_node *args_list;
@@ -119,6 +93,20 @@ struct statement {
 		/* STMT_INVOKE, STMT_INVOKEVIRTUAL, STMT_INVOKEINTERFACE */
 		struct {
 			struct expression *invoke_result;
+
+			/*
+			 * The operand stack is empty apart from the
+			 * result when the call returns so the frame can
+			 * be deoptimized there.
+			 */
+			bool deopt_point;
+
+			/*
+			 * The virtual or interface method that class
+			 * hierarchy analysis devirtualized this call
+			 * from or NULL. See jit/cha.c.
+			 */
+			struct vm_method *cha_method;
 		};
 	};
 
@@ -140,11 +128,8 @@ struct statement *alloc_statement(enum statement_type);
 void free_statement(struct statement *);
 int stmt_nr_kids(struct statement *);
 
-struct tableswitch *alloc_tableswitch(struct tableswitch_info *, struct compilation_unit *, struct basic_block *, unsigned long);
+struct tableswitch *alloc_tableswitch(struct compilation_unit *, int32_t, int32_t);
 void free_tableswitch(struct tableswitch *);
-struct lookupswitch *alloc_lookupswitch(struct lookupswitch_info *, struct compilation_unit *, struct basic_block *, unsigned long);
-void free_lookupswitch(struct lookupswitch *);
-int lookupswitch_pair_comp(const void *, const void *);
 struct statement *if_stmt(struct basic_block *, enum vm_type, enum binary_operator, struct expression *, struct expression *);
 
 static inline unsigned long stmt_method_index(struct statement *stmt)
@@ -6,6 +6,7 @@
 extern bool opt_trace_vtable;
 
 struct compilation_unit;
+struct vm_method;
 struct vm_object;
 
 struct vtable {
@@ -16,5 +17,6 @@ void vtable_init(struct vtable *vtable, unsigned int nr_methods);
 void vtable_release(struct vtable *vtable);
 void vtable_setup_method(struct vtable *vtable, unsigned long idx, void *native_ptr);
 void fixup_vtable(struct compilation_unit *cu, struct vm_object *this, void *target);
+void fixup_vtable_entry(struct vm_method *vmm, void *target);
 
 #endif /* __JIT_VTABLE_H */
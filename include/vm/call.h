@@ -94,5 +94,8 @@ extern void native_call(struct vm_method *method,
 			void *target,
 			unsigned long *args,
 			union jvalue *result);
+extern void native_call_get_args(struct vm_method *method,
+				 void *frame,
+				 unsigned long *args);
 
 #endif
@@ -42,6 +42,13 @@ enum vm_class_kind {
  */
 #define SUPERTYPE_CACHE_SIZE           2
 
+/*
+ * Number of entries in the primary supertype display. Classes that are
+ * nested deeper than this in the class hierarchy are found through the
+ * secondary supertypes instead.
+ */
+#define VM_CLASS_DISPLAY_SIZE          8
+
 struct vm_class {
 	/* Compile lock for fast class initialization */
 	struct compile_lock cl;
@@ -112,6 +119,57 @@ struct vm_class {
 	 */
 	const struct vm_class			*supertype_cache[SUPERTYPE_CACHE_SIZE];
 	unsigned int				supertype_cache_ndx;
+
+	/*
+	 * The primary supertype display holds the superclass chain of this
+	 * class indexed by depth in the class hierarchy: display[0] is
+	 * java/lang/Object and display[display_depth] is the class itself.
+	 * Unused entries are NULL. The secondary supertypes are all the
+	 * interfaces this class implements and the superclasses that did
+	 * not fit in the display. Both are set up at link time.
+	 */
+	const struct vm_class			*display[VM_CLASS_DISPLAY_SIZE];
+	unsigned int				display_depth;
+	unsigned int				nr_secondary_supers;
+	const struct vm_class			**secondary_supers;
+
+	/*
+	 * Class hierarchy analysis state of interfaces. See jit/cha.c for
+	 * details.
+	 */
+	struct vm_class				*cha_implementor;
+	bool					cha_many_implementors;
+	struct list_head			cha_dependent_list;
+
+	/*
+	 * Instances are no longer reserved for the thread that locks them
+	 * once the bias of nr_bias_revocations of them has been revoked.
+	 * See vm/monitor.c for details.
+	 */
+	unsigned long				nr_bias_revocations;
+	bool					bias_revoked;
+
+	/*
+	 * Number of iterations a thread spins on a contended monitor of an
+	 * instance before it blocks. Kept here because monitor records move
+	 * between objects. See vm/monitor.c for details.
+	 */
+	int					monitor_spin_limit;
+
+	/*
+	 * GC descriptor of instances that marks only their reference
+	 * fields. Only set for regular classes when the GC supports typed
+	 * allocation.
+	 */
+	bool					has_gc_descr;
+	unsigned long				gc_descr;
+
+	/*
+	 * Bitmap of the words of instances that hold references. Only set
+	 * for regular classes when the generational heap is used.
+	 */
+	unsigned long				*ref_map;
+	unsigned long				ref_map_words;
 };
 
 int vm_class_link(struct vm_class *vmc, const struct cafebabe_class *class);
@@ -126,6 +184,11 @@ static inline int vm_class_ensure_init(struct vm_class *vmc)
 	return vm_class_init(vmc);
 }
 
+static inline bool vm_class_is_initialized(const struct vm_class *vmc)
+{
+	return vmc->state == VM_CLASS_INITIALIZED;
+}
+
 static inline bool vm_class_is_public(const struct vm_class *vmc)
 {
 	return vmc->access_flags & CAFEBABE_CLASS_ACC_PUBLIC;
@@ -224,8 +287,36 @@ static inline bool supertype_cache_test(const struct vm_class *vmc, const struct
 	return vmc->supertype_cache[0] == super || vmc->supertype_cache[1] == super;
 }
 
+/*
+ * Returns true if subtype checks against @vmc can be decided by looking at
+ * a single display entry. This is the case for classes that are neither
+ * interfaces nor arrays and fit in the display.
+ */
+static inline bool vm_class_has_primary_display(const struct vm_class *vmc)
+{
+	return vmc->display_depth < VM_CLASS_DISPLAY_SIZE
+		&& !vm_class_is_interface(vmc) && !vm_class_is_array_class(vmc);
+}
+
+static inline unsigned long vm_class_display_offset(const struct vm_class *vmc)
+{
+	return offsetof(struct vm_class, display) + vmc->display_depth * sizeof(struct vm_class *);
+}
+
+static inline bool vm_class_display_test(const struct vm_class *vmc, const struct vm_class *from)
+{
+	return vmc->display_depth < VM_CLASS_DISPLAY_SIZE
+		&& from->display[vmc->display_depth] == vmc;
+}
+
 static inline bool vm_class_is_assignable_from(struct vm_class *vmc, const struct vm_class *from)
 {
+	if (vm_class_display_test(vmc, from))
+		return true;
+
+	if (vm_class_has_primary_display(vmc))
+		return false;
+
 	return supertype_cache_test(vmc, from) || vm_class_is_assignable_from_slow(vmc, from);
 }
 
@@ -314,6 +405,14 @@ DECLARE_STATIC_FIELD_SETTER(double);
 DECLARE_STATIC_FIELD_SETTER(float);
 DECLARE_STATIC_FIELD_SETTER(int);
 DECLARE_STATIC_FIELD_SETTER(long);
-DECLARE_STATIC_FIELD_SETTER(object);
+
+static inline void
+static_field_set_object(const struct vm_field *field, jobject value)
+{
+	assert(vm_field_is_static(field));
+
+	gc_write_barrier(&field->class->static_values[field->offset]);
+	*(jobject *) &field->class->static_values[field->offset] = value;
+}
 
 #endif /* __CLASS_H */
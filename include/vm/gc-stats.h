@@ -0,0 +1,48 @@
+#ifndef JATO_VM_GC_STATS_H
+#define JATO_VM_GC_STATS_H
+
+#include <stdint.h>
+
+enum gc_kind {
+	GC_FULL,
+	GC_MINOR,	/* nursery of the generational heap only */
+};
+
+#define NR_GC_KINDS	2
+
+/*
+ * Per-collection telemetry written with -verbose:gc. Times are in
+ * microseconds. The start time is wall clock time as returned by
+ * gc_stats_now().
+ */
+struct gc_record {
+	enum gc_kind		kind;
+
+	uint64_t		start;
+	uint64_t		pause;
+
+	/* Time it took to stop all threads. 0 if not known. */
+	uint64_t		time_to_safepoint;
+
+	unsigned long		heap_before;
+	unsigned long		heap_after;
+
+	/* Bytes allocated since the previous collection */
+	unsigned long		allocated;
+
+	/* Bytes moved to the old generation by a minor collection */
+	unsigned long		promoted;
+
+	/* Parallel marking. nr_markers is 0 if not known. */
+	unsigned long		nr_markers;
+	uint64_t		marker_busy;
+};
+
+extern const char *opt_gc_log_file;
+
+uint64_t gc_stats_now(void);
+void gc_stats_init(void);
+void gc_stats_record(struct gc_record *record);
+void gc_stats_print(void);
+
+#endif /* JATO_VM_GC_STATS_H */
@@ -7,8 +7,10 @@
 #include "vm/object.h"
 
 struct register_state;
+struct vm_class;
 
 extern unsigned long		max_heap_size;
+extern unsigned long		opt_parallel_gc_threads;
 extern void			*gc_safepoint_page;
 extern bool			newgc_enabled;
 extern bool			verbose_gc;
@@ -19,6 +21,9 @@ typedef void (*finalizer_fn)(struct vm_object *object);
 struct gc_operations {
 	void *(*gc_alloc)(size_t size);
 	void *(*gc_alloc_noscan)(size_t size);
+	void *(*gc_alloc_many)(size_t size);
+	void *(*gc_alloc_typed)(size_t size, unsigned long descr);
+	unsigned long (*gc_make_descr)(unsigned long *bitmap, unsigned long nr_words);
 	void *(*vm_alloc)(size_t size);
 	void (*vm_free)(void *p);
 	int (*gc_register_finalizer)(struct vm_object *object, finalizer_fn finalizer);
@@ -73,6 +78,20 @@ extern struct gc_operations gc_ops;
  *		Allocates collectable memory region. Can not be freed
  *              manually. The content is NOT scanned for object references.
  *              This is used to allocate memory for primitives.
+ *
+ * gc_alloc_many()
+ *		Allocates a list of zeroed collectable memory regions of
+ *              the same size linked through their first word. This is
+ *              used to refill thread-local allocation buffers. Optional.
+ *
+ * gc_alloc_typed()
+ *		Allocates collectable memory region whose layout is
+ *              described by a descriptor from gc_make_descr(). Only the
+ *              words set in the bitmap passed to gc_make_descr() are
+ *              scanned for object references. This is used to allocate
+ *              instances of classes that have a descriptor. They are
+ *              never allocated from thread-local allocation buffers.
+ *              Optional.
  */
 
 static inline void *gc_alloc(size_t size)
@@ -85,6 +104,26 @@ static inline void *gc_alloc_noscan(size_t size)
 	return gc_ops.gc_alloc_noscan(size);
 }
 
+static inline void *gc_alloc_many(size_t size)
+{
+	return gc_ops.gc_alloc_many(size);
+}
+
+static inline bool gc_typed_alloc_supported(void)
+{
+	return gc_ops.gc_alloc_typed && gc_ops.gc_make_descr;
+}
+
+static inline void *gc_alloc_typed(size_t size, unsigned long descr)
+{
+	return gc_ops.gc_alloc_typed(size, descr);
+}
+
+static inline unsigned long gc_make_descr(unsigned long *bitmap, unsigned long nr_words)
+{
+	return gc_ops.gc_make_descr(bitmap, nr_words);
+}
+
 static inline void *vm_alloc(size_t size)
 {
 	return gc_ops.vm_alloc(size);
@@ -92,6 +131,9 @@ static inline void *vm_alloc(size_t size)
 
 void *vm_zalloc(size_t size);
 
+void *gc_alloc_static_values(struct vm_class *vmc, size_t size);
+void gc_free_static_values(void *values);
+
 static inline void vm_free(void *ptr)
 {
 	gc_ops.vm_free(ptr);
@@ -111,6 +153,7 @@ gc_setup_signals(void)
 }
 
 void gc_safepoint(struct register_state *);
+void gc_run_at_safepoint(void (*fn)(void *), void *arg);
 void suspend_handler(int, siginfo_t *, void *);
 void wakeup_handler(int, siginfo_t *, void *);
 
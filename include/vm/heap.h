@@ -0,0 +1,164 @@
+#ifndef JATO_VM_HEAP_H
+#define JATO_VM_HEAP_H
+
+#include "arch/memory.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct gc_record;
+struct vm_class;
+
+/*
+ * The generational heap of -Xnewgc has one card per 2^GC_CARD_SHIFT bytes.
+ * A card is marked dirty when a reference is stored into an object that
+ * overlaps it.
+ */
+#define GC_CARD_SHIFT		9
+#define GC_CARD_SIZE		(1UL << GC_CARD_SHIFT)
+
+#define GC_CARD_DIRTY		0
+#define GC_CARD_CLEAN		1
+
+extern unsigned long		opt_nursery_size;
+extern unsigned long		opt_max_tenuring_threshold;
+
+/* Bounds of the generational heap. Both are 0 if it is not used. */
+extern unsigned long		gc_heap_start;
+extern unsigned long		gc_heap_end;
+
+/*
+ * The card of heap address A is the byte at gc_card_table_bias +
+ * (A >> GC_CARD_SHIFT). The bias fits in a signed 32-bit displacement.
+ */
+extern unsigned long		gc_card_table_bias;
+
+static inline bool heap_enabled(void)
+{
+	return gc_heap_end != 0;
+}
+
+static inline bool gc_in_heap(const void *p)
+{
+	return (unsigned long) p - gc_heap_start < gc_heap_end - gc_heap_start;
+}
+
+/*
+ * Write barrier for a reference store to @p. It must be called before the
+ * store; see vm/heap.c for why.
+ */
+static inline void gc_write_barrier(void *p)
+{
+	unsigned long addr = (unsigned long) p;
+
+	if (!gc_in_heap(p))
+		return;
+
+	*(volatile uint8_t *) (gc_card_table_bias + (addr >> GC_CARD_SHIFT)) = GC_CARD_DIRTY;
+	barrier();
+}
+
+/*
+ * Write barrier for copying references to @size bytes at @p. It must be
+ * called both before and after the copy.
+ */
+static inline void gc_write_barrier_range(void *p, size_t size)
+{
+	unsigned long addr = (unsigned long) p;
+	unsigned long card, last;
+
+	if (!size || !gc_in_heap(p))
+		return;
+
+	last = (addr + size - 1) >> GC_CARD_SHIFT;
+
+	for (card = addr >> GC_CARD_SHIFT; card <= last; card++)
+		*(volatile uint8_t *) (gc_card_table_bias + card) = GC_CARD_DIRTY;
+
+	barrier();
+}
+
+/*
+ * Copies @count references from @src to @dest, which may overlap. Every
+ * reference passes through a general purpose register where a collection
+ * that stops the thread during the copy sees it, so the copy loop must not
+ * be vectorized by the compiler or done by memcpy().
+ */
+static inline void gc_copy_refs(void *dest, const void *src, size_t count)
+{
+	void * volatile *d = dest;
+	void * const volatile *s = src;
+	size_t i;
+
+	if (d < s) {
+		for (i = 0; i < count; i++)
+			d[i] = s[i];
+	} else {
+		for (i = count; i > 0; i--)
+			d[i - 1] = s[i - 1];
+	}
+}
+
+/*
+ * A growable array that is safe to use in signal handlers. The memory is
+ * taken from mmap() directly.
+ */
+struct heap_buffer {
+	void			**data;
+	unsigned long		nr;
+	unsigned long		max;
+};
+
+void heap_buffer_grow(struct heap_buffer *buf);
+void heap_buffer_release(struct heap_buffer *buf);
+
+static inline void heap_buffer_push(struct heap_buffer *buf, void *p)
+{
+	if (buf->nr == buf->max)
+		heap_buffer_grow(buf);
+
+	buf->data[buf->nr++] = p;
+}
+
+/*
+ * Roots that a thread found on its own stack when it was stopped for a
+ * collection. @exact holds addresses of slots, @ambiguous holds values.
+ */
+struct heap_roots {
+	struct heap_buffer	exact;
+	struct heap_buffer	ambiguous;
+};
+
+/*
+ * Eden page that a thread bump-allocates from without taking the heap
+ * lock. A minor collection takes the page away from every thread.
+ */
+struct heap_chunk {
+	void			*start;
+	void			*cur;
+	void			*limit;
+};
+
+void heap_roots_init(struct heap_roots *roots);
+void heap_roots_release(struct heap_roots *roots);
+
+static inline void heap_roots_reset(struct heap_roots *roots)
+{
+	roots->exact.nr		= 0;
+	roots->ambiguous.nr	= 0;
+}
+
+void heap_init(void);
+void heap_chunk_init(struct heap_chunk *chunk);
+void *heap_alloc(size_t size, bool noscan);
+void *heap_alloc_many(size_t size);
+void *heap_alloc_tenured(size_t size, bool noscan);
+void *heap_alloc_statics(struct vm_class *vmc, size_t size);
+void heap_free_statics(void *values);
+int32_t heap_identity_hash(void *p, int32_t hash);
+void *heap_vm_alloc(size_t size);
+void heap_vm_free(void *p);
+void heap_collect_minor(struct gc_record *record);
+
+#endif /* JATO_VM_HEAP_H */
@@ -1,14 +1,28 @@
 #ifndef JATO__VM_INTERP_H
 #define JATO__VM_INTERP_H
 
+#include "vm/types.h"
 #include "vm/jni.h"
 
+#include <stdbool.h>
 #include <stdarg.h>
 
+struct cafebabe_code_attribute;
 struct vm_method;
 struct vm_object;
 
+extern bool opt_interp_only;
+extern unsigned long opt_compile_threshold;
+
+void vm_interp_method_a(struct vm_method *method, unsigned long *args, union jvalue *result);
 void vm_interp_method_v(struct vm_method *method, va_list args, union jvalue *result);
+void vm_interp_resume(struct vm_method *method,
+		      const struct cafebabe_code_attribute *code_attr,
+		      unsigned long pc, unsigned long *locals, enum vm_type type,
+		      union jvalue *value, union jvalue *result);
+bool vm_method_can_interpret(struct vm_method *method);
+bool vm_method_should_interpret(struct vm_method *method);
+void *vm_interp_bridge_ptr(struct vm_method *method);
 
 static inline void vm_interp_method(struct vm_method *method, ...)
 {
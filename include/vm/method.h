@@ -19,6 +19,8 @@
 
 #include "lib/buffer.h"
 
+#include "arch/atomic.h"
+
 struct vm_class;
 
 #ifdef CONFIG_ARGS_MAP
@@ -61,6 +63,22 @@ struct vm_method {
 
 	char flags;
 
+	/*
+	 * Profiling counters for mixed-mode execution. Invocations are
+	 * counted in the JIT trampoline and backward branches in the
+	 * interpreter; the method is handed to the JIT once their sum
+	 * reaches opt_compile_threshold.
+	 */
+	atomic_t invocation_count;
+	atomic_t backedge_count;
+
+	/*
+	 * Class hierarchy analysis state. See jit/cha.c for details.
+	 */
+	bool cha_overridden;
+	struct list_head cha_dependent_list;
+	void *cha_dispatch_stub;
+
 	unsigned int nr_annotations;
 	struct vm_annotation **annotations;
 	bool annotation_initialized;
@@ -6,11 +6,22 @@
 #include "arch/atomic.h"
 
 #include <semaphore.h>
+#include <stdbool.h>
 #include <pthread.h>
 
 struct vm_exec_env;
 struct vm_object;
 
+#define VM_MONITOR_RESERVED	0x01UL
+
+extern bool opt_use_biased_locking;
+extern bool opt_print_biased_locking_stats;
+extern bool opt_trace_monitor;
+
+#define MIN_SPIN_LIMIT		16
+#define INITIAL_SPIN_LIMIT	128
+#define MAX_SPIN_LIMIT		4096
+
 /*
  * Structure used in relaxed-lock protocol for monitor locking.
  * Locking thread acquires the lock by placing pointer to its
@@ -24,6 +35,11 @@ struct vm_object;
  *
  * For more details see David Dice's work: "Implementing Fast Java
  * Monitors with Relaxed-Locks".
+ *
+ * An object can also be reserved for a thread (biased locking). When the
+ * thread unlocks it, object.monitor_record is set to the thread's
+ * vm_exec_env with VM_MONITOR_RESERVED set instead of NULL. See
+ * vm/monitor.c for details.
  */
 struct vm_monitor_record {
 	/* Holds pointer to struct vm_exec_env */
@@ -32,12 +48,33 @@ struct vm_monitor_record {
 	atomic_t		nr_waiting;
 	atomic_t		candidate;
 	int			lock_count;
+
+	/*
+	 * Set if the object stays reserved for the owner when it is
+	 * unlocked. Only records that are not installed in an object are
+	 * in the thread's pool and those have this cleared.
+	 */
+	bool			biased;
+
 	struct list_head	ee_free_list_node;
 	sem_t			sem;
 	pthread_mutex_t		notify_mutex;
 	pthread_cond_t		notify_cond;
 };
 
+/*
+ * Returns the spin limit of a lock after a contending thread spun up to
+ * @limit iterations on it. The limit is doubled if the owner released the
+ * lock in time and halved if it did not.
+ */
+static inline int vm_monitor_adapt_spin_limit(int limit, bool released)
+{
+	if (released)
+		return limit < MAX_SPIN_LIMIT ? limit * 2 : limit;
+
+	return limit > MIN_SPIN_LIMIT ? limit / 2 : limit;
+}
+
 int vm_object_lock(struct vm_object *self);
 int vm_object_unlock(struct vm_object *self);
 int vm_object_wait(struct vm_object *self);
@@ -45,5 +82,8 @@ int vm_object_timed_wait(struct vm_object *self, uint64_t ms, int ns);
 int vm_object_notify(struct vm_object *self);
 int vm_object_notify_all(struct vm_object *self);
 void vm_monitor_record_free(struct vm_monitor_record *vmr);
+void vm_monitor_record_flush(struct vm_monitor_record *record);
+void vm_monitor_print_stats(void);
+void vm_monitor_print_contention(void);
 
 #endif
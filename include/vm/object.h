@@ -8,6 +8,7 @@
 #include "vm/monitor.h"
 #include "vm/system.h"
 #include "vm/field.h"
+#include "vm/heap.h"
 #include "vm/jni.h"
 #include "vm/vm.h"
 
@@ -62,10 +63,14 @@ static inline void *vm_array_elems(const struct vm_object *obj)
 
 int init_vm_objects(void);
 
+struct vm_class *vm_primitive_array_class(int type);
+
 struct vm_object *vm_object_alloc(struct vm_class *class);
 struct vm_object *vm_object_alloc_array_raw(struct vm_class *class, size_t elem_size, int count);
 struct vm_object *vm_object_alloc_primitive_array(int type, int count);
+struct vm_object *vm_object_alloc_primitive_array_class(struct vm_class *vmc, int count);
 struct vm_object *vm_object_alloc_multi_array(struct vm_class *class, int nr_dimensions, ...);
+struct vm_object *vm_object_alloc_multi_array_a(struct vm_class *class, int nr_dimensions, const int *counts);
 struct vm_object *vm_object_alloc_array(struct vm_class *class, int count);
 struct vm_object *vm_object_alloc_array_of(struct vm_class *elem_class, int count);
 
@@ -162,7 +167,16 @@ DECLARE_FIELD_SETTER(double);
 DECLARE_FIELD_SETTER(float);
 DECLARE_FIELD_SETTER(int);
 DECLARE_FIELD_SETTER(long);
-DECLARE_FIELD_SETTER(object);
+
+static inline void
+field_set_object(struct vm_object *obj, const struct vm_field *field,
+		 jobject value)
+{
+	uint8_t *fields = vm_object_fields(obj);
+
+	gc_write_barrier(&fields[field->offset]);
+	*(jobject *) &fields[field->offset] = value;
+}
 
 DECLARE_FIELD_GETTER(byte);
 DECLARE_FIELD_GETTER(boolean);
@@ -229,7 +243,15 @@ DECLARE_ARRAY_FIELD_SETTER(double, J_DOUBLE);
 DECLARE_ARRAY_FIELD_SETTER(float, J_FLOAT);
 DECLARE_ARRAY_FIELD_SETTER(int, J_INT);
 DECLARE_ARRAY_FIELD_SETTER(long, J_LONG);
-DECLARE_ARRAY_FIELD_SETTER(object, J_REFERENCE);
+
+static inline void
+array_set_field_object(struct vm_object *obj, int index, jobject value)
+{
+	uint8_t *fields = vm_array_elems(obj);
+
+	gc_write_barrier(&fields[index * vmtype_get_size(J_REFERENCE)]);
+	*(jobject *) &fields[index * vmtype_get_size(J_REFERENCE)] = value;
+}
 
 DECLARE_ARRAY_FIELD_GETTER(byte, J_BYTE);
 DECLARE_ARRAY_FIELD_GETTER(boolean, J_BOOLEAN);
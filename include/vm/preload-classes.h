@@ -27,6 +27,7 @@ PRELOAD_CLASS("java/lang/RuntimeException", vm_java_lang_RuntimeException, 0)
 PRELOAD_CLASS("java/lang/UnsatisfiedLinkError", vm_java_lang_UnsatisfiedLinkError, 0)
 PRELOAD_CLASS("java/lang/NoSuchFieldError", vm_java_lang_NoSuchFieldError, 0)
 PRELOAD_CLASS("java/lang/NoSuchMethodError", vm_java_lang_NoSuchMethodError, 0)
+PRELOAD_CLASS("java/lang/AbstractMethodError", vm_java_lang_AbstractMethodError, 0)
 PRELOAD_CLASS("java/lang/StackOverflowError", vm_java_lang_StackOverflowError, 0)
 PRELOAD_CLASS("java/lang/VerifyError", vm_java_lang_VerifyError, 0)
 PRELOAD_CLASS("java/lang/Thread", vm_java_lang_Thread, 0)
@@ -3,6 +3,9 @@
 
 #include "lib/list.h"
 
+#include "vm/heap.h"
+#include "vm/tlab.h"
+
 #include "arch/atomic.h"
 #include "arch/registers.h"
 
@@ -11,6 +14,7 @@
 #include <semaphore.h>
 #include <signal.h>
 
+struct vm_monitor_record;
 struct vm_object;
 
 enum vm_thread_state {
@@ -54,6 +58,12 @@ struct vm_exec_env {
 	struct vm_thread *thread;
 	struct list_head free_monitor_recs;
 
+	/*
+	 * A pooled monitor record that JIT code can install on an unlocked
+	 * object without calling into the VM. It is not on the list above.
+	 */
+	struct vm_monitor_record *spare_monitor_rec;
+
 	/*
 	 * Holds a reference to exception that has been signalled.  This
 	 * pointer is cleared when handler is executed or
@@ -67,16 +77,39 @@ struct vm_exec_env {
 	/* A semaphore flag used by GC */
 	sig_atomic_t in_safepoint;
 
+	/*
+	 * Objects are only reserved for threads that are stopped at
+	 * safepoints. Bias revocation is retried while the thread is
+	 * changing the state of one of its reserved objects.
+	 */
+	bool bias_enabled;
+	sig_atomic_t in_bias_update;
+
 	/* Signal register state */
 	struct register_state thread_register_state;
 
+	/* Highest address of the stack of this thread or NULL if unknown */
+	void *stack_end;
+
 	struct string *trace_buffer;
+
+	/* Thread-local allocation buffers */
+	struct vm_tlab tlab;
+
+	/* Eden page of the generational heap that this thread allocates from */
+	struct heap_chunk eden_chunk;
+
+	/* Roots found on the stack of this thread when it was last stopped */
+	struct heap_roots heap_roots;
 };
 
 unsigned int vm_nr_threads(void);
 
 extern pthread_key_t current_exec_env_key;
 
+/* Same as vm_get_exec_env() but accessible from JIT code */
+extern __thread struct vm_exec_env *current_exec_env;
+
 static inline struct vm_exec_env *vm_get_exec_env(void)
 {
 	return pthread_getspecific(current_exec_env_key);
@@ -93,6 +126,7 @@ static inline struct vm_thread *vm_thread_self(void)
 }
 
 void init_exec_env(void);
+int vm_thread_init_internal(void);
 int init_threading(void);
 int vm_thread_start(struct vm_object *vmthread);
 void vm_thread_wait_for_non_daemons(void);
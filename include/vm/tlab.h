@@ -0,0 +1,48 @@
+#ifndef JATO_VM_TLAB_H
+#define JATO_VM_TLAB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct vm_exec_env;
+
+/*
+ * Thread-local allocation buffers. Every thread keeps a list of free,
+ * zeroed objects for each small size class. The lists are linked through
+ * the first word of the objects and refilled from the GC in batches so
+ * that most allocations don't take the GC allocation lock.
+ */
+#define TLAB_GRANULE_SIZE	(2 * sizeof(void *))
+#define TLAB_NR_SIZE_CLASSES	16
+#define TLAB_MAX_SIZE		(TLAB_NR_SIZE_CLASSES * TLAB_GRANULE_SIZE)
+
+struct vm_tlab {
+	void			*free_lists[TLAB_NR_SIZE_CLASSES];
+
+	/* Statistics */
+	unsigned long		nr_refills;
+	unsigned long		nr_refill_objects;
+};
+
+extern bool opt_use_tlab;
+
+static inline unsigned long tlab_size_class(size_t size)
+{
+	return (size + TLAB_GRANULE_SIZE - 1) / TLAB_GRANULE_SIZE - 1;
+}
+
+static inline size_t tlab_class_size(unsigned long size_class)
+{
+	return (size_class + 1) * TLAB_GRANULE_SIZE;
+}
+
+bool tlab_enabled(void);
+bool tlab_can_alloc(size_t size);
+void tlab_init(struct vm_tlab *tlab);
+void *tlab_alloc(size_t size);
+void *tlab_refill(unsigned long size_class);
+void tlab_flush(struct vm_tlab *tlab);
+unsigned long tlab_nr_allocs(struct vm_tlab *tlab);
+void tlab_print_stats(struct vm_exec_env *ee);
+
+#endif /* JATO_VM_TLAB_H */
@@ -35,11 +35,16 @@
 #include "runtime/runtime.h"
 
 #include "jit/llvm/core.h"
+#include "jit/compile-queue.h"
 #include "jit/compiler.h"
 #include "jit/cu-mapping.h"
+#include "jit/cha.h"
+#include "jit/deopt.h"
 #include "jit/gdb.h"
 #include "jit/exception.h"
 #include "jit/inline-cache.h"
+#include "jit/inliner.h"
+#include "jit/osr.h"
 #include "jit/perf-map.h"
 #include "jit/debug.h"
 #include "jit/text.h"
@@ -67,12 +72,15 @@
 #include "vm/string.h"
 #include "vm/system.h"
 #include "vm/thread.h"
+#include "vm/tlab.h"
 #include "vm/class.h"
 #include "vm/call.h"
 #include "vm/utf8.h"
 #include "vm/jar.h"
 #include "vm/jni.h"
+#include "vm/gc-stats.h"
 #include "vm/gc.h"
+#include "vm/heap.h"
 #include "vm/vm.h"
 #include "vm/java-version.h"
 
@@ -105,8 +113,6 @@ static bool use_system_classloader = true;
  */
 bool opt_ssa_enable;
 
-static bool opt_interp_only;
-
 /*
  * Enable LLVM backend:
  */
@@ -124,6 +130,18 @@ bool running_on_valgrind;
 
 static void vm_atexit(void)
 {
+	if (verbose_gc && vm_get_exec_env())
+		tlab_print_stats(vm_get_exec_env());
+
+	if (verbose_gc)
+		gc_stats_print();
+
+	if (opt_print_biased_locking_stats)
+		vm_monitor_print_stats();
+
+	if (opt_trace_monitor)
+		vm_monitor_print_contention();
+
 	classloader_destroy();
 
 	if (opt_llvm_enable)
@@ -582,10 +600,32 @@ static void jit_init_natives(void)
 	"  -D<name>=<value> set a system property\n"					\
 	"  -verbose[:gc]\n"								\
 	"		   :gc print out results of garbage collection\n"		\
+	"  -Xloggc:<file>  write garbage collection results to <file>\n"	\
 	"  -version	   print out version number and copyright information\n"	\
 	"\n"										\
 	"  -Xint           operate in interpreter-only mode\n"				\
-	"  -XX:+PrintCompilation Print a message when a method is compiled\n"
+	"  -XX:+PrintCompilation Print a message when a method is compiled\n"	\
+	"  -XX:CompileThreshold=<n> interpret methods until they have been\n"	\
+	"		   invoked or looped <n> times (0 compiles on first call)\n"	\
+	"  -XX:CICompilerCount=<n> compile methods in <n> background threads\n"	\
+	"  -XX:MaxInlineSize=<n> inline methods of at most <n> bytecode bytes\n"	\
+	"  -XX:MaxInlineLevel=<n> inline calls at most <n> levels deep (0 disables)\n"	\
+	"  -XX:OptLevel=<n> optimize compiled code at level <n> (0 to 2)\n"	\
+	"  -XX:-UseTLAB    allocate all objects directly from the GC heap\n"	\
+	"  -XX:-UseCHA     do not devirtualize calls with class hierarchy analysis\n"	\
+	"  -XX:-UseOnStackReplacement do not move looping interpreter frames\n"	\
+	"		   to compiled code\n"						\
+	"  -XX:-DoEscapeAnalysis do not replace objects that do not escape\n"	\
+	"		   their method with temporaries\n"				\
+	"  -XX:-EliminateLocks do not remove or merge redundant locking\n"	\
+	"  -XX:-UseBiasedLocking do not reserve objects for the thread that\n"	\
+	"		   locks them\n"						\
+	"  -XX:+PrintBiasedLockingStatistics print the number of bias\n"	\
+	"		   revocations on exit\n"						\
+	"  -XX:ParallelGCThreads=<n> mark the heap in <n> threads\n"	\
+	"  -Xmn<size>      use a nursery of <size> bytes with -Xnewgc (0 disables)\n"	\
+	"  -XX:MaxTenuringThreshold=<n> promote objects that survived <n>\n"	\
+	"		   minor collections\n"
 
 static void usage(FILE *f, int retval)
 {
@@ -810,6 +850,31 @@ static void handle_trace_invoke_verbose(void)
 	opt_trace_invoke_verbose = true;
 }
 
+static void handle_trace_ic(void)
+{
+	opt_trace_ic = true;
+}
+
+static void handle_trace_deopt(void)
+{
+	opt_trace_deopt = true;
+}
+
+static void handle_trace_escape(void)
+{
+	opt_trace_escape = true;
+}
+
+static void handle_trace_locks(void)
+{
+	opt_trace_locks = true;
+}
+
+static void handle_trace_monitor(void)
+{
+	opt_trace_monitor = true;
+}
+
 static void handle_trace_itable(void)
 {
 	opt_trace_itable = true;
@@ -888,6 +953,12 @@ static void handle_verbose_gc(void)
 	verbose_gc = true;
 }
 
+static void handle_gc_log_file(const char *arg)
+{
+	opt_gc_log_file	= arg;
+	verbose_gc	= true;
+}
+
 static void handle_max_heap_size(const char *arg)
 {
 	max_heap_size = parse_long(arg);
@@ -898,6 +969,17 @@ static void handle_max_heap_size(const char *arg)
 	}
 }
 
+static void handle_nursery_size(const char *arg)
+{
+	opt_nursery_size = parse_long(arg);
+
+	/* -Xmn0 selects the non-generational heap of -Xnewgc. */
+	if (!opt_nursery_size && strcmp(arg, "0")) {
+		fprintf(stderr, "%s: unparseable nursery size '%s'\n", program_name, arg);
+		usage(stderr, EXIT_FAILURE);
+	}
+}
+
 static void handle_thread_stack_size(const char *arg)
 {
 	/* Ignore */
@@ -908,6 +990,97 @@ static void handle_print_compilation(void)
 	opt_print_compilation = true;
 }
 
+static unsigned long parse_ulong_option(const char *arg, const char *what)
+{
+	unsigned long ret;
+	char *end;
+
+	ret = strtoul(arg, &end, 10);
+
+	if (*arg == '\0' || *end != '\0') {
+		fprintf(stderr, "%s: unparseable %s '%s'\n", program_name, what, arg);
+		usage(stderr, EXIT_FAILURE);
+	}
+
+	return ret;
+}
+
+static void handle_compile_threshold(const char *arg)
+{
+	opt_compile_threshold = parse_ulong_option(arg, "compile threshold");
+}
+
+static void handle_ci_compiler_count(const char *arg)
+{
+	opt_ci_compiler_count = parse_ulong_option(arg, "compiler thread count");
+}
+
+static void handle_parallel_gc_threads(const char *arg)
+{
+	opt_parallel_gc_threads = parse_ulong_option(arg, "GC thread count");
+}
+
+static void handle_max_tenuring_threshold(const char *arg)
+{
+	opt_max_tenuring_threshold = parse_ulong_option(arg, "tenuring threshold");
+}
+
+static void handle_max_inline_size(const char *arg)
+{
+	opt_inline_max_size = parse_ulong_option(arg, "inline size");
+}
+
+static void handle_max_inline_level(const char *arg)
+{
+	opt_inline_max_level = parse_ulong_option(arg, "inline level");
+}
+
+static void handle_opt_level(const char *arg)
+{
+	opt_level = parse_ulong_option(arg, "optimization level");
+
+	if (opt_level > MAX_OPT_LEVEL) {
+		fprintf(stderr, "%s: optimization level %lu is out of range (0 to %d)\n",
+			program_name, opt_level, MAX_OPT_LEVEL);
+		usage(stderr, EXIT_FAILURE);
+	}
+}
+
+static void handle_no_tlab(void)
+{
+	opt_use_tlab = false;
+}
+
+static void handle_no_cha(void)
+{
+	opt_use_cha = false;
+}
+
+static void handle_no_osr(void)
+{
+	opt_use_osr = false;
+}
+
+static void handle_no_escape_analysis(void)
+{
+	opt_escape_analysis = false;
+}
+
+static void handle_no_eliminate_locks(void)
+{
+	opt_eliminate_locks = false;
+}
+
+static void handle_no_biased_locking(void)
+{
+	opt_use_biased_locking = false;
+}
+
+static void handle_print_biased_locking_stats(void)
+{
+	opt_print_biased_locking_stats = true;
+}
+
 const struct option options[] = {
 	DEFINE_OPTION("version",		handle_version),
 	DEFINE_OPTION("h",			handle_help),
@@ -933,12 +1106,17 @@ const struct option options[] = {
 	DEFINE_OPTION("Xtrace:bytecode-offset",	handle_trace_bytecode_offset),
 	DEFINE_OPTION("Xtrace:classloader",	handle_trace_classloader),
 	DEFINE_OPTION("Xtrace:compile",		handle_trace_compile),
+	DEFINE_OPTION("Xtrace:deopt",		handle_trace_deopt),
+	DEFINE_OPTION("Xtrace:escape",		handle_trace_escape),
 	DEFINE_OPTION("Xtrace:exceptions",	handle_trace_exceptions),
 	DEFINE_OPTION("Xtrace:invoke",		handle_trace_invoke),
 	DEFINE_OPTION("Xtrace:invoke-verbose",	handle_trace_invoke_verbose),
+	DEFINE_OPTION("Xtrace:ic",		handle_trace_ic),
 	DEFINE_OPTION("Xtrace:itable",		handle_trace_itable),
 	DEFINE_OPTION("Xtrace:jit",		handle_trace_jit),
 	DEFINE_OPTION("Xtrace:liveness",	handle_trace_liveness),
+	DEFINE_OPTION("Xtrace:locks",		handle_trace_locks),
+	DEFINE_OPTION("Xtrace:monitor",		handle_trace_monitor),
 	DEFINE_OPTION("Xtrace:signals",		handle_trace_signals),
 	DEFINE_OPTION("Xtrace:trampoline",	handle_trace_trampoline),
 	DEFINE_OPTION("Xtrace:verifier",	handle_trace_verifier),
@@ -953,10 +1131,26 @@ const struct option options[] = {
 
 	DEFINE_OPTION_ADJACENT_ARG("Xbootclasspath/a:",	handle_bootclasspath_append),
 	DEFINE_OPTION_ADJACENT_ARG("D",		handle_define),
+	DEFINE_OPTION_ADJACENT_ARG("Xloggc:",	handle_gc_log_file),
 	DEFINE_OPTION_ADJACENT_ARG("Xmx",	handle_max_heap_size),
+	DEFINE_OPTION_ADJACENT_ARG("Xmn",	handle_nursery_size),
 	DEFINE_OPTION_ADJACENT_ARG("Xss",	handle_thread_stack_size),
 
 	DEFINE_OPTION("XX:+PrintCompilation",	handle_print_compilation),
+	DEFINE_OPTION("XX:-UseTLAB",		handle_no_tlab),
+	DEFINE_OPTION("XX:-UseCHA",		handle_no_cha),
+	DEFINE_OPTION("XX:-UseOnStackReplacement",	handle_no_osr),
+	DEFINE_OPTION("XX:-DoEscapeAnalysis",	handle_no_escape_analysis),
+	DEFINE_OPTION("XX:-EliminateLocks",	handle_no_eliminate_locks),
+	DEFINE_OPTION("XX:-UseBiasedLocking",	handle_no_biased_locking),
+	DEFINE_OPTION("XX:+PrintBiasedLockingStatistics",	handle_print_biased_locking_stats),
+	DEFINE_OPTION_ADJACENT_ARG("XX:CompileThreshold=",	handle_compile_threshold),
+	DEFINE_OPTION_ADJACENT_ARG("XX:CICompilerCount=",	handle_ci_compiler_count),
+	DEFINE_OPTION_ADJACENT_ARG("XX:MaxInlineSize=",	handle_max_inline_size),
+	DEFINE_OPTION_ADJACENT_ARG("XX:MaxInlineLevel=",	handle_max_inline_level),
+	DEFINE_OPTION_ADJACENT_ARG("XX:OptLevel=",	handle_opt_level),
+	DEFINE_OPTION_ADJACENT_ARG("XX:ParallelGCThreads=",	handle_parallel_gc_threads),
+	DEFINE_OPTION_ADJACENT_ARG("XX:MaxTenuringThreshold=",	handle_max_tenuring_threshold),
 };
 
 static void parse_options(int argc, char *argv[])
@@ -1227,6 +1421,11 @@ main(int argc, char *argv[])
 		goto out_check_exception;
 	}
 
+	if (init_compile_queue()) {
+		fprintf(stderr, "could not start compiler threads\n");
+		goto out_check_exception;
+	}
+
 	switch (operation) {
 	case OPERATION_MAIN_CLASS:
 		status = do_main_class();
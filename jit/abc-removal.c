@@ -14,10 +14,433 @@
 #include "jit/vars.h"
 
 #include "lib/bitset.h"
+#include "lib/hash-map.h"
 #include "lib/radix-tree.h"
 
+#include "vm/object.h"
+
 #include <stdio.h>
 
+/*
+ * Loop bounds check elimination. A loop of the form
+ *
+ *	for (i = 0; i < a.length; i++)
+ *		... a[i] ...
+ *
+ * keeps the induction variable @index_slot in [0, a.length) everywhere in
+ * the loop body until the next store to it. We prove that for one loop at
+ * a time and drop the bounds checks of accesses to the same array whose
+ * index is such a load.
+ */
+struct abc_loop {
+	struct basic_block	*header;
+	/* Successor of @header entered when the loop test holds */
+	struct basic_block	*body;
+	struct stack_slot	*index_slot;
+	/* Array whose length the induction variable is tested against */
+	struct var_info		*array;
+	struct bitset		*tainted;
+};
+
+static struct insn *ssa_def_insn(struct var_info *var)
+{
+	struct use_position *use;
+
+	list_for_each_entry(use, &var->interval->use_positions, use_pos_list) {
+		struct use_position *defs[MAX_REG_OPERANDS];
+		int nr_defs;
+
+		if (insn_is_phi(use->insn))
+			continue;
+
+		nr_defs = insn_defs_reg(use->insn, defs);
+		for (int i = 0; i < nr_defs; i++) {
+			if (defs[i] == use)
+				return use->insn;
+		}
+	}
+
+	return NULL;
+}
+
+static bool insn_is_load_of(struct insn *insn, struct stack_slot *slot)
+{
+	return insn && insn->type == INSN_MOV_MEMLOCAL_REG
+		&& insn->src.slot->index == slot->index;
+}
+
+static bool insn_stores_slot(struct insn *insn, struct stack_slot *slot)
+{
+	struct stack_slot *dest;
+
+	switch (insn->type) {
+	case INSN_PHI:
+	case INSN_MOV_MEMLOCAL_REG:
+	case INSN_MOVSS_MEMLOCAL_XMM:
+	case INSN_MOVSD_MEMLOCAL_XMM:
+	case INSN_FLD_MEMLOCAL:
+	case INSN_FLD_64_MEMLOCAL:
+	case INSN_PUSH_MEMLOCAL:
+		return false;
+	case INSN_FSTP_MEMLOCAL:
+	case INSN_FSTP_64_MEMLOCAL:
+	case INSN_POP_MEMLOCAL:
+		dest = insn->operand.slot;
+		break;
+	default:
+		if (insn->dest.type != OPERAND_MEMLOCAL)
+			return false;
+
+		dest = insn->dest.slot;
+		break;
+	}
+
+	if (dest->index == slot->index)
+		return true;
+
+	/* 64-bit stores cover the following slot too. */
+	if (insn->type == INSN_FSTP_64_MEMLOCAL || insn->type == INSN_MOVSD_XMM_MEMLOCAL)
+		return dest->index + 1 == slot->index;
+
+	return false;
+}
+
+static bool bb_in_loop(struct abc_loop *loop, struct basic_block *bb)
+{
+	return test_bit(loop->header->natural_loop->bits, bb->dfn);
+}
+
+static bool bb_dominates(struct basic_block *dom, struct basic_block *bb)
+{
+	return dom == bb || test_bit(bb->dominators->bits, dom->dfn);
+}
+
+static struct insn *bb_prev_insn(struct basic_block *bb, struct insn *insn)
+{
+	if (insn->insn_list_node.prev == &bb->insn_list)
+		return NULL;
+
+	return list_entry(insn->insn_list_node.prev, struct insn, insn_list_node);
+}
+
+static bool insn_is_array_length(struct insn *insn)
+{
+	return insn && insn->type == INSN_MOV_MEMBASE_REG
+		&& insn->src.disp == offsetof(struct vm_array, array_length);
+}
+
+/*
+ * Matches "index < array.length" at the end of the loop header and
+ * returns the loop body successor.
+ */
+static bool match_loop_test(struct abc_loop *loop)
+{
+	struct basic_block *header = loop->header;
+	struct var_info *index, *length;
+	struct insn *branch, *cmp, *load, *insn;
+	bool taken;
+
+	if (list_is_empty(&header->insn_list) || header->nr_successors != 2)
+		return false;
+
+	branch = list_entry(header->insn_list.prev, struct insn, insn_list_node);
+	cmp = bb_prev_insn(header, branch);
+	if (!cmp || cmp->type != INSN_CMP_REG_REG)
+		return false;
+
+	/* "cmp src, dest" sets the flags for "dest - src". */
+	switch (branch->type) {
+	case INSN_JL_BRANCH:
+	case INSN_JGE_BRANCH:
+		index	= cmp->dest.reg.interval->var_info;
+		length	= cmp->src.reg.interval->var_info;
+		taken	= branch->type == INSN_JL_BRANCH;
+		break;
+	case INSN_JG_BRANCH:
+	case INSN_JLE_BRANCH:
+		index	= cmp->src.reg.interval->var_info;
+		length	= cmp->dest.reg.interval->var_info;
+		taken	= branch->type == INSN_JG_BRANCH;
+		break;
+	default:
+		return false;
+	}
+
+	load = ssa_def_insn(index);
+	if (load == NULL || load->type != INSN_MOV_MEMLOCAL_REG)
+		return false;
+
+	insn = ssa_def_insn(length);
+	if (!insn_is_array_length(insn))
+		return false;
+
+	loop->index_slot = load->src.slot;
+	loop->array = insn->src.base_reg.interval->var_info;
+
+	/* The loaded index must still be in the slot when the loop is entered. */
+	for (insn = cmp; insn && insn != load; insn = bb_prev_insn(header, insn)) {
+		if (insn_stores_slot(insn, loop->index_slot))
+			return false;
+	}
+
+	if (!insn)
+		return false;
+
+	if (header->successors[0] == branch->operand.branch_target)
+		loop->body = header->successors[taken ? 0 : 1];
+	else
+		loop->body = header->successors[taken ? 1 : 0];
+
+	if (loop->body == header || !bb_in_loop(loop, loop->body))
+		return false;
+
+	return loop->body->nr_predecessors == 1;
+}
+
+/*
+ * Marks the loop blocks that can be reached from a store to the index
+ * slot without passing through the loop header.
+ */
+static void compute_tainted_bbs(struct compilation_unit *cu, struct abc_loop *loop)
+{
+	struct basic_block *worklist[cu->nr_bb];
+	struct basic_block *bb;
+	struct insn *insn;
+	unsigned long nr = 0;
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		if (bb == loop->header || !bb_in_loop(loop, bb))
+			continue;
+
+		for_each_insn(insn, &bb->insn_list) {
+			if (insn_stores_slot(insn, loop->index_slot)) {
+				worklist[nr++] = bb;
+				break;
+			}
+		}
+	}
+
+	while (nr) {
+		bb = worklist[--nr];
+
+		for (unsigned long i = 0; i < bb->nr_successors; i++) {
+			struct basic_block *succ = bb->successors[i];
+
+			if (succ == loop->header || !bb_in_loop(loop, succ))
+				continue;
+
+			if (test_bit(loop->tainted->bits, succ->dfn))
+				continue;
+
+			set_bit(loop->tainted->bits, succ->dfn);
+			worklist[nr++] = succ;
+		}
+	}
+}
+
+/*
+ * Marks the registers that are loaded from the index slot at a point
+ * where the loop test is known to hold.
+ */
+static void compute_in_range(struct compilation_unit *cu, struct abc_loop *loop, bool *in_range)
+{
+	struct basic_block *bb;
+	struct insn *insn;
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		if (!bb_in_loop(loop, bb) || !bb_dominates(loop->body, bb))
+			continue;
+
+		if (test_bit(loop->tainted->bits, bb->dfn))
+			continue;
+
+		for_each_insn(insn, &bb->insn_list) {
+			if (insn_stores_slot(insn, loop->index_slot))
+				break;
+
+			if (insn_is_load_of(insn, loop->index_slot))
+				in_range[insn->dest.reg.interval->var_info->vreg] = true;
+		}
+	}
+}
+
+static bool is_non_negative_store(struct insn *insn)
+{
+	struct insn *def;
+
+	if (insn->type == INSN_MOV_IMM_MEMLOCAL)
+		return (int32_t) insn->src.imm >= 0;
+
+	if (insn->type != INSN_MOV_REG_MEMLOCAL)
+		return false;
+
+	def = ssa_def_insn(insn->src.reg.interval->var_info);
+
+	return def && insn_is_mov_imm_reg(def) && (int32_t) def->src.imm >= 0;
+}
+
+/*
+ * Checks that @store is "index = index + 1" where the old value of index
+ * is in range. The increment then cannot overflow.
+ */
+static bool is_safe_increment(struct compilation_unit *cu, struct abc_loop *loop,
+			      struct basic_block *bb, struct insn *store, bool *in_range)
+{
+	struct use_position *add_on = NULL;
+	struct insn *add, *insn;
+	struct var_info *old;
+
+	if (store->type != INSN_MOV_REG_MEMLOCAL)
+		return false;
+
+	add = ssa_def_insn(store->src.reg.interval->var_info);
+	if (!add || add->type != INSN_ADD_IMM_REG || add->src.imm != 1)
+		return false;
+
+	hash_map_get(cu->insn_add_ons, add, (void **) &add_on);
+	if (!add_on)
+		return false;
+
+	old = add_on->interval->var_info;
+	if (!in_range[old->vreg])
+		return false;
+
+	for (insn = bb_prev_insn(bb, store); insn; insn = bb_prev_insn(bb, insn)) {
+		if (insn_stores_slot(insn, loop->index_slot))
+			return false;
+
+		if (insn_is_load_of(insn, loop->index_slot))
+			return insn->dest.reg.interval->var_info == old;
+	}
+
+	return false;
+}
+
+/*
+ * The index slot is an induction variable if it is only assigned
+ * non-negative constants outside of the loop and only incremented by one
+ * from an in-range value inside of it.
+ */
+static bool is_induction_slot(struct compilation_unit *cu, struct abc_loop *loop, bool *in_range)
+{
+	struct basic_block *bb;
+	struct insn *insn;
+
+	if (loop->index_slot->index < cu->stack_frame->nr_args)
+		return false;
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		for_each_insn(insn, &bb->insn_list) {
+			if (!insn_stores_slot(insn, loop->index_slot))
+				continue;
+
+			if (bb_in_loop(loop, bb)) {
+				if (!is_safe_increment(cu, loop, bb, insn, in_range))
+					return false;
+			} else if (!is_non_negative_store(insn))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static bool is_loop_array(struct compilation_unit *cu, struct abc_loop *loop, struct var_info *array)
+{
+	struct insn *def, *loop_def, *insn;
+	struct basic_block *bb;
+
+	if (array == loop->array)
+		return true;
+
+	def = ssa_def_insn(array);
+	loop_def = ssa_def_insn(loop->array);
+	if (!def || def->type != INSN_MOV_MEMLOCAL_REG || !insn_is_load_of(loop_def, def->src.slot))
+		return false;
+
+	/* Both are loads of the same local which the loop never changes. */
+	for_each_basic_block(bb, &cu->bb_list) {
+		if (!bb_in_loop(loop, bb))
+			continue;
+
+		for_each_insn(insn, &bb->insn_list) {
+			if (insn_stores_slot(insn, def->src.slot))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static void abc_removal_loop(struct compilation_unit *cu, struct basic_block *header)
+{
+	bool in_range[cu->ssa_nr_vregs];
+	struct abc_loop loop = {
+		.header	= header,
+	};
+	struct basic_block *bb;
+	struct insn *insn, *tmp;
+
+	if (!match_loop_test(&loop))
+		return;
+
+	loop.tainted = alloc_bitset(cu->nr_bb);
+	if (!loop.tainted)
+		return;
+
+	for (unsigned long i = 0; i < cu->ssa_nr_vregs; i++)
+		in_range[i] = false;
+
+	compute_tainted_bbs(cu, &loop);
+	compute_in_range(cu, &loop, in_range);
+
+	if (!is_induction_slot(cu, &loop, in_range))
+		goto out;
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		if (!bb_in_loop(&loop, bb))
+			continue;
+
+		list_for_each_entry_safe(insn, tmp, &bb->insn_list, insn_list_node) {
+			struct var_info *index, *array;
+			struct insn *cmp;
+
+			if (!insn_is_array_check(insn))
+				continue;
+
+			index = insn->dest.reg.interval->var_info;
+			array = insn->src.reg.interval->var_info;
+
+			if (!in_range[index->vreg] || !is_loop_array(cu, &loop, array))
+				continue;
+
+			cmp = bb_prev_insn(bb, insn);
+
+			remove_insn(insn);
+			remove_insn(cmp);
+		}
+	}
+out:
+	free(loop.tainted);
+}
+
+static void abc_removal_loops(struct compilation_unit *cu)
+{
+	struct basic_block *bb;
+
+	/*
+	 * Code reached from exception handlers is not part of the dominator
+	 * tree nor of the natural loops so we can't reason about it.
+	 */
+	if (cu_has_eh_bbs(cu))
+		return;
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		if (bb->natural_loop)
+			abc_removal_loop(cu, bb);
+	}
+}
+
 void abc_removal(struct compilation_unit *cu)
 {
 	struct basic_block *bb;
@@ -34,7 +457,7 @@ void abc_removal(struct compilation_unit *cu)
 
 	for_each_basic_block(bb, &cu->bb_list)
 		list_for_each_entry(insn, &bb->insn_list, insn_list_node)
-			if (insn_is_call_to(insn, vm_object_alloc_primitive_array))
+			if (insn_is_array_check(insn))
 				nr_array_check++;
 
 	struct insn *delete[nr_array_check];
@@ -48,7 +471,8 @@ void abc_removal(struct compilation_unit *cu)
 				regs_value[reg].val = insn->src.imm;
 			}
 
-			if (insn_is_call_to(insn, vm_object_alloc_primitive_array)) {
+			if (insn_is_call_to(insn, vm_object_alloc_primitive_array) ||
+			    insn_is_call_to(insn, vm_object_alloc_primitive_array_class)) {
 				struct insn *insn_push_size, *insn_mov_eax_array;
 				uint32_t size_reg, array_reg;
 
@@ -66,17 +490,11 @@ void abc_removal(struct compilation_unit *cu)
 				}
 			}
 
-			if (insn_is_call_to(insn, vm_object_check_array)) {
-				struct insn *insn_push_index, *insn_push_array;
+			if (insn_is_array_check(insn)) {
 				uint32_t index_reg, array_reg;
 
-				insn_push_index = list_entry(insn->insn_list_node.prev->prev,
-								struct insn, insn_list_node);
-				index_reg = insn_push_index->src.reg.interval->var_info->vreg;
-
-				insn_push_array = list_entry(insn->insn_list_node.prev,
-								struct insn, insn_list_node);
-				array_reg = insn_push_array->src.reg.interval->var_info->vreg;
+				index_reg = insn->dest.reg.interval->var_info->vreg;
+				array_reg = insn->src.reg.interval->var_info->vreg;
 
 				if (regs_value[index_reg].active && arrays_value[array_reg].active) {
 					if (regs_value[index_reg].val < arrays_value[array_reg].size)
@@ -87,27 +505,15 @@ void abc_removal(struct compilation_unit *cu)
 	}
 
 	for (int i = 0; i < index; i++) {
-		struct insn *insn_push_index, *insn_push_array,
-			*insn, *insn_args_cleanup,
-			*insn_exception_test1, *insn_exception_test2;
+		struct insn *insn, *insn_cmp_length;
 
 		insn = delete[i];
-		insn_push_index = list_entry(insn->insn_list_node.prev->prev,
-					struct insn, insn_list_node);
-		insn_push_array = list_entry(insn->insn_list_node.prev,
-					struct insn, insn_list_node);
-		insn_args_cleanup = list_entry(insn->insn_list_node.next,
-					struct insn, insn_list_node);
-		insn_exception_test1 = list_entry(insn->insn_list_node.next->next,
-					struct insn, insn_list_node);
-		insn_exception_test2 = list_entry(insn->insn_list_node.next->next->next,
+		insn_cmp_length = list_entry(insn->insn_list_node.prev,
 					struct insn, insn_list_node);
 
 		remove_insn(insn);
-		remove_insn(insn_push_index);
-		remove_insn(insn_push_array);
-		remove_insn(insn_args_cleanup);
-		remove_insn(insn_exception_test1);
-		remove_insn(insn_exception_test2);
+		remove_insn(insn_cmp_length);
 	}
+
+	abc_removal_loops(cu);
 }
@@ -136,14 +136,16 @@ bool all_insn_have_bytecode_offset(struct compilation_unit *cu)
 	return true;
 }
 
-int bytecode_offset_to_line_no(struct vm_method *mb, unsigned long bc_offset)
+static int
+line_number_table_lookup(const struct cafebabe_line_number_table_attribute *attr,
+			 unsigned long bc_offset)
 {
 	struct cafebabe_line_number_table_entry *table;
 	int length;
 	int i;
 
-	table = mb->line_number_table_attribute.line_number_table;
-	length = mb->line_number_table_attribute.line_number_table_length;
+	table = attr->line_number_table;
+	length = attr->line_number_table_length;
 
 	if(bc_offset == BC_OFFSET_UNKNOWN || length == 0)
 		return -1;
@@ -154,3 +156,17 @@ int bytecode_offset_to_line_no(struct vm_method *mb, unsigned long bc_offset)
 
 	return table[i].line_number;
 }
+
+int bytecode_offset_to_line_no(struct vm_method *mb, unsigned long bc_offset)
+{
+	return line_number_table_lookup(&mb->line_number_table_attribute, bc_offset);
+}
+
+/*
+ * Returns the line number of @bc_offset in the code of @cu, which might
+ * have methods inlined into it.
+ */
+int cu_bytecode_offset_to_line_no(struct compilation_unit *cu, unsigned long bc_offset)
+{
+	return line_number_table_lookup(cu->line_number_table_attribute, bc_offset);
+}
@@ -183,13 +183,13 @@ static int do_convert_bb_to_ir(struct basic_block *bb)
 		.buffer = &buffer,
 		.cu = cu,
 		.bb = bb,
-		.code = cu->method->code_attribute.code,
+		.code = cu->code_attribute->code,
 		.is_wide = false,
 	};
 	int err = 0;
 
 	buffer = (struct bytecode_buffer) {
-		.buffer		= cu->method->code_attribute.code,
+		.buffer		= cu->code_attribute->code,
 		.pos		= bb->start,
 	};
 
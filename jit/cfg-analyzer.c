@@ -23,7 +23,7 @@
 
 static bool is_exception_handler(struct basic_block *bb)
 {
-	return lookup_eh_entry(bb->b_parent->method, bb->start) != NULL;
+	return lookup_eh_entry(bb->b_parent, bb->start) != NULL;
 }
 
 static void detect_exception_handlers(struct compilation_unit *cu)
@@ -36,14 +36,14 @@ static void detect_exception_handlers(struct compilation_unit *cu)
 
 static int split_at_exception_handlers(struct compilation_unit *cu)
 {
-	struct vm_method *method = cu->method;
+	struct cafebabe_code_attribute *code_attr = cu->code_attribute;
 	int i, err = 0;
 
-	for (i = 0; i < method->code_attribute.exception_table_length; i++) {
+	for (i = 0; i < code_attr->exception_table_length; i++) {
 		struct cafebabe_code_attribute_exception *eh;
 		struct basic_block *bb;
 
-		eh = &method->code_attribute.exception_table[i];
+		eh = &code_attr->exception_table[i];
 
 		bb = find_bb(cu, eh->handler_pc);
 		if (!bb) {
@@ -102,7 +102,7 @@ static int split_at_branch_targets(struct compilation_unit *cu, struct bitset *b
 	unsigned long offset;
 	int err = 0;
 
-	for (offset = 0; offset < cu->method->code_attribute.code_length; offset++) {
+	for (offset = 0; offset < cu->code_attribute->code_length; offset++) {
 		struct basic_block *bb;
 
 		if (!test_bit(branch_targets->bits, offset))
@@ -215,14 +215,14 @@ static int split_after_branches(const unsigned char *code,
 
 static bool all_exception_handlers_have_bb(struct compilation_unit *cu)
 {
-	struct vm_method *method = cu->method;
+	struct cafebabe_code_attribute *code_attr = cu->code_attribute;
 	int i;
 
-	for (i = 0; i < method->code_attribute.exception_table_length; i++) {
+	for (i = 0; i < code_attr->exception_table_length; i++) {
 		struct cafebabe_code_attribute_exception *eh;
 		struct basic_block *bb;
 
-		eh = &method->code_attribute.exception_table[i];
+		eh = &code_attr->exception_table[i];
 		bb = find_bb(cu, eh->handler_pc);
 
 		if (bb == NULL || bb->start != eh->handler_pc || !bb->is_eh)
@@ -239,8 +239,8 @@ int analyze_control_flow(struct compilation_unit *cu)
 	int code_length;
 	int err = 0;
 
-	code = cu->method->code_attribute.code;
-	code_length = cu->method->code_attribute.code_length;
+	code = cu->code_attribute->code;
+	code_length = cu->code_attribute->code_length;
 
 	branch_targets = alloc_bitset(code_length);
 	if (!branch_targets)
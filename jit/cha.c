@@ -0,0 +1,391 @@
+/*
+ * Class hierarchy analysis
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ *
+ * Virtual and interface calls whose target is the only implementation in
+ * the loaded class hierarchy are compiled to direct calls. The compilation
+ * unit records a dependency on every method it assumed is not overridden
+ * and on every interface it assumed has a single implementing class.
+ *
+ * When a newly linked class breaks an assumption, the code of all
+ * dependent compilation units is invalidated: the method gets a fresh
+ * compilation unit and the entry of the old code is patched to jump to the
+ * method trampoline so that callers end up recompiling the method. The
+ * devirtualized calls of the old code are redirected to stubs that
+ * dispatch on the receiver so that frames which are already running the
+ * old code keep calling the right methods. Where possible, such frames
+ * are also deoptimized when the call they are in returns (see
+ * jit/deopt.c). Once the method has been recompiled, the entries of its
+ * old code are patched to jump to the new code.
+ */
+
+#include "jit/compilation-unit.h"
+#include "jit/emit-code.h"
+#include "jit/compiler.h"
+#include "jit/inliner.h"
+#include "jit/deopt.h"
+#include "jit/cha.h"
+
+#include "vm/method.h"
+#include "vm/class.h"
+#include "vm/die.h"
+
+#include "lib/list.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+bool opt_use_cha = true;
+
+/*
+ * Protects the class hierarchy analysis state of classes and methods and
+ * the dependency lists of compilation units.
+ */
+static pthread_mutex_t cha_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+struct cha_dependency {
+	struct compilation_unit	*cu;
+
+	/* The dependents list of the method or interface. */
+	struct list_head	*dependents;
+
+	struct list_head	cu_node;
+	struct list_head	node;
+};
+
+static int add_dependency(struct compilation_unit *cu, struct list_head *dependents)
+{
+	struct cha_dependency *dep;
+
+	list_for_each_entry(dep, &cu->cha_dependency_list, cu_node) {
+		if (dep->dependents == dependents)
+			return 0;
+	}
+
+	dep = malloc(sizeof *dep);
+	if (!dep)
+		return -ENOMEM;
+
+	dep->cu		= cu;
+	dep->dependents	= dependents;
+
+	list_add(&dep->cu_node, &cu->cha_dependency_list);
+	list_add(&dep->node, dependents);
+
+	cu->cha_dependent = true;
+
+	return 0;
+}
+
+static void __cha_remove_dependencies(struct compilation_unit *cu)
+{
+	struct cha_dependency *dep, *next;
+
+	list_for_each_entry_safe(dep, next, &cu->cha_dependency_list, cu_node) {
+		list_del(&dep->cu_node);
+		list_del(&dep->node);
+		free(dep);
+	}
+}
+
+/*
+ * Drops the dependencies recorded by an earlier compilation attempt of
+ * @cu.
+ */
+void cha_remove_dependencies(struct compilation_unit *cu)
+{
+	pthread_mutex_lock(&cha_mutex);
+
+	__cha_remove_dependencies(cu);
+
+	cu->cha_dependent = false;
+	cu->cha_invalid = false;
+
+	pthread_mutex_unlock(&cha_mutex);
+}
+
+static bool can_devirtualize(struct vm_method *vmm)
+{
+	return vm_method_is_virtual(vmm) && !vm_method_is_abstract(vmm)
+		&& !vm_method_is_native(vmm);
+}
+
+/*
+ * Returns @vmm if it is the only implementation of the method for all
+ * loaded subclasses of its class or NULL otherwise.
+ */
+struct vm_method *cha_unique_target(struct compilation_unit *cu, struct vm_method *vmm)
+{
+	struct vm_method *target = NULL;
+
+	if (!opt_use_cha || !can_devirtualize(vmm))
+		return NULL;
+
+	if (vm_method_is_final(vmm) || vm_class_is_final(vmm->class))
+		return vmm;
+
+	pthread_mutex_lock(&cha_mutex);
+
+	if (!vmm->cha_overridden && !add_dependency(cu, &vmm->cha_dependent_list))
+		target = vmm;
+
+	pthread_mutex_unlock(&cha_mutex);
+
+	return target;
+}
+
+/*
+ * Returns the implementation of interface method @vmm if only one class
+ * and its subclasses implement the interface and none of the subclasses
+ * override the method. Returns NULL otherwise.
+ */
+struct vm_method *cha_unique_interface_target(struct compilation_unit *cu, struct vm_method *vmm)
+{
+	struct vm_class *vmi = vmm->class;
+	struct vm_method *target = NULL;
+	struct vm_class *impl;
+
+	if (!opt_use_cha || !vm_class_is_interface(vmi))
+		return NULL;
+
+	pthread_mutex_lock(&cha_mutex);
+
+	impl = vmi->cha_implementor;
+	if (!impl || vmi->cha_many_implementors)
+		goto out_unlock;
+
+	target = vm_class_get_method_recursive(impl, vmm->name, vmm->type);
+	if (!target || !can_devirtualize(target)) {
+		target = NULL;
+		goto out_unlock;
+	}
+
+	if (!vm_method_is_final(target) && !vm_class_is_final(target->class)) {
+		if (target->cha_overridden || add_dependency(cu, &target->cha_dependent_list)) {
+			target = NULL;
+			goto out_unlock;
+		}
+	}
+
+	if (add_dependency(cu, &vmi->cha_dependent_list))
+		target = NULL;
+
+out_unlock:
+	pthread_mutex_unlock(&cha_mutex);
+
+	return target;
+}
+
+int cha_add_call_site(struct compilation_unit *cu, struct insn *call_insn,
+		      struct vm_method *target, struct vm_method *vmm)
+{
+	struct cha_call_site *site;
+
+	site = malloc(sizeof *site);
+	if (!site)
+		return -ENOMEM;
+
+	site->call_insn		= call_insn;
+	site->mach_offset	= 0;
+	site->target		= target;
+	site->vmm		= vmm;
+
+	list_add(&site->node, &cu->cha_call_site_list);
+
+	return 0;
+}
+
+void cha_free_call_sites(struct compilation_unit *cu)
+{
+	struct cha_call_site *site, *next;
+
+	list_for_each_entry_safe(site, next, &cu->cha_call_site_list, node) {
+		list_del(&site->node);
+		free(site);
+	}
+}
+
+/*
+ * Redirects the devirtualized calls of @cu to stubs that dispatch on the
+ * receiver. Must be called with cha_mutex held.
+ */
+static void redirect_call_sites(struct compilation_unit *cu)
+{
+	struct cha_call_site *site;
+
+	list_for_each_entry(site, &cu->cha_call_site_list, node) {
+		struct vm_method *vmm = site->vmm;
+
+		if (!vmm->cha_dispatch_stub) {
+			vmm->cha_dispatch_stub = emit_cha_dispatch_stub(vmm);
+			if (!vmm->cha_dispatch_stub)
+				die("out of memory");
+		}
+
+		fixup_cha_call_site(site->target->trampoline,
+				    buffer_ptr(cu->objcode) + site->mach_offset,
+				    vmm->cha_dispatch_stub);
+	}
+}
+
+/*
+ * Replaces the compilation unit of the method of @cu with a fresh one and
+ * makes the code of @cu jump to the method trampoline. Must be called with
+ * cha_mutex held.
+ */
+static void invalidate_code(struct compilation_unit *cu)
+{
+	struct vm_method *vmm = cu->method;
+	struct compilation_unit *new_cu;
+
+	assert(vmm->compilation_unit == cu);
+
+	new_cu = compilation_unit_alloc(vmm);
+	if (!new_cu)
+		die("out of memory");
+
+	/*
+	 * The new code is compiled from the same inlined bytecode. It and
+	 * the inlined frames stay allocated in the same arena because stack
+	 * traces and deoptimization of the old code use them too.
+	 */
+	if (cu->inline_frames) {
+		size_t size = cu->nr_inline_frames * sizeof(struct inline_frame *);
+
+		new_cu->inline_frames = malloc(size);
+		if (!new_cu->inline_frames)
+			die("out of memory");
+
+		memcpy(new_cu->inline_frames, cu->inline_frames, size);
+		new_cu->nr_inline_frames = cu->nr_inline_frames;
+	}
+
+	new_cu->code_attribute			= cu->code_attribute;
+	new_cu->line_number_table_attribute	= cu->line_number_table_attribute;
+
+	new_cu->inline_arena	= cu->inline_arena;
+	cu->inline_arena	= NULL;
+
+	new_cu->inline_pc_map		= cu->inline_pc_map;
+	new_cu->inline_orig_code	= cu->inline_orig_code;
+	cu->inline_pc_map		= NULL;
+
+	new_cu->replaced_cu	= cu;
+	vmm->compilation_unit	= new_cu;
+
+	fixup_method_entry(cu_entry_point(cu), vm_method_trampoline_ptr(vmm));
+	redirect_call_sites(cu);
+	deopt_invalidate(cu);
+
+	cu->state = COMPILATION_STATE_INVALIDATED;
+}
+
+/*
+ * Invalidates all compilation units on @dependents. Code that is not
+ * installed yet is invalidated by cha_code_installed(). Must be called
+ * with cha_mutex held.
+ */
+static void invalidate_dependents(struct list_head *dependents)
+{
+	while (!list_is_empty(dependents)) {
+		struct cha_dependency *dep;
+		struct compilation_unit *cu;
+
+		dep = list_first_entry(dependents, struct cha_dependency, node);
+		cu = dep->cu;
+
+		cu->cha_invalid = true;
+
+		__cha_remove_dependencies(cu);
+
+		if (cu->state == COMPILATION_STATE_COMPILED)
+			invalidate_code(cu);
+	}
+}
+
+static void cha_add_implementor(struct vm_class *vmi, struct vm_class *vmc)
+{
+	if (vmi->cha_many_implementors)
+		return;
+
+	if (!vmi->cha_implementor) {
+		vmi->cha_implementor = vmc;
+		return;
+	}
+
+	if (vm_class_is_assignable_from(vmi->cha_implementor, vmc))
+		return;
+
+	vmi->cha_many_implementors = true;
+
+	invalidate_dependents(&vmi->cha_dependent_list);
+}
+
+/*
+ * Updates the class hierarchy analysis state with @vmc and invalidates the
+ * code that assumed no such class exists. This must be called before
+ * instances of @vmc can be created.
+ */
+void cha_class_linked(struct vm_class *vmc)
+{
+	if (vm_class_is_interface(vmc))
+		return;
+
+	pthread_mutex_lock(&cha_mutex);
+
+	for (unsigned int i = 0; vmc->super && i < vmc->nr_methods; i++) {
+		struct vm_method *vmm = &vmc->methods[i];
+		struct vm_method *overridden;
+
+		if (!vm_method_is_virtual(vmm))
+			continue;
+
+		overridden = vm_class_get_method_recursive(vmc->super, vmm->name, vmm->type);
+		if (!overridden || !vm_method_is_virtual(overridden))
+			continue;
+
+		overridden->cha_overridden = true;
+
+		invalidate_dependents(&overridden->cha_dependent_list);
+	}
+
+	for (unsigned int i = 0; i < vmc->nr_secondary_supers; i++) {
+		struct vm_class *vmi = (struct vm_class *) vmc->secondary_supers[i];
+
+		if (vm_class_is_interface(vmi))
+			cha_add_implementor(vmi, vmc);
+	}
+
+	pthread_mutex_unlock(&cha_mutex);
+}
+
+/*
+ * Must be called after the code of @cu has been marked as compiled. If a
+ * class that invalidates the code was linked during compilation, the code
+ * is invalidated here. Otherwise the code that @cu replaces is patched to
+ * jump to the new code.
+ */
+void cha_code_installed(struct compilation_unit *cu)
+{
+	struct compilation_unit *old;
+
+	if (!cu->cha_dependent && !cu->replaced_cu)
+		return;
+
+	pthread_mutex_lock(&cha_mutex);
+
+	if (cu->cha_invalid) {
+		if (cu->state == COMPILATION_STATE_COMPILED)
+			invalidate_code(cu);
+	} else {
+		for (old = cu->replaced_cu; old != NULL; old = old->replaced_cu)
+			fixup_method_entry(cu_entry_point(old), cu_entry_point(cu));
+	}
+
+	pthread_mutex_unlock(&cha_mutex);
+}
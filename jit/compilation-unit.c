@@ -10,7 +10,10 @@
 
 #include "jit/args.h"
 #include "jit/basic-block.h"
+#include "jit/cha.h"
 #include "jit/compilation-unit.h"
+#include "jit/gc-map.h"
+#include "jit/inliner.h"
 #include "jit/instruction.h"
 #include "jit/stack-slot.h"
 #include "jit/statement.h"
@@ -77,8 +80,12 @@ struct compilation_unit *compilation_unit_alloc(struct vm_method *method)
 		memset(cu, 0, sizeof *cu);
 
 		INIT_LIST_HEAD(&cu->bb_list);
+		INIT_LIST_HEAD(&cu->compile_queue_node);
 		cu->method = method;
 
+		cu->code_attribute = &method->code_attribute;
+		cu->line_number_table_attribute = &method->line_number_table_attribute;
+
 		cu->exit_bb = do_alloc_basic_block(cu, 0, 0);
 		if (!cu->exit_bb)
 			goto out_of_memory;
@@ -104,8 +111,9 @@ struct compilation_unit *compilation_unit_alloc(struct vm_method *method)
 		INIT_LIST_HEAD(&cu->static_fixup_site_list);
 		INIT_LIST_HEAD(&cu->call_fixup_site_list);
 		INIT_LIST_HEAD(&cu->tableswitch_list);
-		INIT_LIST_HEAD(&cu->lookupswitch_list);
 		INIT_LIST_HEAD(&cu->ic_call_list);
+		INIT_LIST_HEAD(&cu->cha_dependency_list);
+		INIT_LIST_HEAD(&cu->cha_call_site_list);
 
 		cu->lir_insn_map = NULL;
 
@@ -160,17 +168,6 @@ static void free_tableswitch_list(struct compilation_unit *cu)
 	}
 }
 
-static void free_lookupswitch_list(struct compilation_unit *cu)
-{
-	struct lookupswitch *this, *next;
-
-	list_for_each_entry_safe(this, next, &cu->lookupswitch_list, list_node)
-	{
-		list_del(&this->list_node);
-		free_lookupswitch(this);
-	}
-}
-
 static void free_call_fixup_sites(struct compilation_unit *cu)
 {
 	struct fixup_site *this, *next;
@@ -213,8 +210,11 @@ void free_compilation_unit(struct compilation_unit *cu)
 {
 	struct basic_block *bb, *tmp_bb;
 
+	cha_remove_dependencies(cu);
+	cha_free_call_sites(cu);
 	free_call_fixup_sites(cu);
 	shrink_compilation_unit(cu);
+	free_inline_frames(cu);
 
 	list_for_each_entry_safe(bb, tmp_bb, &cu->bb_list, bb_list_node)
 		free_basic_block(bb);
@@ -225,10 +225,13 @@ void free_compilation_unit(struct compilation_unit *cu)
 	free_buffer(cu->objcode);
 	free_stack_frame(cu->stack_frame);
 	free_bc_offset_map(cu->bc_offset_map);
-	free_lookupswitch_list(cu);
 	free_tableswitch_list(cu);
 	free_lir_insn_map(cu);
 	free(cu->exception_handlers);
+	free(cu->local_kinds);
+	free(cu->deopt_sites);
+	free(cu->osr_entries);
+	free_gc_maps(cu->gc_maps);
 	free_constant_pool(cu->pool_head);
 	free(cu);
 }
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ *
+ * Background compilation. Methods are put into a queue that is ordered by
+ * how hot the methods are and compiled by a pool of compiler threads. The
+ * thread that invoked the method keeps on running it in the interpreter
+ * until the compiled code is installed.
+ */
+
+#include "jit/compile-queue.h"
+#include "jit/compilation-unit.h"
+#include "jit/cha.h"
+#include "jit/compiler.h"
+#include "jit/cu-mapping.h"
+#include "jit/exception.h"
+#include "jit/vtable.h"
+
+#include "vm/method.h"
+#include "vm/thread.h"
+#include "vm/die.h"
+
+#include "lib/list.h"
+
+#include <pthread.h>
+#include <stdio.h>
+
+unsigned int opt_ci_compiler_count;
+
+static struct list_head compile_queue = LIST_HEAD_INIT(compile_queue);
+static pthread_mutex_t compile_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t compile_queue_cond = PTHREAD_COND_INITIALIZER;
+
+static unsigned long method_hotness(struct vm_method *vmm)
+{
+	return atomic_read(&vmm->invocation_count)
+		+ atomic_read(&vmm->backedge_count);
+}
+
+/*
+ * Inserts @cu so that the queue stays sorted by descending priority.
+ * Must be called with compile_queue_mutex held.
+ */
+static void compile_queue_insert(struct compilation_unit *cu)
+{
+	struct compilation_unit *this;
+
+	list_for_each_entry(this, &compile_queue, compile_queue_node) {
+		if (this->compile_priority < cu->compile_priority) {
+			list_add_tail(&cu->compile_queue_node, &this->compile_queue_node);
+			return;
+		}
+	}
+
+	list_add_tail(&cu->compile_queue_node, &compile_queue);
+}
+
+static struct compilation_unit *compile_queue_take(void)
+{
+	struct compilation_unit *cu;
+
+	pthread_mutex_lock(&compile_queue_mutex);
+
+	while (list_is_empty(&compile_queue))
+		pthread_cond_wait(&compile_queue_cond, &compile_queue_mutex);
+
+	cu = list_first_entry(&compile_queue, struct compilation_unit, compile_queue_node);
+	list_del(&cu->compile_queue_node);
+
+	pthread_mutex_unlock(&compile_queue_mutex);
+
+	return cu;
+}
+
+/**
+ * Queues @cu for background compilation. Returns true if the caller
+ * should run the method in the interpreter meanwhile and false if the
+ * method must be compiled synchronously by the caller.
+ */
+bool compile_queue_submit(struct compilation_unit *cu)
+{
+	bool ret = true;
+
+	if (!opt_ci_compiler_count)
+		return false;
+
+	pthread_mutex_lock(&cu->compile_mutex);
+
+	switch (cu->state) {
+	case COMPILATION_STATE_INITIAL:
+		/*
+		 * Background compilation of this method failed before. We
+		 * compile it in the caller's context so that the error is
+		 * reported to the caller.
+		 */
+		if (cu->async_compile_failed) {
+			ret = false;
+			break;
+		}
+
+		cu->state = COMPILATION_STATE_QUEUED;
+		cu->compile_priority = method_hotness(cu->method);
+
+		pthread_mutex_lock(&compile_queue_mutex);
+		compile_queue_insert(cu);
+		pthread_cond_signal(&compile_queue_cond);
+		pthread_mutex_unlock(&compile_queue_mutex);
+		break;
+	case COMPILATION_STATE_QUEUED:
+		/* The method got hotter while waiting so move it up. */
+		cu->compile_priority = method_hotness(cu->method);
+
+		pthread_mutex_lock(&compile_queue_mutex);
+		list_del(&cu->compile_queue_node);
+		compile_queue_insert(cu);
+		pthread_mutex_unlock(&compile_queue_mutex);
+		break;
+	case COMPILATION_STATE_COMPILING:
+		/*
+		 * Synchronous compilation holds ->compile_mutex for the
+		 * whole duration so this is a compiler thread.
+		 */
+		break;
+	default:
+		ret = false;
+		break;
+	}
+
+	pthread_mutex_unlock(&cu->compile_mutex);
+
+	return ret;
+}
+
+/*
+ * Installs compiled code of @cu so that call sites and the vtable of the
+ * declaring class no longer go through the trampoline. Vtables of
+ * subclasses are fixed up by the trampoline on their next invocation.
+ */
+static void compile_queue_install(struct compilation_unit *cu, void *target)
+{
+	struct vm_method *vmm = cu->method;
+
+	fixup_direct_calls(vmm->trampoline, (unsigned long) target);
+
+	if (vm_method_is_virtual(vmm))
+		fixup_vtable_entry(vmm, target);
+}
+
+static void compile_queue_compile(struct compilation_unit *cu)
+{
+	void *target = NULL;
+
+	pthread_mutex_lock(&cu->compile_mutex);
+	assert(cu->state == COMPILATION_STATE_QUEUED);
+	cu->state = COMPILATION_STATE_COMPILING;
+	pthread_mutex_unlock(&cu->compile_mutex);
+
+	if (!compile(cu)) {
+		target = cu_entry_point(cu);
+
+		if (add_cu_mapping((unsigned long) target, cu))
+			target = NULL;
+	}
+
+	pthread_mutex_lock(&cu->compile_mutex);
+
+	if (target) {
+		cu->state = COMPILATION_STATE_COMPILED;
+	} else {
+		cu->state = COMPILATION_STATE_INITIAL;
+		cu->async_compile_failed = true;
+		clear_exception();
+	}
+
+	shrink_compilation_unit(cu);
+
+	pthread_mutex_unlock(&cu->compile_mutex);
+
+	if (target) {
+		cha_code_installed(cu);
+		compile_queue_install(cu, target);
+	}
+}
+
+static void *compiler_thread(void *arg)
+{
+	if (vm_thread_init_internal())
+		die("unable to initialize compiler thread");
+
+	for (;;)
+		compile_queue_compile(compile_queue_take());
+
+	return NULL;
+}
+
+int init_compile_queue(void)
+{
+	for (unsigned int i = 0; i < opt_ci_compiler_count; i++) {
+		pthread_t thread;
+
+		if (pthread_create(&thread, NULL, compiler_thread, NULL)) {
+			opt_ci_compiler_count = i;
+			return warn("unable to create compiler thread"), -1;
+		}
+
+		pthread_detach(thread);
+	}
+
+	return 0;
+}
@@ -7,6 +7,7 @@
  * file LICENSE for details.
  */
 #include "jit/compiler.h"
+#include "jit/cha.h"
 
 #include "arch/inline-cache.h"
 #include "arch/peephole.h"
@@ -15,6 +16,8 @@
 #include "jit/statement.h"
 #include "jit/bc-offset-mapping.h"
 #include "jit/exception.h"
+#include "jit/deopt.h"
+#include "jit/inliner.h"
 #include "jit/perf-map.h"
 #include "jit/subroutine.h"
 #include "jit/llvm/core.h"
@@ -52,11 +55,26 @@ static void perf_append_cu(struct compilation_unit *cu)
 	perf_map_append(symbol, addr, size);
 }
 
+/*
+ * Optimization level. At level 1 methods that access arrays are compiled
+ * through SSA form like with -Xssa. At level 2 all methods are and global
+ * value numbering and loop-invariant code motion are done too.
+ */
+unsigned long opt_level;
+
 static bool uses_array_ops(struct compilation_unit *cu)
 {
 	return cu->flags & CU_FLAG_ARRAY_OPC;
 }
 
+static bool use_ssa(struct compilation_unit *cu)
+{
+	if (opt_level >= 2)
+		return true;
+
+	return (opt_ssa_enable || opt_level >= 1) && uses_array_ops(cu);
+}
+
 static int do_compile(struct compilation_unit *cu)
 {
 	bool ssa_enable;
@@ -68,12 +86,18 @@ static int do_compile(struct compilation_unit *cu)
 	if (opt_trace_compile)
 		trace_method(cu);
 
+	cha_remove_dependencies(cu);
+
 	err = inline_subroutines(cu->method);
 	if (err)
 		goto out;
 
+	err = inline_methods(cu);
+	if (err)
+		goto out;
+
 	if (opt_trace_bytecode)
-		trace_bytecode(cu->method);
+		trace_cu_bytecode(cu);
 
 	err = analyze_control_flow(cu);
 	if (err)
@@ -83,7 +107,29 @@ static int do_compile(struct compilation_unit *cu)
 	if (err)
 		goto out;
 
-	ssa_enable = opt_ssa_enable && uses_array_ops(cu);
+	err = escape_analysis(cu);
+	if (err)
+		goto out;
+
+	err = eliminate_locks(cu);
+	if (err)
+		goto out;
+
+	ssa_enable = use_ssa(cu);
+
+#ifdef CONFIG_X86_32
+	/*
+	 * Deoptimization and OSR need all locals in the frame. On x86-64
+	 * arguments are passed in registers. The interpreter can not see
+	 * objects whose fields live in temporaries and would run monitor
+	 * statements that have been elided.
+	 */
+	if (!ssa_enable && !cu->nr_eliminated_allocs && !cu->nr_elided_locks) {
+		err = compute_local_kinds(cu);
+		if (err)
+			goto out;
+	}
+#endif
 
 	if (ssa_enable) {
 		err = compute_dfns(cu);
@@ -126,6 +172,16 @@ static int do_compile(struct compilation_unit *cu)
 
 		abc_removal(cu);
 
+		if (opt_level >= 2) {
+			err = licm(cu);
+			if (err)
+				goto out;
+
+			err = gvn(cu);
+			if (err)
+				goto out;
+		}
+
 		err = dce(cu);
 		if (err)
 			goto out;
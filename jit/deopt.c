@@ -0,0 +1,392 @@
+/*
+ * Deoptimization
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ *
+ * When class hierarchy analysis invalidates compiled code, its devirtualized
+ * calls are redirected to dispatch on the receiver (see jit/cha.c), so frames
+ * that are still running it stay correct wherever they are. Deoptimization
+ * moves such frames out of the stale code early. Every call that returns
+ * to an empty operand stack is followed by a deopt site:
+ * a 5-byte nop that deopt_invalidate() patches with a call to one of the
+ * deopt_trampoline*() entries. The trampoline calls deopt_resume() which
+ * copies the local variables of the compiled frame to an interpreter frame
+ * and runs the rest of the method in the interpreter. The result of the
+ * interpreter is then returned through the exit block of the compiled code
+ * so that the lock of a synchronized method is released as usual.
+ *
+ * This only works on i386 and for code whose local variables all live in
+ * stack slots of the frame, which is not the case for code compiled in SSA
+ * form. Such code, and calls that return to a non-empty operand stack, have
+ * no deopt sites. Frames keep running the invalidated code there until
+ * they return.
+ */
+
+#include "cafebabe/constant_pool.h"
+#include "cafebabe/class.h"
+
+#include "jit/compilation-unit.h"
+#include "jit/cu-mapping.h"
+#include "jit/stack-slot.h"
+#include "jit/exception.h"
+#include "jit/compiler.h"
+#include "jit/deopt.h"
+
+#include "arch/stack-frame.h"
+
+#include "vm/bytecode.h"
+#include "vm/opcodes.h"
+#include "vm/method.h"
+#include "vm/interp.h"
+#include "vm/class.h"
+#include "vm/trace.h"
+#include "vm/die.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+bool opt_trace_deopt;
+
+static bool mark_local(unsigned char *kinds, unsigned long nr_locals,
+		       unsigned long idx, enum local_kind kind)
+{
+	if (idx >= nr_locals)
+		return false;
+
+	if (kinds[idx] != LOCAL_UNUSED && kinds[idx] != kind)
+		return false;
+
+	kinds[idx] = kind;
+	return true;
+}
+
+static bool mark_local_type(unsigned char *kinds, unsigned long nr_locals,
+			    unsigned long idx, enum vm_type type)
+{
+	switch (type) {
+	case J_LONG:
+		return mark_local(kinds, nr_locals, idx, LOCAL_WORD)
+			&& mark_local(kinds, nr_locals, idx + 1, LOCAL_WORD);
+	case J_DOUBLE:
+		return mark_local(kinds, nr_locals, idx, LOCAL_DOUBLE)
+			&& mark_local(kinds, nr_locals, idx + 1, LOCAL_DOUBLE_HIGH);
+	default:
+		return mark_local(kinds, nr_locals, idx, LOCAL_WORD);
+	}
+}
+
+static enum vm_type local_insn_type(unsigned char opc)
+{
+	switch (opc) {
+	case OPC_LLOAD:
+	case OPC_LLOAD_0 ... OPC_LLOAD_3:
+	case OPC_LSTORE:
+	case OPC_LSTORE_0 ... OPC_LSTORE_3:
+		return J_LONG;
+	case OPC_DLOAD:
+	case OPC_DLOAD_0 ... OPC_DLOAD_3:
+	case OPC_DSTORE:
+	case OPC_DSTORE_0 ... OPC_DSTORE_3:
+		return J_DOUBLE;
+	default:
+		return J_INT;
+	}
+}
+
+/*
+ * Computes how the local variables of the method of @cu are laid out in
+ * its frame. Longs are stored one word per slot like in the interpreter
+ * but doubles occupy two contiguous slots. If a local is used both ways,
+ * ->local_kinds is left NULL and the code gets no deopt sites or OSR
+ * entries.
+ */
+int compute_local_kinds(struct compilation_unit *cu)
+{
+	struct vm_method *vmm = cu->method;
+	struct cafebabe_code_attribute *code_attr = cu->code_attribute;
+	unsigned long nr_locals = code_attr->max_locals;
+	struct vm_method_arg *arg;
+	unsigned char *kinds;
+	unsigned long idx;
+	unsigned long pc;
+
+	free(cu->local_kinds);
+	free(cu->deopt_sites);
+	free(cu->osr_entries);
+
+	cu->local_kinds = NULL;
+	cu->deopt_sites = NULL;
+	cu->nr_deopt_sites = 0;
+	cu->osr_entries = NULL;
+	cu->nr_osr_entries = 0;
+
+	kinds = calloc(nr_locals + 1, sizeof(*kinds));
+	if (!kinds)
+		return warn("out of memory"), -ENOMEM;
+
+	idx = 0;
+
+	if (!vm_method_is_static(vmm)) {
+		if (!mark_local(kinds, nr_locals, idx++, LOCAL_WORD))
+			goto out_conflict;
+	}
+
+	list_for_each_entry(arg, &vmm->args, list_node) {
+		enum vm_type type = arg->type_info.vm_type;
+
+		if (!mark_local_type(kinds, nr_locals, idx, type))
+			goto out_conflict;
+
+		idx += vm_type_is_pair(type) ? 2 : 1;
+	}
+
+	bytecode_for_each_insn(code_attr->code, code_attr->code_length, pc) {
+		const unsigned char *insn = &code_attr->code[pc];
+		bool ok = true;
+
+		if (*insn == OPC_WIDE) {
+			ok = mark_local_type(kinds, nr_locals, read_u16(insn + 2),
+					     local_insn_type(insn[1]));
+		} else if (*insn == OPC_IINC || *insn == OPC_RET) {
+			ok = mark_local(kinds, nr_locals, read_u8(insn + 1), LOCAL_WORD);
+		} else if (bc_uses_local_var(*insn)) {
+			ok = mark_local_type(kinds, nr_locals,
+					     get_local_var_index(code_attr->code, pc),
+					     local_insn_type(*insn));
+		}
+
+		if (!ok)
+			goto out_conflict;
+	}
+
+	cu->local_kinds = kinds;
+	return 0;
+
+out_conflict:
+	free(kinds);
+	return 0;
+}
+
+void read_frame_locals(struct compilation_unit *cu, struct jit_stack_frame *frame,
+		       unsigned long *locals)
+{
+	unsigned long nr_locals = cu->code_attribute->max_locals;
+
+	for (unsigned long i = 0; i < nr_locals; i++) {
+		struct stack_slot *slot = get_local_slot(cu->stack_frame, i);
+
+		switch (cu->local_kinds[i]) {
+		case LOCAL_WORD:
+			memcpy(&locals[i], (void *) frame + slot_offset(slot),
+			       sizeof(unsigned long));
+			break;
+		case LOCAL_DOUBLE:
+			memcpy(&locals[i], (void *) frame + slot_offset_64(slot),
+			       sizeof(jdouble));
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/*
+ * Stores the @nr_locals local variables in @locals to the compiled frame.
+ * Locals of the method beyond @nr_locals are left uninitialized.
+ */
+void write_frame_locals(struct compilation_unit *cu, struct jit_stack_frame *frame,
+			unsigned long *locals, unsigned long nr_locals)
+{
+	if (nr_locals > cu->code_attribute->max_locals)
+		nr_locals = cu->code_attribute->max_locals;
+
+	for (unsigned long i = 0; i < nr_locals; i++) {
+		struct stack_slot *slot = get_local_slot(cu->stack_frame, i);
+
+		switch (cu->local_kinds[i]) {
+		case LOCAL_WORD:
+			memcpy((void *) frame + slot_offset(slot), &locals[i],
+			       sizeof(unsigned long));
+			break;
+		case LOCAL_DOUBLE:
+			if (i + 1 < nr_locals)
+				memcpy((void *) frame + slot_offset_64(slot),
+				       &locals[i], sizeof(jdouble));
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/*
+ * Returns the return type of the method invoked by the instruction at
+ * @bc_offset of @cu. Only the descriptor in the constant pool is looked at
+ * so that no classes are loaded.
+ */
+static enum vm_type invoke_return_type(struct compilation_unit *cu, unsigned long bc_offset)
+{
+	const struct cafebabe_class *class = cu->method->class->class;
+	const unsigned char *insn = &cu->code_attribute->code[bc_offset];
+	const struct cafebabe_constant_info_name_and_type *name_and_type;
+	const struct cafebabe_constant_info_utf8 *type;
+	uint16_t name_and_type_index;
+	uint16_t idx;
+
+	idx = read_u16(insn + 1);
+
+	if (*insn == OPC_INVOKEINTERFACE) {
+		const struct cafebabe_constant_info_interface_method_ref *ref;
+
+		if (cafebabe_class_constant_get_interface_method_ref(class, idx, &ref))
+			error("invalid interface method reference");
+
+		name_and_type_index = ref->name_and_type_index;
+	} else {
+		const struct cafebabe_constant_info_method_ref *ref;
+
+		if (cafebabe_class_constant_get_method_ref(class, idx, &ref))
+			error("invalid method reference");
+
+		name_and_type_index = ref->name_and_type_index;
+	}
+
+	if (cafebabe_class_constant_get_name_and_type(class, name_and_type_index, &name_and_type))
+		error("invalid name and type");
+
+	if (cafebabe_class_constant_get_utf8(class, name_and_type->descriptor_index, &type))
+		error("invalid method descriptor");
+
+	for (unsigned int i = 0; i + 1 < type->length; i++) {
+		if (type->bytes[i] == ')')
+			return str_to_type((const char *) &type->bytes[i + 1]);
+	}
+
+	error("invalid method descriptor");
+}
+
+void add_deopt_site(struct compilation_unit *cu, unsigned long mach_offset,
+		    unsigned long bc_offset)
+{
+	struct deopt_site *sites;
+
+	sites = realloc(cu->deopt_sites, (cu->nr_deopt_sites + 1) * sizeof(*sites));
+	if (!sites)
+		die("out of memory");
+
+	sites[cu->nr_deopt_sites].mach_offset	= mach_offset;
+	sites[cu->nr_deopt_sites].bc_offset	= bc_offset;
+	sites[cu->nr_deopt_sites].return_type	= invoke_return_type(cu, bc_offset);
+
+	cu->deopt_sites = sites;
+	cu->nr_deopt_sites++;
+}
+
+/*
+ * Makes frames that are running the code of @cu leave it for the
+ * interpreter when the call they are in returns.
+ */
+void deopt_invalidate(struct compilation_unit *cu)
+{
+	for (unsigned long i = 0; i < cu->nr_deopt_sites; i++) {
+		struct deopt_site *site = &cu->deopt_sites[i];
+
+		fixup_deopt_site(buffer_ptr(cu->objcode) + site->mach_offset,
+				 site->return_type);
+	}
+
+	if (opt_trace_deopt && cu->nr_deopt_sites) {
+		trace_printf("[deopt] %s.%s%s: patched %lu sites\n",
+			     cu->method->class->name, cu->method->name,
+			     cu->method->type, cu->nr_deopt_sites);
+		trace_flush();
+	}
+}
+
+static struct deopt_site *lookup_deopt_site(struct compilation_unit *cu, void *site)
+{
+	unsigned long mach_offset = site - buffer_ptr(cu->objcode);
+
+	for (unsigned long i = 0; i < cu->nr_deopt_sites; i++) {
+		if (cu->deopt_sites[i].mach_offset == mach_offset)
+			return &cu->deopt_sites[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Called by the deoptimization trampoline when the frame @frame returns to
+ * the patched deopt site @site.
+ */
+void deopt_resume(struct deopt_regs *regs, void *site, struct jit_stack_frame *frame)
+{
+	struct compilation_unit *cu;
+	struct deopt_site *dsite;
+	struct vm_method *vmm;
+	union jvalue result;
+	union jvalue value;
+	unsigned long pc;
+
+	cu = jit_lookup_cu((unsigned long) site);
+	if (!cu)
+		die("no compilation unit for deopt site %p", site);
+
+	dsite = lookup_deopt_site(cu, site);
+	if (!dsite)
+		die("unknown deopt site %p", site);
+
+	vmm = cu->method;
+
+	unsigned long locals[cu->code_attribute->max_locals + 1];
+
+	memset(locals, 0, sizeof(locals));
+	read_frame_locals(cu, frame, locals);
+
+	value.j = regs->result_lo | (uint64_t) regs->result_hi << 32;
+
+	pc = dsite->bc_offset;
+	if (!exception_occurred())
+		pc += bc_insn_size(cu->code_attribute->code, pc);
+
+	if (opt_trace_deopt) {
+		trace_printf("[deopt] %s.%s%s at pc %lu\n", vmm->class->name,
+			     vmm->name, vmm->type, pc);
+		trace_flush();
+	}
+
+	vm_interp_resume(vmm, cu->code_attribute, pc, locals, dsite->return_type,
+			 &value, &result);
+
+	regs->sp = (void *) frame - cu_frame_total_offset(cu);
+
+	if (exception_occurred()) {
+		regs->fp_type = DEOPT_FP_NONE;
+
+		if (is_native(frame->return_address))
+			regs->target = cu->exit_bb_ptr;
+		else
+			regs->target = cu->unwind_bb_ptr;
+
+		return;
+	}
+
+	regs->result_lo = result.j & ~0UL;
+	regs->result_hi = (uint64_t) result.j >> 32;
+	regs->target = cu->exit_bb_ptr;
+
+	switch (vm_method_return_type(vmm)) {
+	case J_FLOAT:
+		regs->fp_type = DEOPT_FP_FLOAT;
+		break;
+	case J_DOUBLE:
+		regs->fp_type = DEOPT_FP_DOUBLE;
+		break;
+	default:
+		regs->fp_type = DEOPT_FP_NONE;
+		break;
+	}
+}
@@ -18,13 +18,18 @@
 
 #include "jit/compilation-unit.h"
 #include "jit/basic-block.h"
+#include "jit/bc-offset-mapping.h"
 #include "jit/compiler.h"
+#include "jit/cha.h"
 #include "jit/emit-code.h"
 #include "jit/exception.h"
+#include "jit/gc-map.h"
 #include "jit/gdb.h"
 #include "jit/instruction.h"
 #include "jit/statement.h"
 #include "jit/debug.h"
+#include "jit/deopt.h"
+#include "jit/osr.h"
 #include "jit/text.h"
 
 #include <stdlib.h>
@@ -72,22 +77,6 @@ static void backpatch_tableswitch(struct tableswitch *table)
 	}
 }
 
-static void backpatch_lookupswitch(struct lookupswitch *table)
-{
-	for (unsigned int i = 0; i < table->count; i++) {
-		int idx = bb_lookup_successor_index(table->src,
-						    table->pairs[i].bb_target);
-
-		if (branch_needs_resolution_block(table->src, idx)) {
-			table->pairs[i].target =
-				(void *)table->src->resolution_blocks[idx].addr;
-		} else {
-			table->pairs[i].target =
-				bb_native_ptr(table->pairs[i].bb_target);
-		}
-	}
-}
-
 static void backpatch_tableswitch_targets(struct compilation_unit *cu)
 {
 	struct tableswitch *this;
@@ -98,16 +87,6 @@ static void backpatch_tableswitch_targets(struct compilation_unit *cu)
 	}
 }
 
-static void backpatch_lookupswitch_targets(struct compilation_unit *cu)
-{
-	struct lookupswitch *this;
-
-	list_for_each_entry(this, &cu->lookupswitch_list, list_node)
-	{
-		backpatch_lookupswitch(this);
-	}
-}
-
 static void backpatch_branches(struct basic_block *bb, struct buffer *buf)
 {
 	struct insn *insn;
@@ -129,6 +108,23 @@ static void backpatch_branches(struct basic_block *bb, struct buffer *buf)
 	}
 }
 
+/*
+ * Emits a deopt site after a call that returns to an empty operand stack
+ * in code that can be invalidated. See jit/deopt.c.
+ */
+static void emit_deopt_site(struct compilation_unit *cu, struct buffer *buf,
+			    struct insn *insn)
+{
+	void *site;
+
+	if (!cu->cha_dependent || !cu->local_kinds || opt_debug_stack)
+		return;
+
+	site = emit_patchable_entry(buf);
+
+	add_deopt_site(cu, site - buffer_ptr(buf), insn_get_bc_offset(insn));
+}
+
 void emit_body(struct basic_block *bb, struct buffer *buf)
 {
 	struct insn *insn;
@@ -137,7 +133,15 @@ void emit_body(struct basic_block *bb, struct buffer *buf)
 	bb->is_emitted = true;
 
 	for_each_insn(insn, &bb->insn_list) {
+		unsigned long lir_pos = insn->lir_pos;
+		unsigned long start = buffer_offset(buf);
+
 		emit_insn(buf, bb, insn);
+
+		gc_maps_add_site(bb->b_parent, bb, insn, lir_pos, start, buffer_offset(buf));
+
+		if (insn->flags & INSN_FLAG_DEOPT_POINT)
+			emit_deopt_site(bb->b_parent, buf, insn);
 	}
 
 	if (opt_trace_machine_code)
@@ -180,6 +184,16 @@ static void process_call_fixup_sites(struct compilation_unit *cu)
 	}
 }
 
+static void process_cha_call_sites(struct compilation_unit *cu)
+{
+	struct cha_call_site *site;
+
+	list_for_each_entry(site, &cu->cha_call_site_list, node) {
+		site->mach_offset = site->call_insn->mach_offset;
+		site->call_insn = NULL;
+	}
+}
+
 int emit_machine_code(struct compilation_unit *cu)
 {
 	unsigned long frame_size;
@@ -188,6 +202,12 @@ int emit_machine_code(struct compilation_unit *cu)
 	int err = 0;
 	void *ic_check = NULL;
 
+	if (newgc_enabled) {
+		err = gc_maps_prepare(cu);
+		if (err)
+			return warn("out of memory"), err;
+	}
+
 	buf = alloc_exec_buffer();
 	if (!buf)
 		return warn("out of memory"), -ENOMEM;
@@ -206,9 +226,17 @@ int emit_machine_code(struct compilation_unit *cu)
 		ic_check = emit_ic_check(buf);
 	}
 
-	cu->entry_point = buffer_current(buf);
+	/*
+	 * Code that depends on class hierarchy analysis gets an entry that
+	 * can be patched when the code is invalidated.
+	 */
+	if (cu->cha_dependent)
+		cu->entry_point = emit_patchable_entry(buf);
+	else
+		cu->entry_point = buffer_current(buf);
 
 	emit_prolog(cu->objcode, cu->stack_frame, frame_size);
+	emit_gc_maps_prolog(cu, cu->objcode);
 
 	if (vm_method_is_synchronized(cu->method))
 		emit_monitorenter(cu, frame_size);
@@ -235,13 +263,17 @@ int emit_machine_code(struct compilation_unit *cu)
 		emit_resolution_blocks(bb, cu->objcode);
 	}
 
+	for_each_basic_block(bb, &cu->bb_list) {
+		emit_array_check_stubs(cu->objcode, bb);
+	}
+
 	for_each_basic_block(bb, &cu->bb_list) {
 		backpatch_branches(bb, cu->objcode);
 	}
 
 	process_call_fixup_sites(cu);
+	process_cha_call_sites(cu);
 	backpatch_tableswitch_targets(cu);
-	backpatch_lookupswitch_targets(cu);
 	build_exception_handlers_table(cu);
 
 	cu->exit_bb_ptr = bb_native_ptr(cu->exit_bb);
@@ -251,6 +283,10 @@ int emit_machine_code(struct compilation_unit *cu)
 		emit_ic_miss_handler(buf, ic_check, cu->method);
 	}
 
+	add_osr_entries(cu);
+	if (cu->nr_osr_entries)
+		cu->osr_entry_point = emit_osr_entry(buf, cu->stack_frame, frame_size);
+
 	jit_text_reserve(buffer_offset(cu->objcode));
 
 	jit_text_unlock();
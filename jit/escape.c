@@ -0,0 +1,1006 @@
+/*
+ * Escape analysis and scalar replacement
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ *
+ * Finds objects that are allocated with "new" and never leave the method
+ * and replaces their fields with temporaries so that the allocation goes
+ * away. The analysis works on the tree IR right after it has been built.
+ *
+ * An allocation is stored to a temporary by the bytecode converter. The
+ * temporary and every local variable or temporary that is assigned from
+ * it in the same basic block are the holders of the object. A holder must
+ * have no other assignment so that it always refers to the latest object
+ * allocated at the site. The object does not escape if the holders are
+ * only used to read or write instance fields and as the receiver of a
+ * constructor that does nothing but call a constructor of the same kind
+ * of the superclass. Constructors are not inlined so any other
+ * constructor makes the object escape. Locking such an object has no
+ * effect because no other thread can see it so its monitorenter and
+ * monitorexit are removed too.
+ *
+ * Exception handlers are entered with the registers of the code that threw
+ * so the fields of a replaced object must not be used in code that can be
+ * reached from a handler. A handler could also see a holder that is
+ * assigned after the statement that threw.
+ */
+
+#include "jit/compilation-unit.h"
+#include "jit/basic-block.h"
+#include "jit/bc-offset-mapping.h"
+#include "jit/expression.h"
+#include "jit/statement.h"
+#include "jit/compiler.h"
+#include "jit/vars.h"
+
+#include "vm/method.h"
+#include "vm/opcodes.h"
+#include "vm/class.h"
+#include "vm/field.h"
+#include "vm/trace.h"
+
+#include "lib/hash-map.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+bool opt_escape_analysis = true;
+bool opt_trace_escape;
+
+struct replaced_field {
+	struct vm_field		*field;
+	struct expression	*tmp;
+};
+
+struct holder {
+	struct expression	*expr;
+	struct statement	*def;
+	bool			defined;
+};
+
+struct alloc_site {
+	/* The STMT_STORE of EXPR_NEW to a temporary. */
+	struct statement	*stmt;
+	struct basic_block	*bb;
+	bool			escapes;
+
+	struct holder		*holders;
+	unsigned long		nr_holders;
+
+	struct replaced_field	*fields;
+	unsigned long		nr_fields;
+};
+
+struct escape_state {
+	struct compilation_unit	*cu;
+
+	unsigned long		nr_vregs;
+	unsigned long		nr_locals;
+
+	/* Number of assignments, saturated at 2. */
+	unsigned char		*vreg_defs;
+	unsigned char		*local_defs;
+
+	struct alloc_site	**vreg_sites;
+	struct alloc_site	**local_sites;
+
+	struct alloc_site	*sites;
+	unsigned long		nr_sites;
+
+	/* Basic blocks that can be reached from an exception handler. */
+	struct hash_map		*handler_code;
+	bool			in_handler_code;
+};
+
+static void count_def(unsigned char *defs, unsigned long nr, unsigned long idx)
+{
+	if (idx < nr && defs[idx] < 2)
+		defs[idx]++;
+}
+
+static void count_store(struct escape_state *state, struct expression *dest)
+{
+	switch (expr_type(dest)) {
+	case EXPR_TEMPORARY:
+		count_def(state->vreg_defs, state->nr_vregs, dest->tmp_low->vreg);
+		break;
+	case EXPR_LOCAL:
+		count_def(state->local_defs, state->nr_locals, dest->local_index);
+		if (vm_type_is_pair(dest->vm_type))
+			count_def(state->local_defs, state->nr_locals, dest->local_index + 1);
+		break;
+	default:
+		break;
+	}
+}
+
+static void mark_multi_def(struct escape_state *state, struct expression *expr)
+{
+	if (expr_type(expr) == EXPR_TEMPORARY && expr->tmp_low->vreg < state->nr_vregs)
+		state->vreg_defs[expr->tmp_low->vreg] = 2;
+}
+
+static bool is_single_def(struct escape_state *state, struct expression *expr)
+{
+	switch (expr_type(expr)) {
+	case EXPR_TEMPORARY:
+		return expr->tmp_low->vreg < state->nr_vregs
+			&& state->vreg_defs[expr->tmp_low->vreg] == 1;
+	case EXPR_LOCAL:
+		return expr->local_index < state->nr_locals
+			&& state->local_defs[expr->local_index] == 1;
+	default:
+		return false;
+	}
+}
+
+static struct alloc_site **holder_slot(struct escape_state *state,
+				       struct expression *expr)
+{
+	if (expr->vm_type != J_REFERENCE)
+		return NULL;
+
+	switch (expr_type(expr)) {
+	case EXPR_TEMPORARY:
+		if (expr->tmp_low->vreg >= state->nr_vregs)
+			return NULL;
+
+		return &state->vreg_sites[expr->tmp_low->vreg];
+	case EXPR_LOCAL:
+		if (expr->local_index >= state->nr_locals)
+			return NULL;
+
+		return &state->local_sites[expr->local_index];
+	default:
+		return NULL;
+	}
+}
+
+static struct alloc_site *holder_site(struct escape_state *state,
+				      struct expression *expr)
+{
+	struct alloc_site **slot = holder_slot(state, expr);
+
+	return slot ? *slot : NULL;
+}
+
+static struct expression *strip_null_check(struct expression *expr)
+{
+	if (expr_type(expr) == EXPR_NULL_CHECK)
+		return to_expr(expr->null_check_ref);
+
+	return expr;
+}
+
+static bool is_instance_field(struct expression *expr)
+{
+	return expr_type(expr) == EXPR_INSTANCE_FIELD
+		|| expr_type(expr) == EXPR_FLOAT_INSTANCE_FIELD;
+}
+
+/*
+ * Returns the allocation site of the object whose field @expr accesses or
+ * NULL if it is not an instance field access of a holder.
+ */
+static struct alloc_site *field_site(struct escape_state *state,
+				     struct expression *expr)
+{
+	if (!is_instance_field(expr))
+		return NULL;
+
+	return holder_site(state, strip_null_check(to_expr(expr->objectref_expression)));
+}
+
+/*
+ * A constructor is trivial if it only calls a trivial constructor of the
+ * superclass. The constructor of java/lang/Object is empty.
+ */
+static bool is_trivial_constructor(struct vm_method *vmm)
+{
+	const unsigned char *code;
+	struct vm_class *super;
+
+	if (!vm_method_is_constructor(vmm) || strcmp(vmm->type, "()V"))
+		return false;
+
+	if (vm_method_is_native(vmm))
+		return false;
+
+	code = vmm->code_attribute.code;
+
+	switch (vmm->code_attribute.code_length) {
+	case 1:
+		return code[0] == OPC_RETURN;
+	case 5:
+		if (code[0] != OPC_ALOAD_0 || code[1] != OPC_INVOKESPECIAL
+		    || code[4] != OPC_RETURN)
+			return false;
+
+		/*
+		 * The verifier only lets a constructor call a constructor
+		 * of its own class or the superclass on "this" before it
+		 * does anything else.
+		 */
+		super = vmm->class->super;
+		if (!super)
+			return false;
+
+		vmm = vm_class_get_method(super, "<init>", "()V");
+
+		return vmm && is_trivial_constructor(vmm);
+	default:
+		return false;
+	}
+}
+
+/*
+ * Returns true if allocating an instance of @vmc does not need to run a
+ * static initializer.
+ */
+static bool class_init_is_trivial(struct vm_class *vmc)
+{
+	for (; vmc != NULL; vmc = vmc->super) {
+		if (vm_class_is_initialized(vmc))
+			return true;
+
+		if (vm_class_get_method(vmc, "<clinit>", "()V"))
+			return false;
+	}
+
+	return true;
+}
+
+static bool can_replace_class(struct vm_class *vmc)
+{
+	if (!vm_class_is_regular_class(vmc))
+		return false;
+
+	if (vm_class_is_abstract(vmc) || vm_class_is_interface(vmc))
+		return false;
+
+	return class_init_is_trivial(vmc);
+}
+
+/*
+ * Returns the allocation site of the receiver of @stmt if it is a call to
+ * a trivial constructor on a holder.
+ */
+static struct alloc_site *ctor_site(struct escape_state *state,
+				    struct statement *stmt)
+{
+	struct expression *args;
+
+	if (stmt_type(stmt) != STMT_INVOKE)
+		return NULL;
+
+	if (!is_trivial_constructor(stmt->target_method))
+		return NULL;
+
+	args = to_expr(stmt->args_list);
+	if (expr_type(args) != EXPR_ARG_THIS)
+		return NULL;
+
+	return holder_site(state, strip_null_check(to_expr(args->arg_expression)));
+}
+
+/*
+ * Returns the allocation site of the object that @stmt locks or unlocks.
+ */
+static struct alloc_site *monitor_site(struct escape_state *state,
+				       struct statement *stmt)
+{
+	if (!opt_eliminate_locks)
+		return NULL;
+
+	switch (stmt_type(stmt)) {
+	case STMT_MONITOR_ENTER:
+	case STMT_MONITOR_EXIT:
+		return holder_site(state, strip_null_check(to_expr(stmt->expression)));
+	default:
+		return NULL;
+	}
+}
+
+static int add_holder(struct alloc_site *site, struct expression *expr,
+		      struct statement *def)
+{
+	struct holder *holders;
+
+	holders = realloc(site->holders, (site->nr_holders + 1) * sizeof(*holders));
+	if (!holders)
+		return -ENOMEM;
+
+	holders[site->nr_holders].expr		= expr;
+	holders[site->nr_holders].def		= def;
+	holders[site->nr_holders].defined	= false;
+
+	site->holders = holders;
+	site->nr_holders++;
+
+	return 0;
+}
+
+static struct holder *lookup_holder(struct escape_state *state,
+				    struct alloc_site *site,
+				    struct expression *expr)
+{
+	if (holder_site(state, expr) != site)
+		return NULL;
+
+	for (unsigned long i = 0; i < site->nr_holders; i++) {
+		if (holder_slot(state, site->holders[i].expr) == holder_slot(state, expr))
+			return &site->holders[i];
+	}
+
+	return NULL;
+}
+
+static struct replaced_field *lookup_field(struct alloc_site *site,
+					   struct vm_field *vmf)
+{
+	for (unsigned long i = 0; i < site->nr_fields; i++) {
+		if (site->fields[i].field == vmf)
+			return &site->fields[i];
+	}
+
+	return NULL;
+}
+
+static void add_field(struct alloc_site *site, struct vm_field *vmf)
+{
+	struct replaced_field *fields;
+
+	if (lookup_field(site, vmf))
+		return;
+
+	fields = realloc(site->fields, (site->nr_fields + 1) * sizeof(*fields));
+	if (!fields) {
+		/* Keep the allocation. */
+		site->escapes = true;
+		return;
+	}
+
+	fields[site->nr_fields].field	= vmf;
+	fields[site->nr_fields].tmp	= NULL;
+
+	site->fields = fields;
+	site->nr_fields++;
+}
+
+static int count_defs(struct escape_state *state)
+{
+	struct compilation_unit *cu = state->cu;
+	struct basic_block *bb;
+	struct statement *stmt;
+
+	/* Arguments are assigned on entry. */
+	for (unsigned long i = 0; i < vm_method_arg_stack_count(cu->method); i++) {
+		if (i < state->nr_locals)
+			state->local_defs[i] = 2;
+	}
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		for_each_stmt(stmt, &bb->stmt_list) {
+			switch (stmt_type(stmt)) {
+			case STMT_STORE:
+				count_store(state, to_expr(stmt->store_dest));
+
+				if (expr_type(to_expr(stmt->store_src)) == EXPR_NEW)
+					state->nr_sites++;
+				break;
+			case STMT_INVOKE:
+			case STMT_INVOKEVIRTUAL:
+			case STMT_INVOKEINTERFACE:
+				if (stmt->invoke_result)
+					mark_multi_def(state, stmt->invoke_result);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	if (!state->nr_sites)
+		return 0;
+
+	state->sites = calloc(state->nr_sites, sizeof(struct alloc_site));
+	if (!state->sites)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void find_sites(struct escape_state *state)
+{
+	struct basic_block *bb;
+	struct statement *stmt;
+	unsigned long nr = 0;
+
+	for_each_basic_block(bb, &state->cu->bb_list) {
+		for_each_stmt(stmt, &bb->stmt_list) {
+			struct expression *dest, *src;
+			struct alloc_site *site;
+
+			if (stmt_type(stmt) != STMT_STORE)
+				continue;
+
+			src = to_expr(stmt->store_src);
+			if (expr_type(src) != EXPR_NEW)
+				continue;
+
+			dest = to_expr(stmt->store_dest);
+
+			site = &state->sites[nr++];
+			site->stmt	= stmt;
+			site->bb	= bb;
+			site->escapes	= true;
+
+			if (expr_type(dest) != EXPR_TEMPORARY || !is_single_def(state, dest))
+				continue;
+
+			if (!can_replace_class(src->class))
+				continue;
+
+			if (add_holder(site, dest, stmt))
+				continue;
+
+			*holder_slot(state, dest) = site;
+			site->escapes = false;
+		}
+	}
+}
+
+/*
+ * Holders other than the temporary of the allocation are assigned from
+ * another holder after the allocation in the same basic block.
+ */
+static int find_copies(struct escape_state *state, struct alloc_site *site)
+{
+	struct statement *stmt;
+	bool seen = false;
+	int err;
+
+	for_each_stmt(stmt, &site->bb->stmt_list) {
+		struct expression *dest, *src;
+
+		if (stmt == site->stmt) {
+			seen = true;
+			continue;
+		}
+
+		if (!seen || stmt_type(stmt) != STMT_STORE)
+			continue;
+
+		dest = to_expr(stmt->store_dest);
+		src = to_expr(stmt->store_src);
+
+		if (holder_site(state, src) != site || !is_single_def(state, dest))
+			continue;
+
+		if (!holder_slot(state, dest) || holder_site(state, dest))
+			continue;
+
+		err = add_holder(site, dest, stmt);
+		if (err)
+			return err;
+
+		*holder_slot(state, dest) = site;
+	}
+
+	return 0;
+}
+
+static bool refs_undefined_holder(struct escape_state *state,
+				  struct alloc_site *site,
+				  struct tree_node *node)
+{
+	struct expression *expr = to_expr(node);
+	struct holder *holder;
+
+	holder = lookup_holder(state, site, expr);
+	if (holder)
+		return !holder->defined;
+
+	for (int i = 0; i < expr_nr_kids(expr); i++) {
+		if (refs_undefined_holder(state, site, expr->node.kids[i]))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * In the basic block of the allocation, a holder that is used before it is
+ * assigned still refers to an object allocated by an earlier iteration of
+ * a loop.
+ */
+static void check_order(struct escape_state *state, struct alloc_site *site)
+{
+	struct statement *stmt;
+
+	for (unsigned long i = 0; i < site->nr_holders; i++)
+		site->holders[i].defined = false;
+
+	for_each_stmt(stmt, &site->bb->stmt_list) {
+		struct holder *def = NULL;
+
+		for (unsigned long i = 0; i < site->nr_holders; i++) {
+			if (site->holders[i].def == stmt)
+				def = &site->holders[i];
+		}
+
+		for (int i = 0; i < stmt_nr_kids(stmt); i++) {
+			if (!stmt->node.kids[i])
+				continue;
+
+			if (def && stmt->node.kids[i] == stmt->store_dest)
+				continue;
+
+			if (refs_undefined_holder(state, site, stmt->node.kids[i]))
+				site->escapes = true;
+		}
+
+		if (def)
+			def->defined = true;
+	}
+}
+
+static void check_node(struct escape_state *state, struct tree_node *node)
+{
+	struct expression *expr = to_expr(node);
+	struct alloc_site *site;
+
+	site = field_site(state, expr);
+	if (site) {
+		if (state->in_handler_code)
+			site->escapes = true;
+		else
+			add_field(site, expr->instance_field);
+		return;
+	}
+
+	site = holder_site(state, expr);
+	if (site) {
+		site->escapes = true;
+		return;
+	}
+
+	for (int i = 0; i < expr_nr_kids(expr); i++)
+		check_node(state, expr->node.kids[i]);
+}
+
+static void check_stmt(struct escape_state *state, struct statement *stmt)
+{
+	struct alloc_site *site;
+
+	switch (stmt_type(stmt)) {
+	case STMT_STORE:
+		site = holder_site(state, to_expr(stmt->store_dest));
+		if (!site)
+			break;
+
+		if (stmt == site->stmt)
+			return;
+
+		if (holder_site(state, to_expr(stmt->store_src)) == site)
+			return;
+
+		site->escapes = true;
+		break;
+	case STMT_INVOKE:
+		if (ctor_site(state, stmt))
+			return;
+		break;
+	case STMT_MONITOR_ENTER:
+	case STMT_MONITOR_EXIT:
+		if (monitor_site(state, stmt))
+			return;
+		break;
+	default:
+		break;
+	}
+
+	for (int i = 0; i < stmt_nr_kids(stmt); i++) {
+		if (stmt->node.kids[i])
+			check_node(state, stmt->node.kids[i]);
+	}
+}
+
+static int mark_handler_code(struct escape_state *state)
+{
+	struct compilation_unit *cu = state->cu;
+	struct basic_block **worklist;
+	struct basic_block *bb;
+	unsigned long nr = 0;
+	int err = 0;
+
+	for_each_basic_block(bb, &cu->bb_list)
+		nr++;
+
+	worklist = malloc(nr * sizeof(*worklist));
+	state->handler_code = alloc_hash_map(&pointer_key);
+	if (!worklist || !state->handler_code) {
+		free(worklist);
+		return -ENOMEM;
+	}
+
+	nr = 0;
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		if (!bb->is_eh)
+			continue;
+
+		if (hash_map_put(state->handler_code, bb, bb)) {
+			err = -ENOMEM;
+			goto out;
+		}
+
+		worklist[nr++] = bb;
+	}
+
+	while (nr > 0) {
+		bb = worklist[--nr];
+
+		for (unsigned long i = 0; i < bb->nr_successors; i++) {
+			struct basic_block *succ = bb->successors[i];
+
+			if (hash_map_contains(state->handler_code, succ))
+				continue;
+
+			if (hash_map_put(state->handler_code, succ, succ)) {
+				err = -ENOMEM;
+				goto out;
+			}
+
+			worklist[nr++] = succ;
+		}
+	}
+out:
+	free(worklist);
+
+	return err;
+}
+
+static struct expression *default_value(enum vm_type type)
+{
+	if (vm_type_is_float(type))
+		return fvalue_expr(type, 0.0);
+
+	return value_expr(type, 0);
+}
+
+static enum vm_type field_tmp_type(struct vm_field *vmf)
+{
+	switch (vm_field_type(vmf)) {
+	case J_BOOLEAN:
+	case J_BYTE:
+	case J_CHAR:
+	case J_SHORT:
+		return J_INT;
+	default:
+		return vm_field_type(vmf);
+	}
+}
+
+/*
+ * Values stored to byte, char and short fields are truncated by the store.
+ * Booleans are stored as bytes.
+ */
+static enum vm_type field_truncation_type(struct vm_field *vmf)
+{
+	switch (vm_field_type(vmf)) {
+	case J_BOOLEAN:
+	case J_BYTE:
+		return J_BYTE;
+	case J_CHAR:
+		return J_CHAR;
+	case J_SHORT:
+		return J_SHORT;
+	default:
+		return J_VOID;
+	}
+}
+
+static int alloc_field_tmps(struct escape_state *state, struct alloc_site *site)
+{
+	for (unsigned long i = 0; i < site->nr_fields; i++) {
+		struct replaced_field *f = &site->fields[i];
+
+		f->tmp = temporary_expr(field_tmp_type(f->field), state->cu);
+		if (!f->tmp)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/*
+ * Replaces the allocation with assignments of the default values to the
+ * temporaries of the fields.
+ */
+static int insert_field_inits(struct alloc_site *site)
+{
+	for (unsigned long i = site->nr_fields; i-- > 0; ) {
+		struct replaced_field *f = &site->fields[i];
+		struct expression *value;
+		struct statement *stmt;
+
+		value = default_value(f->tmp->vm_type);
+		if (!value)
+			return -ENOMEM;
+
+		stmt = alloc_statement(STMT_STORE);
+		if (!stmt) {
+			expr_put(value);
+			return -ENOMEM;
+		}
+
+		stmt->store_dest = &expr_get(f->tmp)->node;
+		stmt->store_src = &value->node;
+
+		tree_patch_bc_offset(&stmt->node, site->stmt->node.bytecode_offset);
+		list_add(&stmt->stmt_list_node, &site->stmt->stmt_list_node);
+	}
+
+	return 0;
+}
+
+static void remove_stmt(struct statement *stmt)
+{
+	list_del(&stmt->stmt_list_node);
+	free_statement(stmt);
+}
+
+static void replace_node(struct escape_state *state, struct tree_node **slot)
+{
+	struct expression *expr = to_expr(*slot);
+	struct alloc_site *site;
+
+	site = field_site(state, expr);
+	if (site && !site->escapes) {
+		struct replaced_field *f;
+
+		f = lookup_field(site, expr->instance_field);
+		*slot = &expr_get(f->tmp)->node;
+		expr_put(expr);
+		return;
+	}
+
+	for (int i = 0; i < expr_nr_kids(expr); i++)
+		replace_node(state, &expr->node.kids[i]);
+}
+
+static int truncate_field_store(struct escape_state *state,
+				struct statement *stmt)
+{
+	struct expression *dest = to_expr(stmt->store_dest);
+	struct expression *src;
+	struct alloc_site *site;
+	enum vm_type type;
+
+	site = field_site(state, dest);
+	if (!site || site->escapes)
+		return 0;
+
+	type = field_truncation_type(dest->instance_field);
+	if (type == J_VOID)
+		return 0;
+
+	src = truncation_expr(type, to_expr(stmt->store_src));
+	if (!src)
+		return -ENOMEM;
+
+	tree_patch_bc_offset(&src->node, stmt->node.bytecode_offset);
+	stmt->store_src = &src->node;
+
+	return 0;
+}
+
+static int replace_stmt(struct escape_state *state, struct basic_block *bb,
+			struct statement *stmt)
+{
+	struct alloc_site *site;
+	int err;
+
+	switch (stmt_type(stmt)) {
+	case STMT_STORE:
+		site = holder_site(state, to_expr(stmt->store_dest));
+		if (site && !site->escapes) {
+			if (stmt == site->stmt) {
+				err = insert_field_inits(site);
+				if (err)
+					return err;
+			}
+
+			remove_stmt(stmt);
+			return 0;
+		}
+
+		err = truncate_field_store(state, stmt);
+		if (err)
+			return err;
+		break;
+	case STMT_MONITOR_ENTER:
+	case STMT_MONITOR_EXIT:
+		site = monitor_site(state, stmt);
+		if (site && !site->escapes) {
+			remove_stmt(stmt);
+			return 0;
+		}
+		break;
+	case STMT_INVOKE:
+		site = ctor_site(state, stmt);
+		if (site && !site->escapes) {
+			struct statement *prev;
+
+			prev = list_entry(stmt->stmt_list_node.prev,
+					  struct statement, stmt_list_node);
+
+			if (&prev->stmt_list_node != &bb->stmt_list
+			    && stmt_type(prev) == STMT_BEFORE_ARGS
+			    && prev->target_method == stmt->target_method)
+				remove_stmt(prev);
+
+			remove_stmt(stmt);
+			return 0;
+		}
+		break;
+	default:
+		break;
+	}
+
+	for (int i = 0; i < stmt_nr_kids(stmt); i++) {
+		if (stmt->node.kids[i])
+			replace_node(state, &stmt->node.kids[i]);
+	}
+
+	return 0;
+}
+
+static int replace_allocs(struct escape_state *state)
+{
+	struct basic_block *bb;
+	int err;
+
+	for (unsigned long i = 0; i < state->nr_sites; i++) {
+		struct alloc_site *site = &state->sites[i];
+
+		if (site->escapes)
+			continue;
+
+		err = alloc_field_tmps(state, site);
+		if (err)
+			return err;
+	}
+
+	for_each_basic_block(bb, &state->cu->bb_list) {
+		struct statement *stmt, *next;
+
+		list_for_each_entry_safe(stmt, next, &bb->stmt_list, stmt_list_node) {
+			err = replace_stmt(state, bb, stmt);
+			if (err)
+				return err;
+		}
+	}
+
+	return 0;
+}
+
+static void trace_escape(struct compilation_unit *cu, unsigned long nr_sites)
+{
+	struct vm_method *vmm = cu->method;
+
+	trace_printf("[escape] %s.%s%s: %lu of %lu allocations eliminated\n",
+		     vmm->class->name, vmm->name, vmm->type,
+		     cu->nr_eliminated_allocs, nr_sites);
+	trace_flush();
+}
+
+static void free_escape_state(struct escape_state *state)
+{
+	for (unsigned long i = 0; i < state->nr_sites; i++) {
+		struct alloc_site *site = &state->sites[i];
+
+		for (unsigned long j = 0; j < site->nr_fields; j++) {
+			if (site->fields[j].tmp)
+				expr_put(site->fields[j].tmp);
+		}
+
+		free(site->fields);
+		free(site->holders);
+	}
+
+	if (state->handler_code)
+		free_hash_map(state->handler_code);
+
+	free(state->sites);
+	free(state->vreg_defs);
+	free(state->local_defs);
+	free(state->vreg_sites);
+	free(state->local_sites);
+}
+
+int escape_analysis(struct compilation_unit *cu)
+{
+	struct escape_state state;
+	struct basic_block *bb;
+	int err;
+
+	cu->nr_eliminated_allocs = 0;
+
+	if (!opt_escape_analysis)
+		return 0;
+
+	state = (struct escape_state) {
+		.cu		= cu,
+		.nr_vregs	= cu->nr_vregs,
+		.nr_locals	= cu->code_attribute->max_locals,
+	};
+
+	err = -ENOMEM;
+
+	state.vreg_defs = calloc(state.nr_vregs + 1, sizeof(*state.vreg_defs));
+	state.local_defs = calloc(state.nr_locals + 1, sizeof(*state.local_defs));
+	state.vreg_sites = calloc(state.nr_vregs + 1, sizeof(*state.vreg_sites));
+	state.local_sites = calloc(state.nr_locals + 1, sizeof(*state.local_sites));
+
+	if (!state.vreg_defs || !state.local_defs || !state.vreg_sites
+	    || !state.local_sites)
+		goto out;
+
+	err = count_defs(&state);
+	if (err || !state.nr_sites)
+		goto out;
+
+	find_sites(&state);
+
+	if (cu->code_attribute->exception_table_length) {
+		err = mark_handler_code(&state);
+		if (err)
+			goto out;
+	}
+
+	for (unsigned long i = 0; i < state.nr_sites; i++) {
+		struct alloc_site *site = &state.sites[i];
+
+		if (site->escapes)
+			continue;
+
+		err = find_copies(&state, site);
+		if (err)
+			goto out;
+
+		check_order(&state, site);
+	}
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		struct statement *stmt;
+
+		state.in_handler_code = state.handler_code
+			&& hash_map_contains(state.handler_code, bb);
+
+		for_each_stmt(stmt, &bb->stmt_list)
+			check_stmt(&state, stmt);
+	}
+
+	for (unsigned long i = 0; i < state.nr_sites; i++) {
+		if (!state.sites[i].escapes)
+			cu->nr_eliminated_allocs++;
+	}
+
+	if (cu->nr_eliminated_allocs) {
+		err = replace_allocs(&state);
+		if (err)
+			goto out;
+	}
+
+	if (opt_trace_escape)
+		trace_escape(cu, state.nr_sites);
+out:
+	free_escape_state(&state);
+
+	return err;
+}
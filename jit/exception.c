@@ -209,13 +209,14 @@ void clear_exception(void)
 }
 
 struct cafebabe_code_attribute_exception *
-lookup_eh_entry(struct vm_method *method, unsigned long target)
+lookup_eh_entry(struct compilation_unit *cu, unsigned long target)
 {
+	struct cafebabe_code_attribute *code_attr = cu->code_attribute;
 	int i;
 
-	for (i = 0; i < method->code_attribute.exception_table_length; i++) {
+	for (i = 0; i < code_attr->exception_table_length; i++) {
 		struct cafebabe_code_attribute_exception *eh
-			= &method->code_attribute.exception_table[i];
+			= &code_attr->exception_table[i];
 
 		if (eh->handler_pc == target)
 			return eh;
@@ -237,12 +238,12 @@ static unsigned char *eh_native_ptr(struct compilation_unit *cu,
 
 int build_exception_handlers_table(struct compilation_unit *cu)
 {
-	struct vm_method *method;
+	struct cafebabe_code_attribute *code_attr;
 	int size;
 	int i;
 
-	method = cu->method;
-	size = method->code_attribute.exception_table_length;
+	code_attr = cu->code_attribute;
+	size = code_attr->exception_table_length;
 
 	if (size == 0)
 		return 0;
@@ -253,7 +254,7 @@ int build_exception_handlers_table(struct compilation_unit *cu)
 
 	for (i = 0; i < size; i++) {
 		struct cafebabe_code_attribute_exception *eh
-			= &method->code_attribute.exception_table[i];
+			= &code_attr->exception_table[i];
 
 		cu->exception_handlers[i] = eh_native_ptr(cu, eh);
 	}
@@ -274,12 +275,12 @@ static unsigned char *find_handler(struct compilation_unit *cu,
 	int i;
 
 	method = cu->method;
-	size = method->code_attribute.exception_table_length;
+	size = cu->code_attribute->exception_table_length;
 
 	for (i = 0; i < size; i++) {
 		struct vm_class *catch_class;
 
-		eh = &method->code_attribute.exception_table[i];
+		eh = &cu->code_attribute->exception_table[i];
 		if (!exception_covers(eh, bc_offset))
 			continue;
 
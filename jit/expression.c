@@ -47,7 +47,6 @@ int expr_nr_kids(struct expression *expr)
 	case EXPR_INSTANCEOF:
 	case EXPR_NULL_CHECK:
 	case EXPR_ARRAY_SIZE_CHECK:
-	case EXPR_LOOKUPSWITCH_BSEARCH:
 		return 1;
 	case EXPR_VALUE:
 	case EXPR_FLOAT_LOCAL:
@@ -99,7 +98,6 @@ int expr_is_pure(struct expression *expr)
 	case EXPR_INSTANCEOF:
 	case EXPR_ARRAY_SIZE_CHECK:
 	case EXPR_NULL_CHECK:
-	case EXPR_LOOKUPSWITCH_BSEARCH:
 	case EXPR_INSTANCE_FIELD:
 	case EXPR_FLOAT_INSTANCE_FIELD:
 
@@ -543,20 +541,6 @@ struct expression *array_size_check_expr(struct expression *size)
 	return expr;
 }
 
-struct expression *lookupswitch_bsearch_expr(struct expression *key, struct lookupswitch *table)
-{
-	struct expression *expr;
-
-	expr = alloc_expression(EXPR_LOOKUPSWITCH_BSEARCH, J_NATIVE_PTR);
-	if (!expr)
-		return NULL;
-
-	expr->key = &key->node;
-	expr->lookupswitch_table = table;
-
-	return expr;
-}
-
 struct expression *truncation_expr(enum vm_type to_type,
 				   struct expression *from_expression)
 {
@@ -0,0 +1,537 @@
+/*
+ * Stack maps for exact garbage collection
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ *
+ * A stack map tells the garbage collector which registers and stack slots
+ * of a compiled frame hold live references. Maps are recorded at the
+ * safepoint polls emitted by select_safepoint_insn(), where the thread that
+ * is stopped is running the method itself, and after every call, where the
+ * method is waiting for a callee to return.
+ *
+ * Local variable slots are classified once for the whole method from the
+ * instructions that access them. Registers and spill slots come from the
+ * live intervals of reference variables after register allocation. The
+ * spill store of an interval is at its end so only the slot that a child
+ * interval was reloaded from holds the current value of a variable, until
+ * the child defines the variable again. That slot is reported as exact and
+ * the other spill slots of the variable as ambiguous because they might
+ * still hold an older reference. Reference slots that the method does not
+ * get from its caller are cleared in the prologue so that the collector
+ * never sees uninitialized data in them.
+ */
+
+#include "jit/compilation-unit.h"
+#include "jit/basic-block.h"
+#include "jit/instruction.h"
+#include "jit/stack-slot.h"
+#include "jit/use-position.h"
+#include "jit/emit-code.h"
+#include "jit/gc-map.h"
+#include "jit/vars.h"
+
+#include "arch/stack-frame.h"
+
+#include "lib/bitset.h"
+#include "lib/buffer.h"
+
+#include "vm/stdlib.h"
+#include "vm/die.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+
+enum {
+	LOCAL_HOLDS_REFERENCE	= 1U << 0,
+	LOCAL_HOLDS_PRIMITIVE	= 1U << 1,
+};
+
+static unsigned long *alloc_bitmap(unsigned long nr_bits)
+{
+	return calloc(max(DIV_ROUND_UP(nr_bits, BITS_PER_LONG), 1UL), sizeof(unsigned long));
+}
+
+static void mark_local(unsigned char *kinds, unsigned long nr_locals,
+		       struct stack_slot *slot, unsigned char kind, bool wide)
+{
+	if (slot->index < nr_locals)
+		kinds[slot->index] |= kind;
+
+	if (wide && slot->index + 1 < nr_locals)
+		kinds[slot->index + 1] |= kind;
+}
+
+static unsigned char reg_kind(struct use_position *reg)
+{
+	if (mach_reg_var(reg)->vm_type == J_REFERENCE)
+		return LOCAL_HOLDS_REFERENCE;
+
+	return LOCAL_HOLDS_PRIMITIVE;
+}
+
+static void classify_local_access(unsigned char *kinds, unsigned long nr_locals,
+				  struct insn *insn)
+{
+	switch (insn->type) {
+	case INSN_MOV_MEMLOCAL_REG:
+		mark_local(kinds, nr_locals, insn->src.slot, reg_kind(&insn->dest.reg), false);
+		break;
+	case INSN_MOV_REG_MEMLOCAL:
+		mark_local(kinds, nr_locals, insn->dest.slot, reg_kind(&insn->src.reg), false);
+		break;
+	case INSN_MOV_IMM_MEMLOCAL:
+#ifdef CONFIG_X86_32
+		/*
+		 * Storing null keeps a reference slot exact. On x86-64
+		 * the store only writes the lower half of the slot.
+		 */
+		if (!insn->src.imm)
+			break;
+#endif
+		mark_local(kinds, nr_locals, insn->dest.slot, LOCAL_HOLDS_PRIMITIVE, false);
+		break;
+	case INSN_MOVSS_MEMLOCAL_XMM:
+		mark_local(kinds, nr_locals, insn->src.slot, LOCAL_HOLDS_PRIMITIVE, false);
+		break;
+	case INSN_MOVSS_XMM_MEMLOCAL:
+		mark_local(kinds, nr_locals, insn->dest.slot, LOCAL_HOLDS_PRIMITIVE, false);
+		break;
+	case INSN_MOVSD_MEMLOCAL_XMM:
+		mark_local(kinds, nr_locals, insn->src.slot, LOCAL_HOLDS_PRIMITIVE, true);
+		break;
+	case INSN_MOVSD_XMM_MEMLOCAL:
+		mark_local(kinds, nr_locals, insn->dest.slot, LOCAL_HOLDS_PRIMITIVE, true);
+		break;
+	case INSN_FLD_MEMLOCAL:
+	case INSN_FSTP_MEMLOCAL:
+		mark_local(kinds, nr_locals, insn->operand.slot, LOCAL_HOLDS_PRIMITIVE, false);
+		break;
+	case INSN_FLD_64_MEMLOCAL:
+	case INSN_FSTP_64_MEMLOCAL:
+		mark_local(kinds, nr_locals, insn->operand.slot, LOCAL_HOLDS_PRIMITIVE, true);
+		break;
+	case INSN_POP_MEMLOCAL:
+		/* We don't know what was pushed. */
+		mark_local(kinds, nr_locals, insn->operand.slot,
+			   LOCAL_HOLDS_REFERENCE | LOCAL_HOLDS_PRIMITIVE, false);
+		break;
+	default:
+		break;
+	}
+}
+
+static void classify_bb_locals(unsigned char *kinds, unsigned long nr_locals,
+			       struct basic_block *bb)
+{
+	struct insn *insn;
+
+	for_each_insn(insn, &bb->insn_list)
+		classify_local_access(kinds, nr_locals, insn);
+}
+
+static int classify_locals(struct compilation_unit *cu, struct gc_maps *maps)
+{
+	unsigned long nr_locals = cu->stack_frame->nr_local_slots;
+	struct basic_block *bb;
+	unsigned char *kinds;
+
+	kinds = zalloc(nr_locals + 1);
+	if (!kinds)
+		return -ENOMEM;
+
+	for_each_basic_block(bb, &cu->bb_list)
+		classify_bb_locals(kinds, nr_locals, bb);
+
+	classify_bb_locals(kinds, nr_locals, cu->exit_bb);
+	classify_bb_locals(kinds, nr_locals, cu->unwind_bb);
+
+	for (unsigned long i = 0; i < nr_locals; i++) {
+		switch (kinds[i]) {
+		case LOCAL_HOLDS_REFERENCE:
+			set_bit(maps->ref_locals, i);
+			break;
+		case LOCAL_HOLDS_REFERENCE | LOCAL_HOLDS_PRIMITIVE:
+			set_bit(maps->ambiguous_locals, i);
+			break;
+		default:
+			break;
+		}
+	}
+
+	free(kinds);
+
+	return 0;
+}
+
+static bool is_reference_var(struct var_info *var)
+{
+	return var->vm_type == J_REFERENCE && var->interval &&
+		!interval_has_fixed_reg(var->interval);
+}
+
+static void mark_ref_spill_slots(struct compilation_unit *cu, unsigned long *bitmap,
+				 struct live_interval *parent)
+{
+	unsigned long nr_locals = cu->stack_frame->nr_local_slots;
+	struct live_interval *it;
+
+	for (it = parent; it != NULL; it = it->next_child) {
+		if (interval_needs_spill(it) && it->spill_slot)
+			set_bit(bitmap, it->spill_slot->index - nr_locals);
+	}
+}
+
+/*
+ * Classifies the stack slots of @cu. This must be called after spill
+ * and reload instructions have been inserted.
+ */
+int gc_maps_prepare(struct compilation_unit *cu)
+{
+	unsigned long nr_locals = cu->stack_frame->nr_local_slots;
+	unsigned long nr_spills = cu->stack_frame->nr_spill_slots;
+	struct gc_maps *maps;
+	struct var_info *var;
+
+	maps = zalloc(sizeof *maps);
+	if (!maps)
+		return -ENOMEM;
+
+	maps->ref_locals	= alloc_bitmap(nr_locals);
+	maps->ambiguous_locals	= alloc_bitmap(nr_locals);
+	maps->ref_spill_slots	= alloc_bitmap(nr_spills);
+	maps->spill_map_words	= DIV_ROUND_UP(nr_spills, BITS_PER_LONG);
+	maps->map_size		= sizeof(struct gc_map) +
+		2 * maps->spill_map_words * sizeof(unsigned long);
+
+	if (!maps->ref_locals || !maps->ambiguous_locals || !maps->ref_spill_slots)
+		goto failed;
+
+	if (classify_locals(cu, maps))
+		goto failed;
+
+	for_each_variable(var, cu->var_infos) {
+		if (is_reference_var(var))
+			mark_ref_spill_slots(cu, maps->ref_spill_slots, var->interval);
+	}
+
+	cu->gc_maps = maps;
+
+	return 0;
+
+  failed:
+	free_gc_maps(maps);
+	return -ENOMEM;
+}
+
+/*
+ * Emits code that clears the reference slots of the frame which are not
+ * passed by the caller.
+ */
+void emit_gc_maps_prolog(struct compilation_unit *cu, struct buffer *buf)
+{
+	struct stack_frame *frame = cu->stack_frame;
+	struct gc_maps *maps = cu->gc_maps;
+	struct stack_slot *slot;
+
+	if (!maps)
+		return;
+
+	for (unsigned long i = frame->nr_args; i < frame->nr_local_slots; i++) {
+		if (test_bit(maps->ref_locals, i))
+			emit_clear_slot(buf, get_local_slot(frame, i));
+	}
+
+	for (slot = frame->spill_slots; slot != NULL; slot = slot->next) {
+		if (test_bit(maps->ref_spill_slots, slot->index - frame->nr_local_slots))
+			emit_clear_slot(buf, slot);
+	}
+}
+
+/*
+ * Clears the same slots as emit_gc_maps_prolog() in a frame that was set
+ * up without running the prologue of @cu.
+ */
+void gc_maps_clear_frame(struct compilation_unit *cu, void *frame)
+{
+	struct stack_frame *stack_frame = cu->stack_frame;
+	struct gc_maps *maps = cu->gc_maps;
+
+	if (!maps)
+		return;
+
+	for (unsigned long i = stack_frame->nr_args; i < stack_frame->nr_local_slots; i++) {
+		if (test_bit(maps->ref_locals, i))
+			*frame_slot_ptr(cu, frame, i) = NULL;
+	}
+
+	for (unsigned long i = 0; i < stack_frame->nr_spill_slots; i++) {
+		if (test_bit(maps->ref_spill_slots, i))
+			*frame_slot_ptr(cu, frame, stack_frame->nr_local_slots + i) = NULL;
+	}
+}
+
+static struct gc_map *intern_map(struct gc_maps *maps, struct gc_map *map)
+{
+	struct gc_map **new_maps;
+
+	for (unsigned long i = 0; i < maps->nr_maps; i++) {
+		if (!memcmp(maps->maps[i], map, maps->map_size)) {
+			free(map);
+			return maps->maps[i];
+		}
+	}
+
+	new_maps = realloc(maps->maps, (maps->nr_maps + 1) * sizeof(*new_maps));
+	if (!new_maps)
+		die("out of memory");
+
+	new_maps[maps->nr_maps++] = map;
+	maps->maps = new_maps;
+
+	return map;
+}
+
+static unsigned long *ambiguous_spill_map(struct gc_maps *maps, struct gc_map *map)
+{
+	return map->spill_map + maps->spill_map_words;
+}
+
+/*
+ * Returns true if @it defines its variable before LIR position @pos.
+ */
+static bool interval_defines_before(struct live_interval *it, unsigned long pos)
+{
+	struct use_position *reg;
+
+	list_for_each_entry(reg, &it->use_positions, use_pos_list) {
+		if ((reg->kind & USE_KIND_OUTPUT) && reg->insn->lir_pos + 1 < pos)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Returns the spill slot that holds the current value of the variable of
+ * @it at LIR position @pos or NULL if no slot does.
+ */
+static struct stack_slot *current_spill_slot(struct live_interval *it, unsigned long pos)
+{
+	if (!interval_needs_reload(it) || !it->spill_parent->spill_slot)
+		return NULL;
+
+	if (interval_defines_before(it, pos))
+		return NULL;
+
+	return it->spill_parent->spill_slot;
+}
+
+/*
+ * Builds the map of references that are live at LIR position @pos. If
+ * @after_call is true, @pos is the position right after a call and
+ * values defined by the call are left out.
+ */
+static struct gc_map *build_map(struct compilation_unit *cu, unsigned long pos,
+				bool after_call)
+{
+	unsigned long nr_locals = cu->stack_frame->nr_local_slots;
+	struct gc_maps *maps = cu->gc_maps;
+	unsigned long *ambiguous;
+	struct var_info *var;
+	struct gc_map *map;
+
+	map = zalloc(maps->map_size);
+	if (!map)
+		die("out of memory");
+
+	ambiguous = ambiguous_spill_map(maps, map);
+
+	for_each_variable(var, cu->var_infos) {
+		struct stack_slot *slot;
+		struct live_interval *it;
+
+		if (!is_reference_var(var))
+			continue;
+
+		it = interval_child_at(var->interval, pos);
+		if (!it)
+			continue;
+
+		if (after_call && interval_start(it) == pos)
+			continue;
+
+		if (it->reg != MACH_REG_UNASSIGNED) {
+			assert(it->reg < NR_GP_REGISTERS);
+			set_bit(map->register_map, it->reg);
+		}
+
+		mark_ref_spill_slots(cu, ambiguous, var->interval);
+
+		slot = current_spill_slot(it, pos);
+		if (slot) {
+			set_bit(map->spill_map, slot->index - nr_locals);
+			clear_bit(ambiguous, slot->index - nr_locals);
+		}
+	}
+
+	return intern_map(maps, map);
+}
+
+static void add_site(struct gc_site **sites, unsigned long *nr_sites,
+		     unsigned long start, unsigned long end, struct gc_map *map)
+{
+	struct gc_site *new_sites;
+
+	new_sites = realloc(*sites, (*nr_sites + 1) * sizeof(*new_sites));
+	if (!new_sites)
+		die("out of memory");
+
+	new_sites[*nr_sites].start	= start;
+	new_sites[*nr_sites].end	= end;
+	new_sites[*nr_sites].map	= map;
+
+	*sites = new_sites;
+	(*nr_sites)++;
+}
+
+/*
+ * Records the map of @insn, which was emitted to [@start, @end) and had
+ * LIR position @lir_pos, if it is a safepoint poll or a call. Sites must
+ * be added in the order of their machine code offsets.
+ */
+void gc_maps_add_site(struct compilation_unit *cu, struct basic_block *bb,
+		      struct insn *insn, unsigned long lir_pos,
+		      unsigned long start, unsigned long end)
+{
+	struct gc_maps *maps = cu->gc_maps;
+
+	if (!maps)
+		return;
+
+	/* Instructions inserted after register allocation have no LIR position. */
+	if (lir_pos < bb->start_insn || lir_pos >= bb->end_insn)
+		return;
+
+	if (insn->flags & INSN_FLAG_SAFEPOINT_POLL)
+		add_site(&maps->polls, &maps->nr_polls, start, end,
+			 build_map(cu, lir_pos, false));
+	else if (insn_is_call(insn))
+		add_site(&maps->calls, &maps->nr_calls, start, end,
+			 build_map(cu, lir_pos + 1, true));
+}
+
+void free_gc_maps(struct gc_maps *maps)
+{
+	if (!maps)
+		return;
+
+	for (unsigned long i = 0; i < maps->nr_maps; i++)
+		free(maps->maps[i]);
+
+	free(maps->maps);
+	free(maps->polls);
+	free(maps->calls);
+	free(maps->ref_locals);
+	free(maps->ambiguous_locals);
+	free(maps->ref_spill_slots);
+	free(maps);
+}
+
+/*
+ * Returns the last site that starts at or before @offset.
+ */
+static struct gc_site *lookup_site(struct gc_site *sites, unsigned long nr_sites,
+				   unsigned long offset)
+{
+	unsigned long lo = 0, hi = nr_sites;
+
+	while (lo < hi) {
+		unsigned long mid = lo + (hi - lo) / 2;
+
+		if (sites[mid].start <= offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (!lo)
+		return NULL;
+
+	return &sites[lo - 1];
+}
+
+/*
+ * Returns the map of the safepoint poll at @addr or NULL if there is no
+ * poll at that address.
+ */
+struct gc_map *gc_map_lookup_poll(struct compilation_unit *cu, unsigned long addr)
+{
+	struct gc_maps *maps = cu->gc_maps;
+	unsigned long offset;
+	struct gc_site *site;
+
+	if (!maps)
+		return NULL;
+
+	offset = addr - (unsigned long) buffer_ptr(cu->objcode);
+
+	site = lookup_site(maps->polls, maps->nr_polls, offset);
+	if (!site || site->start != offset)
+		return NULL;
+
+	return site->map;
+}
+
+/*
+ * Returns the map of the call that returns to @return_addr or NULL if
+ * there is no such call. Instructions that call the VM from a slow path
+ * return somewhere inside the instruction.
+ */
+struct gc_map *gc_map_lookup_call(struct compilation_unit *cu, unsigned long return_addr)
+{
+	struct gc_maps *maps = cu->gc_maps;
+	unsigned long offset;
+	struct gc_site *site;
+
+	if (!maps)
+		return NULL;
+
+	offset = return_addr - (unsigned long) buffer_ptr(cu->objcode);
+
+	site = lookup_site(maps->calls, maps->nr_calls, offset - 1);
+	if (!site || offset > site->end)
+		return NULL;
+
+	return site->map;
+}
+
+/*
+ * Reports the local variable and spill slots of @frame that hold
+ * references according to @map.
+ */
+void gc_map_scan_slots(struct compilation_unit *cu, struct gc_map *map,
+		       void *frame, gc_root_fn fn, void *arg)
+{
+	struct stack_frame *stack_frame = cu->stack_frame;
+	struct gc_maps *maps = cu->gc_maps;
+
+	for (unsigned long i = 0; i < stack_frame->nr_local_slots; i++) {
+		if (test_bit(maps->ref_locals, i))
+			fn(frame_slot_ptr(cu, frame, i), GC_ROOT_EXACT, arg);
+		else if (test_bit(maps->ambiguous_locals, i))
+			fn(frame_slot_ptr(cu, frame, i), GC_ROOT_AMBIGUOUS, arg);
+	}
+
+	for (unsigned long i = 0; i < stack_frame->nr_spill_slots; i++) {
+		void **slot = frame_slot_ptr(cu, frame, stack_frame->nr_local_slots + i);
+
+		if (test_bit(map->spill_map, i))
+			fn(slot, GC_ROOT_EXACT, arg);
+		else if (test_bit(ambiguous_spill_map(maps, map), i))
+			fn(slot, GC_ROOT_AMBIGUOUS, arg);
+	}
+}
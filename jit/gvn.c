@@ -0,0 +1,787 @@
+/*
+ * Global value numbering and loop-invariant code motion
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ *
+ * Both passes work on the SSA form of the LIR. An instruction that computes
+ * a value from virtual registers only is identified by its type, its
+ * operands and its immediate. Loads are identified the same way but are
+ * only equal as long as no store in between may have changed the memory
+ * they read.
+ *
+ * gvn() walks the dominator tree and replaces instructions that compute a
+ * value already computed by a dominating instruction. Loads are only
+ * reused within a basic block.
+ *
+ * licm() moves instructions whose operands are defined outside of a
+ * natural loop to the preheader of the loop. Loads from the heap can fault
+ * so they are only moved when the loop would have executed them before
+ * anything else on entry or when they read a field of "this".
+ */
+
+#include "jit/compilation-unit.h"
+#include "jit/basic-block.h"
+#include "jit/compiler.h"
+#include "jit/instruction.h"
+#include "jit/ssa.h"
+#include "jit/vars.h"
+
+#include "vm/method.h"
+#include "vm/stdlib.h"
+#include "vm/system.h"
+
+#include "lib/bitset.h"
+#include "lib/hash-map.h"
+
+#include <stdlib.h>
+#include <errno.h>
+
+enum value_kind {
+	VALUE_PURE,		/* computed from registers only */
+	VALUE_LOCAL,		/* load of a local variable slot */
+	VALUE_FIELD,		/* load from base register + displacement */
+	VALUE_ELEMENT,		/* load of an array element */
+};
+
+struct value {
+	struct insn		*insn;
+	enum value_kind		kind;
+	/* Immediate, displacement, slot index or scale */
+	unsigned long		imm;
+	struct var_info		*ops[2];
+};
+
+enum mem_effect {
+	MEM_NONE,
+	MEM_LOCAL_STORE,	/* store to a local variable slot */
+	MEM_FRAME_STORE,	/* store relative to the frame or stack pointer */
+	MEM_FIELD_STORE,	/* store to base register + displacement */
+	MEM_ELEMENT_STORE,	/* store to an array element */
+	MEM_BARRIER,		/* may change any memory other than the frame */
+};
+
+static struct var_info *operand_var(struct use_position *reg)
+{
+	return reg->interval->var_info;
+}
+
+static struct var_info *add_on_var(struct compilation_unit *cu, struct insn *insn)
+{
+	struct use_position *add_on = NULL;
+
+	hash_map_get(cu->insn_add_ons, insn, (void **) &add_on);
+	if (!add_on)
+		return NULL;
+
+	return add_on->interval->var_info;
+}
+
+static unsigned long membase_width(struct insn *insn)
+{
+	switch (insn->type) {
+	case INSN_MOVSX_8_MEMBASE_REG:
+		return 1;
+	case INSN_MOVSX_16_MEMBASE_REG:
+	case INSN_FNSTCW_MEMBASE:
+		return 2;
+	case INSN_MOVSS_MEMBASE_XMM:
+	case INSN_MOVSS_XMM_MEMBASE:
+	case INSN_FSTP_MEMBASE:
+	case INSN_OR_IMM_MEMBASE:
+		return 4;
+	case INSN_MOVSD_MEMBASE_XMM:
+	case INSN_MOVSD_XMM_MEMBASE:
+	case INSN_FSTP_64_MEMBASE:
+	case INSN_FISTP_64_MEMBASE:
+		return 8;
+	default:
+		return sizeof(unsigned long);
+	}
+}
+
+/* 64-bit accesses cover the following slot too. */
+static unsigned long memlocal_width(struct insn *insn)
+{
+	switch (insn->type) {
+	case INSN_MOVSD_MEMLOCAL_XMM:
+	case INSN_MOVSD_XMM_MEMLOCAL:
+	case INSN_FLD_64_MEMLOCAL:
+	case INSN_FSTP_64_MEMLOCAL:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+static bool ranges_overlap(unsigned long start1, unsigned long len1,
+			   unsigned long start2, unsigned long len2)
+{
+	return start1 < start2 + len2 && start2 < start1 + len1;
+}
+
+static struct operand *store_operand(struct insn *insn)
+{
+	switch (insn->type) {
+	case INSN_FSTP_MEMLOCAL:
+	case INSN_FSTP_64_MEMLOCAL:
+	case INSN_POP_MEMLOCAL:
+	case INSN_FSTP_MEMBASE:
+	case INSN_FSTP_64_MEMBASE:
+	case INSN_FISTP_64_MEMBASE:
+	case INSN_FNSTCW_MEMBASE:
+		return &insn->operand;
+	default:
+		return &insn->dest;
+	}
+}
+
+static enum mem_effect insn_mem_effect(struct insn *insn)
+{
+	struct operand *dest;
+
+	if (insn_is_phi(insn))
+		return MEM_NONE;
+
+	if (insn_is_call(insn) || insn->flags & INSN_FLAG_VOLATILE)
+		return MEM_BARRIER;
+
+	switch (insn->type) {
+	case INSN_FSTP_MEMLOCAL:
+	case INSN_FSTP_64_MEMLOCAL:
+	case INSN_POP_MEMLOCAL:
+		return MEM_LOCAL_STORE;
+	case INSN_MOV_IMM_MEMBASE:
+	case INSN_MOV_REG_MEMBASE:
+	case INSN_MOVSS_XMM_MEMBASE:
+	case INSN_MOVSD_XMM_MEMBASE:
+	case INSN_OR_IMM_MEMBASE:
+	case INSN_FSTP_MEMBASE:
+	case INSN_FSTP_64_MEMBASE:
+	case INSN_FISTP_64_MEMBASE:
+	case INSN_FNSTCW_MEMBASE:
+		dest = store_operand(insn);
+		if (interval_has_fixed_reg(dest->base_reg.interval))
+			return MEM_FRAME_STORE;
+
+		return MEM_FIELD_STORE;
+	case INSN_MOV_REG_MEMINDEX:
+	case INSN_MOVSS_XMM_MEMINDEX:
+	case INSN_MOVSD_XMM_MEMINDEX:
+		return MEM_ELEMENT_STORE;
+	case INSN_MOV_REG_MEMDISP:
+	case INSN_MOVSS_XMM_MEMDISP:
+	case INSN_MOVSD_XMM_MEMDISP:
+	case INSN_MOV_IMM_THREAD_LOCAL_MEMBASE:
+	case INSN_MOV_REG_THREAD_LOCAL_MEMBASE:
+	case INSN_MOV_REG_THREAD_LOCAL_MEMDISP:
+		return MEM_BARRIER;
+	default:
+		break;
+	}
+
+	if (insn->dest.type == OPERAND_MEMLOCAL)
+		return MEM_LOCAL_STORE;
+
+	return MEM_NONE;
+}
+
+/*
+ * Returns true if the store @store may change the memory that @val was
+ * loaded from. Array elements never overlap fields nor the array length.
+ */
+static bool store_kills_value(struct insn *store, enum mem_effect effect,
+			      struct value *val)
+{
+	struct operand *dest;
+
+	switch (val->kind) {
+	case VALUE_PURE:
+		return false;
+	case VALUE_LOCAL:
+		if (effect == MEM_FRAME_STORE)
+			return true;
+
+		if (effect != MEM_LOCAL_STORE)
+			return false;
+
+		dest = store_operand(store);
+
+		return ranges_overlap(dest->slot->index, memlocal_width(store),
+				      val->imm, memlocal_width(val->insn));
+	case VALUE_FIELD:
+		if (effect == MEM_BARRIER)
+			return true;
+
+		if (effect != MEM_FIELD_STORE)
+			return false;
+
+		dest = store_operand(store);
+
+		return ranges_overlap(dest->disp, membase_width(store),
+				      val->imm, membase_width(val->insn));
+	case VALUE_ELEMENT:
+		return effect == MEM_BARRIER || effect == MEM_FIELD_STORE
+			|| effect == MEM_ELEMENT_STORE;
+	default:
+		return true;
+	}
+}
+
+/*
+ * Returns true and fills in @val if @insn is a candidate for value
+ * numbering. Instructions that use or define fixed registers and
+ * instructions with special flags are left alone.
+ */
+static bool insn_value(struct compilation_unit *cu, struct insn *insn,
+		       struct value *val)
+{
+	struct var_info *tmp;
+	bool commutative = false;
+
+	if (insn->flags & ~INSN_FLAG_KNOWN_BC_OFFSET)
+		return false;
+
+	*val = (struct value) {
+		.insn	= insn,
+		.kind	= VALUE_PURE,
+	};
+
+	switch (insn->type) {
+	case INSN_ADD_IMM_REG:
+	case INSN_SUB_IMM_REG:
+	case INSN_SAR_IMM_REG:
+		val->imm = insn->src.imm;
+		val->ops[0] = add_on_var(cu, insn);
+		break;
+	case INSN_NEG_REG:
+		val->ops[0] = add_on_var(cu, insn);
+		break;
+	case INSN_ADD_REG_REG:
+	case INSN_AND_REG_REG:
+	case INSN_OR_REG_REG:
+	case INSN_XOR_REG_REG:
+	case INSN_MUL_REG_REG:
+	case INSN_ADDSS_XMM_XMM:
+	case INSN_ADDSD_XMM_XMM:
+	case INSN_MULSS_XMM_XMM:
+	case INSN_MULSD_XMM_XMM:
+		commutative = true;
+		/* Fall through */
+	case INSN_SUB_REG_REG:
+	case INSN_SUBSS_XMM_XMM:
+	case INSN_SUBSD_XMM_XMM:
+	case INSN_DIVSS_XMM_XMM:
+	case INSN_DIVSD_XMM_XMM:
+		val->ops[0] = add_on_var(cu, insn);
+		val->ops[1] = operand_var(&insn->src.reg);
+		break;
+	case INSN_MOVSX_8_REG_REG:
+	case INSN_MOVSX_16_REG_REG:
+	case INSN_MOVZX_16_REG_REG:
+		val->ops[0] = operand_var(&insn->src.reg);
+		break;
+	case INSN_MOV_MEMLOCAL_REG:
+	case INSN_MOVSS_MEMLOCAL_XMM:
+	case INSN_MOVSD_MEMLOCAL_XMM:
+		/* The scratch slot is also written through the frame pointer. */
+		if (insn->src.slot == cu->scratch_slot)
+			return false;
+
+		val->kind = VALUE_LOCAL;
+		val->imm = insn->src.slot->index;
+		break;
+	case INSN_MOV_MEMBASE_REG:
+	case INSN_MOVSX_8_MEMBASE_REG:
+	case INSN_MOVSX_16_MEMBASE_REG:
+	case INSN_MOVSS_MEMBASE_XMM:
+	case INSN_MOVSD_MEMBASE_XMM:
+		val->kind = VALUE_FIELD;
+		val->imm = insn->src.disp;
+		val->ops[0] = operand_var(&insn->src.base_reg);
+		break;
+	case INSN_MOV_MEMINDEX_REG:
+	case INSN_MOVSS_MEMINDEX_XMM:
+	case INSN_MOVSD_MEMINDEX_XMM:
+		val->kind = VALUE_ELEMENT;
+		val->imm = insn->src.shift;
+		val->ops[0] = operand_var(&insn->src.base_reg);
+		val->ops[1] = operand_var(&insn->src.index_reg);
+		break;
+	default:
+		return false;
+	}
+
+	if (interval_has_fixed_reg(insn->dest.reg.interval))
+		return false;
+
+	if (insn_use_def(insn) && !val->ops[0])
+		return false;
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(val->ops); i++) {
+		if (val->ops[i] && interval_has_fixed_reg(val->ops[i]->interval))
+			return false;
+	}
+
+	if (commutative && val->ops[1]->vreg < val->ops[0]->vreg) {
+		tmp = val->ops[0];
+		val->ops[0] = val->ops[1];
+		val->ops[1] = tmp;
+	}
+
+	return true;
+}
+
+static bool values_equal(struct value *a, struct value *b)
+{
+	struct var_info *dest_a, *dest_b;
+
+	if (a->kind != b->kind || a->insn->type != b->insn->type)
+		return false;
+
+	if (a->imm != b->imm || a->ops[0] != b->ops[0] || a->ops[1] != b->ops[1])
+		return false;
+
+	dest_a = operand_var(&a->insn->dest.reg);
+	dest_b = operand_var(&b->insn->dest.reg);
+
+	return dest_a->vm_type == dest_b->vm_type;
+}
+
+/*
+ * Long arithmetic is done with instruction pairs like ADD and ADC where
+ * the second one uses the carry flag of the first. Conditional branches
+ * may also use flags set by the instruction before them.
+ */
+static bool insn_flags_used(struct basic_block *bb, struct insn *insn)
+{
+	struct insn *next;
+
+	if (insn->insn_list_node.next == &bb->insn_list)
+		return false;
+
+	next = list_entry(insn->insn_list_node.next, struct insn, insn_list_node);
+
+	switch (next->type) {
+	case INSN_ADC_IMM_REG:
+	case INSN_ADC_MEMBASE_REG:
+	case INSN_ADC_REG_REG:
+	case INSN_SBB_IMM_REG:
+	case INSN_SBB_MEMBASE_REG:
+	case INSN_SBB_REG_REG:
+		return true;
+	default:
+		return insn_is_branch(next) && !insn_is_jmp_branch(next);
+	}
+}
+
+/*
+ * Replaces all uses of the value defined by @dup with the value defined
+ * by @orig and removes @dup.
+ */
+static void replace_value(struct compilation_unit *cu, struct insn *dup,
+			  struct insn *orig)
+{
+	struct live_interval *from, *to;
+	struct use_position *use, *tmp;
+
+	from = dup->dest.reg.interval;
+	to = orig->dest.reg.interval;
+
+	list_for_each_entry_safe(use, tmp, &from->use_positions, use_pos_list) {
+		if (use == &dup->dest.reg)
+			continue;
+
+		list_move(&use->use_pos_list, &to->use_positions);
+		use->interval = to;
+	}
+
+	if (insn_use_def(dup))
+		hash_map_remove(cu->insn_add_ons, dup);
+
+	remove_insn(dup);
+}
+
+struct value_table {
+	struct value		*values;
+	unsigned long		nr_values;
+};
+
+static struct value *lookup_value(struct value_table *table, struct value *val)
+{
+	for (unsigned long i = 0; i < table->nr_values; i++) {
+		if (values_equal(&table->values[i], val))
+			return &table->values[i];
+	}
+
+	return NULL;
+}
+
+static void kill_loads(struct value_table *loads, struct insn *store,
+		       enum mem_effect effect)
+{
+	unsigned long nr = 0;
+
+	for (unsigned long i = 0; i < loads->nr_values; i++) {
+		if (store_kills_value(store, effect, &loads->values[i]))
+			continue;
+
+		loads->values[nr++] = loads->values[i];
+	}
+
+	loads->nr_values = nr;
+}
+
+static void gvn_block(struct compilation_unit *cu, struct basic_block *bb,
+		      struct value_table *values, struct value_table *loads)
+{
+	unsigned long nr_values = values->nr_values;
+	struct insn *insn, *tmp;
+
+	loads->nr_values = 0;
+
+	list_for_each_entry_safe(insn, tmp, &bb->insn_list, insn_list_node) {
+		struct value_table *table;
+		enum mem_effect effect;
+		struct value val, *orig;
+
+		effect = insn_mem_effect(insn);
+		if (effect != MEM_NONE)
+			kill_loads(loads, insn, effect);
+
+		if (!insn_value(cu, insn, &val) || insn_flags_used(bb, insn))
+			continue;
+
+		table = val.kind == VALUE_PURE ? values : loads;
+
+		orig = lookup_value(table, &val);
+		if (orig) {
+			replace_value(cu, insn, orig->insn);
+			continue;
+		}
+
+		table->values[table->nr_values++] = val;
+	}
+
+	for (unsigned long i = 0; i < bb->nr_dom_successors; i++)
+		gvn_block(cu, bb->dom_successors[i], values, loads);
+
+	values->nr_values = nr_values;
+}
+
+static unsigned long nr_insns(struct compilation_unit *cu)
+{
+	struct basic_block *bb;
+	struct insn *insn;
+	unsigned long nr = 0;
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		for_each_insn(insn, &bb->insn_list)
+			nr++;
+	}
+
+	return nr;
+}
+
+int gvn(struct compilation_unit *cu)
+{
+	struct value_table values, loads;
+	unsigned long nr;
+
+	if (cu_has_eh_bbs(cu))
+		return 0;
+
+	nr = nr_insns(cu);
+
+	values.values = malloc(nr * sizeof(struct value));
+	loads.values = malloc(nr * sizeof(struct value));
+	if (!values.values || !loads.values) {
+		free(values.values);
+		free(loads.values);
+		return warn("out of memory"), -ENOMEM;
+	}
+
+	values.nr_values = 0;
+
+	gvn_block(cu, cu->entry_bb, &values, &loads);
+
+	free(values.values);
+	free(loads.values);
+
+	return 0;
+}
+
+struct licm {
+	struct compilation_unit	*cu;
+	/* Basic block and instruction defining each virtual register */
+	struct basic_block	**def_bbs;
+	struct insn		**def_insns;
+	/* Local variable slot 0 always holds "this". */
+	bool			this_is_fixed;
+};
+
+static bool bb_in_loop(struct basic_block *header, struct basic_block *bb)
+{
+	return test_bit(header->natural_loop->bits, bb->dfn);
+}
+
+/*
+ * Returns the only predecessor of @header outside of the loop if it does
+ * not branch anywhere else.
+ */
+static struct basic_block *loop_preheader(struct basic_block *header)
+{
+	struct basic_block *preheader = NULL;
+	struct insn *last;
+
+	for (unsigned long i = 0; i < header->nr_predecessors; i++) {
+		struct basic_block *pred = header->predecessors[i];
+
+		if (bb_in_loop(header, pred))
+			continue;
+
+		if (preheader)
+			return NULL;
+
+		preheader = pred;
+	}
+
+	if (!preheader || preheader->nr_successors != 1)
+		return NULL;
+
+	if (list_is_empty(&preheader->insn_list))
+		return preheader;
+
+	last = list_entry(preheader->insn_list.prev, struct insn, insn_list_node);
+	if (insn_is_branch(last) && !insn_is_jmp_branch(last))
+		return NULL;
+
+	return preheader;
+}
+
+static void preheader_add_insn(struct basic_block *preheader, struct insn *insn)
+{
+	struct insn *last;
+
+	list_del(&insn->insn_list_node);
+
+	if (!list_is_empty(&preheader->insn_list)) {
+		last = list_entry(preheader->insn_list.prev, struct insn, insn_list_node);
+
+		if (insn_is_branch(last)) {
+			list_add_tail(&insn->insn_list_node, &last->insn_list_node);
+			return;
+		}
+	}
+
+	bb_add_insn(preheader, insn);
+}
+
+static int licm_init(struct licm *licm, struct compilation_unit *cu)
+{
+	struct basic_block *bb;
+	struct insn *insn;
+
+	licm->cu = cu;
+	licm->this_is_fixed = !vm_method_is_static(cu->method);
+
+	licm->def_bbs = zalloc(cu->ssa_nr_vregs * sizeof(struct basic_block *));
+	licm->def_insns = zalloc(cu->ssa_nr_vregs * sizeof(struct insn *));
+	if (!licm->def_bbs || !licm->def_insns)
+		return -ENOMEM;
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		for_each_insn(insn, &bb->insn_list) {
+			struct use_position *defs[MAX_REG_OPERANDS];
+			int nr_defs;
+
+			if (insn_mem_effect(insn) == MEM_LOCAL_STORE &&
+			    store_operand(insn)->slot->index == 0)
+				licm->this_is_fixed = false;
+
+			nr_defs = insn_defs_reg(insn, defs);
+			for (int i = 0; i < nr_defs; i++) {
+				struct var_info *var = operand_var(defs[i]);
+
+				licm->def_bbs[var->vreg] = bb;
+				licm->def_insns[var->vreg] = insn;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static bool is_invariant(struct licm *licm, struct basic_block *header,
+			 struct value *val)
+{
+	for (unsigned int i = 0; i < ARRAY_SIZE(val->ops); i++) {
+		struct basic_block *bb;
+
+		if (!val->ops[i])
+			continue;
+
+		bb = licm->def_bbs[val->ops[i]->vreg];
+		if (bb && bb_in_loop(header, bb))
+			return false;
+	}
+
+	return true;
+}
+
+static bool loop_kills_value(struct compilation_unit *cu, struct basic_block *header,
+			     struct value *val)
+{
+	struct basic_block *bb;
+	struct insn *insn;
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		if (!bb_in_loop(header, bb))
+			continue;
+
+		for_each_insn(insn, &bb->insn_list) {
+			enum mem_effect effect = insn_mem_effect(insn);
+
+			if (effect != MEM_NONE && store_kills_value(insn, effect, val))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+static bool is_this(struct licm *licm, struct var_info *var)
+{
+	struct insn *def;
+
+	if (!licm->this_is_fixed)
+		return false;
+
+	def = licm->def_insns[var->vreg];
+
+	return def && def->type == INSN_MOV_MEMLOCAL_REG && def->src.slot->index == 0;
+}
+
+/*
+ * Returns true if @insn is executed before anything that can fault or has
+ * side effects each time @header is entered.
+ */
+static bool is_first_effect_in_header(struct licm *licm, struct basic_block *header,
+				      struct insn *insn)
+{
+	struct insn *prev;
+
+	for_each_insn(prev, &header->insn_list) {
+		struct value val;
+
+		if (prev == insn)
+			return true;
+
+		if (insn_is_phi(prev) || insn_is_copy(prev) || insn_is_mov_imm_reg(prev))
+			continue;
+
+		if (!insn_value(licm->cu, prev, &val))
+			return false;
+
+		if (val.kind != VALUE_PURE && val.kind != VALUE_LOCAL)
+			return false;
+	}
+
+	return false;
+}
+
+static bool can_hoist(struct licm *licm, struct basic_block *header,
+		      struct basic_block *bb, struct value *val)
+{
+	if (!is_invariant(licm, header, val))
+		return false;
+
+	switch (val->kind) {
+	case VALUE_PURE:
+		return true;
+	case VALUE_LOCAL:
+		return !loop_kills_value(licm->cu, header, val);
+	case VALUE_FIELD:
+		if (loop_kills_value(licm->cu, header, val))
+			return false;
+
+		if (is_this(licm, val->ops[0]))
+			return true;
+
+		return bb == header && is_first_effect_in_header(licm, header, val->insn);
+	default:
+		return false;
+	}
+}
+
+static bool licm_loop(struct licm *licm, struct basic_block *header)
+{
+	struct compilation_unit *cu = licm->cu;
+	struct basic_block *preheader, *bb;
+	bool changed = false;
+
+	preheader = loop_preheader(header);
+	if (!preheader)
+		return false;
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		struct insn *insn, *tmp;
+
+		if (!bb_in_loop(header, bb))
+			continue;
+
+		list_for_each_entry_safe(insn, tmp, &bb->insn_list, insn_list_node) {
+			struct var_info *dest;
+			struct value val;
+
+			if (!insn_value(cu, insn, &val) || insn_flags_used(bb, insn))
+				continue;
+
+			if (!can_hoist(licm, header, bb, &val))
+				continue;
+
+			preheader_add_insn(preheader, insn);
+
+			dest = operand_var(&insn->dest.reg);
+			licm->def_bbs[dest->vreg] = preheader;
+
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+int licm(struct compilation_unit *cu)
+{
+	struct basic_block *bb;
+	struct licm licm;
+	bool changed;
+	int err;
+
+	if (cu_has_eh_bbs(cu))
+		return 0;
+
+	err = licm_init(&licm, cu);
+	if (err)
+		goto out;
+
+	/*
+	 * Moving an instruction out of an inner loop can make instructions
+	 * of the outer loop invariant.
+	 */
+	do {
+		changed = false;
+
+		for_each_basic_block(bb, &cu->bb_list) {
+			if (bb->natural_loop && licm_loop(&licm, bb))
+				changed = true;
+		}
+	} while (changed);
+out:
+	free(licm.def_bbs);
+	free(licm.def_insns);
+
+	return err;
+}
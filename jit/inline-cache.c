@@ -8,6 +8,7 @@
 #include <stdbool.h>
 
 bool opt_ic_enabled = true;
+bool opt_trace_ic;
 
 bool ic_enabled(void)
 {
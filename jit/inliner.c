@@ -0,0 +1,937 @@
+/*
+ * Method inlining
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ *
+ * Inlines small methods into their callers at bytecode level before the
+ * control flow is analyzed. Only methods of the caller's own class are
+ * inlined so that constant pool indices of the callee remain valid and
+ * class initialization and stack walking based caller checks are not
+ * affected. A callee is inlined if it is static, private or final, is
+ * not synchronized and has no exception handlers, and if it contains no
+ * invocations, subroutines or switches once its own calls have been
+ * inlined.
+ *
+ * Arguments are popped into fresh local variables and returns are
+ * replaced with a jump to the instruction following the call site. For
+ * every instruction we record the chain of inlined methods it belongs to
+ * so that stack traces can show the inlined frames.
+ */
+
+#include "cafebabe/code_attribute.h"
+#include "cafebabe/line_number_table_attribute.h"
+
+#include "jit/compilation-unit.h"
+#include "jit/compiler.h"
+#include "jit/exception.h"
+#include "jit/stack-slot.h"
+#include "jit/inliner.h"
+
+#include "vm/bytecode.h"
+#include "vm/opcodes.h"
+#include "vm/method.h"
+#include "vm/class.h"
+#include "vm/stdlib.h"
+#include "vm/trace.h"
+#include "vm/die.h"
+
+#include "lib/arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+/*
+ * Inlining is not done into methods larger than this so that all branch
+ * offsets are guaranteed to fit in 16 bits.
+ */
+#define INLINE_MAX_CODE_LENGTH	8000
+
+unsigned long opt_inline_max_size = 35;
+unsigned long opt_inline_max_level = 3;
+
+struct inline_unit {
+	struct vm_method	*method;
+	struct inline_unit	*parent;
+
+	unsigned char		*code;
+	unsigned long		code_length;
+	unsigned long		max_locals;
+	unsigned long		max_stack;
+
+	/* Bytecode offset in ->method of every instruction. */
+	unsigned long		*orig_pc;
+
+	/* Inlined frames of every instruction or NULL. */
+	struct inline_frame	**frames;
+};
+
+struct inline_site {
+	unsigned long		pc;
+	struct inline_unit	*callee;
+};
+
+struct code_writer {
+	unsigned char		*code;
+	unsigned long		*orig_pc;
+	struct inline_frame	**frames;
+	unsigned long		pc;
+};
+
+static void free_inline_unit(struct inline_unit *unit)
+{
+	free(unit->code);
+	free(unit->orig_pc);
+	free(unit->frames);
+	free(unit);
+}
+
+static struct inline_unit *
+inline_unit_from_method(struct vm_method *method, struct inline_unit *parent)
+{
+	struct cafebabe_code_attribute *attr = &method->code_attribute;
+	struct inline_unit *unit;
+	unsigned long pc;
+
+	unit = zalloc(sizeof *unit);
+	if (!unit)
+		return NULL;
+
+	unit->method		= method;
+	unit->parent		= parent;
+	unit->code_length	= attr->code_length;
+	unit->max_locals	= attr->max_locals;
+	unit->max_stack		= attr->max_stack;
+
+	unit->code = malloc(attr->code_length);
+	unit->orig_pc = malloc(attr->code_length * sizeof(unsigned long));
+	unit->frames = zalloc(attr->code_length * sizeof(struct inline_frame *));
+
+	if (!unit->code || !unit->orig_pc || !unit->frames) {
+		free_inline_unit(unit);
+		return NULL;
+	}
+
+	memcpy(unit->code, attr->code, attr->code_length);
+
+	bytecode_for_each_insn(unit->code, unit->code_length, pc)
+		unit->orig_pc[pc] = pc;
+
+	return unit;
+}
+
+static bool is_inline_recursion(struct inline_unit *unit, struct vm_method *target)
+{
+	for (; unit != NULL; unit = unit->parent) {
+		if (unit->method == target)
+			return true;
+	}
+
+	return false;
+}
+
+static struct vm_method *
+inline_target(struct inline_unit *unit, unsigned long pc)
+{
+	const unsigned char *insn = &unit->code[pc];
+	struct vm_method *target;
+	struct vm_class *class;
+	char *name;
+	char *type;
+
+	switch (*insn) {
+	case OPC_INVOKESTATIC:
+	case OPC_INVOKESPECIAL:
+	case OPC_INVOKEVIRTUAL:
+		break;
+	default:
+		return NULL;
+	}
+
+	if (vm_class_resolve_method(unit->method->class, read_u16(insn + 1),
+				    &class, &name, &type)) {
+		/* Let the bytecode converter report the error. */
+		clear_exception();
+		return NULL;
+	}
+
+	target = NULL;
+
+	if (class == unit->method->class)
+		target = vm_class_get_method(class, name, type);
+
+	free(name);
+	free(type);
+
+	if (!target)
+		return NULL;
+
+	switch (*insn) {
+	case OPC_INVOKESTATIC:
+		if (!vm_method_is_static(target))
+			return NULL;
+		break;
+	case OPC_INVOKESPECIAL:
+		if (vm_method_is_static(target) || !vm_method_is_private(target))
+			return NULL;
+		break;
+	case OPC_INVOKEVIRTUAL:
+		if (vm_method_is_static(target))
+			return NULL;
+
+		if (!vm_method_is_private(target) && !vm_method_is_final(target)
+		    && !vm_class_is_final(class))
+			return NULL;
+		break;
+	default:
+		return NULL;
+	}
+
+	if (vm_method_is_constructor(target) || vm_method_is_native(target)
+	    || vm_method_is_abstract(target)
+	    || vm_method_is_synchronized(target))
+		return NULL;
+
+	if (target->code_attribute.code_length == 0
+	    || target->code_attribute.code_length > opt_inline_max_size
+	    || target->code_attribute.exception_table_length != 0)
+		return NULL;
+
+	if (is_inline_recursion(unit, target))
+		return NULL;
+
+	return target;
+}
+
+static bool can_inline_unit(struct inline_unit *unit)
+{
+	unsigned long pc;
+
+	if (unit->code_length > opt_inline_max_size)
+		return false;
+
+	bytecode_for_each_insn(unit->code, unit->code_length, pc) {
+		switch (unit->code[pc]) {
+		case OPC_INVOKEVIRTUAL:
+		case OPC_INVOKESPECIAL:
+		case OPC_INVOKESTATIC:
+		case OPC_INVOKEINTERFACE:
+		case OPC_TABLESWITCH:
+		case OPC_LOOKUPSWITCH:
+		case OPC_JSR:
+		case OPC_JSR_W:
+		case OPC_RET:
+			return false;
+		case OPC_WIDE:
+			if (unit->code[pc + 1] == OPC_RET)
+				return false;
+			break;
+		default:
+			break;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Returns an upper bound for the size of the code that replaces a call
+ * to @callee. Argument stores take at most 4 bytes each, the receiver
+ * null check 9 bytes and every instruction of the body grows by at most
+ * 3 bytes when local variable indices are widened or when a return is
+ * replaced with a goto.
+ */
+static unsigned long inlined_size_bound(struct inline_unit *callee)
+{
+	unsigned long nr_args;
+
+	nr_args = vm_method_arg_slots(callee->method) + 1;
+
+	return nr_args * 4 + 9 + callee->code_length * 4;
+}
+
+static void emit_insn_start(struct code_writer *w, unsigned long orig_pc,
+			    struct inline_frame *frame)
+{
+	w->orig_pc[w->pc] = orig_pc;
+	w->frames[w->pc] = frame;
+}
+
+static void emit_u8(struct code_writer *w, uint8_t value)
+{
+	w->code[w->pc++] = value;
+}
+
+static void emit_u16(struct code_writer *w, uint16_t value)
+{
+	write_u16(&w->code[w->pc], value);
+	w->pc += 2;
+}
+
+static void emit_bytes(struct code_writer *w, const unsigned char *p,
+		       unsigned long count)
+{
+	memcpy(&w->code[w->pc], p, count);
+	w->pc += count;
+}
+
+static void emit_local_insn(struct code_writer *w, unsigned char opc,
+			    unsigned long idx)
+{
+	if (idx > UINT8_MAX) {
+		emit_u8(w, OPC_WIDE);
+		emit_u8(w, opc);
+		emit_u16(w, idx);
+		return;
+	}
+
+	emit_u8(w, opc);
+	emit_u8(w, idx);
+}
+
+static void emit_iinc(struct code_writer *w, unsigned long idx, int value)
+{
+	if (idx > UINT8_MAX || value < INT8_MIN || value > INT8_MAX) {
+		emit_u8(w, OPC_WIDE);
+		emit_u8(w, OPC_IINC);
+		emit_u16(w, idx);
+		emit_u16(w, (uint16_t) value);
+		return;
+	}
+
+	emit_u8(w, OPC_IINC);
+	emit_u8(w, idx);
+	emit_u8(w, (uint8_t) value);
+}
+
+/*
+ * Returns the opcode of the general form of local variable instruction
+ * @opc. For example, OPC_ILOAD is returned for OPC_ILOAD_2.
+ */
+static unsigned char local_insn_opc(unsigned char opc)
+{
+	if (opc >= OPC_ILOAD_0 && opc <= OPC_ALOAD_3)
+		return OPC_ILOAD + (opc - OPC_ILOAD_0) / 4;
+
+	if (opc >= OPC_ISTORE_0 && opc <= OPC_ASTORE_3)
+		return OPC_ISTORE + (opc - OPC_ISTORE_0) / 4;
+
+	return opc;
+}
+
+static unsigned char store_insn_opc(enum vm_type type)
+{
+	switch (type) {
+	case J_REFERENCE:
+		return OPC_ASTORE;
+	case J_LONG:
+		return OPC_LSTORE;
+	case J_FLOAT:
+		return OPC_FSTORE;
+	case J_DOUBLE:
+		return OPC_DSTORE;
+	default:
+		return OPC_ISTORE;
+	}
+}
+
+static void set_branch_target(unsigned char *code, unsigned long pc,
+			      unsigned long target)
+{
+	bc_set_target_off(&code[pc], (long) target - (long) pc);
+}
+
+/*
+ * Returns the inlined frames of instruction @pc of @callee when it is
+ * inlined into a method whose call site has frames @caller.
+ */
+static struct inline_frame *
+inline_frame_chain(struct arena *arena, struct inline_unit *callee,
+		   unsigned long pc, struct inline_frame *caller)
+{
+	struct inline_frame *frame, *inner, *head;
+	struct inline_frame **link;
+
+	frame = arena_alloc(arena, sizeof *frame);
+	if (!frame)
+		return NULL;
+
+	frame->method		= callee->method;
+	frame->bc_offset	= callee->orig_pc[pc];
+	frame->caller		= caller;
+
+	/* Frames inlined into the callee are on top of it. */
+	link = &head;
+
+	for (inner = callee->frames[pc]; inner != NULL; inner = inner->caller) {
+		struct inline_frame *copy;
+
+		copy = arena_alloc(arena, sizeof *copy);
+		if (!copy)
+			return NULL;
+
+		copy->method	= inner->method;
+		copy->bc_offset	= inner->bc_offset;
+
+		*link = copy;
+		link = &copy->caller;
+	}
+
+	*link = frame;
+
+	return head;
+}
+
+/*
+ * Pops arguments of @callee from the operand stack into local variables
+ * starting at @base. The receiver is checked for null so that
+ * NullPointerException is thrown at the call site.
+ */
+static void emit_inlined_args(struct code_writer *w, struct vm_method *callee,
+			      unsigned long base, unsigned long orig_pc,
+			      struct inline_frame *frame)
+{
+	struct vm_method_arg *arg;
+	unsigned long slot;
+
+	slot = vm_method_arg_slots(callee);
+	if (!vm_method_is_static(callee))
+		slot++;
+
+	list_for_each_entry_reverse(arg, &callee->args, list_node) {
+		enum vm_type type = arg->type_info.vm_type;
+
+		slot -= vm_type_is_pair(type) ? 2 : 1;
+
+		emit_insn_start(w, orig_pc, frame);
+		emit_local_insn(w, store_insn_opc(type), base + slot);
+	}
+
+	if (vm_method_is_static(callee))
+		return;
+
+	emit_insn_start(w, orig_pc, frame);
+	emit_local_insn(w, OPC_ASTORE, base);
+
+	emit_insn_start(w, orig_pc, frame);
+	emit_local_insn(w, OPC_ALOAD, base);
+
+	emit_insn_start(w, orig_pc, frame);
+	emit_u8(w, OPC_IFNONNULL);
+	emit_u16(w, 5);
+
+	emit_insn_start(w, orig_pc, frame);
+	emit_u8(w, OPC_ACONST_NULL);
+
+	emit_insn_start(w, orig_pc, frame);
+	emit_u8(w, OPC_ATHROW);
+}
+
+static int emit_inlined_body(struct arena *arena, struct code_writer *w,
+			     struct inline_unit *callee, unsigned long base,
+			     unsigned long orig_pc, struct inline_frame *caller)
+{
+	unsigned long *returns;
+	unsigned long nr_returns;
+	unsigned long *map;
+	unsigned long pc;
+	int err = 0;
+
+	map = malloc((callee->code_length + 1) * sizeof(unsigned long));
+	returns = malloc(callee->code_length * sizeof(unsigned long));
+	if (!map || !returns) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	nr_returns = 0;
+
+	bytecode_for_each_insn(callee->code, callee->code_length, pc) {
+		const unsigned char *insn = &callee->code[pc];
+		unsigned long size = bc_insn_size(callee->code, pc);
+		struct inline_frame *frame;
+
+		map[pc] = w->pc;
+
+		/* The last return just falls through to the call site. */
+		if (bc_is_return(*insn) && pc + size == callee->code_length)
+			continue;
+
+		frame = inline_frame_chain(arena, callee, pc, caller);
+		if (!frame) {
+			err = -ENOMEM;
+			goto out;
+		}
+
+		emit_insn_start(w, orig_pc, frame);
+
+		if (bc_is_return(*insn)) {
+			returns[nr_returns++] = w->pc;
+			emit_u8(w, OPC_GOTO);
+			emit_u16(w, 0);
+		} else if (*insn == OPC_WIDE && insn[1] == OPC_IINC) {
+			emit_iinc(w, read_u16(insn + 2) + base, read_s16(insn + 4));
+		} else if (*insn == OPC_WIDE) {
+			emit_local_insn(w, insn[1], read_u16(insn + 2) + base);
+		} else if (*insn == OPC_IINC) {
+			emit_iinc(w, read_u8(insn + 1) + base, (int8_t) insn[2]);
+		} else if (bc_uses_local_var(*insn)) {
+			emit_local_insn(w, local_insn_opc(*insn),
+				get_local_var_index(callee->code, pc) + base);
+		} else {
+			emit_bytes(w, insn, size);
+		}
+	}
+
+	map[callee->code_length] = w->pc;
+
+	bytecode_for_each_insn(callee->code, callee->code_length, pc) {
+		const unsigned char *insn = &callee->code[pc];
+
+		if (!bc_is_branch(*insn))
+			continue;
+
+		set_branch_target(w->code, map[pc], map[pc + bc_target_off(insn)]);
+	}
+
+	for (unsigned long i = 0; i < nr_returns; i++)
+		set_branch_target(w->code, returns[i], w->pc);
+  out:
+	free(returns);
+	free(map);
+	return err;
+}
+
+static void emit_switch(struct code_writer *w, const unsigned char *code,
+			unsigned long pc)
+{
+	unsigned long size = bc_insn_size(code, pc);
+	int old_pad = get_tableswitch_padding(pc);
+	int new_pad = get_tableswitch_padding(w->pc);
+
+	/* The padding depends on the offset of the instruction. */
+	emit_u8(w, code[pc]);
+	memset(&w->code[w->pc], 0, new_pad);
+	w->pc += new_pad;
+	emit_bytes(w, &code[pc + 1 + old_pad], size - 1 - old_pad);
+}
+
+static void relocate_switch(unsigned char *new_code, const unsigned char *code,
+			    unsigned long pc, unsigned long *map)
+{
+	unsigned long new_pc = map[pc];
+	const unsigned char *src;
+	unsigned char *dest;
+	int32_t count;
+
+	src = &code[pc + 1 + get_tableswitch_padding(pc)];
+	dest = &new_code[new_pc + 1 + get_tableswitch_padding(new_pc)];
+
+	/* default target */
+	write_s32(dest, map[pc + read_s32(src)] - new_pc);
+
+	if (code[pc] == OPC_TABLESWITCH) {
+		count = read_s32(src + 8) - read_s32(src + 4) + 1;
+		src += 12;
+		dest += 12;
+
+		for (int32_t i = 0; i < count; i++, src += 4, dest += 4)
+			write_s32(dest, map[pc + read_s32(src)] - new_pc);
+	} else {
+		count = read_s32(src + 4);
+		src += 8;
+		dest += 8;
+
+		for (int32_t i = 0; i < count; i++, src += 8, dest += 8)
+			write_s32(dest + 4, map[pc + read_s32(src + 4)] - new_pc);
+	}
+}
+
+static int find_inline_sites(struct arena *arena, struct inline_unit *unit,
+			     unsigned long depth, struct inline_site *sites,
+			     unsigned long *nr_sites, unsigned long *new_size);
+
+static int inline_calls(struct arena *arena, struct inline_unit *unit,
+			unsigned long depth, unsigned long **map_p)
+{
+	struct inline_site *sites;
+	struct code_writer w = { };
+	unsigned long nr_sites;
+	unsigned long max_stack;
+	unsigned long new_size;
+	unsigned long *map;
+	unsigned long base;
+	unsigned long pc;
+	unsigned long i;
+	int err;
+
+	if (map_p)
+		*map_p = NULL;
+
+	if (depth >= opt_inline_max_level)
+		return 0;
+
+	sites = malloc(unit->code_length * sizeof *sites);
+	if (!sites)
+		return -ENOMEM;
+
+	map = NULL;
+	nr_sites = 0;
+
+	err = find_inline_sites(arena, unit, depth, sites, &nr_sites, &new_size);
+	if (err || !nr_sites)
+		goto out;
+
+	w.code = malloc(new_size);
+	w.orig_pc = zalloc(new_size * sizeof(unsigned long));
+	w.frames = zalloc(new_size * sizeof(struct inline_frame *));
+	map = malloc((unit->code_length + 1) * sizeof(unsigned long));
+	if (!w.code || !w.orig_pc || !w.frames || !map) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	base = unit->max_locals;
+	max_stack = unit->max_stack;
+	i = 0;
+
+	bytecode_for_each_insn(unit->code, unit->code_length, pc) {
+		struct inline_frame *frame = unit->frames[pc];
+		unsigned long orig_pc = unit->orig_pc[pc];
+		unsigned char opc = unit->code[pc];
+
+		map[pc] = w.pc;
+
+		if (i < nr_sites && sites[i].pc == pc) {
+			struct inline_unit *callee = sites[i++].callee;
+
+			emit_inlined_args(&w, callee->method, base, orig_pc, frame);
+
+			err = emit_inlined_body(arena, &w, callee, base, orig_pc, frame);
+			if (err)
+				goto out;
+
+			base += callee->max_locals;
+
+			if (unit->max_stack + callee->max_stack > max_stack)
+				max_stack = unit->max_stack + callee->max_stack;
+			continue;
+		}
+
+		emit_insn_start(&w, orig_pc, frame);
+
+		if (opc == OPC_TABLESWITCH || opc == OPC_LOOKUPSWITCH)
+			emit_switch(&w, unit->code, pc);
+		else
+			emit_bytes(&w, &unit->code[pc], bc_insn_size(unit->code, pc));
+	}
+
+	map[unit->code_length] = w.pc;
+
+	bytecode_for_each_insn(unit->code, unit->code_length, pc) {
+		const unsigned char *insn = &unit->code[pc];
+
+		if (*insn == OPC_TABLESWITCH || *insn == OPC_LOOKUPSWITCH) {
+			relocate_switch(w.code, unit->code, pc, map);
+			continue;
+		}
+
+		if (!bc_is_branch(*insn))
+			continue;
+
+		set_branch_target(w.code, map[pc], map[pc + bc_target_off(insn)]);
+	}
+
+	free(unit->code);
+	free(unit->orig_pc);
+	free(unit->frames);
+
+	unit->code		= w.code;
+	unit->orig_pc		= w.orig_pc;
+	unit->frames		= w.frames;
+	unit->code_length	= w.pc;
+	unit->max_locals	= base;
+	unit->max_stack		= max_stack;
+
+	w.code = NULL;
+	w.orig_pc = NULL;
+	w.frames = NULL;
+
+	if (map_p) {
+		*map_p = map;
+		map = NULL;
+	}
+  out:
+	for (i = 0; i < nr_sites; i++)
+		free_inline_unit(sites[i].callee);
+
+	free(w.code);
+	free(w.orig_pc);
+	free(w.frames);
+	free(sites);
+	free(map);
+	return err;
+}
+
+/*
+ * Finds the call sites of @unit which can be inlined. The callees have
+ * their own calls inlined first. @new_size is set to an upper bound of
+ * the size of the code after inlining.
+ */
+static int find_inline_sites(struct arena *arena, struct inline_unit *unit,
+			     unsigned long depth, struct inline_site *sites,
+			     unsigned long *nr_sites, unsigned long *new_size)
+{
+	unsigned long pc;
+	int err;
+
+	*new_size = unit->code_length;
+
+	bytecode_for_each_insn(unit->code, unit->code_length, pc) {
+		struct inline_unit *callee;
+		struct vm_method *target;
+		unsigned long size;
+
+		if (unit->code[pc] == OPC_TABLESWITCH ||
+		    unit->code[pc] == OPC_LOOKUPSWITCH) {
+			*new_size += 3;
+			continue;
+		}
+
+		target = inline_target(unit, pc);
+		if (!target)
+			continue;
+
+		callee = inline_unit_from_method(target, unit);
+		if (!callee)
+			return -ENOMEM;
+
+		err = inline_calls(arena, callee, depth + 1, NULL);
+		if (err) {
+			free_inline_unit(callee);
+			return err;
+		}
+
+		size = inlined_size_bound(callee);
+
+		if (!can_inline_unit(callee) ||
+		    *new_size + size > INLINE_MAX_CODE_LENGTH) {
+			free_inline_unit(callee);
+			continue;
+		}
+
+		sites[*nr_sites].pc	= pc;
+		sites[*nr_sites].callee	= callee;
+		(*nr_sites)++;
+
+		*new_size += size;
+	}
+
+	return 0;
+}
+
+/*
+ * Allocates @size bytes from @arena so that the next allocation is word
+ * aligned.
+ */
+static void *inline_arena_alloc(struct arena *arena, size_t size)
+{
+	return arena_alloc(arena, ALIGN(size, sizeof(long)));
+}
+
+static struct cafebabe_code_attribute_exception *
+relocate_exception_table(struct arena *arena, struct vm_method *method,
+			 unsigned long *map)
+{
+	struct cafebabe_code_attribute_exception *table;
+	unsigned long length;
+
+	length = method->code_attribute.exception_table_length;
+
+	table = inline_arena_alloc(arena, length * sizeof *table);
+	if (!table)
+		return NULL;
+
+	for (unsigned long i = 0; i < length; i++) {
+		table[i] = method->code_attribute.exception_table[i];
+
+		table[i].start_pc	= map[table[i].start_pc];
+		table[i].end_pc		= map[table[i].end_pc];
+		table[i].handler_pc	= map[table[i].handler_pc];
+	}
+
+	return table;
+}
+
+/*
+ * Inlined code has no entries in the line number table so it gets the
+ * line number of the call site.
+ */
+static struct cafebabe_line_number_table_entry *
+relocate_line_number_table(struct arena *arena, struct vm_method *method,
+			   unsigned long *map)
+{
+	struct cafebabe_line_number_table_entry *table;
+	unsigned long length;
+
+	length = method->line_number_table_attribute.line_number_table_length;
+
+	table = inline_arena_alloc(arena, length * sizeof *table);
+	if (!table)
+		return NULL;
+
+	for (unsigned long i = 0; i < length; i++) {
+		table[i] = method->line_number_table_attribute.line_number_table[i];
+
+		table[i].start_pc = map[table[i].start_pc];
+	}
+
+	return table;
+}
+
+struct inline_frame *cu_inline_frame(struct compilation_unit *cu, unsigned long bc_offset)
+{
+	if (!cu || !cu->inline_frames || bc_offset >= cu->nr_inline_frames)
+		return NULL;
+
+	return cu->inline_frames[bc_offset];
+}
+
+void free_inline_frames(struct compilation_unit *cu)
+{
+	free(cu->inline_frames);
+	free(cu->inline_pc_map);
+
+	if (cu->inline_arena)
+		arena_delete(cu->inline_arena);
+
+	cu->inline_frames = NULL;
+	cu->inline_pc_map = NULL;
+	cu->inline_arena = NULL;
+}
+
+/**
+ * The inlined code is a copy that is owned by @cu; the attributes of its
+ * method are not changed. Changes to @cu are made only when the function
+ * returns successfully.
+ */
+int inline_methods(struct compilation_unit *cu)
+{
+	struct cafebabe_line_number_table_attribute *line_number_table_attr;
+	struct cafebabe_code_attribute *code_attr;
+	struct vm_method *method = cu->method;
+	struct inline_unit *unit;
+	struct arena *arena;
+	unsigned long *map;
+	int err;
+
+	if (!opt_inline_max_level)
+		return 0;
+
+	/*
+	 * The method was already inlined into when its earlier code was
+	 * compiled. Inlining again would move the bytecode offsets that
+	 * deoptimization of frames running the earlier code relies on.
+	 * The inlined code has more locals than the method.
+	 */
+	if (cu->inline_frames)
+		return stack_frame_grow_locals(cu->stack_frame, cu->code_attribute->max_locals);
+
+	if (method->code_attribute.code_length > INLINE_MAX_CODE_LENGTH)
+		return 0;
+
+	/*
+	 * Frames recorded by an earlier compilation attempt are still
+	 * referenced so we keep allocating from the same arena.
+	 */
+	arena = cu->inline_arena;
+	if (!arena) {
+		arena = arena_new();
+		if (!arena)
+			return warn("out of memory"), -ENOMEM;
+	}
+
+	unit = inline_unit_from_method(method, NULL);
+	if (!unit) {
+		err = -ENOMEM;
+		goto out_free_arena;
+	}
+
+	err = inline_calls(arena, unit, 0, &map);
+	if (err || !map)
+		goto out_free_unit;
+
+	if (opt_trace_bytecode) {
+		trace_printf("Code before method inlining:\n");
+		trace_bytecode(method);
+	}
+
+	err = stack_frame_grow_locals(cu->stack_frame, unit->max_locals);
+	if (err)
+		goto out_free_map;
+
+	err = -ENOMEM;
+
+	code_attr = inline_arena_alloc(arena, sizeof *code_attr);
+	line_number_table_attr = inline_arena_alloc(arena, sizeof *line_number_table_attr);
+	if (!code_attr || !line_number_table_attr)
+		goto out_free_map;
+
+	*code_attr		= method->code_attribute;
+	*line_number_table_attr	= method->line_number_table_attribute;
+
+	code_attr->code = inline_arena_alloc(arena, unit->code_length);
+	if (!code_attr->code)
+		goto out_free_map;
+
+	memcpy(code_attr->code, unit->code, unit->code_length);
+
+	code_attr->code_length	= unit->code_length;
+	code_attr->max_locals	= unit->max_locals;
+	code_attr->max_stack	= unit->max_stack;
+
+	if (code_attr->exception_table_length) {
+		code_attr->exception_table = relocate_exception_table(arena, method, map);
+		if (!code_attr->exception_table)
+			goto out_free_map;
+	}
+
+	if (line_number_table_attr->line_number_table_length) {
+		line_number_table_attr->line_number_table =
+			relocate_line_number_table(arena, method, map);
+		if (!line_number_table_attr->line_number_table)
+			goto out_free_map;
+	}
+
+	err = 0;
+
+	cu->code_attribute		= code_attr;
+	cu->line_number_table_attribute	= line_number_table_attr;
+
+	cu->inline_orig_code	= method->code_attribute.code;
+	cu->inline_pc_map	= map;
+
+	free(cu->inline_frames);
+
+	cu->inline_frames	= unit->frames;
+	cu->nr_inline_frames	= unit->code_length;
+	cu->inline_arena	= arena;
+
+	unit->frames = NULL;
+	map = NULL;
+  out_free_map:
+	free(map);
+  out_free_unit:
+	free_inline_unit(unit);
+  out_free_arena:
+	if (arena != cu->inline_arena)
+		arena_delete(arena);
+
+	if (err == -ENOMEM)
+		warn("out of memory");
+
+	return err;
+}
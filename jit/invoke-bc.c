@@ -9,6 +9,7 @@
 #include "jit/bytecode-to-ir.h"
 
 #include "jit/exception.h"
+#include "jit/cha.h"
 #include "jit/statement.h"
 #include "jit/compiler.h"
 #include "jit/args.h"
@@ -196,6 +197,8 @@ static int insert_before_args_stmt(struct parse_context *ctx, struct vm_method *
 
 static void insert_invoke_stmt(struct parse_context *ctx, struct statement *stmt)
 {
+	stmt->deopt_point = stack_is_empty(ctx->bb->mimic_stack);
+
 	convert_statement(ctx, stmt);
 
 	if (stmt->invoke_result) {
@@ -252,9 +255,44 @@ static void null_check_this_arg(struct expression *arg)
 	null_check_this_arg(to_expr(arg->args_left));
 }
 
+/*
+ * Converts a call that always goes to @invoke_target and needs no dispatch
+ * on the receiver. @cha_method is the method that class hierarchy analysis
+ * devirtualized the call from or NULL.
+ */
+static int convert_direct_invoke(struct parse_context *ctx, struct vm_method *invoke_target,
+				 struct vm_method *cha_method)
+{
+	struct statement *stmt;
+	int err;
+
+	stmt = invoke_stmt(ctx, STMT_INVOKE, invoke_target);
+	if (!stmt)
+		return warn("out of memory"), -ENOMEM;
+
+	stmt->cha_method = cha_method;
+
+	err = convert_and_add_args(ctx, invoke_target, stmt);
+	if (err)
+		goto failed;
+
+	null_check_this_arg(to_expr(stmt->args_list));
+
+	err = insert_before_args_stmt(ctx, invoke_target);
+	if (err)
+		goto failed;
+
+	insert_invoke_stmt(ctx, stmt);
+	return 0;
+      failed:
+	free_statement(stmt);
+	return err;
+}
+
 int convert_invokeinterface(struct parse_context *ctx)
 {
 	struct vm_method *invoke_target;
+	struct vm_method *cha_target;
 	struct statement *stmt;
 	int count;
 	int zero;
@@ -264,10 +302,6 @@ int convert_invokeinterface(struct parse_context *ctx)
 	if (!invoke_target)
 		return warn("unable to resolve invocation target"), -EINVAL;
 
-	stmt = invoke_stmt(ctx, STMT_INVOKEINTERFACE, invoke_target);
-	if (!stmt)
-		return warn("out of memory"), -ENOMEM;
-
 	count = bytecode_read_u8(ctx->buffer);
 	if (count == 0)
 		return warn("invokeinterface count must not be zero"), -EINVAL;
@@ -278,6 +312,14 @@ int convert_invokeinterface(struct parse_context *ctx)
 			-EINVAL;
 	}
 
+	cha_target = cha_unique_interface_target(ctx->cu, invoke_target);
+	if (cha_target)
+		return convert_direct_invoke(ctx, cha_target, invoke_target);
+
+	stmt = invoke_stmt(ctx, STMT_INVOKEINTERFACE, invoke_target);
+	if (!stmt)
+		return warn("out of memory"), -ENOMEM;
+
 	err = convert_and_add_args(ctx, invoke_target, stmt);
 	if (err)
 		goto failed;
@@ -297,6 +339,7 @@ failed:
 int convert_invokevirtual(struct parse_context *ctx)
 {
 	struct vm_method *invoke_target;
+	struct vm_method *cha_target;
 	struct statement *stmt;
 	int err = -ENOMEM;
 
@@ -304,6 +347,10 @@ int convert_invokevirtual(struct parse_context *ctx)
 	if (!invoke_target)
 		return warn("unable to resolve invocation target"), -EINVAL;
 
+	cha_target = cha_unique_target(ctx->cu, invoke_target);
+	if (cha_target)
+		return convert_direct_invoke(ctx, cha_target, invoke_target);
+
 	stmt = invoke_stmt(ctx, STMT_INVOKEVIRTUAL, invoke_target);
 	if (!stmt)
 		return warn("out of memory"), -ENOMEM;
@@ -326,32 +373,12 @@ int convert_invokevirtual(struct parse_context *ctx)
 int convert_invokespecial(struct parse_context *ctx)
 {
 	struct vm_method *invoke_target;
-	struct statement *stmt;
-	int err;
 
 	invoke_target = resolve_invoke_target(ctx, CAFEBABE_CLASS_ACC_STATIC);
 	if (!invoke_target)
 		return warn("unable to resolve invocation target"), -EINVAL;
 
-	stmt = invoke_stmt(ctx, STMT_INVOKE, invoke_target);
-	if (!stmt)
-		return warn("out of memory"), -ENOMEM;
-
-	err = convert_and_add_args(ctx, invoke_target, stmt);
-	if (err)
-		goto failed;
-
-	null_check_this_arg(to_expr(stmt->args_list));
-
-	err = insert_before_args_stmt(ctx, invoke_target);
-	if (err)
-		goto failed;
-
-	insert_invoke_stmt(ctx, stmt);
-	return 0;
-      failed:
-	free_statement(stmt);
-	return err;
+	return convert_direct_invoke(ctx, invoke_target, NULL);
 }
 
 int convert_invokestatic(struct parse_context *ctx)
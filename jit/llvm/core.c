@@ -11,6 +11,7 @@
 #include "vm/classloader.h"
 #include "jit/compiler.h"	/* for bytecode tracing */
 #include "jit/emulate.h"
+#include "lib/hash-map.h"
 #include "lib/stack.h"
 #include "vm/method.h"
 #include "vm/class.h"
@@ -21,6 +22,7 @@
 #include <llvm-c/Core.h>
 
 #include <assert.h>
+#include <errno.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <ctype.h>
@@ -47,6 +49,21 @@ struct llvm_context {
 	 * compilation.
 	 */
 	struct stack			*mimic_stack;
+
+	/*
+	 * The basic block failing array bounds checks branch to and its
+	 * PHI nodes for the array reference and the index:
+	 */
+	LLVMBasicBlockRef		array_check_bb;
+	LLVMValueRef			array_check_arrayref;
+	LLVMValueRef			array_check_index;
+
+	/*
+	 * Maps a basic block to the LLVM basic block its code ends in.
+	 * Array bounds checks split basic blocks so this is not always
+	 * the same as ->priv.
+	 */
+	struct hash_map			*bb_tails;
 };
 
 /*
@@ -55,15 +72,15 @@ struct llvm_context {
 static LLVMExecutionEngineRef	engine;
 static LLVMModuleRef		module;
 
-static void llvm_array_check(struct vm_object *arrayref, jint index)
+static void llvm_array_check_failed(struct vm_object *arrayref, jint index)
 {
 	struct vm_class *vmc = arrayref->class;
 
 	assert(vm_class_is_array_class(vmc));
 
-	assert(index >= 0);
+	assert(index < 0 || index >= vm_array_length(arrayref));
 
-	assert(index < vm_array_length(arrayref));
+	assert(0);
 }
 
 static void llvm_array_store_check(struct vm_object *arrayref,
@@ -120,7 +137,7 @@ static LLVM_DECLARE_BUILTIN(emulate_dcmpl);
 static LLVM_DECLARE_BUILTIN(emulate_fcmpg);
 static LLVM_DECLARE_BUILTIN(emulate_fcmpl);
 static LLVM_DECLARE_BUILTIN(emulate_lcmp);
-static LLVM_DECLARE_BUILTIN(llvm_array_check);
+static LLVM_DECLARE_BUILTIN(llvm_array_check_failed);
 static LLVM_DECLARE_BUILTIN(llvm_array_store_check);
 static LLVM_DECLARE_BUILTIN(llvm_throw_stub);
 
@@ -507,6 +524,80 @@ static LLVMValueRef llvm_build_array_load(struct llvm_context *ctx, LLVMValueRef
 	return LLVMBuildLoad(ctx->builder, addr, "");
 }
 
+static LLVMValueRef llvm_build_array_length(struct llvm_context *ctx, LLVMValueRef arrayref)
+{
+	LLVMValueRef gep, addr;
+	LLVMValueRef indices[1];
+
+	indices[0] = LLVMConstInt(LLVMInt32Type(), offsetof(struct vm_array, array_length), 0);
+
+	gep 	= LLVMBuildGEP(ctx->builder, arrayref, indices, 1, "");
+
+	addr	= LLVMBuildBitCast(ctx->builder, gep, LLVMPointerType(LLVMInt32Type(), 0), "");
+
+	return LLVMBuildLoad(ctx->builder, addr, "");
+}
+
+/*
+ * All failing array bounds checks of a method branch to one basic block
+ * that calls llvm_array_check_failed(). The array reference and the
+ * index are passed to it through PHI nodes.
+ */
+static LLVMBasicBlockRef llvm_array_check_bb(struct llvm_context *ctx)
+{
+	LLVMBasicBlockRef current_bbr;
+	LLVMValueRef args[2];
+
+	if (ctx->array_check_bb)
+		return ctx->array_check_bb;
+
+	current_bbr = LLVMGetInsertBlock(ctx->builder);
+
+	ctx->array_check_bb = LLVMAppendBasicBlock(ctx->func, "array_check");
+
+	LLVMPositionBuilderAtEnd(ctx->builder, ctx->array_check_bb);
+
+	ctx->array_check_arrayref	= LLVMBuildPhi(ctx->builder, LLVMReferenceType(), "");
+	ctx->array_check_index		= LLVMBuildPhi(ctx->builder, LLVMInt32Type(), "");
+
+	args[0]		= ctx->array_check_arrayref;
+	args[1]		= ctx->array_check_index;
+
+	LLVMBuildCall(ctx->builder, LLVM_BUILTIN(llvm_array_check_failed), args, 2, "");
+
+	LLVMBuildUnreachable(ctx->builder);
+
+	LLVMPositionBuilderAtEnd(ctx->builder, current_bbr);
+
+	return ctx->array_check_bb;
+}
+
+static void llvm_build_array_check(struct llvm_context *ctx, LLVMValueRef arrayref, LLVMValueRef index)
+{
+	LLVMBasicBlockRef check_bbr, current_bbr, next_bbr;
+	LLVMValueRef length, cmp;
+
+	check_bbr	= llvm_array_check_bb(ctx);
+
+	length		= llvm_build_array_length(ctx, arrayref);
+
+	/*
+	 * Unsigned comparison catches negative indices too.
+	 */
+	cmp		= LLVMBuildICmp(ctx->builder, LLVMIntUGE, index, length, "");
+
+	next_bbr	= LLVMAppendBasicBlock(ctx->func, "");
+
+	LLVMBuildCondBr(ctx->builder, cmp, check_bbr, next_bbr);
+
+	current_bbr	= LLVMGetInsertBlock(ctx->builder);
+
+	LLVMAddIncoming(ctx->array_check_arrayref, &arrayref, &current_bbr, 1);
+	LLVMAddIncoming(ctx->array_check_index, &index, &current_bbr, 1);
+
+	LLVMPositionBuilderAtEnd(ctx->builder, next_bbr);
+}
+
 static void llvm_build_monitorexit(struct llvm_context *ctx, LLVMValueRef objectref)
 {
 	struct vm_method *vmm;
@@ -994,15 +1085,11 @@ restart:
 	}
 	case OPC_AALOAD: {
 		LLVMValueRef arrayref, index, value;
-		LLVMValueRef args[2];
 
 		index		= stack_pop(ctx->mimic_stack);
 		arrayref	= stack_pop(ctx->mimic_stack);
 
-		args[0]		= arrayref;
-		args[1]		= index;
-
-		LLVMBuildCall(ctx->builder, LLVM_BUILTIN(llvm_array_check), args, 2, "");
+		llvm_build_array_check(ctx, arrayref, index);
 
 		value = llvm_build_array_load(ctx, arrayref, index, llvm_type(J_REFERENCE));
 
@@ -1012,15 +1099,11 @@ restart:
 	}
 	case OPC_BALOAD: {
 		LLVMValueRef arrayref, index, value;
-		LLVMValueRef args[2];
 
 		index		= stack_pop(ctx->mimic_stack);
 		arrayref	= stack_pop(ctx->mimic_stack);
 
-		args[0]		= arrayref;
-		args[1]		= index;
-
-		LLVMBuildCall(ctx->builder, LLVM_BUILTIN(llvm_array_check), args, 2, "");
+		llvm_build_array_check(ctx, arrayref, index);
 
 		value = llvm_build_array_load(ctx, arrayref, index, llvm_type(J_BYTE));
 
@@ -1030,15 +1113,11 @@ restart:
 	}
 	case OPC_CALOAD: {
 		LLVMValueRef arrayref, index, value;
-		LLVMValueRef args[2];
 
 		index		= stack_pop(ctx->mimic_stack);
 		arrayref	= stack_pop(ctx->mimic_stack);
 
-		args[0]		= arrayref;
-		args[1]		= index;
-
-		LLVMBuildCall(ctx->builder, LLVM_BUILTIN(llvm_array_check), args, 2, "");
+		llvm_build_array_check(ctx, arrayref, index);
 
 		value = llvm_build_array_load(ctx, arrayref, index, llvm_type(J_CHAR));
 
@@ -1048,15 +1127,11 @@ restart:
 	}
 	case OPC_SALOAD: {
 		LLVMValueRef arrayref, index, value;
-		LLVMValueRef args[2];
 
 		index		= stack_pop(ctx->mimic_stack);
 		arrayref	= stack_pop(ctx->mimic_stack);
 
-		args[0]		= arrayref;
-		args[1]		= index;
-
-		LLVMBuildCall(ctx->builder, LLVM_BUILTIN(llvm_array_check), args, 2, "");
+		llvm_build_array_check(ctx, arrayref, index);
 
 		value = llvm_build_array_load(ctx, arrayref, index, llvm_type(J_SHORT));
 
@@ -1224,16 +1299,12 @@ restart:
 		LLVMValueRef arrayref, index, value;
 		LLVMValueRef gep, elems, addr;
 		LLVMValueRef indices[1];
-		LLVMValueRef args[2];
 
 		value		= stack_pop(ctx->mimic_stack);
 		index		= stack_pop(ctx->mimic_stack);
 		arrayref	= stack_pop(ctx->mimic_stack);
 
-		args[0]		= arrayref;
-		args[1]		= index;
-
-		LLVMBuildCall(ctx->builder, LLVM_BUILTIN(llvm_array_check), args, 2, "");
+		llvm_build_array_check(ctx, arrayref, index);
 
 		indices[0] = LLVMConstInt(LLVMInt32Type(), VM_ARRAY_ELEMS_OFFSET, 0);
 
@@ -2484,18 +2555,11 @@ restart:
 		break;
 	}
 	case OPC_ARRAYLENGTH: {
-		LLVMValueRef arrayref, length, addr, gep;
-		LLVMValueRef indices[1];
+		LLVMValueRef arrayref, length;
 
 		arrayref = stack_pop(ctx->mimic_stack);
 
-		indices[0] = LLVMConstInt(LLVMInt32Type(), offsetof(struct vm_array, array_length), 0);
-
-		gep 	= LLVMBuildGEP(ctx->builder, arrayref, indices, 1, "");
-
-		addr	= LLVMBuildBitCast(ctx->builder, gep, LLVMPointerType(LLVMInt32Type(), 0), "");
-
-		length	= LLVMBuildLoad(ctx->builder, addr, "");
+		length	= llvm_build_array_length(ctx, arrayref);
 
 		stack_push(ctx->mimic_stack, length);
 
@@ -2645,6 +2709,16 @@ static LLVMValueRef llvm_bc2ir_build_phi(struct llvm_context *ctx, struct basic_
 	return LLVMBuildPhi(ctx->builder, LLVMTypeOf(value), "");
 }
 
+static LLVMBasicBlockRef llvm_bb_tail(struct llvm_context *ctx, struct basic_block *bb)
+{
+	void *bbr;
+
+	if (hash_map_get(ctx->bb_tails, bb, &bbr))
+		return bb->priv;
+
+	return bbr;
+}
+
 static int llvm_bc2ir_bb(struct llvm_context *ctx, struct basic_block *bb)
 {
 	struct vm_method *vmm = ctx->cu->method;
@@ -2666,6 +2740,9 @@ static int llvm_bc2ir_bb(struct llvm_context *ctx, struct basic_block *bb)
 	while (pos < bb->end)
 		llvm_bc2ir_insn(ctx, code, &pos);
 
+	if (hash_map_put(ctx->bb_tails, bb, LLVMGetInsertBlock(ctx->builder)))
+		return -ENOMEM;
+
 	/*
 	 * Build PHI nodes.
 	 */
@@ -2769,7 +2846,7 @@ static int llvm_bc2ir(struct llvm_context *ctx)
 		if (bb->is_converted)
 			continue;
 
-		LLVMPositionBuilderAtEnd(ctx->builder, prev->priv);
+		LLVMPositionBuilderAtEnd(ctx->builder, llvm_bb_tail(ctx, prev));
 
 		if (!prev->has_branch && !prev->has_return && !prev->has_athrow)
 			LLVMBuildBr(ctx->builder, bbr);
@@ -2814,7 +2891,7 @@ static int llvm_bc2ir(struct llvm_context *ctx)
 				value = pred->mimic_stack->elements[stack_depth - 1];
 
 				incoming_values[i] = value;
-				incoming_blocks[i] = pred->priv;
+				incoming_blocks[i] = llvm_bb_tail(ctx, pred);
 			}
 
 			LLVMAddIncoming(phi, incoming_values, incoming_blocks, bb->nr_predecessors);
@@ -2852,6 +2929,10 @@ static int llvm_codegen(struct compilation_unit *cu)
 	if (!ctx.locals)
 		return -1;
 
+	ctx.bb_tails = alloc_hash_map(&pointer_key);
+	if (!ctx.bb_tails)
+		return -1;
+
 	ctx.func = llvm_function(&ctx);
 	if (!ctx.func)
 		return -1;
@@ -2871,6 +2952,7 @@ static int llvm_codegen(struct compilation_unit *cu)
 		trace_flush();
 	}
 
+	free_hash_map(ctx.bb_tails);
 	free(ctx.locals);
 
 	return 0;
@@ -2945,7 +3027,7 @@ static void llvm_setup_builtins(void)
 	LLVM_DEFINE_BUILTIN(emulate_fcmpg, J_INT, 2, J_FLOAT, J_FLOAT);
 	LLVM_DEFINE_BUILTIN(emulate_fcmpl, J_INT, 2, J_FLOAT, J_FLOAT);
 	LLVM_DEFINE_BUILTIN(emulate_lcmp, J_INT, 2, J_LONG, J_LONG);
-	LLVM_DEFINE_BUILTIN(llvm_array_check, J_VOID, 2, J_REFERENCE, J_INT);
+	LLVM_DEFINE_BUILTIN(llvm_array_check_failed, J_VOID, 2, J_REFERENCE, J_INT);
 	LLVM_DEFINE_BUILTIN(llvm_array_store_check, J_VOID, 3, J_REFERENCE, J_INT, J_REFERENCE);
 	LLVM_DEFINE_BUILTIN(llvm_throw_stub, J_VOID, 1, J_REFERENCE);
 }
@@ -0,0 +1,433 @@
+/*
+ * Lock elision and coarsening
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ *
+ * Removes monitorenter and monitorexit statements from the tree IR whose
+ * effect can be proven redundant. Locking objects that do not escape the
+ * method is removed by escape_analysis() already.
+ *
+ * The object of a monitor statement is only known if it is read from a
+ * parameter, or "this", that is never assigned or from a local variable
+ * that is only assigned copies of one such parameter. javac copies the
+ * object of a synchronized statement to a local variable which the
+ * monitorexit reads. Loads of local variables are converted to stores to
+ * temporaries, so a temporary that is assigned once is followed to the
+ * value it was assigned.
+ *
+ * A synchronized instance method holds the lock of "this" until it
+ * returns so locking "this" again in the method is removed. A monitorexit
+ * that is followed by a monitorenter of the same object with only copies
+ * between local variables in between, on a path that nothing else joins,
+ * is removed together with the monitorenter. The exception handlers that
+ * javac emits for both synchronized statements still release the lock
+ * once. The lock of a synchronized method is released by the exit and
+ * unwind blocks as before and is never touched here.
+ *
+ * The interpreter would run the removed statements, so code with elided
+ * locks gets no deopt sites or OSR entries.
+ */
+
+#include "jit/compilation-unit.h"
+#include "jit/basic-block.h"
+#include "jit/expression.h"
+#include "jit/statement.h"
+#include "jit/compiler.h"
+#include "jit/vars.h"
+
+#include "vm/method.h"
+#include "vm/class.h"
+#include "vm/trace.h"
+
+#include <stdlib.h>
+#include <errno.h>
+
+bool opt_eliminate_locks = true;
+bool opt_trace_locks;
+
+#define LOCK_ROOT_NONE		(-1L)
+#define LOCK_ROOT_UNKNOWN	(-2L)
+
+struct lock_state {
+	struct compilation_unit	*cu;
+	unsigned long		nr_locals;
+	unsigned long		nr_args;
+
+	unsigned long		nr_vregs;
+
+	bool			*assigned;
+
+	/* The parameter that every assignment of a local variable copies. */
+	long			*roots;
+
+	/*
+	 * Number of assignments of a temporary, saturated at 2, and the
+	 * value it was last assigned.
+	 */
+	unsigned char		*vreg_defs;
+	struct expression	**vreg_srcs;
+};
+
+static bool local_index(struct lock_state *state, struct expression *expr,
+			unsigned long *idx)
+{
+	switch (expr_type(expr)) {
+	case EXPR_LOCAL:
+	case EXPR_FLOAT_LOCAL:
+		break;
+	default:
+		return false;
+	}
+
+	if (expr->local_index >= state->nr_locals)
+		return false;
+
+	*idx = expr->local_index;
+	return true;
+}
+
+static bool is_immutable_arg(struct lock_state *state, unsigned long idx)
+{
+	return idx < state->nr_args && !state->assigned[idx];
+}
+
+static void count_vreg_def(struct lock_state *state, struct expression *dest,
+			   struct expression *src)
+{
+	unsigned long vreg;
+
+	if (expr_type(dest) != EXPR_TEMPORARY)
+		return;
+
+	vreg = dest->tmp_low->vreg;
+	if (vreg >= state->nr_vregs)
+		return;
+
+	if (state->vreg_defs[vreg] < 2)
+		state->vreg_defs[vreg]++;
+
+	state->vreg_srcs[vreg] = src;
+}
+
+static void mark_multi_def(struct lock_state *state, struct expression *expr)
+{
+	if (expr_type(expr) == EXPR_TEMPORARY && expr->tmp_low->vreg < state->nr_vregs)
+		state->vreg_defs[expr->tmp_low->vreg] = 2;
+}
+
+/*
+ * Returns the value that @expr was assigned if it is a temporary that is
+ * assigned once by a store, otherwise @expr itself.
+ */
+static struct expression *resolve_temporary(struct lock_state *state,
+					    struct expression *expr)
+{
+	for (unsigned long i = 0; i < state->nr_vregs; i++) {
+		unsigned long vreg;
+
+		if (expr_type(expr) != EXPR_TEMPORARY)
+			break;
+
+		vreg = expr->tmp_low->vreg;
+		if (vreg >= state->nr_vregs || state->vreg_defs[vreg] != 1
+		    || !state->vreg_srcs[vreg])
+			break;
+
+		expr = state->vreg_srcs[vreg];
+	}
+
+	return expr;
+}
+
+static void mark_assigned(struct lock_state *state, struct expression *dest)
+{
+	unsigned long idx;
+
+	if (!local_index(state, dest, &idx))
+		return;
+
+	state->assigned[idx] = true;
+
+	if (vm_type_is_pair(dest->vm_type) && idx + 1 < state->nr_locals)
+		state->assigned[idx + 1] = true;
+}
+
+static void merge_root(struct lock_state *state, unsigned long idx, long root)
+{
+	if (state->roots[idx] == LOCK_ROOT_NONE)
+		state->roots[idx] = root;
+	else if (state->roots[idx] != root)
+		state->roots[idx] = LOCK_ROOT_UNKNOWN;
+}
+
+static void record_store(struct lock_state *state, struct statement *stmt)
+{
+	struct expression *dest = to_expr(stmt->store_dest);
+	struct expression *src;
+	unsigned long idx, src_idx;
+
+	if (!local_index(state, dest, &idx))
+		return;
+
+	if (dest->vm_type != J_REFERENCE) {
+		state->roots[idx] = LOCK_ROOT_UNKNOWN;
+
+		if (vm_type_is_pair(dest->vm_type) && idx + 1 < state->nr_locals)
+			state->roots[idx + 1] = LOCK_ROOT_UNKNOWN;
+		return;
+	}
+
+	src = resolve_temporary(state, to_expr(stmt->store_src));
+
+	if (local_index(state, src, &src_idx) && is_immutable_arg(state, src_idx))
+		merge_root(state, idx, src_idx);
+	else
+		state->roots[idx] = LOCK_ROOT_UNKNOWN;
+}
+
+/*
+ * Returns the parameter whose object @stmt locks or unlocks or a negative
+ * value if it is not known.
+ */
+static long lock_root(struct lock_state *state, struct statement *stmt)
+{
+	struct expression *expr = to_expr(stmt->expression);
+	unsigned long idx;
+
+	if (expr_type(expr) == EXPR_NULL_CHECK)
+		expr = to_expr(expr->null_check_ref);
+
+	expr = resolve_temporary(state, expr);
+
+	if (expr->vm_type != J_REFERENCE || !local_index(state, expr, &idx))
+		return LOCK_ROOT_UNKNOWN;
+
+	if (is_immutable_arg(state, idx))
+		return idx;
+
+	if (state->roots[idx] >= 0)
+		return state->roots[idx];
+
+	return LOCK_ROOT_UNKNOWN;
+}
+
+static bool is_monitor_stmt(struct statement *stmt)
+{
+	return stmt_type(stmt) == STMT_MONITOR_ENTER
+		|| stmt_type(stmt) == STMT_MONITOR_EXIT;
+}
+
+static void remove_stmt(struct statement *stmt)
+{
+	list_del(&stmt->stmt_list_node);
+	free_statement(stmt);
+}
+
+static void compute_roots(struct lock_state *state)
+{
+	struct basic_block *bb;
+	struct statement *stmt;
+
+	for_each_basic_block(bb, &state->cu->bb_list) {
+		for_each_stmt(stmt, &bb->stmt_list) {
+			switch (stmt_type(stmt)) {
+			case STMT_STORE:
+				mark_assigned(state, to_expr(stmt->store_dest));
+				count_vreg_def(state, to_expr(stmt->store_dest),
+					       to_expr(stmt->store_src));
+				break;
+			case STMT_INVOKE:
+			case STMT_INVOKEVIRTUAL:
+			case STMT_INVOKEINTERFACE:
+				if (stmt->invoke_result)
+					mark_multi_def(state, stmt->invoke_result);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	for (unsigned long i = 0; i < state->nr_locals; i++)
+		state->roots[i] = LOCK_ROOT_NONE;
+
+	for_each_basic_block(bb, &state->cu->bb_list) {
+		for_each_stmt(stmt, &bb->stmt_list) {
+			if (stmt_type(stmt) == STMT_STORE)
+				record_store(state, stmt);
+		}
+	}
+}
+
+/*
+ * A synchronized instance method holds the lock of "this" (local variable
+ * 0) while it runs.
+ */
+static void elide_recursive_locks(struct lock_state *state)
+{
+	struct vm_method *vmm = state->cu->method;
+	struct basic_block *bb;
+
+	if (!vm_method_is_synchronized(vmm) || vm_method_is_static(vmm))
+		return;
+
+	for_each_basic_block(bb, &state->cu->bb_list) {
+		struct statement *stmt, *next;
+
+		list_for_each_entry_safe(stmt, next, &bb->stmt_list, stmt_list_node) {
+			if (is_monitor_stmt(stmt) && lock_root(state, stmt) == 0) {
+				remove_stmt(stmt);
+				state->cu->nr_elided_locks++;
+			}
+		}
+	}
+}
+
+static struct statement *last_monitor_exit(struct basic_block *bb)
+{
+	struct statement *stmt;
+
+	list_for_each_entry_reverse(stmt, &bb->stmt_list, stmt_list_node) {
+		if (stmt_type(stmt) == STMT_GOTO)
+			continue;
+
+		if (stmt_type(stmt) == STMT_MONITOR_EXIT)
+			return stmt;
+
+		break;
+	}
+
+	return NULL;
+}
+
+/*
+ * Returns the only basic block that @bb continues to. Exception handlers
+ * are not entered by falling through.
+ */
+static struct basic_block *single_successor(struct basic_block *bb)
+{
+	struct basic_block *succ = NULL;
+
+	for (unsigned long i = 0; i < bb->nr_successors; i++) {
+		if (bb->successors[i]->is_eh)
+			continue;
+
+		if (succ)
+			return NULL;
+
+		succ = bb->successors[i];
+	}
+
+	return succ;
+}
+
+static bool is_copy_operand(struct expression *expr)
+{
+	return expr_type(expr) == EXPR_LOCAL || expr_type(expr) == EXPR_TEMPORARY;
+}
+
+static struct statement *first_monitor_enter(struct basic_block *bb)
+{
+	struct statement *stmt;
+
+	for_each_stmt(stmt, &bb->stmt_list) {
+		if (stmt_type(stmt) == STMT_MONITOR_ENTER)
+			return stmt;
+
+		if (stmt_type(stmt) != STMT_STORE)
+			break;
+
+		if (!is_copy_operand(to_expr(stmt->store_dest))
+		    || !is_copy_operand(to_expr(stmt->store_src)))
+			break;
+	}
+
+	return NULL;
+}
+
+static void coarsen_locks(struct lock_state *state)
+{
+	struct basic_block *bb;
+
+	for_each_basic_block(bb, &state->cu->bb_list) {
+		struct statement *exit, *enter;
+		struct basic_block *succ;
+		long root;
+
+		exit = last_monitor_exit(bb);
+		if (!exit)
+			continue;
+
+		root = lock_root(state, exit);
+		if (root < 0)
+			continue;
+
+		succ = single_successor(bb);
+		if (!succ || succ == bb || succ->is_eh || succ->nr_predecessors != 1)
+			continue;
+
+		enter = first_monitor_enter(succ);
+		if (!enter || lock_root(state, enter) != root)
+			continue;
+
+		remove_stmt(exit);
+		remove_stmt(enter);
+		state->cu->nr_elided_locks += 2;
+	}
+}
+
+static void trace_locks(struct compilation_unit *cu)
+{
+	struct vm_method *vmm = cu->method;
+
+	trace_printf("[locks] %s.%s%s: %lu monitor operations elided\n",
+		     vmm->class->name, vmm->name, vmm->type,
+		     cu->nr_elided_locks);
+	trace_flush();
+}
+
+int eliminate_locks(struct compilation_unit *cu)
+{
+	struct vm_method *vmm = cu->method;
+	struct lock_state state;
+	int err = 0;
+
+	cu->nr_elided_locks = 0;
+
+	if (!opt_eliminate_locks)
+		return 0;
+
+	state = (struct lock_state) {
+		.cu		= cu,
+		.nr_locals	= cu->code_attribute->max_locals,
+		.nr_args	= vm_method_arg_stack_count(vmm),
+		.nr_vregs	= cu->nr_vregs,
+	};
+
+	state.assigned = calloc(state.nr_locals + 1, sizeof(*state.assigned));
+	state.roots = calloc(state.nr_locals + 1, sizeof(*state.roots));
+	state.vreg_defs = calloc(state.nr_vregs + 1, sizeof(*state.vreg_defs));
+	state.vreg_srcs = calloc(state.nr_vregs + 1, sizeof(*state.vreg_srcs));
+	if (!state.assigned || !state.roots || !state.vreg_defs || !state.vreg_srcs) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	compute_roots(&state);
+
+	elide_recursive_locks(&state);
+
+	coarsen_locks(&state);
+
+	if (opt_trace_locks)
+		trace_locks(cu);
+out:
+	free(state.assigned);
+	free(state.roots);
+	free(state.vreg_defs);
+	free(state.vreg_srcs);
+
+	return err;
+}
@@ -0,0 +1,195 @@
+/*
+ * On-stack replacement
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ *
+ * A method that spends its time in a long loop is not helped by being
+ * compiled when it is invoked the next time. When the interpreter takes a
+ * backward branch in a hot method, it calls osr_enter() which compiles the
+ * method and continues the loop in the compiled code.
+ *
+ * Loop headers where no virtual register is live and the operand stack is
+ * empty are OSR entries. The compiled code gets one extra entry that sets
+ * up the frame like the normal prologue and then calls osr_migrate_frame()
+ * to copy the local variables of the interpreter into the frame and to
+ * look up where to jump. The interpreter frame stays on the stack below the
+ * compiled frame until the method returns.
+ */
+
+#include "jit/compile-queue.h"
+#include "jit/compilation-unit.h"
+#include "jit/basic-block.h"
+#include "jit/exception.h"
+#include "jit/compiler.h"
+#include "jit/deopt.h"
+#include "jit/gc-map.h"
+#include "jit/osr.h"
+
+#include "vm/method.h"
+#include "vm/class.h"
+#include "vm/call.h"
+#include "vm/trace.h"
+#include "vm/die.h"
+
+#include "lib/bitset.h"
+
+#include <stdlib.h>
+#include <errno.h>
+
+bool opt_use_osr = true;
+
+struct osr_request {
+	struct compilation_unit	*cu;
+	struct osr_entry	*entry;
+	unsigned long		*locals;
+	unsigned long		nr_locals;
+};
+
+static __thread struct osr_request osr_request;
+
+static bool is_loop_header(struct basic_block *bb)
+{
+	for (unsigned long i = 0; i < bb->nr_predecessors; i++) {
+		if (bb->predecessors[i]->start >= bb->start)
+			return true;
+	}
+
+	return false;
+}
+
+static bool is_osr_entry(struct basic_block *bb)
+{
+	if (bb->is_eh || bb->entry_mimic_stack_size != 0)
+		return false;
+
+	if (!is_loop_header(bb))
+		return false;
+
+	return bitset_ffs_from(bb->live_in_set, NR_FIXED_REGISTERS) < 0;
+}
+
+/*
+ * Records the OSR entries of @cu. This must be called after the basic
+ * blocks have been emitted and before the liveness information is freed.
+ */
+void add_osr_entries(struct compilation_unit *cu)
+{
+	struct basic_block *bb;
+
+	if (!opt_use_osr || !cu->local_kinds)
+		return;
+
+	if (vm_method_is_synchronized(cu->method))
+		return;
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		struct osr_entry *entries;
+
+		if (!is_osr_entry(bb))
+			continue;
+
+		entries = realloc(cu->osr_entries,
+				  (cu->nr_osr_entries + 1) * sizeof(*entries));
+		if (!entries)
+			die("out of memory");
+
+		entries[cu->nr_osr_entries].bc_offset	= bb->start;
+		entries[cu->nr_osr_entries].mach_offset	= bb->mach_offset;
+
+		cu->osr_entries = entries;
+		cu->nr_osr_entries++;
+	}
+}
+
+static struct osr_entry *lookup_osr_entry(struct compilation_unit *cu,
+					  unsigned long bc_offset)
+{
+	for (unsigned long i = 0; i < cu->nr_osr_entries; i++) {
+		if (cu->osr_entries[i].bc_offset == bc_offset)
+			return &cu->osr_entries[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Continues the interpreter frame of @vmm that is at the loop header @pc of
+ * @code in compiled code and stores the return value of the method to
+ * @result. Returns -EAGAIN if the method is being compiled in the
+ * background and -ENOENT if @pc is not an OSR entry.
+ */
+int osr_enter(struct vm_method *vmm, const unsigned char *code,
+	      unsigned long pc, unsigned long *locals, unsigned long nr_locals,
+	      union jvalue *result)
+{
+	struct compilation_unit *cu;
+	struct osr_entry *entry;
+
+	if (vm_method_is_synchronized(vmm))
+		return -EINVAL;
+
+	cu = vmm->compilation_unit;
+
+	if (!compilation_unit_is_compiled(cu)) {
+		if (compile_queue_submit(cu))
+			return -EAGAIN;
+
+		if (!jit_compile_method(cu)) {
+			clear_exception();
+			return -EINVAL;
+		}
+
+		cu = vmm->compilation_unit;
+		if (!compilation_unit_is_compiled(cu))
+			return -EAGAIN;
+	}
+
+	if (!cu->osr_entry_point)
+		return -EINVAL;
+
+	/*
+	 * The frame runs either the code of @cu, after it was deoptimized,
+	 * or the code of @vmm that methods were inlined into for @cu.
+	 */
+	if (code != cu->code_attribute->code) {
+		if (code != cu->inline_orig_code || !cu->inline_pc_map)
+			return -EINVAL;
+
+		pc = cu->inline_pc_map[pc];
+	}
+
+	entry = lookup_osr_entry(cu, pc);
+	if (!entry)
+		return -ENOENT;
+
+	if (opt_trace_deopt) {
+		trace_printf("[osr] %s.%s%s at pc %lu\n", vmm->class->name,
+			     vmm->name, vmm->type, pc);
+		trace_flush();
+	}
+
+	osr_request.cu		= cu;
+	osr_request.entry	= entry;
+	osr_request.locals	= locals;
+	osr_request.nr_locals	= nr_locals;
+
+	native_call(vmm, cu->osr_entry_point, locals, result);
+
+	return 0;
+}
+
+/*
+ * Called from the OSR entry of the compiled code with the newly set up
+ * @frame. Returns the address of the loop header to jump to.
+ */
+void *osr_migrate_frame(struct jit_stack_frame *frame)
+{
+	struct osr_request *req = &osr_request;
+
+	gc_maps_clear_frame(req->cu, frame);
+	write_frame_locals(req->cu, frame, req->locals, req->nr_locals);
+
+	return buffer_ptr(req->cu->objcode) + req->entry->mach_offset;
+}
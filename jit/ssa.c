@@ -93,6 +93,22 @@ void remove_insn(struct insn *insn)
 	free_insn(insn);
 }
 
+/*
+ * Code reached from exception handlers is not part of the dominator tree
+ * nor of the natural loops.
+ */
+bool cu_has_eh_bbs(struct compilation_unit *cu)
+{
+	struct basic_block *bb;
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		if (!bb->dfn && bb != cu->entry_bb)
+			return true;
+	}
+
+	return false;
+}
+
 static int ssa_analyze_liveness(struct compilation_unit *cu)
 {
 	int err = 0;
@@ -11,6 +11,8 @@
 #include "vm/stdlib.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 
 struct stack_frame *alloc_stack_frame(unsigned long nr_args,
 				      unsigned long nr_local_slots)
@@ -54,6 +56,46 @@ void free_stack_frame(struct stack_frame *frame)
 	free(frame);
 }
 
+/*
+ * Adds stack slots for local variables so that there are
+ * @nr_local_slots of them. Spill slots are located after local
+ * variables so they are moved accordingly.
+ */
+int stack_frame_grow_locals(struct stack_frame *frame,
+			    unsigned long nr_local_slots)
+{
+	struct stack_slot *local_slots;
+	unsigned long nr_new, i;
+	struct stack_slot *s;
+
+	if (nr_local_slots <= frame->nr_local_slots)
+		return 0;
+
+	local_slots = realloc(frame->local_slots,
+			      nr_local_slots * sizeof(struct stack_slot));
+	if (!local_slots)
+		return -ENOMEM;
+
+	frame->local_slots = local_slots;
+
+	for (i = frame->nr_local_slots; i < nr_local_slots; i++) {
+		struct stack_slot *slot = get_local_slot(frame, i);
+
+		memset(slot, 0, sizeof *slot);
+		slot->index  = i;
+		slot->parent = frame;
+	}
+
+	nr_new = nr_local_slots - frame->nr_local_slots;
+
+	for (s = frame->spill_slots; s != NULL; s = s->next)
+		s->index += nr_new;
+
+	frame->nr_local_slots = nr_local_slots;
+
+	return 0;
+}
+
 struct stack_slot *get_local_slot(struct stack_frame *frame, unsigned long index)
 {
 	return &frame->local_slots[index];
@@ -10,7 +10,6 @@
 #include "jit/bc-offset-mapping.h"
 #include "jit/expression.h"
 
-#include "vm/bytecode.h"
 #include "vm/vm.h"
 
 #include <assert.h>
@@ -33,7 +32,6 @@ int stmt_nr_kids(struct statement *stmt)
 	case STMT_MONITOR_EXIT:
 	case STMT_CHECKCAST:
 	case STMT_TABLESWITCH:
-	case STMT_LOOKUPSWITCH_JUMP:
 	case STMT_INVOKE:
 	case STMT_INVOKEINTERFACE:
 	case STMT_INVOKEVIRTUAL:
@@ -85,35 +83,33 @@ void free_statement(struct statement *stmt)
 	free(stmt);
 }
 
-struct tableswitch *alloc_tableswitch(struct tableswitch_info *info,
-				      struct compilation_unit *cu,
-				      struct basic_block *bb,
-				      unsigned long offset)
+/*
+ * Allocates a jump table for the keys from @low to @high. The caller fills
+ * in the target basic blocks and the source basic block of the table.
+ */
+struct tableswitch *alloc_tableswitch(struct compilation_unit *cu,
+				      int32_t low, int32_t high)
 {
 	struct tableswitch *table;
+	unsigned int count;
 
 	table = malloc(sizeof(*table));
 	if (!table)
 		return NULL;
 
-	table->src = bb;
+	table->src = NULL;
+
+	table->low = low;
+	table->high = high;
 
-	table->low = info->low;
-	table->high = info->high;
+	count = table->high - table->low + 1;
 
-	table->bb_lookup_table = malloc(sizeof(void *) * info->count);
+	table->bb_lookup_table = calloc(count, sizeof(void *));
 	if (!table->bb_lookup_table) {
 		free(table);
 		return NULL;
 	}
 
-	for (unsigned int i = 0; i < info->count; i++) {
-		int32_t target;
-
-		target = read_s32(info->targets + i * 4);
-		table->bb_lookup_table[i] = find_bb(cu, offset + target);
-	}
-
 	list_add(&table->list_node, &cu->tableswitch_list);
 
 	return table;
@@ -124,50 +120,3 @@ void free_tableswitch(struct tableswitch *table)
 	free(table->lookup_table);
 	free(table);
 }
-
-struct lookupswitch *alloc_lookupswitch(struct lookupswitch_info *info,
-				       struct compilation_unit *cu,
-				       struct basic_block *bb,
-				       unsigned long offset)
-{
-	struct lookupswitch *table;
-
-	table = malloc(sizeof(*table));
-	if (!table)
-		return NULL;
-
-	table->src = bb;
-
-	table->count = info->count;
-
-	table->pairs = malloc(sizeof(struct lookupswitch_pair) * info->count);
-	if (!table->pairs) {
-		free(table);
-		return NULL;
-	}
-
-	for (unsigned int i = 0; i < info->count; i++) {
-		int32_t target;
-
-		target = read_lookupswitch_target(info, i);
-		table->pairs[i].match = read_lookupswitch_match(info, i);
-		table->pairs[i].bb_target = find_bb(cu, offset + target);
-	}
-
-	list_add(&table->list_node, &cu->lookupswitch_list);
-
-	return table;
-}
-
-void free_lookupswitch(struct lookupswitch *table)
-{
-	free(table->pairs);
-	free(table);
-}
-
-int lookupswitch_pair_comp(const void *key, const void *elem)
-{
-	const struct lookupswitch_pair *pair = elem;
-
-	return (int32_t) ((intptr_t) key) - pair->match;
-}
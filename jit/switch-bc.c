@@ -17,6 +17,8 @@
 
 #include "lib/stack.h"
 
+#include <stdbool.h>
+#include <stdlib.h>
 #include <errno.h>
 
 static struct statement *branch_if_lesser_stmt(struct basic_block *target,
@@ -45,33 +47,41 @@ static struct statement *branch_if_greater_stmt(struct basic_block *target,
 	return if_stmt(target, J_INT, OP_GT, left, right_expr);
 }
 
-static struct statement *branch_if_null_stmt(struct basic_block *target,
-					     struct expression *left)
-{
-	struct expression *right_expr;
+/*
+ * Lookupswitches with at least this many keys are compiled to a jump table
+ * when the table has at most LOOKUPSWITCH_MAX_TABLE_RATIO entries per key.
+ */
+#define LOOKUPSWITCH_MIN_TABLE_KEYS	4
+#define LOOKUPSWITCH_MAX_TABLE_RATIO	3
 
-	right_expr = value_expr(J_NATIVE_PTR, 0);
-	if (!right_expr)
-		return NULL;
+/*
+ * Maximum number of keys that are compared one by one at the leaves of the
+ * lookupswitch compare tree.
+ */
+#define LOOKUPSWITCH_MAX_LINEAR_KEYS	3
 
-	return if_stmt(target, J_NATIVE_PTR, OP_EQ, left, right_expr);
-}
+struct lookupswitch_case {
+	int32_t			match;
+	struct basic_block	*target;
+};
 
-int convert_tableswitch(struct parse_context *ctx)
+/*
+ * Emits a range check of @pure_index followed by an indirect jump through
+ * @table. Two basic blocks are split off from the current one for the
+ * upper bound check and the jump.
+ */
+static int __convert_tableswitch(struct parse_context *ctx,
+				 struct tableswitch *table,
+				 struct basic_block *default_bb,
+				 struct expression *pure_index)
 {
-	struct tableswitch_info info;
-	struct tableswitch *table;
+	struct statement *if_lesser_stmt;
+	struct statement *if_greater_stmt;
+	struct statement *stmt;
 	struct basic_block *master_bb;
-	struct basic_block *default_bb;
 	struct basic_block *b1;
 	struct basic_block *b2;
-
-	get_tableswitch_info(ctx->code, ctx->offset, &info);
-	ctx->buffer->pos += info.insn_size;
-
-	default_bb = find_bb(ctx->cu, ctx->offset + info.default_target);
-	if (!default_bb)
-		goto fail_default_bb;
+	unsigned int count;
 
 	master_bb = ctx->bb;
 
@@ -90,36 +100,25 @@ int convert_tableswitch(struct parse_context *ctx)
 	bb_add_successor(b1, default_bb );
 	bb_add_successor(b1, b2);
 
-	for (unsigned int i = 0; i < info.count; i++) {
-		struct basic_block *target_bb;
-		int32_t target;
+	table->src = b2;
 
-		target = read_s32(info.targets + i * 4);
-		target_bb = find_bb(ctx->cu, ctx->offset + target);
+	count = table->high - table->low + 1;
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct basic_block *target_bb = table->bb_lookup_table[i];
 
 		if (!bb_successors_contains(b2, target_bb))
 			bb_add_successor(b2, target_bb);
 	}
 
-	table = alloc_tableswitch(&info, ctx->cu, b2, ctx->offset);
-	if (!table)
-		return -ENOMEM;
-
-	struct statement *if_lesser_stmt;
-	struct statement *if_greater_stmt;
-	struct statement *stmt;
-	struct expression *pure_index;
-
-	pure_index = get_pure_expr(ctx, stack_pop(ctx->bb->mimic_stack));
-
 	if_lesser_stmt =
-		branch_if_lesser_stmt(default_bb, pure_index, info.low);
+		branch_if_lesser_stmt(default_bb, pure_index, table->low);
 	if (!if_lesser_stmt)
 		goto fail_lesser_stmt;
 
 	expr_get(pure_index);
 	if_greater_stmt =
-		branch_if_greater_stmt(default_bb, pure_index, info.high);
+		branch_if_greater_stmt(default_bb, pure_index, table->high);
 	if (!if_greater_stmt)
 		goto fail_greater_stmt;
 
@@ -141,86 +140,236 @@ int convert_tableswitch(struct parse_context *ctx)
  fail_greater_stmt:
 	free_statement(if_lesser_stmt);
  fail_lesser_stmt:
-	free_tableswitch(table);
- fail_default_bb:
-	return -1;
+	return -ENOMEM;
 }
 
-int convert_lookupswitch(struct parse_context *ctx)
+int convert_tableswitch(struct parse_context *ctx)
 {
-	struct lookupswitch_info info;
-	struct lookupswitch *table;
-	struct basic_block *master_bb;
+	struct tableswitch_info info;
+	struct tableswitch *table;
 	struct basic_block *default_bb;
-	struct basic_block *b1;
+	struct expression *pure_index;
 
-	get_lookupswitch_info(ctx->code, ctx->offset, &info);
+	get_tableswitch_info(ctx->code, ctx->offset, &info);
 	ctx->buffer->pos += info.insn_size;
 
 	default_bb = find_bb(ctx->cu, ctx->offset + info.default_target);
 	if (!default_bb)
-		goto fail_default_bb;
+		return -1;
 
-	master_bb = ctx->bb;
+	table = alloc_tableswitch(ctx->cu, info.low, info.high);
+	if (!table)
+		return -ENOMEM;
 
-	b1 = bb_split(master_bb, master_bb->end);
+	for (unsigned int i = 0; i < info.count; i++) {
+		int32_t target;
 
-	assert(b1);
+		target = read_s32(info.targets + i * 4);
+		table->bb_lookup_table[i] = find_bb(ctx->cu, ctx->offset + target);
+	}
 
-	b1->has_branch = true;
+	pure_index = get_pure_expr(ctx, stack_pop(ctx->bb->mimic_stack));
 
-	bb_add_successor(master_bb, default_bb );
-	bb_add_successor(master_bb, b1);
+	return __convert_tableswitch(ctx, table, default_bb, pure_index);
+}
 
-	for (unsigned int i = 0; i < info.count; i++) {
-		struct basic_block *target_bb;
-		int32_t target;
+static bool lookupswitch_is_dense(struct lookupswitch_case *cases,
+				  unsigned int count)
+{
+	int64_t range;
 
-		target = read_lookupswitch_target(&info, i);
-		target_bb = find_bb(ctx->cu, ctx->offset + target);
+	if (count < LOOKUPSWITCH_MIN_TABLE_KEYS)
+		return false;
 
-		if (!bb_successors_contains(b1, target_bb))
-			bb_add_successor(b1, target_bb);
-	}
+	range = (int64_t) cases[count - 1].match - cases[0].match + 1;
+
+	return range <= (int64_t) count * LOOKUPSWITCH_MAX_TABLE_RATIO;
+}
 
-	table = alloc_lookupswitch(&info, ctx->cu, b1, ctx->offset);
+static int convert_lookupswitch_to_table(struct parse_context *ctx,
+					 struct lookupswitch_case *cases,
+					 unsigned int count,
+					 struct basic_block *default_bb,
+					 struct expression *key)
+{
+	struct tableswitch *table;
+	int32_t low, high;
+
+	low = cases[0].match;
+	high = cases[count - 1].match;
+
+	table = alloc_tableswitch(ctx->cu, low, high);
 	if (!table)
 		return -ENOMEM;
 
-	struct statement *if_null_stmt;
+	for (int64_t i = 0; i <= (int64_t) high - low; i++)
+		table->bb_lookup_table[i] = default_bb;
+
+	for (unsigned int i = 0; i < count; i++)
+		table->bb_lookup_table[(int64_t) cases[i].match - low] = cases[i].target;
+
+	return __convert_tableswitch(ctx, table, default_bb, key);
+}
+
+/*
+ * Returns the number of basic blocks in the compare tree of @count keys.
+ * Leaves compare the keys one by one and end with a jump to the default
+ * target. Inner nodes compare against the middle key and branch to the
+ * left subtree which is laid out after the right one.
+ */
+static unsigned int nr_tree_bbs(unsigned int count)
+{
+	unsigned int mid;
+
+	if (count <= LOOKUPSWITCH_MAX_LINEAR_KEYS)
+		return count + 1;
+
+	mid = count / 2;
+
+	return 1 + nr_tree_bbs(mid) + nr_tree_bbs(count - mid);
+}
+
+static void add_tree_branch(struct basic_block *bb, struct statement *stmt,
+			    struct basic_block *next, unsigned long offset)
+{
+	bb_add_successor(bb, stmt->if_true);
+	if (!bb_successors_contains(bb, next))
+		bb_add_successor(bb, next);
+
+	do_convert_statement(bb, stmt, offset);
+}
+
+static int convert_lookupswitch_tree(struct parse_context *ctx,
+				     struct basic_block **bbs,
+				     struct lookupswitch_case *cases,
+				     unsigned int count,
+				     struct basic_block *default_bb,
+				     struct expression *key)
+{
 	struct statement *stmt;
+	unsigned int mid;
+	int err;
+
+	if (count <= LOOKUPSWITCH_MAX_LINEAR_KEYS) {
+		for (unsigned int i = 0; i < count; i++) {
+			struct expression *match;
+
+			match = value_expr(J_INT, cases[i].match);
+			if (!match)
+				return -ENOMEM;
+
+			expr_get(key);
+			stmt = if_stmt(cases[i].target, J_INT, OP_EQ, key, match);
+			if (!stmt)
+				return -ENOMEM;
+
+			add_tree_branch(bbs[i], stmt, bbs[i + 1], ctx->offset);
+		}
+
+		stmt = alloc_statement(STMT_GOTO);
+		if (!stmt)
+			return -ENOMEM;
+
+		stmt->goto_target = default_bb;
+
+		bb_add_successor(bbs[count], default_bb);
+		do_convert_statement(bbs[count], stmt, ctx->offset);
+		return 0;
+	}
+
+	mid = count / 2;
+
+	struct basic_block **left = bbs + 1 + nr_tree_bbs(count - mid);
+
+	expr_get(key);
+	stmt = branch_if_lesser_stmt(left[0], key, cases[mid].match);
+	if (!stmt)
+		return -ENOMEM;
+
+	add_tree_branch(bbs[0], stmt, bbs[1], ctx->offset);
+
+	err = convert_lookupswitch_tree(ctx, bbs + 1, cases + mid, count - mid,
+					default_bb, key);
+	if (err)
+		return err;
+
+	return convert_lookupswitch_tree(ctx, left, cases, mid, default_bb, key);
+}
+
+/*
+ * Lookupswitch keys are sorted so the switch is compiled either to a jump
+ * table when the keys are dense or to a balanced tree of compares with
+ * linear search at the leaves. All basic blocks of the tree are split off
+ * from the current one first because bb_split() moves the successors of
+ * the split block to the new one.
+ */
+static int convert_lookupswitch_to_tree(struct parse_context *ctx,
+					struct lookupswitch_case *cases,
+					unsigned int count,
+					struct basic_block *default_bb,
+					struct expression *key)
+{
+	struct basic_block **bbs;
+	unsigned int nr_bbs;
+	int err;
+
+	nr_bbs = nr_tree_bbs(count);
+
+	bbs = malloc(sizeof(*bbs) * nr_bbs);
+	if (!bbs)
+		return -ENOMEM;
+
+	bbs[0] = ctx->bb;
+	for (unsigned int i = 1; i < nr_bbs; i++) {
+		bbs[i] = bb_split(bbs[i - 1], ctx->bb->end);
+		assert(bbs[i]);
+	}
+
+	for (unsigned int i = 0; i < nr_bbs; i++)
+		bbs[i]->has_branch = true;
+
+	err = convert_lookupswitch_tree(ctx, bbs, cases, count, default_bb, key);
+
+	free(bbs);
+	expr_put(key);
+
+	return err;
+}
+
+int convert_lookupswitch(struct parse_context *ctx)
+{
+	struct lookupswitch_info info;
+	struct lookupswitch_case *cases;
+	struct basic_block *default_bb;
 	struct expression *key;
-	struct expression *bsearch;
-	struct expression *pure_bsearch;
+	int err;
 
-	key = stack_pop(ctx->bb->mimic_stack);
+	get_lookupswitch_info(ctx->code, ctx->offset, &info);
+	ctx->buffer->pos += info.insn_size;
 
-	bsearch = lookupswitch_bsearch_expr(key, table);
-	if (!bsearch)
+	default_bb = find_bb(ctx->cu, ctx->offset + info.default_target);
+	if (!default_bb)
 		return -1;
 
-	pure_bsearch = get_pure_expr(ctx, bsearch);
+	cases = malloc(sizeof(*cases) * (info.count + 1));
+	if (!cases)
+		return -ENOMEM;
 
-	if_null_stmt =
-		branch_if_null_stmt(default_bb, pure_bsearch);
-	if (!if_null_stmt)
-		goto fail_null_stmt;
+	for (unsigned int i = 0; i < info.count; i++) {
+		int32_t target;
 
-	stmt = alloc_statement(STMT_LOOKUPSWITCH_JUMP);
-	if (!stmt)
-		goto fail_stmt;
+		target = read_lookupswitch_target(&info, i);
+		cases[i].match = read_lookupswitch_match(&info, i);
+		cases[i].target = find_bb(ctx->cu, ctx->offset + target);
+	}
 
-	expr_get(pure_bsearch);
-	stmt->lookupswitch_target = &pure_bsearch->node;
+	key = get_pure_expr(ctx, stack_pop(ctx->bb->mimic_stack));
 
-	convert_statement(ctx, if_null_stmt);
-	do_convert_statement(b1, stmt, ctx->offset);
-	return 0;
+	if (lookupswitch_is_dense(cases, info.count))
+		err = convert_lookupswitch_to_table(ctx, cases, info.count, default_bb, key);
+	else
+		err = convert_lookupswitch_to_tree(ctx, cases, info.count, default_bb, key);
 
- fail_stmt:
-	free_statement(if_null_stmt);
- fail_null_stmt:
-	free_lookupswitch(table);
- fail_default_bb:
-	return -1;
+	free(cases);
+	return err;
 }
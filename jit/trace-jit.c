@@ -712,7 +712,7 @@ static void print_source_and_line(struct compilation_unit *cu,
 	if (pc == BC_OFFSET_UNKNOWN)
 		return;
 
-	trace_printf(":%d", bytecode_offset_to_line_no(cu->method, pc));
+	trace_printf(":%d", cu_bytecode_offset_to_line_no(cu, pc));
 }
 
 static void trace_return_address(struct jit_stack_frame *frame)
@@ -847,22 +847,31 @@ void trace_exception_unwind_to_native(struct jit_stack_frame *frame)
 	trace_flush();
 }
 
-void trace_bytecode(struct vm_method *method)
+static void __trace_bytecode(struct vm_method *method,
+			     struct cafebabe_code_attribute *code_attr)
 {
 	if (!vm_method_is_traceable(method))
 		return;
 
 	trace_printf("Code:\n");
-	bytecode_disassemble(method->class,
-			     method->code_attribute.code,
-			     method->code_attribute.code_length);
+	bytecode_disassemble(method->class, code_attr->code,
+			     code_attr->code_length);
 	trace_printf("\nException table:\n");
-	print_exception_table(method,
-		method->code_attribute.exception_table,
-		method->code_attribute.exception_table_length);
+	print_exception_table(method, code_attr->exception_table,
+			      code_attr->exception_table_length);
 	trace_printf("\n");
 }
 
+void trace_bytecode(struct vm_method *method)
+{
+	__trace_bytecode(method, &method->code_attribute);
+}
+
+void trace_cu_bytecode(struct compilation_unit *cu)
+{
+	__trace_bytecode(cu->method, cu->code_attribute);
+}
+
 void trace_return_value(struct vm_method *vmm, unsigned long long value)
 {
 	enum vm_type type;
@@ -8,6 +8,8 @@
 #include "arch/memory.h"
 #include "arch/debug.h"
 
+#include "jit/compile-queue.h"
+#include "jit/cha.h"
 #include "jit/compiler.h"
 #include "jit/cu-mapping.h"
 #include "jit/emit-code.h"
@@ -16,6 +18,7 @@
 
 #include "vm/stack-trace.h"
 #include "vm/natives.h"
+#include "vm/interp.h"
 #include "vm/preload.h"
 #include "vm/method.h"
 #include "vm/method.h"
@@ -74,36 +77,50 @@ static void *jit_java_trampoline(struct compilation_unit *cu)
 	return cu_entry_point(cu);
 }
 
-void *jit_magic_trampoline(struct compilation_unit *cu)
+static void *jit_interp_bridge(struct compilation_unit *cu)
 {
 	struct vm_method *method = cu->method;
-	unsigned long state;
-	void *ret;
+	struct buffer *buf;
 
-	if (opt_debug_stack)
-		check_stack_align(method);
+	pthread_mutex_lock(&cu->compile_mutex);
 
-	if (opt_trace_magic_trampoline)
-		trace_magic_trampoline(cu);
+	if (cu->interp_bridge)
+		goto out_unlock;
 
-	if (vm_method_is_static(method)) {
-		/* This is for "invokestatic"... */
-		if (vm_class_ensure_init(method->class))
-			return rethrow_exception();
-	}
+	buf = alloc_exec_buffer();
+	if (!buf)
+		goto out_unlock;
 
-	state = compilation_unit_get_state(cu);
+	emit_interp_bridge(buf, method, vm_interp_bridge_ptr(method));
 
-	if (state == COMPILATION_STATE_COMPILED) {
-		ret = cu_entry_point(cu);
-		goto out_fixup;
-	}
+	if (add_cu_mapping((unsigned long) buffer_ptr(buf), cu))
+		goto out_unlock;
+
+	cu->interp_bridge = buffer_ptr(buf);
+
+out_unlock:
+	pthread_mutex_unlock(&cu->compile_mutex);
+
+	if (!cu->interp_bridge)
+		return throw_oom_error();
+
+	return cu->interp_bridge;
+}
+
+/*
+ * Compiles the method of @cu unless it has been compiled already. Returns
+ * the entry point of the code or NULL with an exception pending.
+ */
+void *jit_compile_method(struct compilation_unit *cu)
+{
+	bool compiled = false;
+	void *ret;
 
 	pthread_mutex_lock(&cu->compile_mutex);
 
 	if (cu->state == COMPILATION_STATE_COMPILED) {
 		ret = cu_entry_point(cu);
-		goto out_unlock_fixup;
+		goto out_unlock;
 	}
 
 	assert(cu->state == COMPILATION_STATE_INITIAL);
@@ -115,16 +132,82 @@ void *jit_magic_trampoline(struct compilation_unit *cu)
 	else
 		ret = jit_java_trampoline(cu);
 
-	if (ret)
+	if (ret) {
 		cu->state = COMPILATION_STATE_COMPILED;
-	else
+		compiled = true;
+	} else
 		cu->state = COMPILATION_STATE_INITIAL;
 
 	shrink_compilation_unit(cu);
 
-out_unlock_fixup:
+out_unlock:
 	pthread_mutex_unlock(&cu->compile_mutex);
 
+	if (compiled)
+		cha_code_installed(cu);
+
+	return ret;
+}
+
+void *jit_magic_trampoline(struct compilation_unit *cu)
+{
+	struct vm_method *method = cu->method;
+	unsigned long state;
+	void *ret;
+
+	/*
+	 * The trampoline always passes the unit it was built for but the
+	 * method gets a new one when its code is invalidated by class
+	 * hierarchy analysis.
+	 */
+	cu = method->compilation_unit;
+
+	if (opt_debug_stack)
+		check_stack_align(method);
+
+	if (opt_trace_magic_trampoline)
+		trace_magic_trampoline(cu);
+
+	/*
+	 * Abstract methods are reached through vtable slots and inline
+	 * caches of classes that don't implement them.
+	 */
+	if (vm_method_is_abstract(method)) {
+		signal_new_exception(vm_java_lang_AbstractMethodError, "%s.%s%s",
+				     method->class->name, method->name, method->type);
+		return rethrow_exception();
+	}
+
+	if (vm_method_is_static(method)) {
+		/* This is for "invokestatic"... */
+		if (vm_class_ensure_init(method->class))
+			return rethrow_exception();
+	}
+
+	state = compilation_unit_get_state(cu);
+
+	if (state == COMPILATION_STATE_COMPILED) {
+		ret = cu_entry_point(cu);
+		goto out_fixup;
+	}
+
+	/*
+	 * Call sites and vtables are not fixed up for interpreted
+	 * methods so that we get here again on the next invocation.
+	 * Methods that are compiled in the background are run in the
+	 * interpreter until the compiler thread installs the code.
+	 */
+	if (vm_method_should_interpret(method) ||
+	    (vm_method_can_interpret(method) && compile_queue_submit(cu))) {
+		ret = jit_interp_bridge(cu);
+		if (!ret)
+			return rethrow_exception();
+
+		return ret;
+	}
+
+	ret = jit_compile_method(cu);
+
 out_fixup:
 	if (!ret)
 		return rethrow_exception();
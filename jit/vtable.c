@@ -36,6 +36,10 @@ void fixup_vtable(struct compilation_unit *cu, struct vm_object *this,
 	struct vm_method *vmm = cu->method;
 	int index = vmm->virtual_index;
 
+	/* The method is run in the interpreter. */
+	if (!vm_method_is_compiled(vmm))
+		return;
+
 	/*
 	 * A method can be invoked by invokevirtual and invokespecial. For
 	 * example, a public method p() in class A is normally invoked with
@@ -51,3 +55,16 @@ void fixup_vtable(struct compilation_unit *cu, struct vm_object *this,
 	/* Fixup the vtable entry in declaring class */
 	vmm->class->vtable.native_ptr[index] = target;
 }
+
+/**
+ * This function replaces the trampoline pointer in the vtable of the
+ * declaring class of @vmm with @target. It is used when a method is
+ * compiled outside of the trampoline.
+ */
+void fixup_vtable_entry(struct vm_method *vmm, void *target)
+{
+	void **entry = &vmm->class->vtable.native_ptr[vmm->virtual_index];
+
+	if (*entry == vm_method_trampoline_ptr(vmm))
+		*entry = target;
+}
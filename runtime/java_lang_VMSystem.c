@@ -5,6 +5,7 @@
 #include "vm/preload.h"
 #include "vm/object.h"
 #include "vm/class.h"
+#include "vm/heap.h"
 
 void java_lang_VMSystem_arraycopy(jobject src, jint src_start, jobject dest, jint dest_start, jint len)
 {
@@ -46,6 +47,16 @@ void java_lang_VMSystem_arraycopy(jobject src, jint src_start, jobject dest, jin
 	}
 
 	elem_size = vmtype_get_size(elem_type);
+
+	if (elem_type == J_REFERENCE) {
+		void *to = vm_array_elems(dest) + dest_start * elem_size;
+
+		gc_write_barrier_range(to, len * elem_size);
+		gc_copy_refs(to, vm_array_elems(src) + src_start * elem_size, len);
+		gc_write_barrier_range(to, len * elem_size);
+		return;
+	}
+
 	memmove(vm_array_elems(dest) + dest_start * elem_size,
 		vm_array_elems(src) + src_start * elem_size,
 		len * elem_size);
@@ -73,5 +84,9 @@ static int32_t hash_ptr_to_int32(void *p)
 
 jint java_lang_VMSystem_identityHashCode(struct vm_object *obj)
 {
+	/* Objects of the generational heap move, see heap_identity_hash(). */
+	if (gc_in_heap(obj))
+		return heap_identity_hash(obj, hash_ptr_to_int32(obj));
+
 	return hash_ptr_to_int32(obj);
 }
@@ -435,6 +435,7 @@ int object_to_jvalue(void *field_ptr, enum vm_type type, struct vm_object *value
 
 	switch (type) {
 	case J_REFERENCE:
+		gc_write_barrier(field_ptr);
 		*(jobject *) field_ptr = value;
 		return 0;
 	case J_BOOLEAN:
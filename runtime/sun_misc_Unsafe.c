@@ -116,6 +116,8 @@ void sun_misc_Unsafe_putObject(jobject this, jobject obj, jlong offset, jobject
 {
 	struct vm_object **value_p = (void *) obj + offset;
 
+	gc_write_barrier(value_p);
+
 	*value_p	= value;
 }
 
@@ -123,6 +125,8 @@ void sun_misc_Unsafe_putObjectVolatile(jobject this, jobject obj, jlong offset,
 {
 	struct vm_object **value_p = (void *) obj + offset;
 
+	gc_write_barrier(value_p);
+
 	mb();
 
 	*value_p	= value;
@@ -154,6 +158,8 @@ jint native_unsafe_compare_and_swap_object(struct vm_object *this,
 {
 	void *p = (void *) obj + offset;
 
+	gc_write_barrier(p);
+
 	return cmpxchg_ptr(p, expect, update) == expect;
 }
 
@@ -14,6 +14,7 @@
 #include "jit/compiler.h"
 
 #include "vm/object.h"
+#include "vm/preload.h"
 
 #include "arch/stack-frame.h"
 #include "arch/memory.h"
@@ -32,6 +33,26 @@ throw_exception(struct compilation_unit *cu, struct vm_object *exception)
 	return throw_from_jit(cu, frame, native_ptr);
 }
 
+/*
+ * Called by array_check_failed() when an inline array bounds check fails
+ * in JIT compiled code. @native_ptr points right past the check.
+ */
+unsigned char *
+throw_array_index_out_of_bounds(struct jit_stack_frame *frame, unsigned char *native_ptr,
+				struct vm_object *array, jint index)
+{
+	struct compilation_unit *cu;
+
+	native_ptr--;
+
+	cu = jit_lookup_cu((unsigned long) native_ptr);
+
+	signal_new_exception(vm_java_lang_ArrayIndexOutOfBoundsException,
+			     "%d > %d", index, vm_array_length(array) - 1);
+
+	return throw_from_jit(cu, frame, native_ptr);
+}
+
 void throw_from_trampoline(void *ctx, struct vm_object *exception)
 {
 	unsigned long return_address;
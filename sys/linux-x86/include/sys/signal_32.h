@@ -15,6 +15,8 @@ save_signal_registers(struct register_state *regs, mcontext_t *mcontext)
 	greg_t *gregs = mcontext->gregs;
 
 	regs->ip	= (uint32_t) gregs[REG_EIP];
+	regs->sp	= gregs[REG_ESP];
+	regs->bp	= gregs[REG_EBP];
 	regs->eax	= gregs[REG_EAX];
 	regs->ebx	= gregs[REG_EBX];
 	regs->ecx	= gregs[REG_ECX];
@@ -23,4 +25,21 @@ save_signal_registers(struct register_state *regs, mcontext_t *mcontext)
 	regs->edi	= gregs[REG_EDI];
 }
 
+/*
+ * Writes back general purpose registers that the garbage collector might
+ * have updated.
+ */
+static inline void
+restore_signal_registers(mcontext_t *mcontext, struct register_state *regs)
+{
+	greg_t *gregs = mcontext->gregs;
+
+	gregs[REG_EAX]	= regs->eax;
+	gregs[REG_EBX]	= regs->ebx;
+	gregs[REG_ECX]	= regs->ecx;
+	gregs[REG_EDX]	= regs->edx;
+	gregs[REG_ESI]	= regs->esi;
+	gregs[REG_EDI]	= regs->edi;
+}
+
 #endif /* X86_SIGNAL_32_H */
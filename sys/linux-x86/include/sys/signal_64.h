@@ -15,6 +15,8 @@ save_signal_registers(struct register_state *regs, mcontext_t *mcontext)
 	greg_t *gregs = mcontext->gregs;
 
 	regs->ip	= gregs[REG_RIP];
+	regs->sp	= gregs[REG_RSP];
+	regs->bp	= gregs[REG_RBP];
         regs->rax	= gregs[REG_RAX];
         regs->rbx	= gregs[REG_RBX];
         regs->rcx	= gregs[REG_RCX];
@@ -31,4 +33,29 @@ save_signal_registers(struct register_state *regs, mcontext_t *mcontext)
         regs->r15	= gregs[REG_R15];
 }
 
+/*
+ * Writes back general purpose registers that the garbage collector might
+ * have updated.
+ */
+static inline void
+restore_signal_registers(mcontext_t *mcontext, struct register_state *regs)
+{
+	greg_t *gregs = mcontext->gregs;
+
+	gregs[REG_RAX]	= regs->rax;
+	gregs[REG_RBX]	= regs->rbx;
+	gregs[REG_RCX]	= regs->rcx;
+	gregs[REG_RDX]	= regs->rdx;
+	gregs[REG_RSI]	= regs->rsi;
+	gregs[REG_RDI]	= regs->rdi;
+	gregs[REG_R8]	= regs->r8;
+	gregs[REG_R9]	= regs->r9;
+	gregs[REG_R10]	= regs->r10;
+	gregs[REG_R11]	= regs->r11;
+	gregs[REG_R12]	= regs->r12;
+	gregs[REG_R13]	= regs->r13;
+	gregs[REG_R14]	= regs->r14;
+	gregs[REG_R15]	= regs->r15;
+}
+
 #endif /* X86_SIGNAL_64_H */
@@ -84,10 +84,39 @@ public class ArrayExceptionsTest extends TestCase {
         assertTrue(caught);
     }
 
+    public static void testArrayStoreOfCompatibleTypes() {
+        Object[] objects = new Object[3];
+        Number[] numbers = new Integer[3];
+        CharSequence[] sequences = new String[3];
+
+        objects[0] = "test";
+        objects[1] = new Integer(1);
+        objects[2] = null;
+        assertEquals("test", objects[0]);
+
+        numbers[0] = new Integer(1);
+        numbers[1] = null;
+        assertEquals(new Integer(1), numbers[0]);
+
+        sequences[0] = "test";
+        assertEquals("test", sequences[0]);
+
+        boolean caught = false;
+
+        try {
+            numbers[2] = new Long(1);
+        } catch (ArrayStoreException e) {
+            caught = true;
+        }
+
+        assertTrue(caught);
+    }
+
     public static void testArrayStore() {
         testArrayStoreThrowsNullPointerException();
         testArrayStoreThrowsArrayIndexOutOfBoundsException();
         testArrayStoreThrowsArrayStoreException();
+        testArrayStoreOfCompatibleTypes();
     }
 
     public static void testArraylengthThrowsNullPointerException() {
@@ -180,6 +209,24 @@ public class ArrayExceptionsTest extends TestCase {
         assertTrue(caught);
     }
 
+    public static void testArrayBoundsCheckInLoop() {
+        int array[] = { 0, 1, 2 };
+        String message = null;
+        int sum = 0;
+        int i = 0;
+
+        try {
+            for (i = 0; i < 5; i++)
+                sum += array[i];
+        } catch (ArrayIndexOutOfBoundsException e) {
+            message = e.getMessage();
+        }
+
+        assertEquals(3, i);
+        assertEquals(3, sum);
+        assertEquals("3 > 2", message);
+    }
+
     public static void main(String args[]) {
         testArrayLoad();
         testArrayStore();
@@ -188,5 +235,6 @@ public class ArrayExceptionsTest extends TestCase {
         testNewarrayThrowsNegativeArraySizeException();
         testMultianewarrayThrowsNegativeArraySizeException();
         testArrayBoundsCheck();
+        testArrayBoundsCheckInLoop();
     }
 }
@@ -157,6 +157,39 @@ public class ArrayTest extends TestCase {
         takeInt( (byte) s[0] );
     }
 
+    public static int sum(int[] array) {
+        int sum = 0;
+
+        for (int i = 0; i < array.length; i++)
+            sum += array[i];
+
+        return sum;
+    }
+
+    public static void testArrayLoop() {
+        int[] array = new int[10];
+
+        for (int i = 0; i < array.length; i++)
+            array[i] = i;
+
+        assertEquals(45, sum(array));
+        assertEquals(0, sum(new int[0]));
+    }
+
+    public static void testNestedArrayLoop() {
+        int[][] matrix = { { 1, 2, 3 }, { 4, 5 }, { } };
+        int sum = 0;
+
+        for (int i = 0; i < matrix.length; i++) {
+            int[] row = matrix[i];
+
+            for (int j = 0; j < row.length; j++)
+                sum += row[j];
+        }
+
+        assertEquals(15, sum);
+    }
+
     public static void main(String args[]) {
         testEmptyStaticArrayLength();
         testEmptyArrayLength();
@@ -176,5 +209,8 @@ public class ArrayTest extends TestCase {
 
         testArrayClass();
         testByteCharShortLoadPushesInt();
+
+        testArrayLoop();
+        testNestedArrayLoop();
     }
 }
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ */
+package jvm;
+
+/**
+ * Objects are reserved for the first thread that locks them. Other threads
+ * must still be able to lock them and mutual exclusion must hold after the
+ * reservation is revoked.
+ */
+public class BiasedLockingTest extends TestCase {
+    public static class Counter {
+        public int value;
+
+        public synchronized void increment() {
+            value++;
+        }
+    }
+
+    private static void lockFromOtherThread(final Object lock) throws InterruptedException {
+        Thread t = new Thread() {
+            public void run() {
+                synchronized (lock) {
+                }
+            }
+        };
+
+        t.start();
+        t.join(10000);
+
+        assertFalse(t.isAlive());
+    }
+
+    public static void testRelock() {
+        Counter counter = new Counter();
+
+        for (int i = 0; i < 1000; i++) {
+            synchronized (counter) {
+                counter.value++;
+            }
+        }
+
+        for (int i = 0; i < 1000; i++)
+            counter.increment();
+
+        assertEquals(2000, counter.value);
+    }
+
+    public static void testRevokeUnlocked() throws InterruptedException {
+        Object lock = new Object();
+
+        synchronized (lock) {
+        }
+
+        lockFromOtherThread(lock);
+
+        synchronized (lock) {
+        }
+
+        lockFromOtherThread(lock);
+    }
+
+    public static void testRevokeLocked() throws InterruptedException {
+        final Counter counter = new Counter();
+
+        Thread t;
+
+        synchronized (counter) {
+            t = new Thread() {
+                public void run() {
+                    synchronized (counter) {
+                        counter.value *= 2;
+                    }
+                }
+            };
+
+            t.start();
+
+            /* Give the other thread time to revoke the bias. */
+            Thread.sleep(100);
+
+            counter.value = 3;
+        }
+
+        t.join(10000);
+
+        assertFalse(t.isAlive());
+        assertEquals(6, counter.value);
+    }
+
+    public static void testContended() throws InterruptedException {
+        final Counter counter = new Counter();
+        Thread[] threads = new Thread[4];
+
+        for (int i = 0; i < threads.length; i++) {
+            threads[i] = new Thread() {
+                public void run() {
+                    for (int j = 0; j < 10000; j++)
+                        counter.increment();
+                }
+            };
+        }
+
+        for (int i = 0; i < threads.length; i++)
+            threads[i].start();
+
+        for (int i = 0; i < threads.length; i++)
+            threads[i].join();
+
+        assertEquals(40000, counter.value);
+    }
+
+    public static void testWaitNotify() throws InterruptedException {
+        final Object lock = new Object();
+
+        synchronized (lock) {
+            Thread t = new Thread() {
+                public void run() {
+                    synchronized (lock) {
+                        lock.notify();
+                    }
+                }
+            };
+
+            t.start();
+
+            lock.wait(10000);
+
+            t.join(10000);
+            assertFalse(t.isAlive());
+        }
+    }
+
+    public static void testManyRevocations() throws InterruptedException {
+        for (int i = 0; i < 50; i++) {
+            Counter counter = new Counter();
+
+            counter.increment();
+            lockFromOtherThread(counter);
+            counter.increment();
+
+            assertEquals(2, counter.value);
+        }
+    }
+
+    public static void main(String[] args) throws InterruptedException {
+        testRelock();
+        testRevokeUnlocked();
+        testRevokeLocked();
+        testContended();
+        testWaitNotify();
+        testManyRevocations();
+    }
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ */
+package jvm;
+
+/**
+ * Calls that are devirtualized by class hierarchy analysis must dispatch
+ * to overriding methods of classes that are loaded after the caller has
+ * been compiled.
+ */
+public class ClassHierarchyAnalysisTest extends TestCase {
+    public static class Base {
+        public int value() {
+            return 1;
+        }
+    }
+
+    public static class Sub extends Base {
+        public int value() {
+            return 2;
+        }
+    }
+
+    public static class SubSub extends Sub {
+        public int value() {
+            return 3;
+        }
+    }
+
+    public static interface Shape {
+        int sides();
+    }
+
+    public static class Triangle implements Shape {
+        public int sides() {
+            return 3;
+        }
+    }
+
+    public static class Square implements Shape {
+        public int sides() {
+            return 4;
+        }
+    }
+
+    public static class Leaf {
+        public int value() {
+            return 5;
+        }
+    }
+
+    public static class LeafSub extends Leaf {
+    }
+
+    public static class Counter {
+        public int next() {
+            return 1;
+        }
+    }
+
+    public static class FastCounter extends Counter {
+        public int next() {
+            return 2;
+        }
+    }
+
+    public static class Accumulator {
+        public int next() {
+            return 1;
+        }
+    }
+
+    public static class FastAccumulator extends Accumulator {
+        public int next() {
+            return 2;
+        }
+    }
+
+    public static class Gauge {
+        public int next() {
+            return 1;
+        }
+    }
+
+    public static class FastGauge extends Gauge {
+        public int next() {
+            return 2;
+        }
+    }
+
+    private static Counter counter;
+    private static Accumulator accumulator;
+    private static Gauge gauge;
+
+    private static void installFastCounter() {
+        counter = new FastCounter();
+    }
+
+    private static int installFastAccumulatorAt(int i, int n) {
+        if (i == n)
+            accumulator = new FastAccumulator();
+        return 0;
+    }
+
+    private static int count(int n) {
+        int sum = 0;
+
+        for (int i = 0; i < n; i++) {
+            sum += counter.next();
+            if (i == 4)
+                installFastCounter();
+        }
+        return sum;
+    }
+
+    /*
+     * The class is linked during a call that returns to a non-empty
+     * operand stack so the frame can not be deoptimized there.
+     */
+    private static int accumulate(int n) {
+        int sum = 0;
+
+        for (int i = 0; i < n; i++)
+            sum += installFastAccumulatorAt(i, 5) + accumulator.next();
+        return sum;
+    }
+
+    /*
+     * The array operations make this method compile in SSA form with
+     * -Xssa.
+     */
+    private static int measure(int[] values) {
+        int sum = 0;
+
+        for (int i = 0; i < values.length; i++) {
+            sum += values[i] * gauge.next();
+            if (i == 4)
+                gauge = new FastGauge();
+        }
+        return sum;
+    }
+
+    private static int callValue(Base base) {
+        return base.value();
+    }
+
+    private static int callSubValue(Sub sub) {
+        return sub.value();
+    }
+
+    private static int callSides(Shape shape) {
+        return shape.sides();
+    }
+
+    private static int callLeafValue(Leaf leaf) {
+        return leaf.value();
+    }
+
+    private static Base newSub() {
+        return new Sub();
+    }
+
+    private static Sub newSubSub() {
+        return new SubSub();
+    }
+
+    private static Shape newSquare() {
+        return new Square();
+    }
+
+    private static Leaf newLeafSub() {
+        return new LeafSub();
+    }
+
+    public static void testOverridingClassLoadedAfterCompilation() {
+        assertEquals(1, callValue(new Base()));
+        assertEquals(2, callValue(newSub()));
+        assertEquals(1, callValue(new Base()));
+    }
+
+    public static void testDeeperOverridingClassLoadedAfterCompilation() {
+        assertEquals(2, callSubValue(new Sub()));
+        assertEquals(3, callSubValue(newSubSub()));
+        assertEquals(3, callValue(newSubSub()));
+    }
+
+    public static void testSecondImplementorLoadedAfterCompilation() {
+        assertEquals(3, callSides(new Triangle()));
+        assertEquals(4, callSides(newSquare()));
+        assertEquals(3, callSides(new Triangle()));
+    }
+
+    public static void testSubclassWithoutOverride() {
+        assertEquals(5, callLeafValue(new Leaf()));
+        assertEquals(5, callLeafValue(newLeafSub()));
+    }
+
+    public static void testOverridingClassLoadedDuringCall() {
+        counter = new Counter();
+        assertEquals(5 + 2 * 5, count(10));
+    }
+
+    public static void testOverridingClassLoadedDuringCallWithOperands() {
+        accumulator = new Accumulator();
+        assertEquals(5 + 2 * 5, accumulate(10));
+    }
+
+    public static void testOverridingClassLoadedDuringCallInArrayLoop() {
+        int[] values = new int[10];
+
+        for (int i = 0; i < values.length; i++)
+            values[i] = 1;
+
+        gauge = new Gauge();
+        assertEquals(5 + 2 * 5, measure(values));
+    }
+
+    public static void main(String[] args) {
+        testOverridingClassLoadedAfterCompilation();
+        testDeeperOverridingClassLoadedAfterCompilation();
+        testSecondImplementorLoadedAfterCompilation();
+        testSubclassWithoutOverride();
+        testOverridingClassLoadedDuringCall();
+        testOverridingClassLoadedDuringCallWithOperands();
+        testOverridingClassLoadedDuringCallInArrayLoop();
+    }
+}
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ */
+package jvm;
+
+/**
+ * Objects that do not escape their method are kept in temporaries. Their
+ * fields must behave exactly like fields of an allocated object.
+ */
+public class EscapeAnalysisTest extends TestCase {
+    private static Object escaped;
+
+    public static class Point {
+        public int x;
+        public int y;
+    }
+
+    public static class Values {
+        public long l;
+        public float f;
+        public double d;
+        public Object ref;
+    }
+
+    public static class Narrow {
+        public byte b;
+        public char c;
+        public short s;
+        public boolean z;
+    }
+
+    public static class Counter {
+        public int count;
+
+        public Counter() {
+            count = 1;
+        }
+    }
+
+    public static class Initialized {
+        public static int initialized;
+
+        public int value;
+
+        static {
+            initialized++;
+        }
+    }
+
+    public static int distance(int x1, int y1, int x2, int y2) {
+        Point a = new Point();
+        Point b = new Point();
+
+        a.x = x1;
+        a.y = y1;
+        b.x = x2;
+        b.y = y2;
+
+        return Math.abs(a.x - b.x) + Math.abs(a.y - b.y);
+    }
+
+    public static int sumInLoop(int n) {
+        int sum = 0;
+
+        for (int i = 0; i < n; i++) {
+            Point p = new Point();
+
+            sum += p.x;
+            p.x = i;
+            p.y = p.x * 2;
+            sum += p.y - p.x;
+        }
+
+        return sum;
+    }
+
+    public static int copies(int n) {
+        Point p = new Point();
+        Point q = p;
+
+        q.x = n;
+        p.y = q.x + 1;
+
+        return p.x + q.y;
+    }
+
+    public static int conditional(boolean flag) {
+        Point p = new Point();
+
+        if (flag)
+            p.x = 1;
+        else
+            p.y = 2;
+
+        return p.x * 10 + p.y;
+    }
+
+    public static double values(long l, float f, double d) {
+        Values v = new Values();
+
+        if (v.l != 0 || v.f != 0.0f || v.d != 0.0 || v.ref != null)
+            return -1;
+
+        v.l = l;
+        v.f = f;
+        v.d = d;
+        v.ref = "x";
+
+        return v.l + v.f + v.d + ((String) v.ref).length();
+    }
+
+    public static int narrow(int value) {
+        Narrow n = new Narrow();
+
+        n.b = (byte) value;
+        n.c = (char) value;
+        n.s = (short) value;
+        n.z = value != 0;
+
+        return n.b + n.c + n.s + (n.z ? 1 : 0);
+    }
+
+    public static Point returned(int x) {
+        Point p = new Point();
+
+        p.x = x;
+
+        return p;
+    }
+
+    public static int stored(int x) {
+        Point p = new Point();
+
+        p.x = x;
+        escaped = p;
+
+        return p.x;
+    }
+
+    public static int compared(int x) {
+        Point p = new Point();
+        Point q = new Point();
+
+        p.x = x;
+
+        return p == q ? -1 : p.x;
+    }
+
+    public static int constructed() {
+        Counter c = new Counter();
+
+        c.count++;
+
+        return c.count;
+    }
+
+    public static int initialized(int x) {
+        Initialized i = new Initialized();
+
+        i.value = x;
+
+        return i.value;
+    }
+
+    public static void testFields() {
+        assertEquals(7, distance(1, 2, 4, 6));
+        assertEquals(4950, sumInLoop(100));
+        assertEquals(7, copies(3));
+        assertEquals(10, conditional(true));
+        assertEquals(2, conditional(false));
+    }
+
+    public static void testFieldTypes() {
+        assertTrue(values(1000, 0.5f, 0.25) == 1001.75);
+        assertEquals(-1 + 0xffff - 1 + 1, narrow(0xffff));
+        assertEquals(0, narrow(0));
+    }
+
+    public static void testEscapingObjects() {
+        assertEquals(5, returned(5).x);
+        assertEquals(6, stored(6));
+        assertEquals(6, ((Point) escaped).x);
+        assertEquals(8, compared(8));
+        assertEquals(2, constructed());
+    }
+
+    public static void testStaticInitializer() {
+        assertEquals(9, initialized(9));
+        assertEquals(1, Initialized.initialized);
+    }
+
+    public static void main(String[] args) {
+        testFields();
+        testFieldTypes();
+        testEscapingObjects();
+        testStaticInitializer();
+    }
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ */
+package jvm;
+
+import java.util.HashMap;
+
+/**
+ * Young objects that are only reachable from old objects, static fields and
+ * arrays must survive minor collections of the nursery.
+ */
+public class GenerationalGCTest extends TestCase {
+    private static Node staticRef;
+
+    public static class Node {
+        public Node next;
+        public int value;
+
+        public Node(int value) {
+            this.value = value;
+        }
+    }
+
+    private static void garbage(int count) {
+        for (int i = 0; i < count; i++)
+            new int[16][4].clone();
+    }
+
+    public static void testOldObjectToYoungObject() {
+        Node old = new Node(0);
+
+        garbage(100000);
+
+        for (int i = 1; i <= 1000; i++) {
+            Node young = new Node(i);
+
+            young.next = old.next;
+            old.next = young;
+
+            garbage(100);
+        }
+
+        garbage(100000);
+
+        int expected = 1000;
+        for (Node node = old.next; node != null; node = node.next)
+            assertEquals(expected--, node.value);
+        assertEquals(0, expected);
+    }
+
+    public static void testStaticFieldToYoungObject() {
+        for (int i = 0; i < 100; i++) {
+            staticRef = new Node(i);
+
+            garbage(1000);
+
+            assertEquals(i, staticRef.value);
+        }
+    }
+
+    public static void testOldArrayToYoungObject() {
+        Node[] array = new Node[1000];
+
+        garbage(100000);
+
+        for (int i = 0; i < array.length; i++) {
+            array[i] = new Node(i);
+            garbage(100);
+        }
+
+        Node[] copy = new Node[array.length];
+        System.arraycopy(array, 0, copy, 0, array.length);
+        Node[] clone = (Node[]) array.clone();
+
+        garbage(100000);
+
+        for (int i = 0; i < array.length; i++) {
+            assertEquals(i, array[i].value);
+            assertSame(array[i], copy[i]);
+            assertSame(array[i], clone[i]);
+        }
+    }
+
+    public static void testIdentityHashCodeSurvivesCollections() {
+        Object object = new Object();
+        Node node = new Node(0);
+        int objectHash = object.hashCode();
+        int nodeHash = System.identityHashCode(node);
+
+        HashMap map = new HashMap();
+        map.put(object, node);
+
+        garbage(100000);
+
+        assertEquals(objectHash, object.hashCode());
+        assertEquals(nodeHash, System.identityHashCode(node));
+        assertSame(node, map.get(object));
+
+        garbage(100000);
+
+        assertEquals(objectHash, object.hashCode());
+        assertEquals(nodeHash, System.identityHashCode(node));
+        assertSame(node, map.get(object));
+    }
+
+    public static void main(String[] args) {
+        testOldObjectToYoungObject();
+        testStaticFieldToYoungObject();
+        testOldArrayToYoungObject();
+        testIdentityHashCodeSurvivesCollections();
+    }
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ */
+package jvm;
+
+/**
+ * @author Pekka Enberg
+ */
+public class InlineCacheTest extends TestCase {
+    public interface Polygon {
+        int sides();
+    }
+
+    public static class Shape implements Polygon {
+        public int sides() { return 0; }
+    }
+
+    public static class Triangle extends Shape {
+        public int sides() { return 3; }
+    }
+
+    public static class Square extends Shape {
+        public int sides() { return 4; }
+    }
+
+    public static class Pentagon extends Shape {
+        public int sides() { return 5; }
+    }
+
+    public static class Hexagon extends Shape {
+        public int sides() { return 6; }
+    }
+
+    public static class Octagon extends Shape {
+        public int sides() { return 8; }
+    }
+
+    public static class Line implements Polygon {
+        public int sides() { return 1; }
+    }
+
+    public static class Angle implements Polygon {
+        public int sides() { return 2; }
+    }
+
+    public static class Star implements Polygon {
+        public int sides() { return 10; }
+    }
+
+    private static int sides(Shape shape) {
+        return shape.sides();
+    }
+
+    private static int sumOfSides(Shape[] shapes, int iterations) {
+        int sum = 0;
+
+        for (int i = 0; i < iterations; i++) {
+            for (int j = 0; j < shapes.length; j++)
+                sum += sides(shapes[j]);
+        }
+        return sum;
+    }
+
+    private static int sides(Polygon polygon) {
+        return polygon.sides();
+    }
+
+    private static int sumOfSides(Polygon[] polygons, int iterations) {
+        int sum = 0;
+
+        for (int i = 0; i < iterations; i++) {
+            for (int j = 0; j < polygons.length; j++)
+                sum += sides(polygons[j]);
+        }
+        return sum;
+    }
+
+    public static void testMonomorphicCallSite() {
+        Shape[] shapes = { new Square() };
+
+        assertEquals(40, sumOfSides(shapes, 10));
+    }
+
+    public static void testBimorphicCallSite() {
+        Shape[] shapes = { new Triangle(), new Square() };
+
+        assertEquals(70, sumOfSides(shapes, 10));
+    }
+
+    public static void testPolymorphicCallSite() {
+        Shape[] shapes = { new Triangle(), new Square(), new Pentagon(), new Hexagon() };
+
+        assertEquals(180, sumOfSides(shapes, 10));
+    }
+
+    public static void testMegamorphicCallSite() {
+        Shape[] shapes = { new Shape(), new Triangle(), new Square(), new Pentagon(), new Hexagon(), new Octagon() };
+
+        assertEquals(260, sumOfSides(shapes, 10));
+    }
+
+    public static void testMonomorphicInterfaceCallSite() {
+        Polygon[] polygons = { new Line() };
+
+        assertEquals(10, sumOfSides(polygons, 10));
+    }
+
+    public static void testPolymorphicInterfaceCallSite() {
+        Polygon[] polygons = { new Line(), new Angle(), new Square() };
+
+        assertEquals(70, sumOfSides(polygons, 10));
+    }
+
+    public static void testMegamorphicInterfaceCallSite() {
+        Polygon[] polygons = { new Line(), new Angle(), new Square(), new Star(), new Triangle(), new Octagon() };
+
+        assertEquals(280, sumOfSides(polygons, 10));
+    }
+
+    public static void main(String[] args) {
+        testMonomorphicCallSite();
+        testBimorphicCallSite();
+        testPolymorphicCallSite();
+        testMegamorphicCallSite();
+        testMonomorphicInterfaceCallSite();
+        testPolymorphicInterfaceCallSite();
+        testMegamorphicInterfaceCallSite();
+    }
+}
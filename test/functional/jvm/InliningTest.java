@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ */
+package jvm;
+
+/**
+ * @author Pekka Enberg
+ */
+public class InliningTest extends TestCase {
+    private int value;
+
+    public InliningTest(int value) {
+        this.value = value;
+    }
+
+    private static int add(int a, int b) {
+        return a + b;
+    }
+
+    private static long addLong(long a, int b, long c) {
+        return a + b + c;
+    }
+
+    private static double scale(double x, float y) {
+        return x * y;
+    }
+
+    private static int twice(int x) {
+        return add(x, x);
+    }
+
+    private static int abs(int x) {
+        if (x < 0)
+            return -x;
+        return x;
+    }
+
+    private int getValue() {
+        return value;
+    }
+
+    public final int plus(int x) {
+        return value + x;
+    }
+
+    private static int divide(int a, int b) {
+        return a / b;
+    }
+
+    private static int callDivide(int a, int b) {
+        return divide(a, b);
+    }
+
+    public static void testInlineStaticMethod() {
+        assertEquals(3, add(1, 2));
+        assertEquals(8, twice(4));
+        assertEquals(5, abs(-5));
+        assertEquals(5, abs(5));
+    }
+
+    public static void testInlineWideArguments() {
+        assertEquals(6L, addLong(1L, 2, 3L));
+        assertEquals(0x100000001L, addLong(0xffffffffL, 1, 1L));
+        assertEquals(3.0, scale(1.5, 2.0f));
+    }
+
+    public static void testInlineInstanceMethod() {
+        InliningTest t = new InliningTest(42);
+
+        assertEquals(42, t.getValue());
+        assertEquals(43, t.plus(1));
+    }
+
+    public static void testInlineNullReceiver() {
+        InliningTest t = null;
+
+        try {
+            t.plus(1);
+            fail();
+        } catch (NullPointerException e) {
+        }
+    }
+
+    public static void testInlinedStackTrace() {
+        StackTraceElement []st = null;
+
+        try {
+            callDivide(1, 0);
+        } catch (ArithmeticException e) {
+            st = e.getStackTrace();
+        }
+
+        assertNotNull(st);
+
+        assertStackTraceElement(st[0], 50, "InliningTest.java",
+                "jvm.InliningTest", "divide", false);
+
+        assertStackTraceElement(st[1], 54, "InliningTest.java",
+                "jvm.InliningTest", "callDivide", false);
+
+        assertStackTraceElement(st[2], 91, "InliningTest.java",
+                "jvm.InliningTest", "testInlinedStackTrace", false);
+    }
+
+    public static void main(String[] args) {
+        testInlineStaticMethod();
+        testInlineWideArguments();
+        testInlineInstanceMethod();
+        testInlineNullReceiver();
+        testInlinedStackTrace();
+    }
+}
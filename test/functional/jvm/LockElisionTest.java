@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ */
+package jvm;
+
+/**
+ * Locking that the JIT removes or merges must still be held where the
+ * program needs it and must be released when the method returns or
+ * throws. tools/test.py also runs this with -Xtrace:locks and checks that
+ * locks of nested(), nestedThrows() and consecutive() were elided.
+ */
+public class LockElisionTest extends TestCase {
+    private int count;
+
+    public static class Holder {
+        public int value;
+    }
+
+    public static int localLock(int n) {
+        Object lock = new Object();
+        int result;
+
+        synchronized (lock) {
+            result = n + 1;
+        }
+
+        return result;
+    }
+
+    public static int localLockWithFields(int n) {
+        Holder h = new Holder();
+
+        synchronized (h) {
+            h.value = n;
+        }
+        synchronized (h) {
+            h.value++;
+        }
+
+        return h.value;
+    }
+
+    public static int localLockThrows(int n) {
+        Object lock = new Object();
+
+        try {
+            synchronized (lock) {
+                if (n > 0)
+                    throw new IllegalStateException();
+            }
+        } catch (IllegalStateException e) {
+            return -1;
+        }
+
+        return n;
+    }
+
+    public synchronized int nested(int n) {
+        synchronized (this) {
+            count += n;
+            notify();
+        }
+
+        return count;
+    }
+
+    public synchronized void nestedThrows() {
+        synchronized (this) {
+            throw new IllegalStateException();
+        }
+    }
+
+    public static int consecutive(Holder lock, int n) {
+        synchronized (lock) {
+            lock.value += n;
+            lock.notify();
+        }
+        synchronized (lock) {
+            lock.value *= 2;
+            lock.notify();
+        }
+        synchronized (lock) {
+            if (n < 0)
+                throw new IllegalArgumentException();
+            lock.notify();
+        }
+
+        return lock.value;
+    }
+
+    private static void assertUnlocked(final Object lock) throws InterruptedException {
+        Thread t = new Thread() {
+            public void run() {
+                synchronized (lock) {
+                }
+            }
+        };
+
+        t.start();
+        t.join(10000);
+
+        assertFalse(t.isAlive());
+    }
+
+    public static void testNonEscapingLocks() {
+        assertEquals(2, localLock(1));
+        assertEquals(4, localLockWithFields(3));
+        assertEquals(-1, localLockThrows(1));
+        assertEquals(0, localLockThrows(0));
+    }
+
+    public static void testRecursiveLocks() throws InterruptedException {
+        LockElisionTest t = new LockElisionTest();
+
+        assertEquals(3, t.nested(3));
+        assertUnlocked(t);
+
+        try {
+            t.nestedThrows();
+            fail();
+        } catch (IllegalStateException e) {
+        }
+
+        assertUnlocked(t);
+    }
+
+    public static void testConsecutiveLocks() throws InterruptedException {
+        Holder lock = new Holder();
+
+        assertEquals(6, consecutive(lock, 3));
+        assertUnlocked(lock);
+
+        try {
+            consecutive(lock, -1);
+            fail();
+        } catch (IllegalArgumentException e) {
+        }
+
+        assertEquals(10, lock.value);
+        assertUnlocked(lock);
+    }
+
+    public static void main(String[] args) throws InterruptedException {
+        testNonEscapingLocks();
+        testRecursiveLocks();
+        testConsecutiveLocks();
+    }
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ */
+package jvm;
+
+/**
+ * Field loads, array length loads and address computations that are moved
+ * out of loops or computed only once must still see every store.
+ */
+public class LoopInvariantCodeMotionTest extends TestCase {
+    private static final int N = 1000;
+
+    private int[] values;
+    private int scale;
+    private int count;
+    private long total;
+    private volatile boolean done;
+
+    public static class Point {
+        public int x;
+        public int y;
+    }
+
+    public int scaledSum() {
+        int sum = 0;
+
+        for (int i = 0; i < values.length; i++)
+            sum += values[i] * scale;
+
+        return sum;
+    }
+
+    public int countUp(int n) {
+        for (int i = 0; i < n; i++)
+            count = count + 1;
+
+        return count;
+    }
+
+    private void bump() {
+        scale++;
+    }
+
+    public int sumWithCall(int n) {
+        int sum = 0;
+
+        for (int i = 0; i < n; i++) {
+            sum += scale;
+            bump();
+        }
+
+        return sum;
+    }
+
+    public static int arrayLength(int[] array) {
+        int sum = 0;
+
+        for (int i = 0; i < array.length; i++)
+            sum += array[i];
+
+        return sum;
+    }
+
+    public static int guardedLoad(Point p, int n) {
+        int sum = 0;
+
+        for (int i = 0; i < n; i++) {
+            if (p != null)
+                sum += p.x;
+        }
+
+        return sum;
+    }
+
+    public static int aliasedStore(Point p, Point q, int n) {
+        int sum = 0;
+
+        for (int i = 0; i < n; i++) {
+            sum += p.x;
+            q.x = i;
+        }
+
+        return sum;
+    }
+
+    public static int matrixSum(int[][] matrix) {
+        int sum = 0;
+
+        for (int i = 0; i < matrix.length; i++) {
+            for (int j = 0; j < matrix[i].length; j++)
+                sum += matrix[i][j];
+        }
+
+        return sum;
+    }
+
+    public static long longSums(long a, long b) {
+        long x = a + b;
+        long y = a + b;
+
+        return x * 3 + y - (a - b) - (a - b);
+    }
+
+    public static int reassignedLocal(int n) {
+        int sum = 0;
+        int k = 7;
+
+        for (int i = 0; i < n; i++) {
+            sum += k;
+            k = i;
+        }
+
+        return sum;
+    }
+
+    public int spin() {
+        int iterations = 0;
+
+        while (!done)
+            iterations++;
+
+        return iterations;
+    }
+
+    public long accumulate(int n) {
+        for (int i = 0; i < n; i++)
+            total += i;
+
+        return total;
+    }
+
+    public static void testFieldLoadsInLoop() {
+        LoopInvariantCodeMotionTest t = new LoopInvariantCodeMotionTest();
+
+        t.values = new int[N];
+        for (int i = 0; i < N; i++)
+            t.values[i] = i;
+        t.scale = 2;
+
+        assertEquals(N * (N - 1), t.scaledSum());
+    }
+
+    public static void testFieldStoredInLoop() {
+        LoopInvariantCodeMotionTest t = new LoopInvariantCodeMotionTest();
+
+        assertEquals(N, t.countUp(N));
+        assertEquals(2 * N, t.countUp(N));
+        assertEquals((long) N * (N - 1) / 2, t.accumulate(N));
+    }
+
+    public static void testFieldStoredByCallInLoop() {
+        LoopInvariantCodeMotionTest t = new LoopInvariantCodeMotionTest();
+
+        assertEquals(N * (N - 1) / 2, t.sumWithCall(N));
+        assertEquals(N, t.scale);
+    }
+
+    public static void testArrayLengthOfNullArray() {
+        try {
+            arrayLength(null);
+            fail();
+        } catch (NullPointerException e) {
+        }
+
+        assertEquals(6, arrayLength(new int[] { 1, 2, 3 }));
+    }
+
+    public static void testGuardedFieldLoad() {
+        Point p = new Point();
+
+        p.x = 3;
+
+        assertEquals(0, guardedLoad(null, N));
+        assertEquals(3 * N, guardedLoad(p, N));
+    }
+
+    public static void testAliasedFieldStore() {
+        Point p = new Point();
+        Point q = new Point();
+
+        p.x = 1;
+        assertEquals(N, aliasedStore(p, q, N));
+        assertEquals(N - 1, q.x);
+
+        p.x = 1;
+        assertEquals(1 + (N - 1) * (N - 2) / 2, aliasedStore(p, p, N));
+    }
+
+    public static void testNestedLoops() {
+        int[][] matrix = new int[10][];
+
+        for (int i = 0; i < matrix.length; i++) {
+            matrix[i] = new int[i];
+            for (int j = 0; j < i; j++)
+                matrix[i][j] = 1;
+        }
+
+        assertEquals(45, matrixSum(matrix));
+    }
+
+    public static void testCommonSubexpressions() {
+        assertEquals(4 * 0x100000001L - 2 * (0x100000000L - 1), longSums(0x100000000L, 1));
+        assertEquals(7 + (N - 1) * (N - 2) / 2, reassignedLocal(N));
+    }
+
+    public static void testVolatileFieldInLoop() throws InterruptedException {
+        final LoopInvariantCodeMotionTest t = new LoopInvariantCodeMotionTest();
+
+        Thread thread = new Thread() {
+            public void run() {
+                t.done = true;
+            }
+        };
+
+        thread.start();
+        t.spin();
+        thread.join();
+
+        assertTrue(t.done);
+    }
+
+    public static void main(String[] args) throws InterruptedException {
+        testFieldLoadsInLoop();
+        testFieldStoredInLoop();
+        testFieldStoredByCallInLoop();
+        testArrayLengthOfNullArray();
+        testGuardedFieldLoad();
+        testAliasedFieldStore();
+        testNestedLoops();
+        testCommonSubexpressions();
+        testVolatileFieldInLoop();
+    }
+}
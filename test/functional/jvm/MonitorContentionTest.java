@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ */
+package jvm;
+
+/**
+ * Threads that spin or block on a monitor owned by another thread must
+ * acquire it once it is released and mutual exclusion must hold.
+ */
+public class MonitorContentionTest extends TestCase {
+    public static class Counter {
+        public int value;
+
+        public synchronized void increment() {
+            value++;
+        }
+
+        public synchronized void slowIncrement() {
+            int v = value;
+
+            for (int i = 0; i < 1000; i++)
+                Thread.yield();
+
+            value = v + 1;
+        }
+    }
+
+    private static void runThreads(Thread[] threads) throws InterruptedException {
+        for (int i = 0; i < threads.length; i++)
+            threads[i].start();
+
+        for (int i = 0; i < threads.length; i++) {
+            threads[i].join(60000);
+            assertFalse(threads[i].isAlive());
+        }
+    }
+
+    public static void testShortCriticalSections() throws InterruptedException {
+        final Counter counter = new Counter();
+        Thread[] threads = new Thread[8];
+
+        for (int i = 0; i < threads.length; i++) {
+            threads[i] = new Thread() {
+                public void run() {
+                    for (int j = 0; j < 20000; j++)
+                        counter.increment();
+                }
+            };
+        }
+
+        runThreads(threads);
+
+        assertEquals(160000, counter.value);
+    }
+
+    public static void testLongCriticalSections() throws InterruptedException {
+        final Counter counter = new Counter();
+        Thread[] threads = new Thread[4];
+
+        for (int i = 0; i < threads.length; i++) {
+            threads[i] = new Thread() {
+                public void run() {
+                    for (int j = 0; j < 50; j++)
+                        counter.slowIncrement();
+                }
+            };
+        }
+
+        runThreads(threads);
+
+        assertEquals(200, counter.value);
+    }
+
+    public static void testContendedWaitNotify() throws InterruptedException {
+        final Counter counter = new Counter();
+        Thread[] threads = new Thread[4];
+
+        for (int i = 0; i < threads.length; i++) {
+            threads[i] = new Thread() {
+                public void run() {
+                    for (int j = 0; j < 100; j++) {
+                        synchronized (counter) {
+                            counter.value++;
+                            counter.notifyAll();
+
+                            try {
+                                counter.wait(1);
+                            } catch (InterruptedException e) {
+                            }
+                        }
+                    }
+                }
+            };
+        }
+
+        runThreads(threads);
+
+        assertEquals(400, counter.value);
+    }
+
+    public static void main(String[] args) throws InterruptedException {
+        testShortCriticalSections();
+        testLongCriticalSections();
+        testContendedWaitNotify();
+    }
+}
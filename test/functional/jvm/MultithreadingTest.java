@@ -40,8 +40,45 @@ public class MultithreadingTest extends TestCase {
         assertTrue(t.thread_run);
     }
 
+    static class CounterThread extends Thread {
+        private final Object lock;
+        public static int counter;
+
+        public CounterThread(Object lock) {
+            this.lock = lock;
+        }
+
+        public void run() {
+            for (int i = 0; i < 10000; i++) {
+                synchronized (lock) {
+                    counter++;
+                }
+            }
+        }
+    };
+
+    public static void testContendedMonitor() {
+        Object lock = new Object();
+        CounterThread[] threads = new CounterThread[4];
+
+        for (int i = 0; i < threads.length; i++) {
+            threads[i] = new CounterThread(lock);
+            threads[i].start();
+        }
+
+        try {
+            for (int i = 0; i < threads.length; i++)
+                threads[i].join();
+        } catch (InterruptedException e) {
+            fail();
+        }
+
+        assertEquals(40000, CounterThread.counter);
+    }
+
     public static void main(String []args) {
         testMainThread();
         testThreadIsExecuted();
+        testContendedMonitor();
     }
 }
@@ -70,9 +70,37 @@ public class ObjectCreationAndManipulationExceptionsTest extends TestCase {
         takeObject(s);
     }
 
+    public static void testCheckcastToSubclassThrowsClassCastException() {
+        boolean caught = false;
+        Object o = new Exception();
+        RuntimeException e = null;
+
+        try {
+            e = (RuntimeException) o;
+        } catch (ClassCastException cce) {
+            caught = true;
+        }
+
+        assertTrue(caught);
+
+        caught = false;
+        o = new Object[1];
+
+        try {
+            takeObject((String[]) o);
+        } catch (ClassCastException cce) {
+            caught = true;
+        }
+
+        assertTrue(caught);
+
+        takeObject(e);
+    }
+
     public static void main(String args[]) {
         testGetfieldThrowsNullPointerException();
         testPutfieldThrowsNullPointerException();
         testCheckcastThrowsClassCastException();
+        testCheckcastToSubclassThrowsClassCastException();
     }
 }
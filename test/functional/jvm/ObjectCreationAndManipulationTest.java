@@ -29,6 +29,25 @@ public class ObjectCreationAndManipulationTest extends TestCase {
         assertEquals(1, fields.field);
     }
 
+    public static void testManyNewObjects() {
+        ListNode head = null;
+
+        for (int i = 0; i < 10000; i++) {
+            ListNode node = new ListNode();
+            assertNull(node.next);
+            assertEquals(0, node.value);
+            node.value = i;
+            node.next = head;
+            head = node;
+        }
+
+        for (int i = 9999; i >= 0; i--) {
+            assertEquals(i, head.value);
+            head = head.next;
+        }
+        assertNull(head);
+    }
+
     public static void testNewArray() {
         int[] array = null;
         assertNull(array);
@@ -63,6 +82,28 @@ public class ObjectCreationAndManipulationTest extends TestCase {
         assertFalse(null instanceof Object);
     }
 
+    public static void testIsInstanceOfClassHierarchy() {
+        Object obj = new Level9();
+
+        assertTrue(obj instanceof Level1);
+        assertTrue(obj instanceof Level5);
+        assertTrue(obj instanceof Level8);
+        assertTrue(obj instanceof Level9);
+        assertTrue(obj instanceof Marker);
+        assertFalse(obj instanceof ClassFields);
+
+        obj = new Level5();
+        assertTrue(obj instanceof Marker);
+        assertFalse(obj instanceof Level6);
+        assertFalse(obj instanceof Level9);
+
+        obj = new String[1];
+        assertTrue(obj instanceof Object[]);
+        assertTrue(obj instanceof Cloneable);
+        assertFalse(obj instanceof Integer[]);
+        assertFalse(new int[1] instanceof Object[]);
+    }
+
     public static void testByteArrayLoadAndStore() {
         byte[] array = new byte[5];
         array[1] = 1;
@@ -163,11 +204,13 @@ public class ObjectCreationAndManipulationTest extends TestCase {
         testNewObject();
         testObjectInitialization();
         testInstanceFieldAccess();
+        testManyNewObjects();
         testNewArray();
         testANewArray();
         testArrayLength();
         testMultiANewArray();
         testIsInstanceOf();
+        testIsInstanceOfClassHierarchy();
         testIntArrayLoadAndStore();
         testCharArrayLoadAndStore();
         testByteArrayLoadAndStore();
@@ -194,4 +237,20 @@ public class ObjectCreationAndManipulationTest extends TestCase {
     private static class InstanceFields {
         public int field;
     };
+
+    private static class ListNode {
+        public ListNode next;
+        public int value;
+    };
+
+    private static interface Marker { }
+    private static class Level1 { }
+    private static class Level2 extends Level1 { }
+    private static class Level3 extends Level2 implements Marker { }
+    private static class Level4 extends Level3 { }
+    private static class Level5 extends Level4 { }
+    private static class Level6 extends Level5 { }
+    private static class Level7 extends Level6 { }
+    private static class Level8 extends Level7 { }
+    private static class Level9 extends Level8 { }
 }
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ */
+package jvm;
+
+/**
+ * Loops that get hot while their method runs in the interpreter continue in
+ * compiled code with the values of all local variables preserved.
+ */
+public class OnStackReplacementTest extends TestCase {
+    private static final int N = 100000;
+
+    public static int intLoop(int n) {
+        int sum = 0;
+
+        for (int i = 0; i < n; i++)
+            sum += i;
+
+        return sum;
+    }
+
+    public static long longLoop(long start, int n) {
+        long sum = start;
+
+        for (int i = 0; i < n; i++)
+            sum += i;
+
+        return sum;
+    }
+
+    public static double doubleLoop(int n) {
+        double sum = 0.5;
+
+        for (int i = 0; i < n; i++)
+            sum += 1.0;
+
+        return sum;
+    }
+
+    public static float floatLoop(int n) {
+        float sum = 0.5f;
+
+        for (int i = 0; i < n; i++)
+            sum += 1.0f;
+
+        return sum;
+    }
+
+    public static int nestedLoop(int n) {
+        int sum = 0;
+
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < 10; j++)
+                sum++;
+        }
+
+        return sum;
+    }
+
+    public int instanceLoop(int[] values) {
+        int sum = 0;
+
+        for (int i = 0; i < values.length; i++)
+            sum += values[i];
+
+        return sum;
+    }
+
+    public static int throwingLoop(int n) {
+        int[] array = new int[n];
+
+        for (int i = 0; ; i++)
+            array[i] = i;
+    }
+
+    public static void testIntLoop() {
+        assertEquals(N * (N - 1) / 2, intLoop(N));
+    }
+
+    public static void testLongLoop() {
+        assertEquals(0x100000000L + (long) N * (N - 1) / 2, longLoop(0x100000000L, N));
+    }
+
+    public static void testDoubleLoop() {
+        assertEquals(N + 0.5, doubleLoop(N));
+    }
+
+    public static void testFloatLoop() {
+        assertEquals(1000.5f, floatLoop(1000));
+    }
+
+    public static void testNestedLoop() {
+        assertEquals(N * 10, nestedLoop(N));
+    }
+
+    public static void testInstanceLoop() {
+        int[] values = new int[N];
+
+        for (int i = 0; i < N; i++)
+            values[i] = 2;
+
+        assertEquals(2 * N, new OnStackReplacementTest().instanceLoop(values));
+    }
+
+    public static void testExceptionFromCompiledLoop() {
+        try {
+            throwingLoop(N);
+            fail();
+        } catch (ArrayIndexOutOfBoundsException e) {
+        }
+    }
+
+    public static void main(String[] args) {
+        testIntLoop();
+        testLongLoop();
+        testDoubleLoop();
+        testFloatLoop();
+        testNestedLoop();
+        testInstanceLoop();
+        testExceptionFromCompiledLoop();
+    }
+}
@@ -114,10 +114,90 @@ class SwitchTest extends TestCase {
         assertEquals(-7, index);
     }
 
+    private static int sparseLookupswitch(int key) {
+        switch (key) {
+        case Integer.MIN_VALUE:
+            return 1;
+        case -65536:
+            return 2;
+        case -100:
+            return 3;
+        case -34:
+            return 4;
+        case 0:
+            return 5;
+        case 221:
+            return 6;
+        case 2000:
+            return 7;
+        case 4000:
+            return 8;
+        case 50000:
+            return 9;
+        case 1000000:
+            return 10;
+        case Integer.MAX_VALUE:
+            return 11;
+        default:
+            return -1;
+        }
+    }
+
+    public static void testSparseLookupswitch() {
+        assertEquals(1, sparseLookupswitch(Integer.MIN_VALUE));
+        assertEquals(2, sparseLookupswitch(-65536));
+        assertEquals(3, sparseLookupswitch(-100));
+        assertEquals(4, sparseLookupswitch(-34));
+        assertEquals(5, sparseLookupswitch(0));
+        assertEquals(6, sparseLookupswitch(221));
+        assertEquals(7, sparseLookupswitch(2000));
+        assertEquals(8, sparseLookupswitch(4000));
+        assertEquals(9, sparseLookupswitch(50000));
+        assertEquals(10, sparseLookupswitch(1000000));
+        assertEquals(11, sparseLookupswitch(Integer.MAX_VALUE));
+
+        assertEquals(-1, sparseLookupswitch(Integer.MIN_VALUE + 1));
+        assertEquals(-1, sparseLookupswitch(-101));
+        assertEquals(-1, sparseLookupswitch(-33));
+        assertEquals(-1, sparseLookupswitch(1));
+        assertEquals(-1, sparseLookupswitch(2001));
+        assertEquals(-1, sparseLookupswitch(3999));
+        assertEquals(-1, sparseLookupswitch(Integer.MAX_VALUE - 1));
+    }
+
+    private static int denseLookupswitch(int key) {
+        switch (key) {
+        case 0:
+            return 1;
+        case 4:
+            return 2;
+        case 8:
+            return 3;
+        case 11:
+            return 4;
+        default:
+            return -1;
+        }
+    }
+
+    public static void testDenseLookupswitch() {
+        int[] expected = { 1, -1, -1, -1, 2, -1, -1, -1, 3, -1, -1, 4 };
+
+        for (int i = 0; i < expected.length; i++)
+            assertEquals(expected[i], denseLookupswitch(i));
+
+        assertEquals(-1, denseLookupswitch(-1));
+        assertEquals(-1, denseLookupswitch(12));
+        assertEquals(-1, denseLookupswitch(Integer.MIN_VALUE));
+        assertEquals(-1, denseLookupswitch(Integer.MAX_VALUE));
+    }
+
     public static void main(String []args) {
         testSwitchCaseMatches();
         testSwitchDefault();
         testLookupswitchCaseMatches();
         testLookupswitchDefault();
+        testSparseLookupswitch();
+        testDenseLookupswitch();
     }
 }
\ No newline at end of file
@@ -17,6 +17,43 @@ public class SynchronizationTest extends TestCase {
         }
     }
 
+    public static void testNestedMonitorEnterAndExit() {
+        Object outer = new Object();
+        Object inner = new Object();
+        int x = 0;
+
+        synchronized (outer) {
+            synchronized (inner) {
+                synchronized (outer) {
+                    x++;
+                }
+                x++;
+            }
+            x++;
+        }
+
+        synchronized (inner) {
+            x++;
+        }
+
+        assertEquals(4, x);
+    }
+
+    public static synchronized long staticSynchronizedLongMethod(long x) {
+        return x;
+    }
+
+    public synchronized double synchronizedDoubleMethod(double x) {
+        return x;
+    }
+
+    public static void testSynchronizedMethodReturnValue() {
+        SynchronizationTest test = new SynchronizationTest();
+
+        assertEquals(0x123456789abcdefL, staticSynchronizedLongMethod(0x123456789abcdefL));
+        assertEquals(1.5, test.synchronizedDoubleMethod(1.5));
+    }
+
     public static synchronized int staticSynchronizedMethod(int x) {
         return x;
     }
@@ -71,9 +108,11 @@ public class SynchronizationTest extends TestCase {
 
     public static void main(String[] args) {
         testMonitorEnterAndExit();
+        testNestedMonitorEnterAndExit();
         testStaticSynchronizedMethod();
         testSynchronizedMethod();
         testStaticSynchronizedExceptingMethod();
         testSynchronizedExceptingMethod();
+        testSynchronizedMethodReturnValue();
     }
 }
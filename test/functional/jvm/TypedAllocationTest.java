@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ */
+package jvm;
+
+/**
+ * The GC only scans the reference fields of objects allocated with the
+ * descriptor of their class. Objects reachable only through inherited and
+ * own reference fields of such objects must survive collections.
+ */
+public class TypedAllocationTest extends TestCase {
+    public static class Base {
+        public long a0, a1, a2, a3, a4, a5, a6, a7;
+        public Object baseRef;
+        public int b0, b1, b2, b3;
+    }
+
+    public static class Node extends Base {
+        public long c0, c1, c2, c3, c4, c5, c6, c7;
+        public double d0, d1, d2, d3, d4, d5, d6, d7;
+        public Node next;
+        public String name;
+        public int value;
+    }
+
+    public static class SmallNode {
+        public int value;
+        public SmallNode next;
+    }
+
+    private static Node buildList(int n) {
+        Node head = null;
+
+        for (int i = 0; i < n; i++) {
+            Node node = new Node();
+
+            node.a7 = i;
+            node.c7 = -i;
+            node.value = i;
+            node.name = "node" + i;
+            node.baseRef = new int[] { i };
+            node.next = head;
+            head = node;
+        }
+
+        return head;
+    }
+
+    private static void makeGarbage() {
+        for (int i = 0; i < 100000; i++)
+            new Object();
+
+        System.gc();
+    }
+
+    public static void testLargeObjects() {
+        Node head = buildList(1000);
+
+        makeGarbage();
+
+        int i = 999;
+        for (Node node = head; node != null; node = node.next, i--) {
+            assertEquals(i, node.value);
+            assertEquals(i, node.a7);
+            assertEquals(-i, node.c7);
+            assertEquals("node" + i, node.name);
+            assertEquals(i, ((int[]) node.baseRef)[0]);
+        }
+
+        assertEquals(-1, i);
+    }
+
+    public static void testSmallObjects() {
+        SmallNode head = null;
+
+        for (int i = 0; i < 1000; i++) {
+            SmallNode node = new SmallNode();
+
+            node.value = i;
+            node.next = head;
+            head = node;
+        }
+
+        makeGarbage();
+
+        int i = 999;
+        for (SmallNode node = head; node != null; node = node.next, i--)
+            assertEquals(i, node.value);
+
+        assertEquals(-1, i);
+    }
+
+    public static void testClone() throws CloneNotSupportedException {
+        CloneableNode node = new CloneableNode();
+
+        node.value = 42;
+        node.next = new Node();
+        node.next.value = 7;
+
+        CloneableNode copy = (CloneableNode) node.clone();
+
+        makeGarbage();
+
+        assertEquals(42, copy.value);
+        assertEquals(7, copy.next.value);
+    }
+
+    public static class CloneableNode extends Node implements Cloneable {
+        public Object clone() throws CloneNotSupportedException {
+            return super.clone();
+        }
+    }
+
+    public static void main(String[] args) throws CloneNotSupportedException {
+        testLargeObjects();
+        testSmallObjects();
+        testClone();
+    }
+}
@@ -0,0 +1,91 @@
+import java.util.ArrayList;
+import java.util.HashMap;
+
+public class ArrayStoreTime {
+  private static final int NUM_STORES = 1000000;
+  private static final int NUM_ELEMENTS = 1024;
+
+  private static class Element {
+    public int value;
+  }
+
+  private static class SubElement extends Element {
+  }
+
+  private static Object[] objects = new Object[NUM_ELEMENTS];
+  private static Element[] elements = new Element[NUM_ELEMENTS];
+
+  private static void storeObjects(Object value) {
+    for (int i = 0; i < NUM_STORES; ++i) {
+      objects[i & (NUM_ELEMENTS - 1)] = value;
+    }
+  }
+
+  private static void storeElements(Element value) {
+    for (int i = 0; i < NUM_STORES; ++i) {
+      elements[i & (NUM_ELEMENTS - 1)] = value;
+    }
+  }
+
+  private static void fillArrayList() {
+    ArrayList list = new ArrayList();
+    Element e = new Element();
+
+    for (int i = 0; i < NUM_STORES; ++i) {
+      list.add(e);
+    }
+  }
+
+  private static void fillHashMap() {
+    HashMap map = new HashMap();
+
+    for (int i = 0; i < NUM_STORES / 10; ++i) {
+      map.put(new Integer(i), new Element());
+    }
+  }
+
+  private static void warmup() {
+    // Make sure all classes are loaded and all methods are compiled
+    storeObjects(new Element());
+    storeElements(new Element());
+    storeElements(new SubElement());
+    fillArrayList();
+    fillHashMap();
+  }
+
+  private static void report(String name, long start, long stop) {
+    long usecs = (stop - start) / 1000;
+
+    System.out.println(name + " = " + usecs + " usecs");
+  }
+
+  public static void main(String[] args) {
+    long start;
+
+    warmup();
+
+    start = System.nanoTime();
+    storeObjects(new Element());
+    report("Object[] store", start, System.nanoTime());
+
+    start = System.nanoTime();
+    storeObjects(null);
+    report("Object[] null store", start, System.nanoTime());
+
+    start = System.nanoTime();
+    storeElements(new Element());
+    report("Element[] exact store", start, System.nanoTime());
+
+    start = System.nanoTime();
+    storeElements(new SubElement());
+    report("Element[] subclass store", start, System.nanoTime());
+
+    start = System.nanoTime();
+    fillArrayList();
+    report("ArrayList.add", start, System.nanoTime());
+
+    start = System.nanoTime();
+    fillHashMap();
+    report("HashMap.put", start, System.nanoTime());
+  }
+}
@@ -0,0 +1,52 @@
+public class PrimitiveArrayAllocTime {
+  private static final int NUM_ALLOCS = 1000000;
+  private static final int MAX_THREADS = 4;
+
+  private static class Allocator extends Thread {
+    public int sum;
+
+    public void run() {
+      for (int i = 0; i < NUM_ALLOCS; ++i) {
+        int[] a = new int[8];
+        a[0] = i;
+        sum += a.length;
+      }
+    }
+  }
+
+  private static void warmup() {
+    // Make sure the allocation loop is compiled
+    Allocator a = new Allocator();
+    a.run();
+  }
+
+  private static void profileAlloc(int nr_threads) throws InterruptedException {
+    Allocator[] threads = new Allocator[nr_threads];
+
+    for (int i = 0; i < nr_threads; ++i) {
+      threads[i] = new Allocator();
+    }
+
+    long start = System.nanoTime();
+    for (int i = 0; i < nr_threads; ++i) {
+      threads[i].start();
+    }
+    for (int i = 0; i < nr_threads; ++i) {
+      threads[i].join();
+    }
+    long stop = System.nanoTime();
+
+    long nr_allocs = (long) nr_threads * NUM_ALLOCS;
+    long usecs = (stop - start) / 1000;
+
+    System.out.println("IntArrayAlloc threads=" + nr_threads + " = "
+        + (nr_allocs * 1000 / (usecs + 1)) + " allocs/ms");
+  }
+
+  public static void main(String[] args) throws InterruptedException {
+    warmup();
+    for (int nr_threads = 1; nr_threads <= MAX_THREADS; nr_threads *= 2) {
+      profileAlloc(nr_threads);
+    }
+  }
+}
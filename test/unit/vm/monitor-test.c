@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ */
+
+#include <libharness.h>
+
+#include "vm/monitor.h"
+
+void test_spin_limit_grows_when_lock_is_released_while_spinning(void)
+{
+	int limit = INITIAL_SPIN_LIMIT;
+
+	limit = vm_monitor_adapt_spin_limit(limit, true);
+	assert_int_equals(INITIAL_SPIN_LIMIT * 2, limit);
+
+	limit = vm_monitor_adapt_spin_limit(limit, true);
+	assert_int_equals(INITIAL_SPIN_LIMIT * 4, limit);
+}
+
+void test_spin_limit_shrinks_when_lock_is_not_released_while_spinning(void)
+{
+	int limit = INITIAL_SPIN_LIMIT;
+
+	limit = vm_monitor_adapt_spin_limit(limit, false);
+	assert_int_equals(INITIAL_SPIN_LIMIT / 2, limit);
+
+	limit = vm_monitor_adapt_spin_limit(limit, true);
+	assert_int_equals(INITIAL_SPIN_LIMIT, limit);
+}
+
+void test_spin_limit_stays_within_bounds(void)
+{
+	int limit = INITIAL_SPIN_LIMIT;
+
+	for (int i = 0; i < 32; i++)
+		limit = vm_monitor_adapt_spin_limit(limit, true);
+	assert_int_equals(MAX_SPIN_LIMIT, limit);
+
+	for (int i = 0; i < 32; i++)
+		limit = vm_monitor_adapt_spin_limit(limit, false);
+	assert_int_equals(MIN_SPIN_LIMIT, limit);
+}
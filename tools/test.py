@@ -6,6 +6,7 @@ import multiprocessing
 import subprocess
 import platform
 import argparse
+import re
 import time
 import sys
 import os
@@ -26,6 +27,9 @@ RUNTIME = [
 
 NO_SYSTEM_CLASSLOADER = [ "-Xnosystemclassloader", "-bootclasspath", "test/functional" ]
 
+# A test can have a list of regular expressions as a fifth element. Each
+# of them must match a line that the VM prints to stderr.
+
 TESTS = [
   #                            Exit
   #  Test                      Code  Extra VM arguments       Architectures
@@ -40,10 +44,16 @@ TESTS = [
 , ( "jvm.ArrayExceptionsTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.ArrayMemberTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.ArrayTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.ArrayTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xssa" ], [ "i386" ] )
+, ( "jvm.BiasedLockingTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.BiasedLockingTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:-UseBiasedLocking" ], [ "i386", "x86_64" ] )
 , ( "jvm.BranchTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.CFGCrashTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.ClinitFloatTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.ClassExceptionsTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.ClassHierarchyAnalysisTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.ClassHierarchyAnalysisTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:-UseCHA" ], [ "i386", "x86_64" ] )
+, ( "jvm.ClassHierarchyAnalysisTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xssa" ], [ "i386" ] )
 , ( "jvm.ClassLoaderTest", 0, [ ], [ "i386", "x86_64" ] )
 , ( "jvm.CloneTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.ControlTransferTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
@@ -51,6 +61,8 @@ TESTS = [
 , ( "jvm.DoubleArithmeticTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.DoubleConversionTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.DupTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.EscapeAnalysisTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.EscapeAnalysisTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:OptLevel=2" ], [ "i386" ] )
 , ( "jvm.ExceptionsTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.ExceptionHandlerTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.FibonacciTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
@@ -58,7 +70,14 @@ TESTS = [
 , ( "jvm.FloatArithmeticTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.FloatConversionTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.GcTortureTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.GcTortureTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:ParallelGCThreads=4", "-verbose:gc" ], [ "i386", "x86_64" ] )
+, ( "jvm.GcTortureTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xloggc:/dev/null" ], [ "i386", "x86_64" ] )
+, ( "jvm.GcTortureTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xnewgc", "-Xmn1m" ], [ "i386", "x86_64" ] )
+, ( "jvm.GenerationalGCTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.GenerationalGCTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xnewgc", "-Xmn1m", "-XX:MaxTenuringThreshold=1", "-verbose:gc" ], [ "i386", "x86_64" ] )
 , ( "jvm.GetstaticPatchingTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.InlineCacheTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.InliningTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.IntegerArithmeticExceptionsTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.IntegerArithmeticTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.InterfaceFieldInheritanceTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
@@ -68,11 +87,19 @@ TESTS = [
 , ( "jvm.InvokeTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.InvokestaticPatchingTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.LoadConstantsTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.LockElisionTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.LockElisionTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xtrace:locks" ], [ "i386", "x86_64" ],
+    [ r"\[locks\] jvm[/.]LockElisionTest\.nested\(I\)I: [1-9]",
+      r"\[locks\] jvm[/.]LockElisionTest\.nestedThrows\(\)V: [1-9]",
+      r"\[locks\] jvm[/.]LockElisionTest\.consecutive\(Ljvm/LockElisionTest\$Holder;I\)I: [1-9]" ] )
 , ( "jvm.LongArithmeticExceptionsTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.LongArithmeticTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.LoopInvariantCodeMotionTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:OptLevel=2" ], [ "i386" ] )
 , ( "jvm.MethodInvocationAndReturnTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.MethodInvokeVirtualTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.MethodInvocationExceptionsTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.MonitorContentionTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.MonitorContentionTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xtrace:monitor" ], [ "i386", "x86_64" ] )
 , ( "jvm.MultithreadingTest", 0, [ ], [ "i386", "x86_64" ] )
 , ( "jvm.MethodOverridingFinal", 1, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.NoSuchMethodErrorTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
@@ -80,6 +107,8 @@ TESTS = [
 , ( "jvm.ObjectCreationAndManipulationExceptionsTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.ObjectCreationAndManipulationTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.ObjectStackTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.OnStackReplacementTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:CompileThreshold=1000" ], [ "i386", "x86_64" ] )
+, ( "jvm.OnStackReplacementTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:CompileThreshold=1000", "-XX:-UseOnStackReplacement" ], [ "i386", "x86_64" ] )
 , ( "jvm.ParameterPassingTest", 100, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.ParameterPassingLivenessTest", 1, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.PopTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
@@ -95,6 +124,8 @@ TESTS = [
 , ( "jvm.SynchronizationExceptionsTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.SynchronizationTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.TrampolineBackpatchingTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.TypedAllocationTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.TypedAllocationTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:-UseTLAB" ], [ "i386", "x86_64" ] )
 , ( "jvm.VirtualAbstractInterfaceMethodTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.WideTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "test.java.lang.ClassTest", 0, [ ], [ "i386", "x86_64" ] )
@@ -129,9 +160,14 @@ def guess_arch():
 ARCH = guess_arch()
 
 def is_test_supported(t):
-  klass, expected_retval, extra_args, archs = t
+  klass, expected_retval, extra_args, archs = t[:4]
   return ARCH in archs
 
+def expected_output(t):
+  if len(t) > 4:
+    return t[4]
+  return [ ]
+
 def success(s):
   return "\033[32m" + s + "\033[0m"
 
@@ -164,12 +200,20 @@ def main():
   tests = filter(lambda t: is_test_supported(t) != opts.skipped, TESTS)
 
   def do_work(t):
-    klass, expected_retval, extra_args, archs = t
+    klass, expected_retval, extra_args, archs = t[:4]
+    patterns = expected_output(t)
     fnull = open(os.devnull, "w")
     progress(len(tests) - q.qsize(), len(tests), klass)
     command = ["./jato"] + RUNTIME + extra_args + [ "-cp", TEST_DIR, klass ]
-    retval = subprocess.call(command, stderr = fnull)
-    if retval != expected_retval:
+    if patterns:
+      process = subprocess.Popen(command, stderr = subprocess.PIPE)
+      output = process.communicate()[1]
+      retval = process.returncode
+    else:
+      output = ""
+      retval = subprocess.call(command, stderr = fnull)
+    missing = filter(lambda p: not re.search(p, output, re.MULTILINE), patterns)
+    if retval != expected_retval or missing:
       if not opts.skipped:
         print "%s: Test FAILED%20s" % (klass, "")
       results.put(False)
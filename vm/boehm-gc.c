@@ -1,14 +1,16 @@
+#include "vm/gc-stats.h"
 #include "vm/gc.h"
 
 #include "../boehmgc/include/gc.h"
+#include "../boehmgc/include/gc_typed.h"
 
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
 #include <stdio.h>
 
 static void *gc_out_of_memory(size_t nr)
 {
-	if (verbose_gc)
-		fprintf(stderr, "[GC]\n");
-
 	GC_gcollect();
 
 	return NULL;	/* is this ok? */
@@ -18,6 +20,62 @@ static void gc_ignore_warnings(char *msg, GC_word arg)
 {
 }
 
+/*
+ * Called by the collecting thread at the end of each collection. It holds
+ * the allocation lock so it must not allocate from the heap.
+ */
+static void gc_collection_end(void)
+{
+	struct gc_record record;
+	uint64_t now;
+
+	now = gc_stats_now();
+
+	/*
+	 * GC_last_collection_start_usecs wraps around on 32-bit machines so
+	 * use it only to compute the time elapsed since the collection started.
+	 */
+	record.kind		= GC_FULL;
+	record.start		= now - (unsigned long) ((unsigned long) now - GC_last_collection_start_usecs);
+	record.pause		= GC_last_pause_usecs;
+	record.time_to_safepoint = 0;
+	record.heap_before	= GC_last_heap_in_use_before;
+	record.heap_after	= GC_last_heap_in_use_after;
+	record.allocated	= GC_last_bytes_allocd;
+	record.promoted		= 0;
+	record.nr_markers	= GC_parallel ? GC_markers : 1;
+	record.marker_busy	= GC_last_marker_busy_usecs;
+
+	gc_stats_record(&record);
+}
+
+/*
+ * The marker threads are started by GC_INIT() and are not VM threads. The
+ * signals that the VM handles are blocked in them so that the handlers,
+ * which expect an attached thread, never run in a marker thread.
+ */
+static void gc_start_marker_threads(void)
+{
+	sigset_t sigset, old_sigset;
+	char buf[32];
+
+	if (opt_parallel_gc_threads) {
+		snprintf(buf, sizeof buf, "%lu", opt_parallel_gc_threads);
+		setenv("GC_MARKERS", buf, 1);
+	}
+
+	sigemptyset(&sigset);
+	sigaddset(&sigset, SIGQUIT);
+	sigaddset(&sigset, SIGUSR1);
+	sigaddset(&sigset, SIGUSR2);
+
+	pthread_sigmask(SIG_BLOCK, &sigset, &old_sigset);
+
+	GC_INIT();
+
+	pthread_sigmask(SIG_SETMASK, &old_sigset, NULL);
+}
+
 static int
 do_gc_register_finalizer(struct vm_object *object, finalizer_fn finalizer)
 {
@@ -52,6 +110,29 @@ static void *do_gc_malloc_noscan(size_t size)
 	return p;
 }
 
+static void *do_gc_malloc_many(size_t size)
+{
+	return GC_malloc_many(size);
+}
+
+static void *do_gc_malloc_typed(size_t size, unsigned long descr)
+{
+	void *p;
+
+	p = GC_malloc_explicitly_typed(size, descr);
+	if (!p)
+		return NULL;
+
+	memset(p, 0, size);
+
+	return p;
+}
+
+static unsigned long do_gc_make_descr(unsigned long *bitmap, unsigned long nr_words)
+{
+	return GC_make_descriptor(bitmap, nr_words);
+}
+
 static void *do_gc_malloc_uncollectable(size_t size)
 {
 	void *p;
@@ -75,6 +156,9 @@ void gc_setup_boehm(void)
 	gc_ops		= (struct gc_operations) {
 		.gc_alloc		= do_gc_malloc,
 		.gc_alloc_noscan	= do_gc_malloc_noscan,
+		.gc_alloc_many		= do_gc_malloc_many,
+		.gc_alloc_typed		= do_gc_malloc_typed,
+		.gc_make_descr		= do_gc_make_descr,
 		.vm_alloc		= do_gc_malloc_uncollectable,
 		.vm_free		= do_gc_free,
 		.gc_register_finalizer	= do_gc_register_finalizer
@@ -88,7 +172,10 @@ void gc_setup_boehm(void)
 
 	GC_dont_gc	= dont_gc;
 
-	GC_INIT();
+	if (verbose_gc)
+		GC_collection_end_call_back = gc_collection_end;
+
+	gc_start_marker_threads();
 
 	GC_set_max_heap_size(max_heap_size);
 }
@@ -19,6 +19,7 @@
 
 #include "jit/exception.h"
 #include "jit/compiler.h"
+#include "jit/cha.h"
 #include "jit/vtable.h"
 #include "jit/cu-mapping.h"
 
@@ -26,6 +27,7 @@
 #include "vm/classloader.h"
 #include "vm/annotation.h"
 #include "vm/gc.h"
+#include "vm/heap.h"
 #include "vm/preload.h"
 #include "vm/errors.h"
 #include "vm/itable.h"
@@ -40,6 +42,7 @@
 
 #include "lib/string.h"
 #include "lib/array.h"
+#include "lib/bitset.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -152,6 +155,17 @@ static int vm_class_link_common(struct vm_class *vmc)
 
 	compile_lock_init(&vmc->cl, true);
 
+	vmc->cha_implementor = NULL;
+	vmc->cha_many_implementors = false;
+	INIT_LIST_HEAD(&vmc->cha_dependent_list);
+
+	vmc->nr_bias_revocations = 0;
+	vmc->bias_revoked = false;
+	vmc->monitor_spin_limit = INITIAL_SPIN_LIMIT;
+
+	vmc->has_gc_descr = false;
+	vmc->ref_map = NULL;
+
 	err = pthread_mutex_init(&vmc->mutex, NULL);
 	if (err)
 		return -err;
@@ -169,6 +183,80 @@ static int vm_class_link_common(struct vm_class *vmc)
 	return vm_preload_add_class_fixup(vmc);
 }
 
+static bool vm_class_has_secondary_super(const struct vm_class *vmc,
+					 const struct vm_class *super)
+{
+	for (unsigned int i = 0; i < vmc->nr_secondary_supers; i++) {
+		if (vmc->secondary_supers[i] == super)
+			return true;
+	}
+
+	return false;
+}
+
+static void vm_class_add_secondary_super(struct vm_class *vmc,
+					 const struct vm_class *super)
+{
+	if (vm_class_has_secondary_super(vmc, super))
+		return;
+
+	vmc->secondary_supers[vmc->nr_secondary_supers++] = super;
+}
+
+/*
+ * Sets up the primary supertype display and the secondary supertypes of
+ * @vmc. The superclass and interfaces must already be linked.
+ */
+static int vm_class_setup_supertypes(struct vm_class *vmc)
+{
+	const struct vm_class *super = vmc->super;
+	unsigned int max_secondary_supers;
+
+	if (super) {
+		memcpy(vmc->display, super->display, sizeof(vmc->display));
+		vmc->display_depth = super->display_depth + 1;
+	} else {
+		memset(vmc->display, 0, sizeof(vmc->display));
+		vmc->display_depth = 0;
+	}
+
+	if (vmc->display_depth < VM_CLASS_DISPLAY_SIZE)
+		vmc->display[vmc->display_depth] = vmc;
+
+	max_secondary_supers = 1;
+
+	if (super)
+		max_secondary_supers += super->nr_secondary_supers;
+
+	for (unsigned int i = 0; i < vmc->nr_interfaces; i++)
+		max_secondary_supers += 1 + vmc->interfaces[i]->nr_secondary_supers;
+
+	vmc->secondary_supers = malloc(sizeof(*vmc->secondary_supers) * max_secondary_supers);
+	if (!vmc->secondary_supers)
+		return -ENOMEM;
+
+	vmc->nr_secondary_supers = 0;
+
+	if (vmc->display_depth >= VM_CLASS_DISPLAY_SIZE)
+		vm_class_add_secondary_super(vmc, vmc);
+
+	if (super) {
+		for (unsigned int i = 0; i < super->nr_secondary_supers; i++)
+			vm_class_add_secondary_super(vmc, super->secondary_supers[i]);
+	}
+
+	for (unsigned int i = 0; i < vmc->nr_interfaces; i++) {
+		const struct vm_class *vmi = vmc->interfaces[i];
+
+		vm_class_add_secondary_super(vmc, vmi);
+
+		for (unsigned int j = 0; j < vmi->nr_secondary_supers; j++)
+			vm_class_add_secondary_super(vmc, vmi->secondary_supers[j]);
+	}
+
+	return 0;
+}
+
 /*
  * This is used for grouping fields by their type, so that we can:
  *
@@ -227,6 +315,56 @@ static void buckets_order_fields(struct field_bucket buckets[VM_TYPE_MAX],
 	*size = offset;
 }
 
+/*
+ * Sets up the GC descriptor of instances of @vmc from the reference
+ * fields of the class and its superclasses. The object header is not
+ * marked because the class and the monitor record are not collectable.
+ */
+static int vm_class_setup_gc_descr(struct vm_class *vmc)
+{
+	unsigned long nr_words;
+	unsigned long *bitmap;
+
+	if (!gc_typed_alloc_supported() && !heap_enabled())
+		return 0;
+
+	nr_words = ALIGN(sizeof(struct vm_object) + vmc->object_size, sizeof(unsigned long))
+		/ sizeof(unsigned long);
+
+	bitmap = zalloc(ALIGN(nr_words, BITS_PER_LONG) / 8);
+	if (!bitmap)
+		return -ENOMEM;
+
+	for (struct vm_class *c = vmc; c; c = c->super) {
+		for (unsigned int i = 0; i < c->nr_fields; i++) {
+			struct vm_field *vmf = &c->fields[i];
+			unsigned long offset;
+
+			if (vm_field_is_static(vmf) || vmf->type_info.vm_type != J_REFERENCE)
+				continue;
+
+			offset = sizeof(struct vm_object) + vmf->offset;
+			set_bit(bitmap, offset / sizeof(unsigned long));
+		}
+	}
+
+	if (gc_typed_alloc_supported()) {
+		vmc->gc_descr		= gc_make_descr(bitmap, nr_words);
+		vmc->has_gc_descr	= true;
+	}
+
+	/* The generational heap scans instances with the bitmap. */
+	if (heap_enabled()) {
+		vmc->ref_map		= bitmap;
+		vmc->ref_map_words	= nr_words;
+		return 0;
+	}
+
+	free(bitmap);
+
+	return 0;
+}
+
 static int insert_interface_method(struct vm_class *vmc,
 				   struct array *extra_methods,
 				   struct vm_method *vmm)
@@ -410,7 +548,7 @@ int vm_class_link(struct vm_class *vmc, const struct cafebabe_class *class)
 	buckets_order_fields(field_buckets[1], &tmp, &vmc->object_size);
 
 	/* XXX: only static fields, right size, etc. */
-	vmc->static_values = vm_zalloc(vmc->static_size);
+	vmc->static_values = gc_alloc_static_values(vmc, vmc->static_size);
 	if (!vmc->static_values)
 		goto error_free_buckets;
 
@@ -425,6 +563,9 @@ int vm_class_link(struct vm_class *vmc, const struct cafebabe_class *class)
 		}
 	}
 
+	if (vm_class_setup_gc_descr(vmc))
+		goto error_free_static_values;
+
 	struct array extra_methods;
 	array_init(&extra_methods);
 
@@ -552,6 +693,11 @@ int vm_class_link(struct vm_class *vmc, const struct cafebabe_class *class)
 	if (!cafebabe_read_enclosing_method_attribute(class, &class->attributes, &vmc->enclosing_method_attribute))
 		vmc->enclosing_class = vm_class_resolve_class(vmc, vmc->enclosing_method_attribute.class_index);
 
+	if (vm_class_setup_supertypes(vmc))
+		goto error_free_annotations;
+
+	cha_class_linked(vmc);
+
 	vmc->state = VM_CLASS_LINKED;
 	return 0;
 
@@ -567,7 +713,7 @@ error_free_methods:
 error_free_inner_classes:
 	vm_free(vmc->inner_classes);
 error_free_static_values:
-	vm_free(vmc->static_values);
+	gc_free_static_values(vmc->static_values);
 error_free_buckets:
 	free_buckets(2, VM_TYPE_MAX, field_buckets);
 error_free_fields:
@@ -611,7 +757,8 @@ int vm_class_link_primitive_class(struct vm_class *vmc, const char *class_name)
 	vmc->vtable.native_ptr = vm_java_lang_Object->vtable.native_ptr;
 
 	vmc->source_file_name = NULL;
-	return 0;
+
+	return vm_class_setup_supertypes(vmc);
 }
 
 int vm_class_link_array_class(struct vm_class *vmc, struct vm_class *elem_class,
@@ -649,7 +796,8 @@ int vm_class_link_array_class(struct vm_class *vmc, struct vm_class *elem_class,
 	vmc->vtable.native_ptr = vm_java_lang_Object->vtable.native_ptr;
 
 	vmc->source_file_name = NULL;
-	return 0;
+
+	return vm_class_setup_supertypes(vmc);
 }
 
 static bool vm_class_check_class_init_fault(struct vm_class *vmc,
@@ -1221,20 +1369,6 @@ static void supertype_cache_update(struct vm_class *vmc, const struct vm_class *
 	vmc->supertype_cache[ndx]       = super;
 }
 
-static bool vm_class_is_subclass_of(const struct vm_class *vmc, const struct vm_class *from)
-{
-	struct vm_class *super = from->super;
-
-	while (super) {
-		if (vmc == super)
-			return true;
-
-		super = super->super;
-	}
-
-	return false;
-}
-
 static bool vm_class_is_assignable_from_nocache(const struct vm_class *vmc, const struct vm_class *from);
 
 static bool vm_class_is_instance_of_array(const struct vm_class *vmc, const struct vm_class *from)
@@ -1244,22 +1378,12 @@ static bool vm_class_is_instance_of_array(const struct vm_class *vmc, const stru
 
 	struct vm_class *vmc_el = vm_class_get_array_element_class(vmc);
 
-	struct vm_class *from_el = vm_class_get_array_element_class(vmc);
-
-	return vm_class_is_assignable_from_nocache(vmc_el, from_el);
-}
-
-static bool vm_class_implements(const struct vm_class *vmc, const struct vm_class *from)
-{
-	for (unsigned int i = 0; i < from->nr_interfaces; ++i) {
-		if (vmc == from->interfaces[i] || vm_class_implements(vmc, from->interfaces[i]))
-			return true;
-	}
+	struct vm_class *from_el = vm_class_get_array_element_class(from);
 
-	if (from->super)
-		return vm_class_implements(vmc, from->super);
+	if (vm_class_is_primitive_class(vmc_el) || vm_class_is_primitive_class(from_el))
+		return vmc_el == from_el;
 
-	return false;
+	return vm_class_is_assignable_from_nocache(vmc_el, from_el);
 }
 
 static bool vm_class_is_assignable_from_nocache(const struct vm_class *vmc, const struct vm_class *from)
@@ -1267,13 +1391,16 @@ static bool vm_class_is_assignable_from_nocache(const struct vm_class *vmc, cons
 	if (vmc == from)
 		return true;
 
-	if (vm_class_is_interface(vmc))
-		return vm_class_implements(vmc, from);
+	if (vm_class_display_test(vmc, from))
+		return true;
+
+	if (vm_class_has_primary_display(vmc))
+		return false;
 
 	if (vm_class_is_array_class(vmc))
 		return vm_class_is_instance_of_array(vmc, from);
 
-	return vm_class_is_subclass_of(vmc, from);
+	return vm_class_has_secondary_super(from, vmc);
 }
 
 /* Reference: http://download.oracle.com/javase/1.5.0/docs/api/java/lang/Class.html#isAssignableFrom(java.lang.Class) */
@@ -1333,8 +1460,13 @@ struct vm_class *vm_class_get_array_class(struct vm_class *element_class)
 	struct vm_class *result;
 	char *name;
 
-	if (!asprintf(&name, "[L%s;", element_class->name))
-		return throw_oom_error();
+	if (vm_class_is_array_class(element_class)) {
+		if (asprintf(&name, "[%s", element_class->name) < 0)
+			return throw_oom_error();
+	} else {
+		if (asprintf(&name, "[L%s;", element_class->name) < 0)
+			return throw_oom_error();
+	}
 
 	result = classloader_load(element_class->classloader, name);
 	free(name);
@@ -0,0 +1,169 @@
+/*
+ * Garbage collection telemetry
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ *
+ * With -verbose:gc every collection is logged as one line of key=value
+ * pairs to stderr or to the file given with -Xloggc:<file>. A histogram of
+ * the pause times of each kind of collection is printed to the same stream
+ * when the VM exits.
+ */
+
+#include "vm/gc-stats.h"
+#include "vm/system.h"
+#include "vm/gc.h"
+
+#include <sys/time.h>
+#include <pthread.h>
+#include <stdio.h>
+
+const char *opt_gc_log_file;
+
+/* Upper limits of the pause time histogram buckets in microseconds */
+static const uint64_t pause_limits[] = {
+	100, 1000, 10000, 100000, 1000000,
+};
+
+static const char *pause_labels[] = {
+	"< 100 us", "< 1 ms", "< 10 ms", "< 100 ms", "< 1 s", ">= 1 s",
+};
+
+#define NR_PAUSE_BUCKETS	ARRAY_SIZE(pause_labels)
+
+static pthread_mutex_t	gc_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static FILE		*gc_log;
+static uint64_t		vm_start;
+
+static const char *gc_kind_names[NR_GC_KINDS] = {
+	[GC_FULL]	= "full",
+	[GC_MINOR]	= "minor",
+};
+
+static unsigned long	nr_collections;
+
+/* Per kind of collection */
+static unsigned long	nr_kind_collections[NR_GC_KINDS];
+static uint64_t		total_pause[NR_GC_KINDS];
+static uint64_t		max_pause[NR_GC_KINDS];
+static unsigned long	pause_histogram[NR_GC_KINDS][NR_PAUSE_BUCKETS];
+
+uint64_t gc_stats_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+void gc_stats_init(void)
+{
+	vm_start = gc_stats_now();
+
+	if (!verbose_gc)
+		return;
+
+	gc_log = stderr;
+
+	if (!opt_gc_log_file)
+		return;
+
+	gc_log = fopen(opt_gc_log_file, "w");
+	if (!gc_log) {
+		fprintf(stderr, "warning: could not open GC log file '%s'\n", opt_gc_log_file);
+		gc_log = stderr;
+	}
+}
+
+static unsigned long pause_bucket(uint64_t pause)
+{
+	unsigned long i;
+
+	for (i = 0; i < ARRAY_SIZE(pause_limits); i++) {
+		if (pause < pause_limits[i])
+			break;
+	}
+
+	return i;
+}
+
+/*
+ * Logs @record and adds it to the pause time histogram. Must not allocate
+ * from the GC heap because the Boehm collector calls it with its allocation
+ * lock held.
+ */
+void gc_stats_record(struct gc_record *record)
+{
+	enum gc_kind kind = record->kind;
+
+	if (!gc_log)
+		return;
+
+	pthread_mutex_lock(&gc_stats_mutex);
+
+	nr_collections++;
+	nr_kind_collections[kind]++;
+	total_pause[kind] += record->pause;
+
+	if (record->pause > max_pause[kind])
+		max_pause[kind] = record->pause;
+
+	pause_histogram[kind][pause_bucket(record->pause)]++;
+
+	fprintf(gc_log, "[GC %lu: kind=%s start_us=%llu pause_us=%llu safepoint_us=%llu "
+		"heap_before=%lu heap_after=%lu allocated=%lu",
+		nr_collections, gc_kind_names[kind],
+		(unsigned long long) (record->start - vm_start),
+		(unsigned long long) record->pause,
+		(unsigned long long) record->time_to_safepoint,
+		record->heap_before, record->heap_after, record->allocated);
+
+	if (kind == GC_MINOR)
+		fprintf(gc_log, " promoted=%lu", record->promoted);
+
+	if (record->nr_markers) {
+		unsigned long utilization = 100;
+
+		if (record->pause)
+			utilization = record->marker_busy * 100 / (record->pause * record->nr_markers);
+
+		fprintf(gc_log, " markers=%lu marker_utilization=%lu%%",
+			record->nr_markers, utilization);
+	}
+
+	fprintf(gc_log, "]\n");
+	fflush(gc_log);
+
+	pthread_mutex_unlock(&gc_stats_mutex);
+}
+
+static void print_pause_histogram(enum gc_kind kind)
+{
+	fprintf(gc_log, "[GC %s pause histogram: %lu collections, total %llu us, max %llu us]\n",
+		gc_kind_names[kind], nr_kind_collections[kind],
+		(unsigned long long) total_pause[kind],
+		(unsigned long long) max_pause[kind]);
+
+	for (unsigned long i = 0; i < NR_PAUSE_BUCKETS; i++)
+		fprintf(gc_log, "  %-9s %lu\n", pause_labels[i], pause_histogram[kind][i]);
+}
+
+void gc_stats_print(void)
+{
+	if (!gc_log)
+		return;
+
+	pthread_mutex_lock(&gc_stats_mutex);
+
+	/* Full collections are always reported, minor ones only if there were any. */
+	print_pause_histogram(GC_FULL);
+
+	if (nr_kind_collections[GC_MINOR])
+		print_pause_histogram(GC_MINOR);
+
+	fflush(gc_log);
+
+	pthread_mutex_unlock(&gc_stats_mutex);
+}
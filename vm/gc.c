@@ -11,6 +11,7 @@
  *   "GC Points in a Threaded Environment", Agesen.
  */
 
+#include "arch/stack-frame.h"
 #include "arch/registers.h"
 #include "arch/memory.h"
 
@@ -18,14 +19,20 @@
 
 #include "jit/compilation-unit.h"
 #include "jit/cu-mapping.h"
+#include "jit/compiler.h"
+#include "jit/gc-map.h"
 
 #include "lib/guard-page.h"
+#include "lib/bitset.h"
 #include "lib/string.h"
 
+#include "vm/stack-trace.h"
 #include "vm/stdlib.h"
 #include "vm/thread.h"
 #include "vm/method.h"
 #include "vm/class.h"
+#include "vm/gc-stats.h"
+#include "vm/heap.h"
 #include "vm/trace.h"
 #include "vm/die.h"
 #include "vm/gc.h"
@@ -50,8 +57,27 @@ static int nr_threads;
 
 static pthread_t gc_thread_id;
 
+/*
+ * An operation that the GC thread runs instead of reclaiming memory while
+ * all threads are stopped. Protected by safepoint_fn_mutex.
+ */
+static pthread_mutex_t	safepoint_fn_mutex	= PTHREAD_MUTEX_INITIALIZER;
+static void		(*safepoint_fn)(void *);
+static void		*safepoint_fn_arg;
+
+/*
+ * Bytes handed out by do_gc_alloc(). Nothing is reclaimed yet so this is
+ * also the size of the heap in use. Protected by gc_alloc_mutex.
+ */
+static pthread_mutex_t	gc_alloc_mutex		= PTHREAD_MUTEX_INITIALIZER;
+static unsigned long	bytes_allocated;
+static unsigned long	bytes_allocated_at_last_gc;
+
 unsigned long max_heap_size	= 128 * 1024 * 1024;	/* 128 MB */
 
+/* 0 lets the collector use one marker thread per CPU */
+unsigned long opt_parallel_gc_threads;
+
 bool				newgc_enabled;
 bool				verbose_gc;
 int				dont_gc;
@@ -144,33 +170,192 @@ static void enter_safepoint(void)
 		die("pthread_spin_unlock");
 }
 
-static void do_gc_reclaim(void)
+static void do_gc_reclaim(struct gc_record *record)
 {
-	if (verbose_gc)
-		fprintf(stderr, "[GC]\n");
+	if (heap_enabled()) {
+		heap_collect_minor(record);
+		return;
+	}
 
 	/* TODO: Do main GC work here. */
+	record->kind = GC_FULL;
 }
 
-static void gc_scan_rootset(struct register_state *regs)
+static void scan_ambiguous(void *start, void *end, gc_root_fn fn, void *arg)
+{
+	void **p;
+
+	for (p = start; (void *) p < end; p++)
+		fn(p, GC_ROOT_AMBIGUOUS, arg);
+}
+
+/*
+ * Reports the registers that the prolog of @cu saved in @frame. They hold
+ * values of the caller which is stopped at @caller_map, or at an unknown
+ * point if @caller_map is NULL.
+ */
+static void scan_callee_saves(struct compilation_unit *cu, void *frame,
+			      struct gc_map *caller_map, gc_root_fn fn, void *arg)
+{
+	unsigned int i;
+
+	for (i = 0; i < NR_CALLEE_SAVE_REGS; i++) {
+		void **slot = frame_callee_save_ptr(cu, frame, i);
+
+		if (!caller_map)
+			fn(slot, GC_ROOT_AMBIGUOUS, arg);
+		else if (test_bit(caller_map->register_map, callee_save_regs[i]))
+			fn(slot, GC_ROOT_EXACT, arg);
+	}
+}
+
+static struct gc_map *lookup_gc_map(struct stack_trace_elem *elem, bool top,
+				    struct compilation_unit **cu_p)
 {
 	struct compilation_unit *cu;
 
-	cu = jit_lookup_cu(regs->ip);
-	if (!cu) {
-		warn("safepoint at unknown IP %" PRIx64, regs->ip);
-		return;
+	if (elem->type != STACK_TRACE_ELEM_TYPE_JIT)
+		return NULL;
+
+	cu = jit_lookup_cu(elem->addr);
+	if (!cu || !cu->gc_maps)
+		return NULL;
+
+	*cu_p = cu;
+
+	if (top)
+		return gc_map_lookup_poll(cu, elem->addr);
+
+	/* The return address points past the call instruction. */
+	return gc_map_lookup_call(cu, elem->addr + 1);
+}
+
+/*
+ * Reports the roots of the current thread which was stopped with @regs.
+ * Frames of compiled methods that are stopped at an instruction with a
+ * stack map are scanned exactly. Registers of the top frame and every
+ * other word between the stack pointer and the end of the stack are
+ * reported as ambiguous roots.
+ */
+static void gc_scan_stack(struct register_state *regs, gc_root_fn fn, void *arg)
+{
+	void *stack_end = vm_get_exec_env()->stack_end;
+	struct compilation_unit *callee_cu = NULL;
+	void *callee_frame = NULL;
+	struct stack_trace_elem elem;
+	void *low, *last_frame;
+	bool top = true;
+	unsigned int i;
+
+	low = (void *) regs->sp - STACK_RED_ZONE_SIZE;
+	last_frame = low;
+
+	init_stack_trace_elem(&elem, regs->ip, (void *) regs->bp);
+
+	for (;;) {
+		struct compilation_unit *cu = NULL;
+		struct gc_map *map;
+		void *frame;
+
+		frame = elem.frame;
+
+		/* Stop at frame pointers that do not point up the stack. */
+		if (elem.type != STACK_TRACE_ELEM_TYPE_JNI) {
+			if (frame <= last_frame)
+				break;
+
+			if (stack_end && frame >= stack_end)
+				break;
+
+			last_frame = frame;
+		}
+
+		map = lookup_gc_map(&elem, top, &cu);
+
+		if (callee_cu) {
+			scan_callee_saves(callee_cu, callee_frame, map, fn, arg);
+			callee_cu = NULL;
+		}
+
+		if (top) {
+			for (i = 0; i < NR_GP_REGISTERS; i++) {
+				void **reg = (void **) &regs->regs[i];
+
+				if (map && test_bit(map->register_map, i))
+					fn(reg, GC_ROOT_EXACT, arg);
+				else
+					fn(reg, GC_ROOT_AMBIGUOUS, arg);
+			}
+			top = false;
+		}
+
+		if (map) {
+			void *bottom = frame_bottom(cu, frame);
+
+			/* Outgoing arguments and anything pushed below the frame. */
+			scan_ambiguous(low, bottom, fn, arg);
+			scan_ambiguous(bottom,
+				frame_callee_save_ptr(cu, frame, NR_CALLEE_SAVE_REGS - 1),
+				fn, arg);
+
+			gc_map_scan_slots(cu, map, frame, fn, arg);
+
+			callee_cu	= cu;
+			callee_frame	= frame;
+			low		= frame_args_end(cu, frame);
+		}
+
+		if (stack_trace_elem_next(&elem))
+			break;
 	}
 
-	if (verbose_gc)
-		fprintf(stderr, "[GC at %s.%s]\n", cu->method->class->name, cu->method->name);
+	if (callee_cu)
+		scan_callee_saves(callee_cu, callee_frame, NULL, fn, arg);
+
+	if (!stack_end)
+		stack_end = last_frame + sizeof(struct native_stack_frame);
+
+	scan_ambiguous(low, stack_end, fn, arg);
+}
+
+static void record_root(void **root, enum gc_root_kind kind, void *arg)
+{
+	struct heap_roots *roots = arg;
+
+	if (kind == GC_ROOT_EXACT)
+		heap_buffer_push(&roots->exact, root);
+	else if (*root)
+		heap_buffer_push(&roots->ambiguous, *root);
+}
+
+/*
+ * Records the roots of the current thread for the collector. This runs in
+ * the signal handler of the thread, before it enters the safepoint.
+ */
+static void gc_scan_rootset(struct register_state *regs)
+{
+	struct vm_exec_env *ee = vm_get_exec_env();
+	struct heap_roots *roots;
+
+	/* Fresh threads have no references on their stack yet. */
+	if (!ee)
+		return;
+
+	roots = &ee->heap_roots;
+	heap_roots_reset(roots);
 
-	/* TODO: get live references from this thread. */
+	gc_scan_stack(regs, record_root, roots);
+
+	if (verbose_gc) {
+		fprintf(stderr, "[GC roots: %lu exact, %lu ambiguous]\n",
+			roots->exact.nr, roots->ambiguous.nr);
+	}
 }
 
 void gc_safepoint(struct register_state *regs)
 {
-	gc_scan_rootset(regs);
+	if (!safepoint_fn)
+		gc_scan_rootset(regs);
 
 	enter_safepoint();
 
@@ -195,14 +380,24 @@ void suspend_handler(int sig, siginfo_t *si, void *ctx)
 
 		save_signal_registers(&thread_register_state, &uc->uc_mcontext);
 		gc_safepoint(&thread_register_state);
+		restore_signal_registers(&uc->uc_mcontext, &thread_register_state);
 	} else {
+		struct register_state thread_register_state;
+		ucontext_t *uc = ctx;
+
 		vm_thread_set_state(self, VM_THREAD_STATE_CONSISTENT);
 
+		save_signal_registers(&thread_register_state, &uc->uc_mcontext);
+		if (!safepoint_fn)
+			gc_scan_rootset(&thread_register_state);
+
 		enter_safepoint();
 
 		suspend_self();
 
 		do_exit_safepoint();	/* don't wake up GC */
+
+		restore_signal_registers(&uc->uc_mcontext, &thread_register_state);
 	}
 }
 
@@ -293,8 +488,55 @@ static void gc_suspend_rest(void)
 	unhide_safepoint_guard_page();
 }
 
+/*
+ * Runs the pending safepoint operation, if any. Returns true if one was
+ * run.
+ */
+static bool run_safepoint_fn(void)
+{
+	if (!safepoint_fn)
+		return false;
+
+	safepoint_fn(safepoint_fn_arg);
+	safepoint_fn = NULL;
+
+	return true;
+}
+
+/*
+ * Completes @record, which do_gc_reclaim() has filled in, with the times
+ * of the collection and logs it.
+ */
+static void gc_record_collection(struct gc_record *record, uint64_t start,
+				 uint64_t stopped, uint64_t end)
+{
+	record->start			= start;
+	record->pause			= end - start;
+	record->time_to_safepoint	= stopped - start;
+
+	if (record->kind == GC_FULL) {
+		if (pthread_mutex_lock(&gc_alloc_mutex) != 0)
+			die("pthread_mutex_lock");
+
+		record->heap_before	= bytes_allocated;
+		record->heap_after	= bytes_allocated;
+		record->allocated	= bytes_allocated - bytes_allocated_at_last_gc;
+
+		bytes_allocated_at_last_gc = bytes_allocated;
+
+		if (pthread_mutex_unlock(&gc_alloc_mutex) != 0)
+			die("pthread_mutex_unlock");
+	}
+
+	gc_stats_record(record);
+}
+
 static void do_gc(void)
 {
+	struct gc_record record = { .kind = GC_FULL };
+	uint64_t start, stopped;
+	bool reclaimed = false;
+
 	vm_lock_thread_count();
 
 	if (pthread_spin_lock(&gc_spinlock) != 0)
@@ -306,15 +548,28 @@ static void do_gc(void)
 	if (nr_threads == 0) {
 		if (pthread_spin_unlock(&gc_spinlock) != 0)
 			die("pthread_spin_unlock");
+
+		/* There is nothing to stop. */
+		run_safepoint_fn();
 		goto out;
 	}
 
 	if (pthread_spin_unlock(&gc_spinlock) != 0)
 		die("pthread_spin_unlock");
 
+	start = gc_stats_now();
 	gc_suspend_rest();
-	do_gc_reclaim();
+	stopped = gc_stats_now();
+
+	if (!run_safepoint_fn()) {
+		do_gc_reclaim(&record);
+		reclaimed = true;
+	}
+
 	gc_resume_rest();
+
+	if (reclaimed)
+		gc_record_collection(&record, start, stopped, gc_stats_now());
 out:
 	if (pthread_spin_lock(&gc_spinlock) != 0)
 		die("pthread_spin_lock");
@@ -396,6 +651,26 @@ wait_for_reclaim:
 		die("pthread_mutex_unlock");
 }
 
+/*
+ * Stops all java threads at a safepoint and calls @fn with @arg in the GC
+ * thread. This works with both garbage collectors.
+ */
+void gc_run_at_safepoint(void (*fn)(void *), void *arg)
+{
+	if (pthread_mutex_lock(&safepoint_fn_mutex) != 0)
+		die("pthread_mutex_lock");
+
+	safepoint_fn		= fn;
+	safepoint_fn_arg	= arg;
+
+	/* A collection that was already in progress doesn't run @fn. */
+	while (safepoint_fn)
+		gc_start();
+
+	if (pthread_mutex_unlock(&safepoint_fn_mutex) != 0)
+		die("pthread_mutex_unlock");
+}
+
 static void *do_gc_alloc(size_t size)
 {
 	void *p;
@@ -404,9 +679,18 @@ static void *do_gc_alloc(size_t size)
 
 	p	= malloc(size);
 
-	if (p)
+	if (p) {
 		memset(p, 0, size);
 
+		if (pthread_mutex_lock(&gc_alloc_mutex) != 0)
+			die("pthread_mutex_lock");
+
+		bytes_allocated += size;
+
+		if (pthread_mutex_unlock(&gc_alloc_mutex) != 0)
+			die("pthread_mutex_unlock");
+	}
+
 	return p;
 }
 
@@ -415,6 +699,87 @@ static void *do_vm_alloc(size_t size)
 	return malloc(size);
 }
 
+/*
+ * Allocates from the generational heap. A full nursery is collected and
+ * the allocation is retried once. Threads that are not Java threads are
+ * not stopped for collections and their stacks are not scanned, so their
+ * objects go to the old generation where they never move.
+ */
+static void *do_heap_alloc(size_t size, bool noscan)
+{
+	void *p;
+
+	if (!vm_thread_self())
+		return heap_alloc_tenured(size, noscan);
+
+	p = heap_alloc(size, noscan);
+	if (p)
+		return p;
+
+	gc_start();
+
+	p = heap_alloc(size, noscan);
+	if (p)
+		return p;
+
+	/* Other threads filled the nursery again. */
+	return heap_alloc_tenured(size, noscan);
+}
+
+/*
+ * Same as do_heap_alloc() for the free lists of thread-local allocation
+ * buffers. A single object from the old generation is a list too.
+ */
+static void *do_heap_gc_alloc_many(size_t size)
+{
+	void *p;
+
+	if (!vm_thread_self())
+		return heap_alloc_tenured(size, false);
+
+	p = heap_alloc_many(size);
+	if (p)
+		return p;
+
+	gc_start();
+
+	p = heap_alloc_many(size);
+	if (p)
+		return p;
+
+	return heap_alloc_tenured(size, false);
+}
+
+static void *do_heap_gc_alloc(size_t size)
+{
+	return do_heap_alloc(size, false);
+}
+
+static void *do_heap_gc_alloc_noscan(size_t size)
+{
+	return do_heap_alloc(size, true);
+}
+
+/*
+ * Allocates the static fields of @vmc. Compiled code accesses them at a
+ * fixed address so they must never move.
+ */
+void *gc_alloc_static_values(struct vm_class *vmc, size_t size)
+{
+	if (heap_enabled())
+		return heap_alloc_statics(vmc, size);
+
+	return vm_zalloc(size);
+}
+
+void gc_free_static_values(void *values)
+{
+	if (heap_enabled())
+		heap_free_statics(values);
+	else
+		vm_free(values);
+}
+
 void *vm_zalloc(size_t size)
 {
 	void *ret;
@@ -472,8 +837,34 @@ static void gc_setup(void)
 		.vm_alloc		= do_vm_alloc,
 		.vm_free		= do_vm_free,
 		.gc_register_finalizer	= do_gc_register_finalizer,
-		.gc_setup_signals	= do_gc_setup_signals,
 	};
+}
+
+/*
+ * The generational heap needs write barriers in compiled code, which the
+ * LLVM backend does not emit.
+ */
+static void gc_setup_heap(void)
+{
+	heap_init();
+
+	gc_ops		= (struct gc_operations) {
+		.gc_alloc		= do_heap_gc_alloc,
+		.gc_alloc_noscan	= do_heap_gc_alloc_noscan,
+		.gc_alloc_many		= do_heap_gc_alloc_many,
+		.vm_alloc		= heap_vm_alloc,
+		.vm_free		= heap_vm_free,
+		.gc_register_finalizer	= do_gc_register_finalizer,
+	};
+}
+
+/*
+ * The GC thread and the signals that stop threads at safepoints are set
+ * up for both garbage collectors because gc_run_at_safepoint() needs them.
+ */
+static void safepoint_setup(void)
+{
+	gc_ops.gc_setup_signals = do_gc_setup_signals;
 
 	if (pthread_spin_init(&gc_spinlock, PTHREAD_PROCESS_SHARED) != 0)
 		die("pthread_spin_init");
@@ -484,12 +875,18 @@ static void gc_setup(void)
 
 void gc_init(void)
 {
+	gc_stats_init();
+
 	gc_safepoint_page = alloc_guard_page(false);
 	if (!gc_safepoint_page)
 		die("Couldn't allocate GC safepoint guard page");
 
-	if (newgc_enabled)
+	if (newgc_enabled && opt_nursery_size && !opt_llvm_enable)
+		gc_setup_heap();
+	else if (newgc_enabled)
 		gc_setup();
 	else
 		gc_setup_boehm();
+
+	safepoint_setup();
 }
@@ -0,0 +1,1110 @@
+/*
+ * Generational heap
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ *
+ * This is the heap of -Xnewgc. It is one contiguous reservation that is
+ * divided into pages. Every thread bump-allocates new objects in an eden
+ * page of its own without taking the heap lock, which is only taken to get
+ * the next page. The free lists of the thread-local allocation buffers are
+ * carved from the same page. When
+ * opt_nursery_size bytes of eden pages are used up a minor collection
+ * copies the live objects of the nursery, the eden and survivor pages, to
+ * new survivor pages. Objects that have already survived
+ * opt_max_tenuring_threshold minor collections are copied to the old
+ * generation instead. Large objects
+ * and static fields are allocated in the old generation directly. The old
+ * generation is not collected yet.
+ *
+ * References from the old generation to the nursery are found with a card
+ * table. Every reference store marks a card of the object it stores into
+ * dirty: the field and array setters do that in C and the instruction
+ * selector emits a card mark for putfield, putstatic and aastore of
+ * references. Marking is imprecise so a minor collection scans every object
+ * that overlaps a dirty card.
+ *
+ * Only the frames of compiled methods that are stopped at a call or at a
+ * safepoint poll are scanned exactly. Everything else, the rest of the
+ * stacks, the memory from vm_alloc() and the data segment of the VM, is
+ * scanned conservatively. A nursery page that an ambiguous root points into
+ * is pinned: it becomes part of the old generation as it is, with all its
+ * cards dirty. This is Bartlett's mostly-copying collection with pages as
+ * the unit of pinning.
+ *
+ * Threads are stopped at arbitrary instructions so the card is marked
+ * before the store. A thread that is stopped between the two still has the
+ * stored reference in a register or on its stack, which pins it.
+ * Copies of many references, as in arraycopy and clone, do not have that
+ * property and mark the cards both before and after the copy.
+ *
+ * A collection can stop a thread in the middle of an allocation from its
+ * eden page. The collection takes the page away from the thread and the
+ * thread notices that when it is resumed and retries with a new page. The
+ * thread still has the address of the block in a register so the page was
+ * pinned and the block it had started to set up is valid memory in the old
+ * generation that is never used. Free lists of the allocation buffers are
+ * emptied by a collection. A thread that is stopped while it takes an
+ * object off a list pins the page of the whole list the same way.
+ *
+ * The identity hash of an object is derived from its address when it is
+ * first asked for and is kept in the block header from then on, so that
+ * it does not change when the object is copied.
+ *
+ *   "Compacting Garbage Collection with Ambiguous Roots", Bartlett.
+ */
+
+#include "lib/bitset.h"
+#include "lib/list.h"
+
+#include "vm/gc-stats.h"
+#include "vm/object.h"
+#include "vm/stdlib.h"
+#include "vm/thread.h"
+#include "vm/class.h"
+#include "vm/field.h"
+#include "vm/heap.h"
+#include "vm/die.h"
+#include "vm/gc.h"
+
+#include <sys/mman.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define HEAP_PAGE_SHIFT		16
+#define HEAP_PAGE_SIZE		(1UL << HEAP_PAGE_SHIFT)
+#define CARDS_PER_PAGE		(HEAP_PAGE_SIZE >> GC_CARD_SHIFT)
+
+/* Larger blocks are allocated in the old generation */
+#define HEAP_LARGE_BLOCK	(HEAP_PAGE_SIZE / 4)
+
+/* Size of the blocks that heap_alloc_many() returns at once */
+#define HEAP_ALLOC_MANY_SIZE	4096
+
+#define HEAP_ALIGN		8
+
+enum heap_page_kind {
+	HEAP_PAGE_FREE,
+	HEAP_PAGE_EDEN,
+	HEAP_PAGE_SURVIVOR,
+	HEAP_PAGE_TO_SPACE,	/* survivor page of the running collection */
+	HEAP_PAGE_OLD,
+};
+
+/*
+ * Header in front of every block of the heap. Blocks are laid out one
+ * after another from the start of a page or of a run of pages. A size of
+ * 0 marks the unused end of a page.
+ */
+struct heap_block {
+	unsigned long		size;		/* including the header */
+	uint16_t		flags;
+	uint16_t		age;		/* minor collections survived */
+	int32_t			hash;		/* valid with HEAP_BLOCK_HASHED */
+};
+
+#define HEAP_HEADER_SIZE	ALIGN(sizeof(struct heap_block), HEAP_ALIGN)
+
+enum {
+	HEAP_BLOCK_NOSCAN	= 1U << 0,	/* holds no references */
+	HEAP_BLOCK_FORWARDED	= 1U << 1,	/* first word is the address of the copy */
+	HEAP_BLOCK_STATICS	= 1U << 2,	/* holds struct heap_statics */
+	HEAP_BLOCK_HASHED	= 1U << 3,	/* ->hash is the identity hash */
+};
+
+/* Static fields of a class */
+struct heap_statics {
+	struct vm_class		*vmc;
+	unsigned long		__pad;
+	uint8_t			values[];
+};
+
+struct heap_region {
+	void			*cur;
+	void			*limit;
+};
+
+/* Header of memory from heap_vm_alloc() */
+struct vm_block {
+	struct list_head	node;
+	unsigned long		size;
+};
+
+#define VM_BLOCK_HEADER_SIZE	ALIGN(sizeof(struct vm_block), 2 * sizeof(long))
+
+/* 4 MB */
+unsigned long opt_nursery_size		= 4 * 1024 * 1024;
+unsigned long opt_max_tenuring_threshold = 2;
+
+unsigned long gc_heap_start;
+unsigned long gc_heap_end;
+unsigned long gc_card_table_bias;
+
+/* Start and end of the data and bss segments of the VM */
+extern char __data_start[], _end[];
+
+/*
+ * Protected by heap_mutex. SIGUSR1 is blocked while the lock is held so
+ * that no thread is stopped for a collection while it holds it.
+ */
+static pthread_mutex_t	heap_mutex		= PTHREAD_MUTEX_INITIALIZER;
+
+static uint8_t		*page_kinds;
+static uint8_t		*page_pinned;
+static unsigned long	nr_pages;
+
+static uint8_t		*card_table;
+static struct heap_block **card_first;		/* first old block that overlaps a card */
+static unsigned long	nr_cards;
+
+static struct heap_region old_space;
+static struct heap_region to_space;
+static unsigned long	nr_eden_pages;
+static unsigned long	max_eden_pages;
+
+static unsigned long	young_used;
+static unsigned long	old_used;
+static unsigned long	bytes_allocated;
+
+static struct list_head	vm_blocks		= LIST_HEAD_INIT(vm_blocks);
+
+/* Used by the GC thread only */
+static struct heap_buffer gray;
+static unsigned long	survivor_used;
+static unsigned long	promoted;
+
+static void heap_lock(sigset_t *old_mask)
+{
+	sigset_t mask;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGUSR1);
+
+	if (pthread_sigmask(SIG_BLOCK, &mask, old_mask) != 0)
+		die("pthread_sigmask");
+
+	if (pthread_mutex_lock(&heap_mutex) != 0)
+		die("pthread_mutex_lock");
+}
+
+static void heap_unlock(sigset_t *old_mask)
+{
+	if (pthread_mutex_unlock(&heap_mutex) != 0)
+		die("pthread_mutex_unlock");
+
+	if (pthread_sigmask(SIG_SETMASK, old_mask, NULL) != 0)
+		die("pthread_sigmask");
+}
+
+void heap_buffer_grow(struct heap_buffer *buf)
+{
+	unsigned long old_size = buf->max * sizeof(void *);
+	unsigned long new_size;
+	void *p;
+
+	new_size = old_size ? old_size * 2 : 4UL * getpagesize();
+
+	if (buf->data)
+		p = mremap(buf->data, old_size, new_size, MREMAP_MAYMOVE);
+	else
+		p = mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (p == MAP_FAILED)
+		die("out of memory for the GC root buffer");
+
+	buf->data	= p;
+	buf->max	= new_size / sizeof(void *);
+}
+
+void heap_buffer_release(struct heap_buffer *buf)
+{
+	if (buf->data)
+		munmap(buf->data, buf->max * sizeof(void *));
+
+	buf->data	= NULL;
+	buf->nr		= 0;
+	buf->max	= 0;
+}
+
+void heap_roots_init(struct heap_roots *roots)
+{
+	memset(roots, 0, sizeof(*roots));
+}
+
+void heap_roots_release(struct heap_roots *roots)
+{
+	heap_buffer_release(&roots->exact);
+	heap_buffer_release(&roots->ambiguous);
+}
+
+static inline unsigned long page_index(const void *p)
+{
+	return ((unsigned long) p - gc_heap_start) >> HEAP_PAGE_SHIFT;
+}
+
+static inline void *page_address(unsigned long page)
+{
+	return (void *) (gc_heap_start + (page << HEAP_PAGE_SHIFT));
+}
+
+static inline unsigned long card_index(const void *p)
+{
+	return ((unsigned long) p - gc_heap_start) >> GC_CARD_SHIFT;
+}
+
+static inline void *card_address(unsigned long card)
+{
+	return (void *) (gc_heap_start + (card << GC_CARD_SHIFT));
+}
+
+static inline void *block_data(struct heap_block *block)
+{
+	return (void *) block + HEAP_HEADER_SIZE;
+}
+
+static inline struct heap_block *block_of(void *p)
+{
+	return p - HEAP_HEADER_SIZE;
+}
+
+static inline struct heap_block *next_block(struct heap_block *block)
+{
+	return (void *) block + block->size;
+}
+
+static unsigned long block_size(size_t size)
+{
+	return ALIGN(HEAP_HEADER_SIZE + size, HEAP_ALIGN);
+}
+
+static void *alloc_pages(unsigned long nr, enum heap_page_kind kind)
+{
+	unsigned long i, run = 0;
+
+	for (i = 0; i < nr_pages; i++) {
+		if (page_kinds[i] != HEAP_PAGE_FREE) {
+			run = 0;
+			continue;
+		}
+
+		if (++run == nr) {
+			memset(page_kinds + i + 1 - nr, kind, nr);
+			return page_address(i + 1 - nr);
+		}
+	}
+
+	return NULL;
+}
+
+static void free_page(unsigned long page)
+{
+	memset(page_address(page), 0, HEAP_PAGE_SIZE);
+	memset(card_table + page * CARDS_PER_PAGE, GC_CARD_CLEAN, CARDS_PER_PAGE);
+
+	page_kinds[page] = HEAP_PAGE_FREE;
+}
+
+static struct heap_block *region_alloc(struct heap_region *region, unsigned long size)
+{
+	void *p = region->cur;
+
+	if (!p || size > (unsigned long) (region->limit - p))
+		return NULL;
+
+	region->cur = p + size;
+
+	return p;
+}
+
+static void init_block(struct heap_block *block, unsigned long size, unsigned int flags)
+{
+	block->size	= size;
+	block->flags	= flags;
+	block->age	= 0;
+}
+
+/* Updates the crossing map for a block of the old generation. */
+static void record_old_block(struct heap_block *block)
+{
+	unsigned long first, last, i;
+
+	first	= card_index(block);
+	last	= card_index((void *) block + block->size - 1);
+
+	if (!card_first[first])
+		card_first[first] = block;
+
+	for (i = first + 1; i <= last; i++)
+		card_first[i] = block;
+}
+
+static struct heap_block *old_alloc(unsigned long size, unsigned int flags)
+{
+	struct heap_block *block;
+
+	block = region_alloc(&old_space, size);
+	if (!block) {
+		unsigned long nr = DIV_ROUND_UP(size, HEAP_PAGE_SIZE);
+		void *page;
+
+		page = alloc_pages(nr, HEAP_PAGE_OLD);
+		if (!page)
+			return NULL;
+
+		old_space.cur	= page;
+		old_space.limit	= page + nr * HEAP_PAGE_SIZE;
+
+		block = region_alloc(&old_space, size);
+	}
+
+	init_block(block, size, flags);
+	record_old_block(block);
+
+	old_used += size;
+
+	return block;
+}
+
+void heap_chunk_init(struct heap_chunk *chunk)
+{
+	chunk->start	= NULL;
+	chunk->cur	= NULL;
+	chunk->limit	= NULL;
+}
+
+/* Called with the heap lock held or while all threads are stopped. */
+static void retire_chunk(struct heap_chunk *chunk)
+{
+	unsigned long used;
+
+	if (!chunk->limit)
+		return;
+
+	used = chunk->cur - chunk->start;
+
+	young_used	+= used;
+	bytes_allocated	+= used;
+
+	heap_chunk_init(chunk);
+}
+
+/*
+ * Gives the current thread a new eden page. Returns false if the nursery
+ * is full.
+ */
+static bool refill_chunk(struct heap_chunk *chunk)
+{
+	void *page = NULL;
+	sigset_t mask;
+
+	heap_lock(&mask);
+
+	retire_chunk(chunk);
+
+	if (nr_eden_pages < max_eden_pages)
+		page = alloc_pages(1, HEAP_PAGE_EDEN);
+
+	if (page) {
+		nr_eden_pages++;
+
+		chunk->start	= page;
+		chunk->cur	= page;
+		chunk->limit	= page + HEAP_PAGE_SIZE;
+	}
+
+	heap_unlock(&mask);
+
+	return page != NULL;
+}
+
+/*
+ * Sets up at most *@nr blocks of @size bytes in a row in the eden page of
+ * the current thread and stores their number in @nr. The data of each
+ * block but the last one points to the data of the next block. Returns
+ * NULL if no block fits or a collection took the page away meanwhile.
+ */
+static struct heap_block *chunk_alloc(struct heap_chunk *chunk, unsigned long size,
+				      unsigned long *nr, unsigned int flags)
+{
+	void *cur = chunk->cur, *limit = chunk->limit;
+	struct heap_block *block;
+	unsigned long i, n;
+
+	if (!limit)
+		return NULL;
+
+	n = min(*nr, (unsigned long) (limit - cur) / size);
+	if (!n)
+		return NULL;
+
+	for (i = 0; i < n; i++) {
+		block = cur + i * size;
+		init_block(block, size, flags);
+
+		if (i + 1 < n)
+			*(void **) block_data(block) = block_data(next_block(block));
+	}
+
+	barrier();
+	chunk->cur = cur + n * size;
+	barrier();
+
+	if (chunk->limit != limit) {
+		heap_chunk_init(chunk);
+		return NULL;
+	}
+
+	*nr = n;
+
+	return cur;
+}
+
+static struct heap_block *eden_alloc(unsigned long size, unsigned long *nr,
+				     unsigned int flags)
+{
+	struct heap_chunk *chunk = &vm_get_exec_env()->eden_chunk;
+	struct heap_block *block;
+
+	for (;;) {
+		block = chunk_alloc(chunk, size, nr, flags);
+		if (block)
+			return block;
+
+		if (!refill_chunk(chunk))
+			return NULL;
+	}
+}
+
+/*
+ * Allocates a zeroed object in eden. Returns NULL if the nursery is full
+ * and a minor collection should be done.
+ */
+void *heap_alloc(size_t size, bool noscan)
+{
+	unsigned long bsize = block_size(size);
+	struct heap_block *block;
+	unsigned long nr = 1;
+
+	if (bsize > HEAP_LARGE_BLOCK || !vm_get_exec_env())
+		return heap_alloc_tenured(size, noscan);
+
+	block = eden_alloc(bsize, &nr, noscan ? HEAP_BLOCK_NOSCAN : 0);
+	if (!block)
+		return NULL;
+
+	return block_data(block);
+}
+
+/*
+ * Allocates a list of zeroed objects of @size bytes in eden for the
+ * thread-local allocation buffers. The objects are linked through their
+ * first word. Returns NULL if the nursery is full and a minor collection
+ * should be done.
+ */
+void *heap_alloc_many(size_t size)
+{
+	unsigned long bsize = block_size(size);
+	struct heap_block *block;
+	unsigned long nr;
+
+	if (!vm_get_exec_env())
+		return heap_alloc_tenured(size, false);
+
+	nr = max(HEAP_ALLOC_MANY_SIZE / bsize, 1UL);
+
+	block = eden_alloc(bsize, &nr, 0);
+	if (!block)
+		return NULL;
+
+	return block_data(block);
+}
+
+static void *alloc_tenured(size_t size, unsigned int flags)
+{
+	unsigned long bsize = block_size(size);
+	struct heap_block *block;
+	sigset_t mask;
+
+	heap_lock(&mask);
+
+	block = old_alloc(bsize, flags);
+	if (block)
+		bytes_allocated += bsize;
+
+	heap_unlock(&mask);
+
+	if (!block)
+		return NULL;
+
+	return block_data(block);
+}
+
+/* Allocates a zeroed object in the old generation. */
+void *heap_alloc_tenured(size_t size, bool noscan)
+{
+	return alloc_tenured(size, noscan ? HEAP_BLOCK_NOSCAN : 0);
+}
+
+/*
+ * Allocates the static fields of @vmc. They never move so compiled code
+ * can use their address.
+ */
+void *heap_alloc_statics(struct vm_class *vmc, size_t size)
+{
+	struct heap_statics *statics;
+
+	statics = alloc_tenured(sizeof(*statics) + size, HEAP_BLOCK_STATICS);
+	if (!statics)
+		return NULL;
+
+	statics->vmc = vmc;
+
+	return statics->values;
+}
+
+void heap_free_statics(void *values)
+{
+	struct heap_statics *statics;
+
+	statics = values - offsetof(struct heap_statics, values);
+
+	/* The class is going away. Its static fields are garbage now. */
+	block_of(statics)->flags = HEAP_BLOCK_NOSCAN;
+}
+
+/*
+ * Returns the identity hash of the object at @p. The first call records
+ * @hash, which the caller derives from the current address of the object,
+ * and the copies that minor collections make keep it. Threads that race
+ * here see the same address because the object is pinned by them, so
+ * they record the same hash.
+ */
+int32_t heap_identity_hash(void *p, int32_t hash)
+{
+	struct heap_block *block = block_of(p);
+
+	if (block->flags & HEAP_BLOCK_HASHED)
+		return block->hash;
+
+	block->hash = hash;
+	barrier();
+	block->flags |= HEAP_BLOCK_HASHED;
+
+	return hash;
+}
+
+/*
+ * Memory from vm_alloc() is scanned for ambiguous roots by every minor
+ * collection, so the blocks are kept on a list.
+ */
+void *heap_vm_alloc(size_t size)
+{
+	struct vm_block *block;
+	sigset_t mask;
+
+	block = malloc(VM_BLOCK_HEADER_SIZE + size);
+	if (!block)
+		return NULL;
+
+	block->size = size;
+
+	heap_lock(&mask);
+	list_add(&block->node, &vm_blocks);
+	heap_unlock(&mask);
+
+	return (void *) block + VM_BLOCK_HEADER_SIZE;
+}
+
+void heap_vm_free(void *p)
+{
+	struct vm_block *block;
+	sigset_t mask;
+
+	if (!p)
+		return;
+
+	block = p - VM_BLOCK_HEADER_SIZE;
+
+	heap_lock(&mask);
+	list_del(&block->node);
+	heap_unlock(&mask);
+
+	free(block);
+}
+
+static inline enum heap_page_kind page_kind(const void *p)
+{
+	return page_kinds[page_index(p)];
+}
+
+static inline bool is_from_space(const void *p)
+{
+	enum heap_page_kind kind;
+
+	if (!gc_in_heap(p))
+		return false;
+
+	kind = page_kind(p);
+
+	return kind == HEAP_PAGE_EDEN || kind == HEAP_PAGE_SURVIVOR;
+}
+
+static inline bool is_young(const void *p)
+{
+	return gc_in_heap(p) && page_kind(p) == HEAP_PAGE_TO_SPACE;
+}
+
+static void pin(void *p)
+{
+	if (is_from_space(p))
+		page_pinned[page_index(p)] = 1;
+}
+
+static void pin_range(void *start, void *end)
+{
+	void **p;
+
+	p = (void **) ALIGN((unsigned long) start, sizeof(void *));
+
+	for (; (void *) (p + 1) <= end; p++)
+		pin(*p);
+}
+
+static void pin_roots(void)
+{
+	struct vm_thread *thread;
+	struct vm_block *block;
+	unsigned long i;
+
+	vm_thread_for_each(thread) {
+		struct heap_buffer *ambiguous;
+
+		pin(thread->vmthread);
+		pin(thread->waiting_mon);
+
+		if (!thread->ee)
+			continue;
+
+		ambiguous = &thread->ee->heap_roots.ambiguous;
+
+		for (i = 0; i < ambiguous->nr; i++)
+			pin(ambiguous->data[i]);
+	}
+
+	list_for_each_entry(block, &vm_blocks, node) {
+		void *start = (void *) block + VM_BLOCK_HEADER_SIZE;
+
+		pin_range(start, start + block->size);
+	}
+
+	pin_range(__data_start, _end);
+}
+
+/*
+ * Moves a pinned nursery page to the old generation. All its cards are
+ * dirty so that the references in it are updated like those of any other
+ * old object.
+ */
+static void promote_page(unsigned long page)
+{
+	struct heap_block *block, *end;
+	unsigned long used = 0;
+
+	page_kinds[page] = HEAP_PAGE_OLD;
+
+	block	= page_address(page);
+	end	= page_address(page + 1);
+
+	for (; block < end && block->size; block = next_block(block)) {
+		record_old_block(block);
+		used += block->size;
+	}
+
+	memset(card_table + page * CARDS_PER_PAGE, GC_CARD_DIRTY, CARDS_PER_PAGE);
+
+	old_used	+= used;
+	promoted	+= used;
+}
+
+static void promote_pinned_pages(void)
+{
+	unsigned long i;
+
+	for (i = 0; i < nr_pages; i++) {
+		if (!page_pinned[i])
+			continue;
+
+		page_pinned[i] = 0;
+		promote_page(i);
+	}
+}
+
+static struct heap_block *to_space_alloc(unsigned long size)
+{
+	struct heap_block *block;
+
+	block = region_alloc(&to_space, size);
+	if (!block) {
+		void *page;
+
+		page = alloc_pages(1, HEAP_PAGE_TO_SPACE);
+		if (!page)
+			return NULL;
+
+		to_space.cur	= page;
+		to_space.limit	= page + HEAP_PAGE_SIZE;
+
+		block = region_alloc(&to_space, size);
+	}
+
+	survivor_used += size;
+
+	return block;
+}
+
+/*
+ * Returns the new address of the object at @p. Nursery objects are copied
+ * on first visit and their copy is queued for scanning.
+ */
+static void *evacuate(void *p)
+{
+	struct heap_block *block, *copy = NULL;
+	unsigned int age;
+
+	if (!is_from_space(p))
+		return p;
+
+	block = block_of(p);
+
+	if (block->flags & HEAP_BLOCK_FORWARDED)
+		return *(void **) p;
+
+	age = block->age + 1;
+
+	if (age <= opt_max_tenuring_threshold)
+		copy = to_space_alloc(block->size);
+
+	if (!copy) {
+		copy = old_alloc(block->size, block->flags);
+		if (!copy)
+			die("out of memory during minor collection");
+
+		promoted += block->size;
+	}
+
+	memcpy(copy, block, block->size);
+	copy->age = age;
+
+	block->flags |= HEAP_BLOCK_FORWARDED;
+	*(void **) p = block_data(copy);
+
+	if (!(copy->flags & HEAP_BLOCK_NOSCAN))
+		heap_buffer_push(&gray, copy);
+
+	return block_data(copy);
+}
+
+/* Returns true if the slot still points to the nursery. */
+static bool scan_slot(void *slot)
+{
+	void **p = slot;
+
+	*p = evacuate(*p);
+
+	return is_young(*p);
+}
+
+static bool scan_statics(struct heap_statics *statics)
+{
+	struct vm_class *vmc = statics->vmc;
+	bool young = false;
+	unsigned int i;
+
+	if (!vmc)
+		return false;
+
+	for (i = 0; i < vmc->nr_fields; i++) {
+		struct vm_field *vmf = &vmc->fields[i];
+
+		if (!vm_field_is_static(vmf) || vmf->type_info.vm_type != J_REFERENCE)
+			continue;
+
+		young |= scan_slot(&statics->values[vmf->offset]);
+	}
+
+	return young;
+}
+
+static bool scan_fields(struct vm_object *obj, struct vm_class *vmc)
+{
+	uint8_t *fields = vm_object_fields(obj);
+	bool young = false;
+
+	for (struct vm_class *c = vmc; c; c = c->super) {
+		for (unsigned int i = 0; i < c->nr_fields; i++) {
+			struct vm_field *vmf = &c->fields[i];
+
+			if (vm_field_is_static(vmf) || vmf->type_info.vm_type != J_REFERENCE)
+				continue;
+
+			young |= scan_slot(&fields[vmf->offset]);
+		}
+	}
+
+	return young;
+}
+
+static bool scan_object(struct vm_object *obj)
+{
+	struct vm_class *vmc = obj->class;
+	bool young = false;
+	unsigned long i;
+
+	/*
+	 * Allocated but not set up yet or on a free list of an allocation
+	 * buffer, where the first word points to the next free object.
+	 */
+	if (!vmc || gc_in_heap(vmc))
+		return false;
+
+	if (vm_class_is_array_class(vmc)) {
+		struct vm_object **elems = vm_array_elems(obj);
+		jsize length = vm_array_length(obj);
+
+		if (vm_class_is_primitive_class(vmc->array_element_class))
+			return false;
+
+		for (i = 0; i < (unsigned long) length; i++)
+			young |= scan_slot(&elems[i]);
+
+		return young;
+	}
+
+	if (!vmc->ref_map)
+		return scan_fields(obj, vmc);
+
+	for (i = 0; i < vmc->ref_map_words; i++) {
+		if (test_bit(vmc->ref_map, i))
+			young |= scan_slot((void **) obj + i);
+	}
+
+	return young;
+}
+
+static bool scan_block(struct heap_block *block)
+{
+	if (block->flags & HEAP_BLOCK_NOSCAN)
+		return false;
+
+	if (block->flags & HEAP_BLOCK_STATICS)
+		return scan_statics(block_data(block));
+
+	return scan_object(block_data(block));
+}
+
+static void dirty_card(void *p)
+{
+	card_table[card_index(p)] = GC_CARD_DIRTY;
+}
+
+/*
+ * Scans the old blocks that overlap @card and were not scanned for a
+ * previous card. A block that still refers to the nursery afterwards keeps
+ * the card of its start dirty.
+ */
+static void scan_card(unsigned long card, void **scanned_until)
+{
+	struct heap_block *block = card_first[card];
+	void *end = card_address(card + 1);
+
+	for (; block && (void *) block < end && block->size; block = next_block(block)) {
+		if ((void *) block < *scanned_until)
+			continue;
+
+		*scanned_until = next_block(block);
+
+		if (scan_block(block))
+			dirty_card(block);
+	}
+}
+
+static void scan_dirty_cards(void)
+{
+	void *scanned_until = NULL;
+	unsigned long i;
+
+	for (i = 0; i < nr_cards; i++) {
+		if (card_table[i] != GC_CARD_DIRTY)
+			continue;
+
+		card_table[i] = GC_CARD_CLEAN;
+
+		if (page_kinds[i / CARDS_PER_PAGE] != HEAP_PAGE_OLD)
+			continue;
+
+		scan_card(i, &scanned_until);
+	}
+}
+
+static void evacuate_roots(void)
+{
+	struct vm_thread *thread;
+	unsigned long i;
+
+	vm_thread_for_each(thread) {
+		struct heap_buffer *exact;
+
+		if (!thread->ee)
+			continue;
+
+		exact = &thread->ee->heap_roots.exact;
+
+		for (i = 0; i < exact->nr; i++)
+			scan_slot(exact->data[i]);
+	}
+}
+
+static void scan_copied_objects(void)
+{
+	while (gray.nr) {
+		struct heap_block *block = gray.data[--gray.nr];
+
+		if (scan_block(block) && page_kind(block) == HEAP_PAGE_OLD)
+			dirty_card(block);
+	}
+}
+
+static void release_nursery(void)
+{
+	unsigned long i;
+
+	for (i = 0; i < nr_pages; i++) {
+		switch (page_kinds[i]) {
+		case HEAP_PAGE_EDEN:
+		case HEAP_PAGE_SURVIVOR:
+			free_page(i);
+			break;
+		case HEAP_PAGE_TO_SPACE:
+			page_kinds[i] = HEAP_PAGE_SURVIVOR;
+			break;
+		default:
+			break;
+		}
+	}
+
+	nr_eden_pages	= 0;
+	young_used	= survivor_used;
+
+	to_space.cur	= to_space.limit = NULL;
+}
+
+/*
+ * Takes the eden pages and the allocation buffers away from the threads so
+ * that they do not pin the pages.
+ */
+static void reset_thread_allocation(void)
+{
+	struct vm_thread *thread;
+
+	vm_thread_for_each(thread) {
+		struct vm_exec_env *ee = thread->ee;
+
+		if (!ee)
+			continue;
+
+		retire_chunk(&ee->eden_chunk);
+		tlab_flush(&ee->tlab);
+	}
+}
+
+/*
+ * Collects the nursery. All threads are stopped and have recorded their
+ * roots. Called in the GC thread.
+ */
+void heap_collect_minor(struct gc_record *record)
+{
+	unsigned long heap_before;
+	sigset_t mask;
+
+	heap_lock(&mask);
+
+	reset_thread_allocation();
+
+	heap_before	= young_used + old_used;
+	survivor_used	= 0;
+	promoted	= 0;
+
+	pin_roots();
+	promote_pinned_pages();
+
+	evacuate_roots();
+	scan_dirty_cards();
+	scan_copied_objects();
+
+	release_nursery();
+
+	record->kind		= GC_MINOR;
+	record->heap_before	= heap_before;
+	record->heap_after	= young_used + old_used;
+	record->allocated	= bytes_allocated;
+	record->promoted	= promoted;
+
+	bytes_allocated = 0;
+
+	heap_unlock(&mask);
+}
+
+void heap_init(void)
+{
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+	unsigned long size;
+	void *p;
+
+#ifdef CONFIG_64_BIT
+	/* Card marks and putstatic use 32-bit displacements. */
+	flags |= MAP_32BIT;
+#endif
+
+	size = ALIGN(max_heap_size, HEAP_PAGE_SIZE);
+
+	p = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (p == MAP_FAILED)
+		die("could not reserve %lu bytes for the heap", size);
+
+	nr_pages	= size >> HEAP_PAGE_SHIFT;
+	nr_cards	= size >> GC_CARD_SHIFT;
+
+	card_table = mmap(NULL, nr_cards, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (card_table == MAP_FAILED)
+		die("could not allocate the card table");
+
+	memset(card_table, GC_CARD_CLEAN, nr_cards);
+
+	page_kinds	= zalloc(nr_pages);
+	page_pinned	= zalloc(nr_pages);
+	card_first	= zalloc(nr_cards * sizeof(*card_first));
+
+	if (!page_kinds || !page_pinned || !card_first)
+		die("out of memory");
+
+	max_eden_pages = opt_nursery_size >> HEAP_PAGE_SHIFT;
+
+	if (max_eden_pages > nr_pages / 2)
+		max_eden_pages = nr_pages / 2;
+
+	if (!max_eden_pages)
+		max_eden_pages = 1;
+
+	gc_heap_start		= (unsigned long) p;
+	gc_card_table_bias	= (unsigned long) card_table - (gc_heap_start >> GC_CARD_SHIFT);
+
+	if ((long) gc_card_table_bias != (int32_t) gc_card_table_bias)
+		die("card table is out of reach of compiled code");
+
+	/* This turns on the write barriers. */
+	gc_heap_end		= gc_heap_start + size;
+}
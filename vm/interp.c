@@ -3,246 +3,1854 @@
  *
  * This file is released under the 2-clause BSD license. Please refer to the
  * file LICENSE for details.
+ *
+ * The file contains a portable bytecode interpreter that is used for
+ * methods which have not (yet) been compiled by the JIT.
  */
 
 #include "vm/interp.h"
 
 #include "cafebabe/code_attribute.h"
+#include "cafebabe/constant_pool.h"
+
+#include "jit/exception.h"
+#include "jit/emulate.h"
+#include "jit/osr.h"
+
+#include "vm/classloader.h"
+#include "vm/bytecode.h"
+#include "vm/opcodes.h"
+#include "vm/preload.h"
+#include "vm/errors.h"
+#include "vm/string.h"
 #include "vm/method.h"
+#include "vm/object.h"
+#include "vm/class.h"
+#include "vm/call.h"
+#include "vm/die.h"
 
 #include <assert.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
 #include <stdio.h>
+#include <math.h>
+
+/*
+ * Run every method in the interpreter.
+ */
+bool opt_interp_only;
+
+/*
+ * Number of invocations and backward branches after which a method is
+ * compiled. Zero disables the interpreter for methods called through
+ * the JIT trampoline.
+ */
+unsigned long opt_compile_threshold;
+
+/*
+ * The operand stack and local variables are arrays of machine words.
+ * Values of type long and double take two consecutive slots as required
+ * by the JVM specification and are stored with memcpy() so that the
+ * layout matches the argument arrays of native_call() on both 32-bit
+ * and 64-bit machines.
+ */
+struct interp_state {
+	struct vm_method	*method;
+	const struct cafebabe_code_attribute *code_attr;
+	const unsigned char	*code;
+	unsigned long		pc;
+	unsigned long		*locals;
+	unsigned long		nr_locals;
+	unsigned long		*stack;
+	unsigned long		sp;
+
+	/* A backward branch was taken by the last instruction. */
+	bool			backedge;
 
-enum interp_status {
-	INTERP_CONTINUE,
-	INTERP_RETURN,
+	/* On-stack replacement is not possible for this frame. */
+	bool			osr_failed;
 };
 
-static enum interp_status interp(uint8_t opc)
-{
-	switch (opc) {
-	case OPC_NOP:
-		 break;
-	case OPC_ACONST_NULL:	assert(!"OPC_ACONST_NULL"); break;
-	case OPC_ICONST_M1:	assert(!"OPC_ICONST_M1"); break;
-	case OPC_ICONST_0:	assert(!"OPC_ICONST_0"); break;
-	case OPC_ICONST_1:	assert(!"OPC_ICONST_1"); break;
-	case OPC_ICONST_2:	assert(!"OPC_ICONST_2"); break;
-	case OPC_ICONST_3:	assert(!"OPC_ICONST_3"); break;
-	case OPC_ICONST_4:	assert(!"OPC_ICONST_4"); break;
-	case OPC_ICONST_5:	assert(!"OPC_ICONST_5"); break;
-	case OPC_LCONST_0:	assert(!"OPC_LCONST_0"); break;
-	case OPC_LCONST_1:	assert(!"OPC_LCONST_1"); break;
-	case OPC_FCONST_0:	assert(!"OPC_FCONST_0"); break;
-	case OPC_FCONST_1:	assert(!"OPC_FCONST_1"); break;
-	case OPC_FCONST_2:	assert(!"OPC_FCONST_2"); break;
-	case OPC_DCONST_0:	assert(!"OPC_DCONST_0"); break;
-	case OPC_DCONST_1:	assert(!"OPC_DCONST_1"); break;
-	case OPC_BIPUSH:	assert(!"OPC_BIPUSH"); break;
-	case OPC_SIPUSH:	assert(!"OPC_SIPUSH"); break;
-	case OPC_LDC:	assert(!"OPC_LDC"); break;
-	case OPC_LDC_W:	assert(!"OPC_LDC_W"); break;
-	case OPC_LDC2_W:	assert(!"OPC_LDC2_W"); break;
-	case OPC_ILOAD:	assert(!"OPC_ILOAD"); break;
-	case OPC_LLOAD:	assert(!"OPC_LLOAD"); break;
-	case OPC_FLOAD:	assert(!"OPC_FLOAD"); break;
-	case OPC_DLOAD:	assert(!"OPC_DLOAD"); break;
-	case OPC_ALOAD:	assert(!"OPC_ALOAD"); break;
-	case OPC_ILOAD_0:	assert(!"OPC_ILOAD_0"); break;
-	case OPC_ILOAD_1:	assert(!"OPC_ILOAD_1"); break;
-	case OPC_ILOAD_2:	assert(!"OPC_ILOAD_2"); break;
-	case OPC_ILOAD_3:	assert(!"OPC_ILOAD_3"); break;
-	case OPC_LLOAD_0:	assert(!"OPC_LLOAD_0"); break;
-	case OPC_LLOAD_1:	assert(!"OPC_LLOAD_1"); break;
-	case OPC_LLOAD_2:	assert(!"OPC_LLOAD_2"); break;
-	case OPC_LLOAD_3:	assert(!"OPC_LLOAD_3"); break;
-	case OPC_FLOAD_0:	assert(!"OPC_FLOAD_0"); break;
-	case OPC_FLOAD_1:	assert(!"OPC_FLOAD_1"); break;
-	case OPC_FLOAD_2:	assert(!"OPC_FLOAD_2"); break;
-	case OPC_FLOAD_3:	assert(!"OPC_FLOAD_3"); break;
-	case OPC_DLOAD_0:	assert(!"OPC_DLOAD_0"); break;
-	case OPC_DLOAD_1:	assert(!"OPC_DLOAD_1"); break;
-	case OPC_DLOAD_2:	assert(!"OPC_DLOAD_2"); break;
-	case OPC_DLOAD_3:	assert(!"OPC_DLOAD_3"); break;
-	case OPC_ALOAD_0:	assert(!"OPC_ALOAD_0"); break;
-	case OPC_ALOAD_1:	assert(!"OPC_ALOAD_1"); break;
-	case OPC_ALOAD_2:	assert(!"OPC_ALOAD_2"); break;
-	case OPC_ALOAD_3:	assert(!"OPC_ALOAD_3"); break;
-	case OPC_IALOAD:	assert(!"OPC_IALOAD"); break;
-	case OPC_LALOAD:	assert(!"OPC_LALOAD"); break;
-	case OPC_FALOAD:	assert(!"OPC_FALOAD"); break;
-	case OPC_DALOAD:	assert(!"OPC_DALOAD"); break;
-	case OPC_AALOAD:	assert(!"OPC_AALOAD"); break;
-	case OPC_BALOAD:	assert(!"OPC_BALOAD"); break;
-	case OPC_CALOAD:	assert(!"OPC_CALOAD"); break;
-	case OPC_SALOAD:	assert(!"OPC_SALOAD"); break;
-	case OPC_ISTORE:	assert(!"OPC_ISTORE"); break;
-	case OPC_LSTORE:	assert(!"OPC_LSTORE"); break;
-	case OPC_FSTORE:	assert(!"OPC_FSTORE"); break;
-	case OPC_DSTORE:	assert(!"OPC_DSTORE"); break;
-	case OPC_ASTORE:	assert(!"OPC_ASTORE"); break;
-	case OPC_ISTORE_0:	assert(!"OPC_ISTORE_0"); break;
-	case OPC_ISTORE_1:	assert(!"OPC_ISTORE_1"); break;
-	case OPC_ISTORE_2:	assert(!"OPC_ISTORE_2"); break;
-	case OPC_ISTORE_3:	assert(!"OPC_ISTORE_3"); break;
-	case OPC_LSTORE_0:	assert(!"OPC_LSTORE_0"); break;
-	case OPC_LSTORE_1:	assert(!"OPC_LSTORE_1"); break;
-	case OPC_LSTORE_2:	assert(!"OPC_LSTORE_2"); break;
-	case OPC_LSTORE_3:	assert(!"OPC_LSTORE_3"); break;
-	case OPC_FSTORE_0:	assert(!"OPC_FSTORE_0"); break;
-	case OPC_FSTORE_1:	assert(!"OPC_FSTORE_1"); break;
-	case OPC_FSTORE_2:	assert(!"OPC_FSTORE_2"); break;
-	case OPC_FSTORE_3:	assert(!"OPC_FSTORE_3"); break;
-	case OPC_DSTORE_0:	assert(!"OPC_DSTORE_0"); break;
-	case OPC_DSTORE_1:	assert(!"OPC_DSTORE_1"); break;
-	case OPC_DSTORE_2:	assert(!"OPC_DSTORE_2"); break;
-	case OPC_DSTORE_3:	assert(!"OPC_DSTORE_3"); break;
-	case OPC_ASTORE_0:	assert(!"OPC_ASTORE_0"); break;
-	case OPC_ASTORE_1:	assert(!"OPC_ASTORE_1"); break;
-	case OPC_ASTORE_2:	assert(!"OPC_ASTORE_2"); break;
-	case OPC_ASTORE_3:	assert(!"OPC_ASTORE_3"); break;
-	case OPC_IASTORE:	assert(!"OPC_IASTORE"); break;
-	case OPC_LASTORE:	assert(!"OPC_LASTORE"); break;
-	case OPC_FASTORE:	assert(!"OPC_FASTORE"); break;
-	case OPC_DASTORE:	assert(!"OPC_DASTORE"); break;
-	case OPC_AASTORE:	assert(!"OPC_AASTORE"); break;
-	case OPC_BASTORE:	assert(!"OPC_BASTORE"); break;
-	case OPC_CASTORE:	assert(!"OPC_CASTORE"); break;
-	case OPC_SASTORE:	assert(!"OPC_SASTORE"); break;
-	case OPC_POP:	assert(!"OPC_POP"); break;
-	case OPC_POP2:	assert(!"OPC_POP2"); break;
-	case OPC_DUP:	assert(!"OPC_DUP"); break;
-	case OPC_DUP_X1:	assert(!"OPC_DUP_X1"); break;
-	case OPC_DUP_X2:	assert(!"OPC_DUP_X2"); break;
-	case OPC_DUP2:	assert(!"OPC_DUP2"); break;
-	case OPC_DUP2_X1:	assert(!"OPC_DUP2_X1"); break;
-	case OPC_DUP2_X2:	assert(!"OPC_DUP2_X2"); break;
-	case OPC_SWAP:	assert(!"OPC_SWAP"); break;
-	case OPC_IADD:	assert(!"OPC_IADD"); break;
-	case OPC_LADD:	assert(!"OPC_LADD"); break;
-	case OPC_FADD:	assert(!"OPC_FADD"); break;
-	case OPC_DADD:	assert(!"OPC_DADD"); break;
-	case OPC_ISUB:	assert(!"OPC_ISUB"); break;
-	case OPC_LSUB:	assert(!"OPC_LSUB"); break;
-	case OPC_FSUB:	assert(!"OPC_FSUB"); break;
-	case OPC_DSUB:	assert(!"OPC_DSUB"); break;
-	case OPC_IMUL:	assert(!"OPC_IMUL"); break;
-	case OPC_LMUL:	assert(!"OPC_LMUL"); break;
-	case OPC_FMUL:	assert(!"OPC_FMUL"); break;
-	case OPC_DMUL:	assert(!"OPC_DMUL"); break;
-	case OPC_IDIV:	assert(!"OPC_IDIV"); break;
-	case OPC_LDIV:	assert(!"OPC_LDIV"); break;
-	case OPC_FDIV:	assert(!"OPC_FDIV"); break;
-	case OPC_DDIV:	assert(!"OPC_DDIV"); break;
-	case OPC_IREM:	assert(!"OPC_IREM"); break;
-	case OPC_LREM:	assert(!"OPC_LREM"); break;
-	case OPC_FREM:	assert(!"OPC_FREM"); break;
-	case OPC_DREM:	assert(!"OPC_DREM"); break;
-	case OPC_INEG:	assert(!"OPC_INEG"); break;
-	case OPC_LNEG:	assert(!"OPC_LNEG"); break;
-	case OPC_FNEG:	assert(!"OPC_FNEG"); break;
-	case OPC_DNEG:	assert(!"OPC_DNEG"); break;
-	case OPC_ISHL:	assert(!"OPC_ISHL"); break;
-	case OPC_LSHL:	assert(!"OPC_LSHL"); break;
-	case OPC_ISHR:	assert(!"OPC_ISHR"); break;
-	case OPC_LSHR:	assert(!"OPC_LSHR"); break;
-	case OPC_IUSHR:	assert(!"OPC_IUSHR"); break;
-	case OPC_LUSHR:	assert(!"OPC_LUSHR"); break;
-	case OPC_IAND:	assert(!"OPC_IAND"); break;
-	case OPC_LAND:	assert(!"OPC_LAND"); break;
-	case OPC_IOR:	assert(!"OPC_IOR"); break;
-	case OPC_LOR:	assert(!"OPC_LOR"); break;
-	case OPC_IXOR:	assert(!"OPC_IXOR"); break;
-	case OPC_LXOR:	assert(!"OPC_LXOR"); break;
-	case OPC_IINC:	assert(!"OPC_IINC"); break;
-	case OPC_I2L:	assert(!"OPC_I2L"); break;
-	case OPC_I2F:	assert(!"OPC_I2F"); break;
-	case OPC_I2D:	assert(!"OPC_I2D"); break;
-	case OPC_L2I:	assert(!"OPC_L2I"); break;
-	case OPC_L2F:	assert(!"OPC_L2F"); break;
-	case OPC_L2D:	assert(!"OPC_L2D"); break;
-	case OPC_F2I:	assert(!"OPC_F2I"); break;
-	case OPC_F2L:	assert(!"OPC_F2L"); break;
-	case OPC_F2D:	assert(!"OPC_F2D"); break;
-	case OPC_D2I:	assert(!"OPC_D2I"); break;
-	case OPC_D2L:	assert(!"OPC_D2L"); break;
-	case OPC_D2F:	assert(!"OPC_D2F"); break;
-	case OPC_I2B:	assert(!"OPC_I2B"); break;
-	case OPC_I2C:	assert(!"OPC_I2C"); break;
-	case OPC_I2S:	assert(!"OPC_I2S"); break;
-	case OPC_LCMP:	assert(!"OPC_LCMP"); break;
-	case OPC_FCMPL:	assert(!"OPC_FCMPL"); break;
-	case OPC_FCMPG:	assert(!"OPC_FCMPG"); break;
-	case OPC_DCMPL:	assert(!"OPC_DCMPL"); break;
-	case OPC_DCMPG:	assert(!"OPC_DCMPG"); break;
-	case OPC_IFEQ:	assert(!"OPC_IFEQ"); break;
-	case OPC_IFNE:	assert(!"OPC_IFNE"); break;
-	case OPC_IFLT:	assert(!"OPC_IFLT"); break;
-	case OPC_IFGE:	assert(!"OPC_IFGE"); break;
-	case OPC_IFGT:	assert(!"OPC_IFGT"); break;
-	case OPC_IFLE:	assert(!"OPC_IFLE"); break;
-	case OPC_IF_ICMPEQ:	assert(!"OPC_IF_ICMPEQ"); break;
-	case OPC_IF_ICMPNE:	assert(!"OPC_IF_ICMPNE"); break;
-	case OPC_IF_ICMPLT:	assert(!"OPC_IF_ICMPLT"); break;
-	case OPC_IF_ICMPGE:	assert(!"OPC_IF_ICMPGE"); break;
-	case OPC_IF_ICMPGT:	assert(!"OPC_IF_ICMPGT"); break;
-	case OPC_IF_ICMPLE:	assert(!"OPC_IF_ICMPLE"); break;
-	case OPC_IF_ACMPEQ:	assert(!"OPC_IF_ACMPEQ"); break;
-	case OPC_IF_ACMPNE:	assert(!"OPC_IF_ACMPNE"); break;
-	case OPC_GOTO:	assert(!"OPC_GOTO"); break;
-	case OPC_JSR:	assert(!"OPC_JSR"); break;
-	case OPC_RET:	assert(!"OPC_RET"); break;
-	case OPC_TABLESWITCH:	assert(!"OPC_TABLESWITCH"); break;
-	case OPC_LOOKUPSWITCH:	assert(!"OPC_LOOKUPSWITCH"); break;
-	case OPC_IRETURN:	assert(!"OPC_IRETURN"); break;
-	case OPC_LRETURN:	assert(!"OPC_LRETURN"); break;
-	case OPC_FRETURN:	assert(!"OPC_FRETURN"); break;
-	case OPC_DRETURN:	assert(!"OPC_DRETURN"); break;
-	case OPC_ARETURN:	assert(!"OPC_ARETURN"); break;
-	case OPC_RETURN:
-		return INTERP_RETURN;
-	case OPC_GETSTATIC:	assert(!"OPC_GETSTATIC"); break;
-	case OPC_PUTSTATIC:	assert(!"OPC_PUTSTATIC"); break;
-	case OPC_GETFIELD:	assert(!"OPC_GETFIELD"); break;
-	case OPC_PUTFIELD:	assert(!"OPC_PUTFIELD"); break;
-	case OPC_INVOKEVIRTUAL:	assert(!"OPC_INVOKEVIRTUAL"); break;
-	case OPC_INVOKESPECIAL:	assert(!"OPC_INVOKESPECIAL"); break;
-	case OPC_INVOKESTATIC:	assert(!"OPC_INVOKESTATIC"); break;
-	case OPC_INVOKEINTERFACE:	assert(!"OPC_INVOKEINTERFACE"); break;
-	case OPC_NEW:	assert(!"OPC_NEW"); break;
-	case OPC_NEWARRAY:	assert(!"OPC_NEWARRAY"); break;
-	case OPC_ANEWARRAY:	assert(!"OPC_ANEWARRAY"); break;
-	case OPC_ARRAYLENGTH:	assert(!"OPC_ARRAYLENGTH"); break;
-	case OPC_ATHROW:	assert(!"OPC_ATHROW"); break;
-	case OPC_CHECKCAST:	assert(!"OPC_CHECKCAST"); break;
-	case OPC_INSTANCEOF:	assert(!"OPC_INSTANCEOF"); break;
-	case OPC_MONITORENTER:	assert(!"OPC_MONITORENTER"); break;
-	case OPC_MONITOREXIT:	assert(!"OPC_MONITOREXIT"); break;
-	case OPC_WIDE:	assert(!"OPC_WIDE"); break;
-	case OPC_MULTIANEWARRAY:	assert(!"OPC_MULTIANEWARRAY"); break;
-	case OPC_IFNULL:	assert(!"OPC_IFNULL"); break;
-	case OPC_IFNONNULL:	assert(!"OPC_IFNONNULL"); break;
-	case OPC_GOTO_W:	assert(!"OPC_GOTO_W"); break;
-	case OPC_JSR_W:	assert(!"OPC_JSR_W"); break;
-	case OPC_BREAKPOINT:	assert(!"OPC_BREAKPOINT"); break;
+static inline void push(struct interp_state *s, unsigned long value)
+{
+	s->stack[s->sp++] = value;
+}
+
+static inline unsigned long pop(struct interp_state *s)
+{
+	return s->stack[--s->sp];
+}
+
+static inline void push_int(struct interp_state *s, jint value)
+{
+	push(s, (unsigned long) (long) value);
+}
+
+static inline jint pop_int(struct interp_state *s)
+{
+	return (jint) pop(s);
+}
+
+static inline void push_ref(struct interp_state *s, struct vm_object *obj)
+{
+	push(s, (unsigned long) obj);
+}
+
+static inline struct vm_object *pop_ref(struct interp_state *s)
+{
+	return (struct vm_object *) pop(s);
+}
+
+static inline void push_float(struct interp_state *s, jfloat value)
+{
+	unsigned long slot = 0;
+
+	memcpy(&slot, &value, sizeof(value));
+	push(s, slot);
+}
+
+static inline jfloat pop_float(struct interp_state *s)
+{
+	unsigned long slot = pop(s);
+	jfloat value;
+
+	memcpy(&value, &slot, sizeof(value));
+	return value;
+}
+
+static inline void push_long(struct interp_state *s, jlong value)
+{
+	memcpy(&s->stack[s->sp], &value, sizeof(value));
+	s->sp += 2;
+}
+
+static inline jlong pop_long(struct interp_state *s)
+{
+	jlong value;
+
+	s->sp -= 2;
+	memcpy(&value, &s->stack[s->sp], sizeof(value));
+	return value;
+}
+
+static inline void push_double(struct interp_state *s, jdouble value)
+{
+	memcpy(&s->stack[s->sp], &value, sizeof(value));
+	s->sp += 2;
+}
+
+static inline jdouble pop_double(struct interp_state *s)
+{
+	jdouble value;
+
+	s->sp -= 2;
+	memcpy(&value, &s->stack[s->sp], sizeof(value));
+	return value;
+}
+
+static inline void load_wide(struct interp_state *s, unsigned int idx)
+{
+	memcpy(&s->stack[s->sp], &s->locals[idx], 8);
+	s->sp += 2;
+}
+
+static inline void store_wide(struct interp_state *s, unsigned int idx)
+{
+	s->sp -= 2;
+	memcpy(&s->locals[idx], &s->stack[s->sp], 8);
+}
+
+static void push_jvalue(struct interp_state *s, enum vm_type type,
+			union jvalue *value)
+{
+	switch (type) {
+	case J_VOID:
+		break;
+	case J_REFERENCE:
+		push_ref(s, value->l);
+		break;
+	case J_BOOLEAN:
+		push_int(s, value->z);
+		break;
+	case J_BYTE:
+		push_int(s, value->b);
+		break;
+	case J_CHAR:
+		push_int(s, value->c);
+		break;
+	case J_SHORT:
+		push_int(s, value->s);
+		break;
+	case J_INT:
+		push_int(s, value->i);
+		break;
+	case J_LONG:
+		push_long(s, value->j);
+		break;
+	case J_FLOAT:
+		push_float(s, value->f);
+		break;
+	case J_DOUBLE:
+		push_double(s, value->d);
+		break;
 	default:
-		assert(!"unknown bytecode");
+		die("unexpected type: %d", type);
 	}
+}
+
+static void get_field_value(struct interp_state *s, struct vm_field *vmf,
+			    struct vm_object *obj)
+{
+	union jvalue value;
 
-	return INTERP_CONTINUE;
+	switch (vm_field_type(vmf)) {
+	case J_REFERENCE:
+		value.l = obj ? field_get_object(obj, vmf) : static_field_get_object(vmf);
+		break;
+	case J_BOOLEAN:
+		value.z = obj ? field_get_boolean(obj, vmf) : static_field_get_boolean(vmf);
+		break;
+	case J_BYTE:
+		value.b = obj ? field_get_byte(obj, vmf) : static_field_get_byte(vmf);
+		break;
+	case J_CHAR:
+		value.c = obj ? field_get_char(obj, vmf) : static_field_get_char(vmf);
+		break;
+	case J_SHORT:
+		value.s = obj ? field_get_short(obj, vmf) : static_field_get_short(vmf);
+		break;
+	case J_INT:
+		value.i = obj ? field_get_int(obj, vmf) : static_field_get_int(vmf);
+		break;
+	case J_LONG:
+		value.j = obj ? field_get_long(obj, vmf) : static_field_get_long(vmf);
+		break;
+	case J_FLOAT:
+		value.f = obj ? field_get_float(obj, vmf) : static_field_get_float(vmf);
+		break;
+	case J_DOUBLE:
+		value.d = obj ? field_get_double(obj, vmf) : static_field_get_double(vmf);
+		break;
+	default:
+		die("unexpected field type: %d", vm_field_type(vmf));
+	}
+
+	push_jvalue(s, vm_field_type(vmf), &value);
 }
 
-void vm_interp_method_v(struct vm_method *method, va_list args, union jvalue *result)
+static void put_static_value(struct interp_state *s, struct vm_field *vmf)
+{
+	switch (vm_field_type(vmf)) {
+	case J_REFERENCE:
+		static_field_set_object(vmf, pop_ref(s));
+		break;
+	case J_BOOLEAN:
+		static_field_set_boolean(vmf, pop_int(s));
+		break;
+	case J_BYTE:
+		static_field_set_byte(vmf, pop_int(s));
+		break;
+	case J_CHAR:
+		static_field_set_char(vmf, pop_int(s));
+		break;
+	case J_SHORT:
+		static_field_set_short(vmf, pop_int(s));
+		break;
+	case J_INT:
+		static_field_set_int(vmf, pop_int(s));
+		break;
+	case J_LONG:
+		static_field_set_long(vmf, pop_long(s));
+		break;
+	case J_FLOAT:
+		static_field_set_float(vmf, pop_float(s));
+		break;
+	case J_DOUBLE:
+		static_field_set_double(vmf, pop_double(s));
+		break;
+	default:
+		die("unexpected field type: %d", vm_field_type(vmf));
+	}
+}
+
+static void put_field_value(struct vm_object *obj, struct vm_field *vmf,
+			    union jvalue *value)
+{
+	switch (vm_field_type(vmf)) {
+	case J_REFERENCE:
+		field_set_object(obj, vmf, value->l);
+		break;
+	case J_BOOLEAN:
+		field_set_boolean(obj, vmf, value->i);
+		break;
+	case J_BYTE:
+		field_set_byte(obj, vmf, value->i);
+		break;
+	case J_CHAR:
+		field_set_char(obj, vmf, value->i);
+		break;
+	case J_SHORT:
+		field_set_short(obj, vmf, value->i);
+		break;
+	case J_INT:
+		field_set_int(obj, vmf, value->i);
+		break;
+	case J_LONG:
+		field_set_long(obj, vmf, value->j);
+		break;
+	case J_FLOAT:
+		field_set_float(obj, vmf, value->f);
+		break;
+	case J_DOUBLE:
+		field_set_double(obj, vmf, value->d);
+		break;
+	default:
+		die("unexpected field type: %d", vm_field_type(vmf));
+	}
+}
+
+static void pop_field_value(struct interp_state *s, struct vm_field *vmf,
+			    union jvalue *value)
+{
+	switch (vm_field_type(vmf)) {
+	case J_REFERENCE:
+		value->l = pop_ref(s);
+		break;
+	case J_LONG:
+		value->j = pop_long(s);
+		break;
+	case J_FLOAT:
+		value->f = pop_float(s);
+		break;
+	case J_DOUBLE:
+		value->d = pop_double(s);
+		break;
+	default:
+		value->i = pop_int(s);
+		break;
+	}
+}
+
+static struct vm_field *resolve_field(struct interp_state *s)
+{
+	struct vm_field *vmf;
+
+	vmf = vm_class_resolve_field_recursive(s->method->class,
+					       read_u16(&s->code[s->pc + 1]));
+	if (!vmf && !exception_occurred())
+		signal_new_exception(vm_java_lang_NoSuchFieldError, NULL);
+
+	return vmf;
+}
+
+static struct vm_class *resolve_class(struct interp_state *s)
+{
+	struct vm_class *vmc;
+
+	vmc = vm_class_resolve_class(s->method->class,
+				     read_u16(&s->code[s->pc + 1]));
+	if (!vmc && !exception_occurred())
+		signal_new_exception(vm_java_lang_NoClassDefFoundError, NULL);
+
+	return vmc;
+}
+
+static int load_constant(struct interp_state *s, unsigned long idx)
+{
+	const struct cafebabe_constant_info_utf8 *utf8;
+	struct cafebabe_constant_pool *cp;
+	struct vm_object *string;
+	struct vm_class *class;
+	struct vm_class *vmc;
+
+	vmc = s->method->class;
+
+	if (cafebabe_class_constant_index_invalid(vmc->class, idx)) {
+		signal_new_exception(vm_java_lang_VerifyError, "invalid constant index: %lu", idx);
+		return -1;
+	}
+
+	cp = &vmc->class->constant_pool[idx];
+
+	switch (cp->tag) {
+	case CAFEBABE_CONSTANT_TAG_INTEGER:
+		push_int(s, cafebabe_constant_pool_get_integer(cp));
+		break;
+	case CAFEBABE_CONSTANT_TAG_FLOAT:
+		push_float(s, cafebabe_constant_pool_get_float(cp));
+		break;
+	case CAFEBABE_CONSTANT_TAG_LONG:
+		push_long(s, cafebabe_constant_pool_get_long(cp));
+		break;
+	case CAFEBABE_CONSTANT_TAG_DOUBLE:
+		push_double(s, cafebabe_constant_pool_get_double(cp));
+		break;
+	case CAFEBABE_CONSTANT_TAG_STRING:
+		if (cafebabe_class_constant_get_utf8(vmc->class, cp->string.string_index, &utf8)) {
+			throw_internal_error();
+			return -1;
+		}
+
+		string = vm_object_alloc_string_from_utf8(utf8->bytes, utf8->length);
+		if (!string)
+			return -1;
+
+		string = vm_string_intern(string);
+		if (!string)
+			return -1;
+
+		push_ref(s, string);
+		break;
+	case CAFEBABE_CONSTANT_TAG_CLASS:
+		class = vm_class_resolve_class(vmc, idx);
+		if (!class) {
+			if (!exception_occurred())
+				signal_new_exception(vm_java_lang_NoClassDefFoundError, NULL);
+			return -1;
+		}
+
+		if (vm_class_ensure_object(class))
+			return -1;
+
+		push_ref(s, class->object);
+		break;
+	default:
+		signal_new_exception(vm_java_lang_VerifyError, "unknown constant tag: %d", cp->tag);
+		return -1;
+	}
+
+	return 0;
+}
+
+static unsigned int nr_arg_slots(struct vm_method *vmm)
+{
+	return vm_method_arg_slots(vmm) + !vm_method_is_static(vmm);
+}
+
+static int invoke(struct interp_state *s, struct vm_method *target, bool virtual)
+{
+	unsigned long args[target->args_count];
+	struct vm_object *this;
+	union jvalue result;
+	unsigned int nr_slots;
+
+	nr_slots = nr_arg_slots(target);
+	s->sp -= nr_slots;
+
+	if (vm_method_is_missing(target)) {
+		signal_new_exception(vm_java_lang_NoSuchMethodError, "%s.%s%s",
+				     target->class->name, target->name, target->type);
+		return -1;
+	}
+
+	memset(args, 0, sizeof(args));
+	memcpy(args, &s->stack[s->sp], nr_slots * sizeof(unsigned long));
+
+	if (!vm_method_is_static(target)) {
+		this = (struct vm_object *) args[0];
+		if (!this) {
+			signal_new_exception(vm_java_lang_NullPointerException, NULL);
+			return -1;
+		}
+	} else
+		this = NULL;
+
+	if (virtual && vm_method_is_virtual(target))
+		vm_call_method_this_a(target, this, args, &result);
+	else
+		vm_call_method_a(target, args, &result);
+
+	if (exception_occurred())
+		return -1;
+
+	push_jvalue(s, target->return_type.vm_type, &result);
+	return 0;
+}
+
+static struct vm_object *
+array_ref(struct interp_state *s, struct vm_object *array, jint index)
+{
+	if (!array) {
+		signal_new_exception(vm_java_lang_NullPointerException, NULL);
+		return NULL;
+	}
+
+	vm_object_check_array(array, index);
+	if (exception_occurred())
+		return NULL;
+
+	return array;
+}
+
+static struct vm_object *new_array(struct vm_class *elem_class, jint count)
+{
+	struct vm_class *array_class;
+
+	array_size_check(count);
+	if (exception_occurred())
+		return NULL;
+
+	array_class = vm_class_get_array_class(elem_class);
+	if (!array_class)
+		return rethrow_exception();
+
+	return vm_object_alloc_array(array_class, count);
+}
+
+static bool find_handler(struct interp_state *s)
+{
+	const struct cafebabe_code_attribute *code_attr = s->code_attr;
+	struct vm_object *exception;
+	unsigned int i;
+
+	exception = exception_occurred();
+	assert(exception != NULL);
+
+	for (i = 0; i < code_attr->exception_table_length; i++) {
+		struct cafebabe_code_attribute_exception *eh;
+		struct vm_class *catch_class;
+
+		eh = &code_attr->exception_table[i];
+		if (!exception_covers(eh, s->pc))
+			continue;
+
+		/* This matches to everything. */
+		if (eh->catch_type == 0)
+			break;
+
+		catch_class = vm_class_resolve_class(s->method->class, eh->catch_type);
+		if (!catch_class)
+			continue;
+
+		if (vm_class_is_assignable_from(catch_class, exception->class))
+			break;
+	}
+
+	if (i == code_attr->exception_table_length) {
+		/* Class resolution above might have clobbered it. */
+		signal_exception(exception);
+		return false;
+	}
+
+	clear_exception();
+
+	s->sp = 0;
+	push_ref(s, exception);
+	s->pc = code_attr->exception_table[i].handler_pc;
+
+	return true;
+}
+
+static struct vm_object *method_lock_object(struct vm_method *method,
+					    unsigned long *args)
+{
+	if (vm_method_is_static(method))
+		return method->class->object;
+
+	return (struct vm_object *) args[0];
+}
+
+static inline void count_backedge(struct interp_state *s, int32_t offset)
+{
+	if (offset <= 0) {
+		atomic_inc(&s->method->backedge_count);
+		s->backedge = true;
+	}
+}
+
+static unsigned long method_hotness(struct vm_method *method)
+{
+	return atomic_read(&method->invocation_count)
+		+ atomic_read(&method->backedge_count);
+}
+
+/*
+ * Transfers a frame that is looping in the interpreter to the compiled
+ * code of the method once the method gets hot. This is only done when
+ * the operand stack is empty. Returns true if the method was completed
+ * in the compiled code.
+ */
+static bool try_osr(struct interp_state *s, union jvalue *result)
+{
+	int err;
+
+	if (!opt_use_osr || opt_interp_only || !opt_compile_threshold)
+		return false;
+
+	if (s->osr_failed || s->sp != 0)
+		return false;
+
+	if (method_hotness(s->method) < opt_compile_threshold)
+		return false;
+
+	err = osr_enter(s->method, s->code, s->pc, s->locals, s->nr_locals, result);
+	if (err == -EAGAIN || err == -ENOENT)
+		return false;
+
+	if (err) {
+		s->osr_failed = true;
+		return false;
+	}
+
+	return true;
+}
+
+#define BRANCH_IF(cond)							\
+	do {								\
+		if (cond) {						\
+			int32_t __offset = read_s16(&code[s.pc + 1]);	\
+									\
+			count_backedge(&s, __offset);			\
+			s.pc += __offset;				\
+		} else							\
+			s.pc += 3;					\
+	} while (0)
+
+#define ARITH(type, op)							\
+	do {								\
+		j ## type __v2 = pop_ ## type(&s);			\
+		j ## type __v1 = pop_ ## type(&s);			\
+									\
+		push_ ## type(&s, __v1 op __v2);			\
+		s.pc++;							\
+	} while (0)
+
+/*
+ * Integer arithmetic in Java wraps around on overflow. Do it with
+ * unsigned types so that we don't rely on undefined behavior.
+ */
+#define INT_ARITH(op)							\
+	do {								\
+		uint32_t __v2 = pop_int(&s);				\
+		uint32_t __v1 = pop_int(&s);				\
+									\
+		push_int(&s, (jint) (__v1 op __v2));			\
+		s.pc++;							\
+	} while (0)
+
+#define LONG_ARITH(op)							\
+	do {								\
+		uint64_t __v2 = pop_long(&s);				\
+		uint64_t __v1 = pop_long(&s);				\
+									\
+		push_long(&s, (jlong) (__v1 op __v2));			\
+		s.pc++;							\
+	} while (0)
+
+#define ARRAY_LOAD(type, push_type)					\
+	do {								\
+		jint __index = pop_int(&s);				\
+		struct vm_object *__array = array_ref(&s, pop_ref(&s), __index); \
+									\
+		if (!__array)						\
+			goto throw;					\
+									\
+		push_ ## push_type(&s, array_get_field_ ## type(__array, __index)); \
+		s.pc++;							\
+	} while (0)
+
+#define ARRAY_STORE(type, pop_type)					\
+	do {								\
+		j ## type __value = pop_ ## pop_type(&s);		\
+		jint __index = pop_int(&s);				\
+		struct vm_object *__array = array_ref(&s, pop_ref(&s), __index); \
+									\
+		if (!__array)						\
+			goto throw;					\
+									\
+		array_set_field_ ## type(__array, __index, __value);	\
+		s.pc++;							\
+	} while (0)
+
+/*
+ * The frame is sized and run from the same @code_attr so that it stays
+ * consistent even if the method's code attribute is replaced meanwhile.
+ */
+static void init_interp_state(struct interp_state *s, struct vm_method *method,
+			      const struct cafebabe_code_attribute *code_attr,
+			      unsigned long pc, unsigned long *locals,
+			      unsigned long *stack)
 {
-	uint32_t pc;
+	s->method	= method;
+	s->code_attr	= code_attr;
+	s->code		= code_attr->code;
+	s->pc		= pc;
+	s->locals	= locals;
+	s->nr_locals	= code_attr->max_locals;
+	s->stack	= stack;
+	s->sp		= 0;
+	s->backedge	= false;
+	s->osr_failed	= false;
+}
+
+/*
+ * Runs the method of @s from the state in @s until it returns. The lock of
+ * a synchronized method is released through @lock_obj. If @throwing is
+ * true, the pending exception is thrown at the current pc first.
+ */
+static void interp(struct interp_state s, struct vm_object *lock_obj,
+		   bool throwing, union jvalue *result)
+{
+	struct vm_method *method = s.method;
+	const unsigned char *code = s.code;
+	unsigned long *locals = s.locals;
+	unsigned long *stack = s.stack;
+	bool wide = false;
+
+	if (throwing)
+		goto throw;
+
+	for (;;) {
+		unsigned char opc = code[s.pc];
+
+		switch (opc) {
+		case OPC_NOP:
+			s.pc++;
+			break;
+		case OPC_ACONST_NULL:
+			push_ref(&s, NULL);
+			s.pc++;
+			break;
+		case OPC_ICONST_M1:
+		case OPC_ICONST_0:
+		case OPC_ICONST_1:
+		case OPC_ICONST_2:
+		case OPC_ICONST_3:
+		case OPC_ICONST_4:
+		case OPC_ICONST_5:
+			push_int(&s, opc - OPC_ICONST_0);
+			s.pc++;
+			break;
+		case OPC_LCONST_0:
+		case OPC_LCONST_1:
+			push_long(&s, opc - OPC_LCONST_0);
+			s.pc++;
+			break;
+		case OPC_FCONST_0:
+		case OPC_FCONST_1:
+		case OPC_FCONST_2:
+			push_float(&s, opc - OPC_FCONST_0);
+			s.pc++;
+			break;
+		case OPC_DCONST_0:
+		case OPC_DCONST_1:
+			push_double(&s, opc - OPC_DCONST_0);
+			s.pc++;
+			break;
+		case OPC_BIPUSH:
+			push_int(&s, (int8_t) code[s.pc + 1]);
+			s.pc += 2;
+			break;
+		case OPC_SIPUSH:
+			push_int(&s, read_s16(&code[s.pc + 1]));
+			s.pc += 3;
+			break;
+		case OPC_LDC:
+			if (load_constant(&s, code[s.pc + 1]))
+				goto throw;
+			s.pc += 2;
+			break;
+		case OPC_LDC_W:
+		case OPC_LDC2_W:
+			if (load_constant(&s, read_u16(&code[s.pc + 1])))
+				goto throw;
+			s.pc += 3;
+			break;
+		case OPC_ILOAD:
+		case OPC_FLOAD:
+		case OPC_ALOAD:
+			if (wide) {
+				push(&s, locals[read_u16(&code[s.pc + 1])]);
+				s.pc += 3;
+			} else {
+				push(&s, locals[code[s.pc + 1]]);
+				s.pc += 2;
+			}
+			break;
+		case OPC_LLOAD:
+		case OPC_DLOAD:
+			if (wide) {
+				load_wide(&s, read_u16(&code[s.pc + 1]));
+				s.pc += 3;
+			} else {
+				load_wide(&s, code[s.pc + 1]);
+				s.pc += 2;
+			}
+			break;
+		case OPC_ILOAD_0:
+		case OPC_ILOAD_1:
+		case OPC_ILOAD_2:
+		case OPC_ILOAD_3:
+			push(&s, locals[opc - OPC_ILOAD_0]);
+			s.pc++;
+			break;
+		case OPC_LLOAD_0:
+		case OPC_LLOAD_1:
+		case OPC_LLOAD_2:
+		case OPC_LLOAD_3:
+			load_wide(&s, opc - OPC_LLOAD_0);
+			s.pc++;
+			break;
+		case OPC_FLOAD_0:
+		case OPC_FLOAD_1:
+		case OPC_FLOAD_2:
+		case OPC_FLOAD_3:
+			push(&s, locals[opc - OPC_FLOAD_0]);
+			s.pc++;
+			break;
+		case OPC_DLOAD_0:
+		case OPC_DLOAD_1:
+		case OPC_DLOAD_2:
+		case OPC_DLOAD_3:
+			load_wide(&s, opc - OPC_DLOAD_0);
+			s.pc++;
+			break;
+		case OPC_ALOAD_0:
+		case OPC_ALOAD_1:
+		case OPC_ALOAD_2:
+		case OPC_ALOAD_3:
+			push(&s, locals[opc - OPC_ALOAD_0]);
+			s.pc++;
+			break;
+		case OPC_IALOAD:
+			ARRAY_LOAD(int, int);
+			break;
+		case OPC_LALOAD:
+			ARRAY_LOAD(long, long);
+			break;
+		case OPC_FALOAD:
+			ARRAY_LOAD(float, float);
+			break;
+		case OPC_DALOAD:
+			ARRAY_LOAD(double, double);
+			break;
+		case OPC_AALOAD:
+			ARRAY_LOAD(object, ref);
+			break;
+		case OPC_BALOAD:
+			ARRAY_LOAD(byte, int);
+			break;
+		case OPC_CALOAD:
+			ARRAY_LOAD(char, int);
+			break;
+		case OPC_SALOAD:
+			ARRAY_LOAD(short, int);
+			break;
+		case OPC_ISTORE:
+		case OPC_FSTORE:
+		case OPC_ASTORE:
+			if (wide) {
+				locals[read_u16(&code[s.pc + 1])] = pop(&s);
+				s.pc += 3;
+			} else {
+				locals[code[s.pc + 1]] = pop(&s);
+				s.pc += 2;
+			}
+			break;
+		case OPC_LSTORE:
+		case OPC_DSTORE:
+			if (wide) {
+				store_wide(&s, read_u16(&code[s.pc + 1]));
+				s.pc += 3;
+			} else {
+				store_wide(&s, code[s.pc + 1]);
+				s.pc += 2;
+			}
+			break;
+		case OPC_ISTORE_0:
+		case OPC_ISTORE_1:
+		case OPC_ISTORE_2:
+		case OPC_ISTORE_3:
+			locals[opc - OPC_ISTORE_0] = pop(&s);
+			s.pc++;
+			break;
+		case OPC_LSTORE_0:
+		case OPC_LSTORE_1:
+		case OPC_LSTORE_2:
+		case OPC_LSTORE_3:
+			store_wide(&s, opc - OPC_LSTORE_0);
+			s.pc++;
+			break;
+		case OPC_FSTORE_0:
+		case OPC_FSTORE_1:
+		case OPC_FSTORE_2:
+		case OPC_FSTORE_3:
+			locals[opc - OPC_FSTORE_0] = pop(&s);
+			s.pc++;
+			break;
+		case OPC_DSTORE_0:
+		case OPC_DSTORE_1:
+		case OPC_DSTORE_2:
+		case OPC_DSTORE_3:
+			store_wide(&s, opc - OPC_DSTORE_0);
+			s.pc++;
+			break;
+		case OPC_ASTORE_0:
+		case OPC_ASTORE_1:
+		case OPC_ASTORE_2:
+		case OPC_ASTORE_3:
+			locals[opc - OPC_ASTORE_0] = pop(&s);
+			s.pc++;
+			break;
+		case OPC_IASTORE:
+			ARRAY_STORE(int, int);
+			break;
+		case OPC_LASTORE:
+			ARRAY_STORE(long, long);
+			break;
+		case OPC_FASTORE:
+			ARRAY_STORE(float, float);
+			break;
+		case OPC_DASTORE:
+			ARRAY_STORE(double, double);
+			break;
+		case OPC_AASTORE: {
+			struct vm_object *value = pop_ref(&s);
+			jint index = pop_int(&s);
+			struct vm_object *array = array_ref(&s, pop_ref(&s), index);
+
+			if (!array)
+				goto throw;
+
+			array_store_check(array, value);
+			if (exception_occurred())
+				goto throw;
+
+			array_set_field_object(array, index, value);
+			s.pc++;
+			break;
+		}
+		case OPC_BASTORE:
+			ARRAY_STORE(byte, int);
+			break;
+		case OPC_CASTORE:
+			ARRAY_STORE(char, int);
+			break;
+		case OPC_SASTORE:
+			ARRAY_STORE(short, int);
+			break;
+		case OPC_POP:
+			s.sp--;
+			s.pc++;
+			break;
+		case OPC_POP2:
+			s.sp -= 2;
+			s.pc++;
+			break;
+		case OPC_DUP:
+			push(&s, stack[s.sp - 1]);
+			s.pc++;
+			break;
+		case OPC_DUP_X1: {
+			unsigned long v1 = pop(&s), v2 = pop(&s);
+
+			push(&s, v1);
+			push(&s, v2);
+			push(&s, v1);
+			s.pc++;
+			break;
+		}
+		case OPC_DUP_X2: {
+			unsigned long v1 = pop(&s), v2 = pop(&s), v3 = pop(&s);
+
+			push(&s, v1);
+			push(&s, v3);
+			push(&s, v2);
+			push(&s, v1);
+			s.pc++;
+			break;
+		}
+		case OPC_DUP2: {
+			unsigned long v1 = pop(&s), v2 = pop(&s);
+
+			push(&s, v2);
+			push(&s, v1);
+			push(&s, v2);
+			push(&s, v1);
+			s.pc++;
+			break;
+		}
+		case OPC_DUP2_X1: {
+			unsigned long v1 = pop(&s), v2 = pop(&s), v3 = pop(&s);
+
+			push(&s, v2);
+			push(&s, v1);
+			push(&s, v3);
+			push(&s, v2);
+			push(&s, v1);
+			s.pc++;
+			break;
+		}
+		case OPC_DUP2_X2: {
+			unsigned long v1 = pop(&s), v2 = pop(&s), v3 = pop(&s), v4 = pop(&s);
+
+			push(&s, v2);
+			push(&s, v1);
+			push(&s, v4);
+			push(&s, v3);
+			push(&s, v2);
+			push(&s, v1);
+			s.pc++;
+			break;
+		}
+		case OPC_SWAP: {
+			unsigned long v1 = pop(&s), v2 = pop(&s);
+
+			push(&s, v1);
+			push(&s, v2);
+			s.pc++;
+			break;
+		}
+		case OPC_IADD:
+			INT_ARITH(+);
+			break;
+		case OPC_LADD:
+			LONG_ARITH(+);
+			break;
+		case OPC_FADD:
+			ARITH(float, +);
+			break;
+		case OPC_DADD:
+			ARITH(double, +);
+			break;
+		case OPC_ISUB:
+			INT_ARITH(-);
+			break;
+		case OPC_LSUB:
+			LONG_ARITH(-);
+			break;
+		case OPC_FSUB:
+			ARITH(float, -);
+			break;
+		case OPC_DSUB:
+			ARITH(double, -);
+			break;
+		case OPC_IMUL:
+			INT_ARITH(*);
+			break;
+		case OPC_LMUL:
+			LONG_ARITH(*);
+			break;
+		case OPC_FMUL:
+			ARITH(float, *);
+			break;
+		case OPC_DMUL:
+			ARITH(double, *);
+			break;
+		case OPC_IDIV:
+		case OPC_IREM: {
+			jint v2 = pop_int(&s);
+			jint v1 = pop_int(&s);
+
+			if (v2 == 0) {
+				signal_new_exception(vm_java_lang_ArithmeticException, "division by zero");
+				goto throw;
+			}
+
+			if (v2 == -1)
+				push_int(&s, opc == OPC_IDIV ? (jint) -(uint32_t) v1 : 0);
+			else
+				push_int(&s, opc == OPC_IDIV ? v1 / v2 : v1 % v2);
+			s.pc++;
+			break;
+		}
+		case OPC_LDIV:
+		case OPC_LREM: {
+			jlong v2 = pop_long(&s);
+			jlong v1 = pop_long(&s);
+
+			if (v2 == 0) {
+				signal_new_exception(vm_java_lang_ArithmeticException, "division by zero");
+				goto throw;
+			}
+
+			if (v2 == -1)
+				push_long(&s, opc == OPC_LDIV ? (jlong) -(uint64_t) v1 : 0);
+			else
+				push_long(&s, opc == OPC_LDIV ? v1 / v2 : v1 % v2);
+			s.pc++;
+			break;
+		}
+		case OPC_FDIV:
+			ARITH(float, /);
+			break;
+		case OPC_DDIV:
+			ARITH(double, /);
+			break;
+		case OPC_FREM: {
+			jfloat v2 = pop_float(&s);
+			jfloat v1 = pop_float(&s);
+
+			push_float(&s, fmodf(v1, v2));
+			s.pc++;
+			break;
+		}
+		case OPC_DREM: {
+			jdouble v2 = pop_double(&s);
+			jdouble v1 = pop_double(&s);
+
+			push_double(&s, fmod(v1, v2));
+			s.pc++;
+			break;
+		}
+		case OPC_INEG:
+			push_int(&s, (jint) -(uint32_t) pop_int(&s));
+			s.pc++;
+			break;
+		case OPC_LNEG:
+			push_long(&s, (jlong) -(uint64_t) pop_long(&s));
+			s.pc++;
+			break;
+		case OPC_FNEG:
+			push_float(&s, -pop_float(&s));
+			s.pc++;
+			break;
+		case OPC_DNEG:
+			push_double(&s, -pop_double(&s));
+			s.pc++;
+			break;
+		case OPC_ISHL: {
+			jint v2 = pop_int(&s);
+			jint v1 = pop_int(&s);
+
+			push_int(&s, emulate_ishl(v1, v2));
+			s.pc++;
+			break;
+		}
+		case OPC_LSHL: {
+			jint v2 = pop_int(&s);
+			jlong v1 = pop_long(&s);
+
+			push_long(&s, emulate_lshl(v1, v2));
+			s.pc++;
+			break;
+		}
+		case OPC_ISHR: {
+			jint v2 = pop_int(&s);
+			jint v1 = pop_int(&s);
+
+			push_int(&s, emulate_ishr(v1, v2));
+			s.pc++;
+			break;
+		}
+		case OPC_LSHR: {
+			jint v2 = pop_int(&s);
+			jlong v1 = pop_long(&s);
+
+			push_long(&s, emulate_lshr(v1, v2));
+			s.pc++;
+			break;
+		}
+		case OPC_IUSHR: {
+			jint v2 = pop_int(&s);
+			jint v1 = pop_int(&s);
+
+			push_int(&s, emulate_iushr(v1, v2));
+			s.pc++;
+			break;
+		}
+		case OPC_LUSHR: {
+			jint v2 = pop_int(&s);
+			jlong v1 = pop_long(&s);
+
+			push_long(&s, emulate_lushr(v1, v2));
+			s.pc++;
+			break;
+		}
+		case OPC_IAND:
+			INT_ARITH(&);
+			break;
+		case OPC_LAND:
+			LONG_ARITH(&);
+			break;
+		case OPC_IOR:
+			INT_ARITH(|);
+			break;
+		case OPC_LOR:
+			LONG_ARITH(|);
+			break;
+		case OPC_IXOR:
+			INT_ARITH(^);
+			break;
+		case OPC_LXOR:
+			LONG_ARITH(^);
+			break;
+		case OPC_IINC: {
+			unsigned int idx;
+			jint value;
+
+			if (wide) {
+				idx = read_u16(&code[s.pc + 1]);
+				value = read_s16(&code[s.pc + 3]);
+				s.pc += 5;
+			} else {
+				idx = code[s.pc + 1];
+				value = (int8_t) code[s.pc + 2];
+				s.pc += 3;
+			}
+			locals[idx] = (unsigned long) (long) (jint) ((uint32_t) locals[idx] + (uint32_t) value);
+			break;
+		}
+		case OPC_I2L:
+			push_long(&s, pop_int(&s));
+			s.pc++;
+			break;
+		case OPC_I2F:
+			push_float(&s, pop_int(&s));
+			s.pc++;
+			break;
+		case OPC_I2D:
+			push_double(&s, pop_int(&s));
+			s.pc++;
+			break;
+		case OPC_L2I:
+			push_int(&s, (jint) pop_long(&s));
+			s.pc++;
+			break;
+		case OPC_L2F:
+			push_float(&s, pop_long(&s));
+			s.pc++;
+			break;
+		case OPC_L2D:
+			push_double(&s, pop_long(&s));
+			s.pc++;
+			break;
+		case OPC_F2I:
+			push_int(&s, emulate_f2i(pop_float(&s)));
+			s.pc++;
+			break;
+		case OPC_F2L:
+			push_long(&s, emulate_f2l(pop_float(&s)));
+			s.pc++;
+			break;
+		case OPC_F2D:
+			push_double(&s, pop_float(&s));
+			s.pc++;
+			break;
+		case OPC_D2I:
+			push_int(&s, emulate_d2i(pop_double(&s)));
+			s.pc++;
+			break;
+		case OPC_D2L:
+			push_long(&s, emulate_d2l(pop_double(&s)));
+			s.pc++;
+			break;
+		case OPC_D2F:
+			push_float(&s, pop_double(&s));
+			s.pc++;
+			break;
+		case OPC_I2B:
+			push_int(&s, (jbyte) pop_int(&s));
+			s.pc++;
+			break;
+		case OPC_I2C:
+			push_int(&s, (jchar) pop_int(&s));
+			s.pc++;
+			break;
+		case OPC_I2S:
+			push_int(&s, (jshort) pop_int(&s));
+			s.pc++;
+			break;
+		case OPC_LCMP: {
+			jlong v2 = pop_long(&s);
+			jlong v1 = pop_long(&s);
+
+			push_int(&s, emulate_lcmp(v1, v2));
+			s.pc++;
+			break;
+		}
+		case OPC_FCMPL:
+		case OPC_FCMPG: {
+			jfloat v2 = pop_float(&s);
+			jfloat v1 = pop_float(&s);
+
+			if (opc == OPC_FCMPL)
+				push_int(&s, emulate_fcmpl(v1, v2));
+			else
+				push_int(&s, emulate_fcmpg(v1, v2));
+			s.pc++;
+			break;
+		}
+		case OPC_DCMPL:
+		case OPC_DCMPG: {
+			jdouble v2 = pop_double(&s);
+			jdouble v1 = pop_double(&s);
+
+			if (opc == OPC_DCMPL)
+				push_int(&s, emulate_dcmpl(v1, v2));
+			else
+				push_int(&s, emulate_dcmpg(v1, v2));
+			s.pc++;
+			break;
+		}
+		case OPC_IFEQ:
+			BRANCH_IF(pop_int(&s) == 0);
+			break;
+		case OPC_IFNE:
+			BRANCH_IF(pop_int(&s) != 0);
+			break;
+		case OPC_IFLT:
+			BRANCH_IF(pop_int(&s) < 0);
+			break;
+		case OPC_IFGE:
+			BRANCH_IF(pop_int(&s) >= 0);
+			break;
+		case OPC_IFGT:
+			BRANCH_IF(pop_int(&s) > 0);
+			break;
+		case OPC_IFLE:
+			BRANCH_IF(pop_int(&s) <= 0);
+			break;
+		case OPC_IF_ICMPEQ:
+		case OPC_IF_ICMPNE:
+		case OPC_IF_ICMPLT:
+		case OPC_IF_ICMPGE:
+		case OPC_IF_ICMPGT:
+		case OPC_IF_ICMPLE: {
+			jint v2 = pop_int(&s);
+			jint v1 = pop_int(&s);
+
+			switch (opc) {
+			case OPC_IF_ICMPEQ:
+				BRANCH_IF(v1 == v2);
+				break;
+			case OPC_IF_ICMPNE:
+				BRANCH_IF(v1 != v2);
+				break;
+			case OPC_IF_ICMPLT:
+				BRANCH_IF(v1 < v2);
+				break;
+			case OPC_IF_ICMPGE:
+				BRANCH_IF(v1 >= v2);
+				break;
+			case OPC_IF_ICMPGT:
+				BRANCH_IF(v1 > v2);
+				break;
+			default:
+				BRANCH_IF(v1 <= v2);
+				break;
+			}
+			break;
+		}
+		case OPC_IF_ACMPEQ:
+		case OPC_IF_ACMPNE: {
+			struct vm_object *v2 = pop_ref(&s);
+			struct vm_object *v1 = pop_ref(&s);
+
+			if (opc == OPC_IF_ACMPEQ)
+				BRANCH_IF(v1 == v2);
+			else
+				BRANCH_IF(v1 != v2);
+			break;
+		}
+		case OPC_GOTO:
+			BRANCH_IF(true);
+			break;
+		case OPC_JSR:
+			push(&s, s.pc + 3);
+			s.pc += read_s16(&code[s.pc + 1]);
+			break;
+		case OPC_RET:
+			if (wide)
+				s.pc = locals[read_u16(&code[s.pc + 1])];
+			else
+				s.pc = locals[code[s.pc + 1]];
+			break;
+		case OPC_TABLESWITCH: {
+			struct tableswitch_info info;
+			jint index = pop_int(&s);
+			int32_t offset;
+
+			get_tableswitch_info(code, s.pc, &info);
+
+			if (index < (jint) info.low || index > (jint) info.high)
+				offset = info.default_target;
+			else
+				offset = read_s32(info.targets + (index - (jint) info.low) * 4);
+
+			count_backedge(&s, offset);
+			s.pc += offset;
+			break;
+		}
+		case OPC_LOOKUPSWITCH: {
+			struct lookupswitch_info info;
+			jint key = pop_int(&s);
+			int32_t offset;
+			unsigned int i;
+
+			get_lookupswitch_info(code, s.pc, &info);
+
+			offset = info.default_target;
+
+			for (i = 0; i < info.count; i++) {
+				if (read_lookupswitch_match(&info, i) == key) {
+					offset = read_lookupswitch_target(&info, i);
+					break;
+				}
+			}
+
+			count_backedge(&s, offset);
+			s.pc += offset;
+			break;
+		}
+		case OPC_IRETURN:
+			result->i = pop_int(&s);
+			goto out;
+		case OPC_LRETURN:
+			result->j = pop_long(&s);
+			goto out;
+		case OPC_FRETURN:
+			result->f = pop_float(&s);
+			goto out;
+		case OPC_DRETURN:
+			result->d = pop_double(&s);
+			goto out;
+		case OPC_ARETURN:
+			result->l = pop_ref(&s);
+			goto out;
+		case OPC_RETURN:
+			goto out;
+		case OPC_GETSTATIC: {
+			struct vm_field *vmf = resolve_field(&s);
+
+			if (!vmf || vm_class_ensure_init(vmf->class))
+				goto throw;
+
+			get_field_value(&s, vmf, NULL);
+			s.pc += 3;
+			break;
+		}
+		case OPC_PUTSTATIC: {
+			struct vm_field *vmf = resolve_field(&s);
+
+			if (!vmf || vm_class_ensure_init(vmf->class))
+				goto throw;
+
+			put_static_value(&s, vmf);
+			s.pc += 3;
+			break;
+		}
+		case OPC_GETFIELD: {
+			struct vm_field *vmf = resolve_field(&s);
+			struct vm_object *obj;
+
+			if (!vmf)
+				goto throw;
+
+			obj = pop_ref(&s);
+			if (!obj) {
+				signal_new_exception(vm_java_lang_NullPointerException, NULL);
+				goto throw;
+			}
+
+			get_field_value(&s, vmf, obj);
+			s.pc += 3;
+			break;
+		}
+		case OPC_PUTFIELD: {
+			struct vm_field *vmf = resolve_field(&s);
+			struct vm_object *obj;
+			union jvalue value;
+
+			if (!vmf)
+				goto throw;
+
+			pop_field_value(&s, vmf, &value);
+
+			obj = pop_ref(&s);
+			if (!obj) {
+				signal_new_exception(vm_java_lang_NullPointerException, NULL);
+				goto throw;
+			}
+
+			put_field_value(obj, vmf, &value);
+			s.pc += 3;
+			break;
+		}
+		case OPC_INVOKEVIRTUAL:
+		case OPC_INVOKESPECIAL:
+		case OPC_INVOKESTATIC: {
+			uint16_t access_flags = 0;
+			struct vm_method *target;
+
+			if (opc == OPC_INVOKESTATIC)
+				access_flags = CAFEBABE_CLASS_ACC_STATIC;
+
+			target = vm_class_resolve_method_recursive(method->class,
+				read_u16(&code[s.pc + 1]), access_flags);
+			if (!target) {
+				if (!exception_occurred())
+					signal_new_exception(vm_java_lang_NoSuchMethodError, NULL);
+				goto throw;
+			}
+
+			if (invoke(&s, target, opc == OPC_INVOKEVIRTUAL))
+				goto throw;
+
+			s.pc += 3;
+			break;
+		}
+		case OPC_INVOKEINTERFACE: {
+			struct vm_method *target;
+
+			target = vm_class_resolve_interface_method_recursive(method->class,
+				read_u16(&code[s.pc + 1]));
+			if (!target) {
+				if (!exception_occurred())
+					signal_new_exception(vm_java_lang_NoSuchMethodError, NULL);
+				goto throw;
+			}
+
+			if (invoke(&s, target, true))
+				goto throw;
+
+			s.pc += 5;
+			break;
+		}
+		case OPC_NEW: {
+			struct vm_class *vmc = resolve_class(&s);
+			struct vm_object *obj;
+
+			if (!vmc || vm_class_ensure_init(vmc))
+				goto throw;
+
+			obj = vm_object_alloc(vmc);
+			if (!obj)
+				goto throw;
+
+			push_ref(&s, obj);
+			s.pc += 3;
+			break;
+		}
+		case OPC_NEWARRAY: {
+			jint count = pop_int(&s);
+			struct vm_object *array;
+
+			array_size_check(count);
+			if (exception_occurred())
+				goto throw;
+
+			array = vm_object_alloc_primitive_array(code[s.pc + 1], count);
+			if (!array)
+				goto throw;
+
+			push_ref(&s, array);
+			s.pc += 2;
+			break;
+		}
+		case OPC_ANEWARRAY: {
+			struct vm_class *vmc = resolve_class(&s);
+			struct vm_object *array;
+
+			if (!vmc)
+				goto throw;
+
+			array = new_array(vmc, pop_int(&s));
+			if (!array)
+				goto throw;
+
+			push_ref(&s, array);
+			s.pc += 3;
+			break;
+		}
+		case OPC_ARRAYLENGTH: {
+			struct vm_object *array = pop_ref(&s);
+
+			if (!array) {
+				signal_new_exception(vm_java_lang_NullPointerException, NULL);
+				goto throw;
+			}
+
+			push_int(&s, vm_array_length(array));
+			s.pc++;
+			break;
+		}
+		case OPC_ATHROW: {
+			struct vm_object *exception = pop_ref(&s);
+
+			if (!exception) {
+				signal_new_exception(vm_java_lang_NullPointerException, NULL);
+				goto throw;
+			}
+
+			signal_exception(exception);
+			goto throw;
+		}
+		case OPC_CHECKCAST: {
+			struct vm_class *vmc = resolve_class(&s);
+
+			if (!vmc)
+				goto throw;
+
+			vm_object_check_cast((struct vm_object *) stack[s.sp - 1], vmc);
+			if (exception_occurred())
+				goto throw;
 
-	pc = 0;
-	while (pc < method->code_attribute.code_length) {
-		uint8_t opc = method->code_attribute.code[pc];
+			s.pc += 3;
+			break;
+		}
+		case OPC_INSTANCEOF: {
+			struct vm_class *vmc = resolve_class(&s);
+			struct vm_object *obj;
 
-		if (interp(opc) == INTERP_RETURN)
+			if (!vmc)
+				goto throw;
+
+			obj = pop_ref(&s);
+			push_int(&s, obj && vm_object_is_instance_of(obj, vmc));
+			s.pc += 3;
+			break;
+		}
+		case OPC_MONITORENTER:
+		case OPC_MONITOREXIT: {
+			struct vm_object *obj = pop_ref(&s);
+
+			if (!obj) {
+				signal_new_exception(vm_java_lang_NullPointerException, NULL);
+				goto throw;
+			}
+
+			if (opc == OPC_MONITORENTER ? vm_object_lock(obj) : vm_object_unlock(obj))
+				goto throw;
+
+			s.pc++;
+			break;
+		}
+		case OPC_WIDE:
+			wide = true;
+			s.pc++;
+			continue;
+		case OPC_MULTIANEWARRAY: {
+			struct vm_class *vmc = resolve_class(&s);
+			unsigned int nr_dimensions = code[s.pc + 3];
+			int counts[nr_dimensions];
+			struct vm_object *array;
+			unsigned int i;
+
+			if (!vmc)
+				goto throw;
+
+			s.sp -= nr_dimensions;
+
+			for (i = 0; i < nr_dimensions; i++) {
+				counts[i] = (jint) stack[s.sp + i];
+
+				array_size_check(counts[i]);
+				if (exception_occurred())
+					goto throw;
+			}
+
+			array = vm_object_alloc_multi_array_a(vmc, nr_dimensions, counts);
+			if (!array)
+				goto throw;
+
+			push_ref(&s, array);
+			s.pc += 4;
+			break;
+		}
+		case OPC_IFNULL:
+			BRANCH_IF(pop_ref(&s) == NULL);
+			break;
+		case OPC_IFNONNULL:
+			BRANCH_IF(pop_ref(&s) != NULL);
+			break;
+		case OPC_GOTO_W: {
+			int32_t offset = read_s32(&code[s.pc + 1]);
+
+			count_backedge(&s, offset);
+			s.pc += offset;
+			break;
+		}
+		case OPC_JSR_W:
+			push(&s, s.pc + 5);
+			s.pc += read_s32(&code[s.pc + 1]);
+			break;
+		default:
+			die("unknown bytecode %d at %s.%s%s:%lu", opc,
+			    method->class->name, method->name, method->type, s.pc);
+		}
+
+		wide = false;
+
+		if (s.backedge) {
+			s.backedge = false;
+
+			if (try_osr(&s, result))
+				return;
+		}
+		continue;
+
+	throw:
+		wide = false;
+
+		if (!find_handler(&s))
+			break;
+	}
+
+	/* Exception was not caught in this method. */
+	if (lock_obj) {
+		struct vm_object *exception = exception_occurred();
+
+		clear_exception();
+		vm_object_unlock(lock_obj);
+		signal_exception(exception);
+	}
+
+	return;
+out:
+	if (lock_obj)
+		vm_object_unlock(lock_obj);
+}
+
+void vm_interp_method_a(struct vm_method *method, unsigned long *args,
+			union jvalue *result)
+{
+	struct cafebabe_code_attribute code_attr = method->code_attribute;
+	unsigned long stack[code_attr.max_stack + 1];
+	unsigned long locals[code_attr.max_locals + 1];
+	struct vm_object *lock_obj = NULL;
+	struct interp_state s;
+
+	memset(locals, 0, sizeof(locals));
+	memcpy(locals, args, nr_arg_slots(method) * sizeof(unsigned long));
+
+	init_interp_state(&s, method, &code_attr, 0, locals, stack);
+
+	result->j = 0;
+
+	if (vm_method_is_synchronized(method)) {
+		lock_obj = method_lock_object(method, args);
+		if (vm_object_lock(lock_obj))
 			return;
+	}
+
+	interp(s, lock_obj, false, result);
+}
+
+/*
+ * Continues running @method in the interpreter at @pc of @code_attr, which
+ * is the code of a compiled frame and might have methods inlined into it.
+ * The local variables in @locals must have room for all its locals.
+ * This is used to deoptimize compiled frames so the lock of a synchronized
+ * method is not released here. If @type is not J_VOID, @value is pushed on
+ * the operand stack first. If an exception is pending, it is thrown at @pc
+ * instead.
+ */
+void vm_interp_resume(struct vm_method *method,
+		      const struct cafebabe_code_attribute *code_attr,
+		      unsigned long pc, unsigned long *locals, enum vm_type type,
+		      union jvalue *value, union jvalue *result)
+{
+	unsigned long stack[code_attr->max_stack + 1];
+	struct interp_state s;
+	bool throwing;
+
+	init_interp_state(&s, method, code_attr, pc, locals, stack);
+
+	result->j = 0;
+
+	throwing = exception_occurred() != NULL;
+	if (!throwing)
+		push_jvalue(&s, type, value);
+
+	interp(s, NULL, throwing, result);
+}
+
+void vm_interp_method_v(struct vm_method *method, va_list args, union jvalue *result)
+{
+	unsigned long args_array[method->args_count];
 
-		pc++;
+	for (int i = 0; i < method->args_count; i++)
+		args_array[i] = va_arg(args, unsigned long);
+
+	vm_interp_method_a(method, args_array, result);
+}
+
+/*
+ * Returns true if @method has bytecode that the interpreter can run.
+ */
+bool vm_method_can_interpret(struct vm_method *method)
+{
+	if (vm_method_is_native(method) || vm_method_is_abstract(method))
+		return false;
+
+	return method->code_attribute.code_length != 0;
+}
+
+/*
+ * Decides whether @method should be run in the interpreter instead of
+ * being compiled. This is called from the JIT trampoline on every
+ * invocation of a method that has not been compiled yet.
+ */
+bool vm_method_should_interpret(struct vm_method *method)
+{
+	if (!vm_method_can_interpret(method))
+		return false;
+
+	if (opt_interp_only)
+		return true;
+
+	atomic_inc(&method->invocation_count);
+
+	if (!opt_compile_threshold)
+		return false;
+
+	return method_hotness(method) < opt_compile_threshold;
+}
+
+/*
+ * The interpreter bridges are called from the per-method bridge code
+ * emitted by emit_interp_bridge(). The @frame points to the frame set
+ * up by that code from which the call arguments are fetched. We need a
+ * separate entry point for floating point return values because they
+ * are not returned in general purpose registers.
+ */
+static void interp_bridge(struct vm_method *method, void *frame,
+			  union jvalue *result)
+{
+	unsigned long args[method->args_count];
+
+	native_call_get_args(method, frame, args);
+
+	vm_interp_method_a(method, args, result);
+}
+
+static uint64_t vm_interp_bridge(struct vm_method *method, void *frame)
+{
+	union jvalue result;
+
+	interp_bridge(method, frame, &result);
+
+	return result.j;
+}
+
+static jfloat vm_interp_bridge_float(struct vm_method *method, void *frame)
+{
+	union jvalue result;
+
+	interp_bridge(method, frame, &result);
+
+	return result.f;
+}
+
+static jdouble vm_interp_bridge_double(struct vm_method *method, void *frame)
+{
+	union jvalue result;
+
+	interp_bridge(method, frame, &result);
+
+	return result.d;
+}
+
+void *vm_interp_bridge_ptr(struct vm_method *method)
+{
+	switch (method->return_type.vm_type) {
+	case J_FLOAT:
+		return vm_interp_bridge_float;
+	case J_DOUBLE:
+		return vm_interp_bridge_double;
+	default:
+		return vm_interp_bridge;
 	}
 }
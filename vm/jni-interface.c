@@ -5,8 +5,10 @@
  * file LICENSE for details.
  */
 
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdio.h>
 
 #include "jit/exception.h"
@@ -19,6 +21,7 @@
 #include "vm/classloader.h"
 #include "vm/die.h"
 #include "vm/errors.h"
+#include "vm/gc.h"
 #include "vm/jni.h"
 #include "vm/method.h"
 #include "vm/object.h"
@@ -437,20 +440,87 @@ static jobject JNI_PopLocalFrame(JNIEnv *env, jobject result)
 	return 0;
 }
 
+/*
+ * Global references live in a table allocated with vm_alloc(). The
+ * collector scans such memory for references, so the objects are kept
+ * alive and are not moved for as long as they are referenced from here.
+ */
+#define INITIAL_GLOBAL_REFS	64
+
+static pthread_mutex_t global_refs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct vm_object **global_refs;
+static unsigned long max_global_refs;
+
+static struct vm_object **global_ref_slot(void)
+{
+	struct vm_object **new_refs;
+	unsigned long new_max;
+	unsigned long i;
+
+	for (i = 0; i < max_global_refs; i++) {
+		if (!global_refs[i])
+			return &global_refs[i];
+	}
+
+	new_max = max_global_refs ? 2 * max_global_refs : INITIAL_GLOBAL_REFS;
+
+	new_refs = vm_zalloc(new_max * sizeof(*new_refs));
+	if (!new_refs)
+		return NULL;
+
+	if (global_refs) {
+		memcpy(new_refs, global_refs, max_global_refs * sizeof(*new_refs));
+		vm_free(global_refs);
+	}
+
+	global_refs	= new_refs;
+	max_global_refs	= new_max;
+
+	return &global_refs[i];
+}
+
 static jobject JNI_NewGlobalRef(JNIEnv *env, jobject obj)
 {
+	struct vm_object **slot;
+
 	enter_vm_from_jni();
 
-	/* TODO: fix this when GC is implemented. */
+	if (!obj)
+		return NULL;
+
+	pthread_mutex_lock(&global_refs_mutex);
+
+	slot = global_ref_slot();
+	if (slot)
+		*slot = obj;
+
+	pthread_mutex_unlock(&global_refs_mutex);
+
+	if (!slot)
+		return throw_oom_error();
 
 	return obj;
 }
 
 static void JNI_DeleteGlobalRef(JNIEnv *env, jobject globalRef)
 {
+	unsigned long i;
+
 	enter_vm_from_jni();
 
-	/* TODO: fix this when GC is implemented. */
+	if (!globalRef)
+		return;
+
+	pthread_mutex_lock(&global_refs_mutex);
+
+	for (i = 0; i < max_global_refs; i++) {
+		if (global_refs[i] == globalRef) {
+			global_refs[i] = NULL;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&global_refs_mutex);
 }
 
 static void JNI_DeleteLocalRef(JNIEnv *env, jobject localRef)
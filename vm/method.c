@@ -115,6 +115,9 @@ int vm_method_init(struct vm_method *vmm,
 	vmm->flags = 0;
 	vmm->annotation_initialized = false;
 
+	atomic_set(&vmm->invocation_count, 0);
+	atomic_set(&vmm->backedge_count, 0);
+
 	const struct cafebabe_constant_info_utf8 *name;
 	if (cafebabe_class_constant_get_utf8(class, method->name_index, &name))
 		return -1;
@@ -270,6 +273,10 @@ int vm_method_prepare_jit(struct vm_method *vmm)
 
 	vmm->compilation_unit = cu;
 
+	vmm->cha_overridden = false;
+	vmm->cha_dispatch_stub = NULL;
+	INIT_LIST_HEAD(&vmm->cha_dependent_list);
+
 	if (method_matches_regex(vmm))
 		vmm->flags |= VM_METHOD_FLAG_TRACE;
 
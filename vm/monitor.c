@@ -3,21 +3,95 @@
  *
  * This file is released under the 2-clause BSD license. Please refer to the
  * file LICENSE for details.
+ *
+ * Biased locking
+ *
+ * When a thread locks an unlocked object the monitor record it installs
+ * is marked biased and when the thread unlocks the object the object
+ * stays reserved for it: .monitor_record is set to the thread's exec env
+ * with VM_MONITOR_RESERVED set. The thread locks and unlocks a reserved
+ * object again without atomic operations by installing and removing a
+ * record from its pool with plain stores.
+ *
+ * Other threads never block on a reserved object or a biased record.
+ * They revoke the bias while all threads are stopped at a safepoint. A
+ * reserved object is then unlocked and a biased record becomes an
+ * ordinary one that the owner releases with the relaxed-lock protocol. A
+ * stopped owner might be in the middle of changing the state of one of
+ * its reserved objects so it sets .in_bias_update while doing that and
+ * the revocation is retried when it is set. Once the bias of
+ * BIAS_REVOCATION_THRESHOLD instances of a class has been revoked, its
+ * instances are no longer reserved.
+ *
+ * Adaptive spinning
+ *
+ * Critical sections are usually short so a thread that finds the monitor
+ * owned by another thread first spins for a while waiting for the owner to
+ * release it before it blocks on the record's semaphore. The spinning
+ * thread does not touch .nr_blocked so the owner deflates the monitor as
+ * usual and the spinning thread then retries from the beginning. The
+ * number of iterations is kept in the class of the object because records
+ * are pooled per thread and move between objects. It is doubled when the
+ * lock was released while spinning and halved when it was not. Threads
+ * update it without synchronization as it is only a hint.
  */
 
 #include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "arch/memory.h"
 #include "arch/atomic.h"
 
 #include "jit/exception.h"
 
+#include "lib/hash-map.h"
+
 #include "vm/object.h"
 #include "vm/preload.h"
 #include "vm/thread.h"
 #include "vm/errors.h"
 #include "vm/class.h"
+#include "vm/gc.h"
+#include "vm/stdlib.h"
+
+#define BIAS_REVOCATION_THRESHOLD	20
+
+bool opt_use_biased_locking = true;
+bool opt_print_biased_locking_stats;
+bool opt_trace_monitor;
+
+/*
+ * Contention statistics of one class collected with -Xtrace:monitor.
+ */
+struct monitor_contention {
+	struct vm_class		*class;
+	unsigned long		nr_contended;
+	unsigned long		nr_spins;
+	unsigned long		nr_blocks;
+	uint64_t		wait_ns;
+};
+
+/*
+ * What happened while the current thread was acquiring a monitor owned by
+ * another thread.
+ */
+struct lock_contention {
+	bool			contended;
+	unsigned long		nr_spins;
+	unsigned long		nr_blocks;
+	struct timespec		start;
+};
+
+static struct hash_map *contention_map;
+static pthread_mutex_t contention_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Only updated by safepoint operations */
+static unsigned long nr_bias_revocations;
+static unsigned long nr_bias_revoked_classes;
 
 /*
  * Get new monitor record with .owner set to the current execution
@@ -30,6 +104,12 @@ static struct vm_monitor_record *get_monitor_record(void)
 
 	ee = vm_get_exec_env();
 
+	if (ee->spare_monitor_rec) {
+		record = ee->spare_monitor_rec;
+		ee->spare_monitor_rec = NULL;
+		return record;
+	}
+
 	if (!list_is_empty(&ee->free_monitor_recs)) {
 		record = list_first_entry(&ee->free_monitor_recs,
 				       struct vm_monitor_record,
@@ -44,6 +124,7 @@ static struct vm_monitor_record *get_monitor_record(void)
 
 	record->owner		= ee;
 	record->lock_count	= 1;
+	record->biased		= false;
 
 	atomic_set(&record->nr_blocked, 0);
 	atomic_set(&record->nr_waiting, 0);
@@ -65,11 +146,18 @@ void vm_monitor_record_free(struct vm_monitor_record *vmr)
 }
 
 /*
- * Puts monitor record back to the pool
+ * Puts monitor record back to the pool. The spare record is used first
+ * because the inline fast path in JIT code can only take that one.
  */
 static void put_monitor_record(struct vm_monitor_record *record)
 {
 	struct vm_exec_env *ee = vm_get_exec_env();
+
+	if (!ee->spare_monitor_rec) {
+		ee->spare_monitor_rec = record;
+		return;
+	}
+
 	list_add(&record->ee_free_list_node, &ee->free_monitor_recs);
 }
 
@@ -94,6 +182,21 @@ static inline void wait(struct vm_monitor_record *record)
 	vm_thread_set_state(self, VM_THREAD_STATE_RUNNABLE);
 }
 
+static inline bool is_reserved(void *monitor_record)
+{
+	return (unsigned long) monitor_record & VM_MONITOR_RESERVED;
+}
+
+static inline void *reserved_for(struct vm_exec_env *ee)
+{
+	return (void *) ((unsigned long) ee | VM_MONITOR_RESERVED);
+}
+
+static inline struct vm_exec_env *reserved_owner(void *monitor_record)
+{
+	return (void *) ((unsigned long) monitor_record & ~VM_MONITOR_RESERVED);
+}
+
 static inline
 int owner_check(struct vm_object *object, struct vm_monitor_record **record_p)
 {
@@ -107,7 +210,7 @@ int owner_check(struct vm_object *object, struct vm_monitor_record **record_p)
 	 */
 
 	record	= object->monitor_record;
-	if (record && record->owner == vm_get_exec_env()) {
+	if (record && !is_reserved(record) && record->owner == vm_get_exec_env()) {
 		*record_p = record;
 		return 0;
 	}
@@ -116,6 +219,317 @@ int owner_check(struct vm_object *object, struct vm_monitor_record **record_p)
 	return -1;
 }
 
+static bool can_reserve(struct vm_object *object, struct vm_exec_env *ee)
+{
+	return opt_use_biased_locking && ee->bias_enabled
+		&& object->class && !object->class->bias_revoked;
+}
+
+/*
+ * The compiler must not move accesses to reserved objects out of the
+ * section between these two.
+ */
+static inline void begin_bias_update(struct vm_exec_env *ee)
+{
+	ee->in_bias_update = true;
+	barrier();
+}
+
+static inline void end_bias_update(struct vm_exec_env *ee)
+{
+	barrier();
+	ee->in_bias_update = false;
+}
+
+/*
+ * Locks @object that is reserved for the current thread by installing
+ * @record. Returns false if the bias was revoked in the meantime.
+ */
+static bool lock_reserved(struct vm_object *object, struct vm_exec_env *ee,
+			  struct vm_monitor_record *record)
+{
+	bool locked = false;
+
+	begin_bias_update(ee);
+
+	if (object->monitor_record == reserved_for(ee)) {
+		/* Other threads must see .biased set when they see the
+		 * record. Stores are not reordered on x86. */
+		record->biased		= true;
+		barrier();
+		object->monitor_record	= record;
+		locked			= true;
+	}
+
+	end_bias_update(ee);
+
+	return locked;
+}
+
+/*
+ * Unlocks @object and leaves it reserved for the current thread. Other
+ * threads can only lock the object after a safepoint so no memory barrier
+ * is needed. Returns false if the bias was revoked in the meantime.
+ */
+static bool unlock_reserved(struct vm_object *object, struct vm_monitor_record *record)
+{
+	struct vm_exec_env *ee = record->owner;
+	bool unlocked = false;
+
+	begin_bias_update(ee);
+
+	if (record->biased) {
+		record->biased		= false;
+		object->monitor_record	= reserved_for(ee);
+		unlocked		= true;
+	}
+
+	end_bias_update(ee);
+
+	if (unlocked)
+		put_monitor_record(record);
+
+	return unlocked;
+}
+
+struct bias_revocation {
+	struct vm_object	*object;
+	bool			done;
+};
+
+/*
+ * Returns @ee if it belongs to a thread that is stopped at the safepoint.
+ * Other threads have exited and can not touch their reserved objects.
+ */
+static struct vm_exec_env *stopped_exec_env(struct vm_exec_env *ee)
+{
+	struct vm_thread *thread;
+
+	vm_thread_for_each(thread) {
+		if (thread->ee == ee)
+			return ee;
+	}
+
+	return NULL;
+}
+
+/*
+ * Runs in the GC thread while all java threads are stopped.
+ */
+static void do_revoke_bias(void *arg)
+{
+	struct bias_revocation *revocation = arg;
+	struct vm_object *object = revocation->object;
+	struct vm_monitor_record *record = NULL;
+	struct vm_class *vmc = object->class;
+	struct vm_exec_env *owner;
+	void *monitor_record;
+
+	monitor_record = object->monitor_record;
+
+	if (is_reserved(monitor_record)) {
+		owner = reserved_owner(monitor_record);
+	} else if (monitor_record && ((struct vm_monitor_record *) monitor_record)->biased) {
+		record = monitor_record;
+		owner = record->owner;
+	} else {
+		/* Revoked already or never biased */
+		revocation->done = true;
+		return;
+	}
+
+	owner = stopped_exec_env(owner);
+	if (owner && owner->in_bias_update)
+		return;
+
+	if (record)
+		record->biased = false;
+	else
+		object->monitor_record = NULL;
+
+	revocation->done = true;
+
+	nr_bias_revocations++;
+
+	if (++vmc->nr_bias_revocations == BIAS_REVOCATION_THRESHOLD) {
+		vmc->bias_revoked = true;
+		nr_bias_revoked_classes++;
+	}
+}
+
+/*
+ * Revokes the bias of @object for another thread.
+ */
+static void revoke_bias(struct vm_object *object)
+{
+	struct bias_revocation revocation = {
+		.object	= object,
+		.done	= false,
+	};
+
+	for (;;) {
+		gc_run_at_safepoint(do_revoke_bias, &revocation);
+		if (revocation.done)
+			break;
+
+		/* Let the owner finish its update. */
+		vm_thread_yield();
+	}
+}
+
+void vm_monitor_print_stats(void)
+{
+	fprintf(stderr, "[biased locking: %lu revocations, %lu classes no longer biased]\n",
+		nr_bias_revocations, nr_bias_revoked_classes);
+}
+
+static bool can_spin(void)
+{
+	static long nr_cpus;
+
+	if (!nr_cpus)
+		nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	/* The owner can not release the lock while we spin on its CPU. */
+	return nr_cpus > 1;
+}
+
+/*
+ * Spins until @record is removed from @object or abandoned by its owner.
+ * Returns false if that did not happen within the spin limit of the class
+ * of @object.
+ */
+static bool spin_for_release(struct vm_object *object, struct vm_monitor_record *record)
+{
+	struct vm_class *vmc = object->class;
+	int limit;
+	int i;
+
+	limit = vmc ? vmc->monitor_spin_limit : INITIAL_SPIN_LIMIT;
+
+	for (i = 0; i < limit; i++) {
+		cpu_relax();
+
+		if (object->monitor_record != record || !record->owner)
+			break;
+	}
+
+	if (vmc)
+		vmc->monitor_spin_limit = vm_monitor_adapt_spin_limit(limit, i < limit);
+
+	return i < limit;
+}
+
+static uint64_t elapsed_ns(struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1000000000ULL + now.tv_nsec - start->tv_nsec;
+}
+
+static void begin_contention(struct lock_contention *contention)
+{
+	if (contention->contended)
+		return;
+
+	contention->contended = true;
+
+	if (opt_trace_monitor)
+		clock_gettime(CLOCK_MONOTONIC, &contention->start);
+}
+
+static void record_contention(struct vm_object *object, struct lock_contention *contention)
+{
+	struct monitor_contention *stats;
+	void *value;
+	uint64_t wait_ns;
+
+	wait_ns = elapsed_ns(&contention->start);
+
+	pthread_mutex_lock(&contention_mutex);
+
+	if (!contention_map)
+		contention_map = alloc_hash_map(&pointer_key);
+
+	if (!contention_map)
+		goto out_unlock;
+
+	if (hash_map_get(contention_map, object->class, &value)) {
+		stats = zalloc(sizeof *stats);
+		if (!stats)
+			goto out_unlock;
+
+		stats->class = object->class;
+
+		if (hash_map_put(contention_map, object->class, stats)) {
+			free(stats);
+			goto out_unlock;
+		}
+	} else {
+		stats = value;
+	}
+
+	stats->nr_contended++;
+	stats->nr_spins		+= contention->nr_spins;
+	stats->nr_blocks	+= contention->nr_blocks;
+	stats->wait_ns		+= wait_ns;
+
+out_unlock:
+	pthread_mutex_unlock(&contention_mutex);
+}
+
+static int contention_compare(const void *a, const void *b)
+{
+	const struct monitor_contention *x = *(const struct monitor_contention **) a;
+	const struct monitor_contention *y = *(const struct monitor_contention **) b;
+
+	if (x->wait_ns != y->wait_ns)
+		return x->wait_ns < y->wait_ns ? 1 : -1;
+
+	return 0;
+}
+
+/*
+ * Prints the contention statistics collected with -Xtrace:monitor, the
+ * classes whose monitors were waited for the longest first.
+ */
+void vm_monitor_print_contention(void)
+{
+	struct monitor_contention **sorted;
+	struct hash_map_entry *entry;
+	unsigned long nr = 0;
+
+	pthread_mutex_lock(&contention_mutex);
+
+	if (!contention_map || hash_map_is_empty(contention_map))
+		goto out_unlock;
+
+	sorted = malloc(hash_map_size(contention_map) * sizeof *sorted);
+	if (!sorted)
+		goto out_unlock;
+
+	hash_map_for_each_entry(entry, contention_map)
+		sorted[nr++] = entry->value;
+
+	qsort(sorted, nr, sizeof *sorted, contention_compare);
+
+	for (unsigned long i = 0; i < nr; i++) {
+		struct monitor_contention *stats = sorted[i];
+
+		fprintf(stderr, "[monitor] %s: %lu contended, %lu spins, %lu blocks, avg wait %llu ns\n",
+			stats->class->name, stats->nr_contended, stats->nr_spins,
+			stats->nr_blocks,
+			(unsigned long long) (stats->wait_ns / stats->nr_contended));
+	}
+
+	free(sorted);
+
+out_unlock:
+	pthread_mutex_unlock(&contention_mutex);
+}
+
 /*
  * Acquire the lock on object's monitor. This implementation uses
  * relaxed-locking protocol based on David Dice's work: "Implementing
@@ -123,7 +537,7 @@ int owner_check(struct vm_object *object, struct vm_monitor_record **record_p)
  * not contain some optimizations metioned in te work.
  *
  */
-int vm_object_lock(struct vm_object *self)
+static int do_lock(struct vm_object *self, struct lock_contention *contention)
 {
 	struct vm_monitor_record *old_record;
 	struct vm_exec_env *ee;
@@ -133,6 +547,27 @@ int vm_object_lock(struct vm_object *self)
 	while (true) {
 		old_record	= self->monitor_record;
 
+		if (is_reserved(old_record)) {
+			struct vm_monitor_record *record;
+
+			if (reserved_owner(old_record) != ee) {
+				revoke_bias(self);
+				continue;
+			}
+
+			record = get_monitor_record();
+			if (!record) {
+				throw_oom_error();
+				return -1;
+			}
+
+			if (lock_reserved(self, ee, record))
+				return 0;
+
+			put_monitor_record(record);
+			continue;
+		}
+
 		if (!old_record) {
 			struct vm_monitor_record *record = get_monitor_record();
 			if (!record) {
@@ -140,10 +575,13 @@ int vm_object_lock(struct vm_object *self)
 				return -1;
 			}
 
+			record->biased = can_reserve(self, ee);
+
 			if (!cmpxchg_ptr(&self->monitor_record, NULL, record)) {
 				return 0;
 			}
 
+			record->biased = false;
 			put_monitor_record(record);
 			continue;
 		}
@@ -157,15 +595,29 @@ int vm_object_lock(struct vm_object *self)
 			return 0;
 		}
 
+		if (old_record->biased) {
+			revoke_bias(self);
+			continue;
+		}
+
 		/* Slowpath... */
 
+		begin_contention(contention);
+
+		if (old_record->owner && can_spin() && spin_for_release(self, old_record)) {
+			contention->nr_spins++;
+			continue;
+		}
+
 		atomic_inc(&old_record->nr_blocked);
 
 		/* This barrier is paired with the barrier in
 		 * unlocking thread after deflation. */
 		smp_mb__after_atomic_inc();
 
-		while (self->monitor_record == old_record) {
+		/* The record might have been reused for a reserved object
+		 * before we got here. Its owner would never wake us up. */
+		while (self->monitor_record == old_record && !old_record->biased) {
 
 			/*
 			 * The unlocking thread checks for it in
@@ -187,6 +639,7 @@ int vm_object_lock(struct vm_object *self)
 				return 0;
 			}
 
+			contention->nr_blocks++;
 			wait(old_record);
 
 			/* We want to see that deflation happen before
@@ -203,6 +656,23 @@ int vm_object_lock(struct vm_object *self)
 	}
 }
 
+int vm_object_lock(struct vm_object *self)
+{
+	struct lock_contention contention;
+	int err;
+
+	contention.contended	= false;
+	contention.nr_spins	= 0;
+	contention.nr_blocks	= 0;
+
+	err = do_lock(self, &contention);
+
+	if (opt_trace_monitor && contention.contended && self->class)
+		record_contention(self, &contention);
+
+	return err;
+}
+
 /*
  * Release the lock on object's monitor.
  */
@@ -219,6 +689,9 @@ int vm_object_unlock(struct vm_object *self)
 		return 0;
 	}
 
+	if (record->biased && unlock_reserved(self, record))
+		return 0;
+
 	/*
 	 * When some thread is blocked on this record release it and notify
 	 * blocked thread. The locking thread might have detected that record
@@ -256,6 +729,17 @@ int vm_object_unlock(struct vm_object *self)
 	 * sees the effect of incrementation of .nr_blocked. */
 	smp_mb();
 
+	vm_monitor_record_flush(record);
+	return 0;
+}
+
+/*
+ * Called by the unlocking thread after it has deflated the monitor of
+ * @record. Wakes up threads that blocked on the record before deflation
+ * and puts the record back to the pool.
+ */
+void vm_monitor_record_flush(struct vm_monitor_record *record)
+{
 	int nr_blocked = atomic_read(&record->nr_blocked);
 	if (nr_blocked > 0) {
 		/* We misspeculated that there are no blocked threads and
@@ -278,7 +762,6 @@ int vm_object_unlock(struct vm_object *self)
 	}
 
 	put_monitor_record(record);
-	return 0;
 }
 
 static int vm_object_do_wait(struct vm_object *self, struct timespec *timespec)
@@ -313,6 +796,12 @@ static int vm_object_do_wait(struct vm_object *self, struct timespec *timespec)
 	old_lock_count		= record->lock_count;
 	record->lock_count	= 1;
 
+	/*
+	 * The record must stay attached to the object while we wait so
+	 * that the notifying thread finds it.
+	 */
+	record->biased		= false;
+
 	atomic_inc(&record->nr_waiting);
 
 	vm_object_unlock(self);
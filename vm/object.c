@@ -14,6 +14,7 @@
 #include "vm/die.h"
 #include "vm/gc.h"
 #include "vm/reference.h"
+#include "vm/tlab.h"
 
 #include "lib/string.h"
 
@@ -58,6 +59,20 @@ static void vm_object_init_common(struct vm_object *object)
 	object->monitor_record = NULL;
 }
 
+/*
+ * Instances of classes that have a GC descriptor are allocated with it so
+ * that the GC scans only their reference fields. Objects in thread-local
+ * allocation buffers are scanned conservatively so they are only used for
+ * the other classes.
+ */
+static void *alloc_instance(struct vm_class *class, size_t size)
+{
+	if (class->has_gc_descr)
+		return gc_alloc_typed(size, class->gc_descr);
+
+	return tlab_alloc(size);
+}
+
 struct vm_object *vm_object_alloc(struct vm_class *class)
 {
 	struct vm_object *res;
@@ -65,7 +80,7 @@ struct vm_object *vm_object_alloc(struct vm_class *class)
 	if (vm_class_ensure_init(class))
 		return rethrow_exception();
 
-	res = gc_alloc(sizeof(*res) + class->object_size);
+	res = alloc_instance(class, sizeof(*res) + class->object_size);
 	if (!res)
 		return throw_oom_error();
 
@@ -79,7 +94,7 @@ struct vm_object *vm_object_alloc_array_raw(struct vm_class *class, size_t elem_
 {
 	struct vm_array *ret;
 
-	ret = gc_alloc(sizeof(*ret) + elem_size * count);
+	ret = tlab_alloc(sizeof(*ret) + elem_size * count);
 	if (!ret)
 		return throw_oom_error();
 
@@ -91,13 +106,53 @@ struct vm_object *vm_object_alloc_array_raw(struct vm_class *class, size_t elem_
 	return &ret->object;
 }
 
-struct vm_object *vm_object_alloc_primitive_array(int type, int count)
+static const char *primitive_array_class_names[] = {
+	[T_BOOLEAN]	= "[Z",
+	[T_CHAR]	= "[C",
+	[T_FLOAT]	= "[F",
+	[T_DOUBLE]	= "[D",
+	[T_BYTE]	= "[B",
+	[T_SHORT]	= "[S",
+	[T_INT]		= "[I",
+	[T_LONG]	= "[J",
+};
+
+static struct vm_class *primitive_array_classes[ARRAY_SIZE(primitive_array_class_names)];
+
+/*
+ * Returns the initialized array class for primitive array type @type. The
+ * class is resolved once and cached so that allocating primitive arrays
+ * doesn't need to take the classloader lock.
+ */
+struct vm_class *vm_primitive_array_class(int type)
+{
+	struct vm_class *vmc;
+
+	if (type < T_BOOLEAN || type >= (int) ARRAY_SIZE(primitive_array_classes))
+		return NULL;
+
+	vmc = primitive_array_classes[type];
+	if (vmc)
+		return vmc;
+
+	vmc = classloader_load(NULL, primitive_array_class_names[type]);
+	if (!vmc)
+		return NULL;
+
+	if (vm_class_ensure_init(vmc))
+		return NULL;
+
+	primitive_array_classes[type] = vmc;
+
+	return vmc;
+}
+
+struct vm_object *vm_object_alloc_primitive_array_class(struct vm_class *vmc, int count)
 {
 	struct vm_array *res;
-	int vm_type;
+	enum vm_type vm_type;
 
-	vm_type = bytecode_type_to_vmtype(type);
-	assert(vm_type != J_VOID);
+	vm_type = vmc->array_element_class->primitive_vm_type;
 
 	res = gc_alloc_noscan(sizeof(*res) + vmtype_get_size(vm_type) * count);
 	if (!res)
@@ -105,48 +160,26 @@ struct vm_object *vm_object_alloc_primitive_array(int type, int count)
 
 	vm_object_init_common(&res->object);
 
-	switch (type) {
-	case T_BOOLEAN:
-		res->object.class = classloader_load(NULL, "[Z");
-		break;
-	case T_CHAR:
-		res->object.class = classloader_load(NULL, "[C");
-		break;
-	case T_FLOAT:
-		res->object.class = classloader_load(NULL, "[F");
-		break;
-	case T_DOUBLE:
-		res->object.class = classloader_load(NULL, "[D");
-		break;
-	case T_BYTE:
-		res->object.class = classloader_load(NULL, "[B");
-		break;
-	case T_SHORT:
-		res->object.class = classloader_load(NULL, "[S");
-		break;
-	case T_INT:
-		res->object.class = classloader_load(NULL, "[I");
-		break;
-	case T_LONG:
-		res->object.class = classloader_load(NULL, "[J");
-		break;
-	default:
-		return throw_internal_error();
-	}
+	res->object.class = vmc;
+	res->array_length = count;
 
-	if (!res->object.class)
-		return throw_internal_error();
+	return &res->object;
+}
 
-	if (vm_class_ensure_init(res->object.class))
-		return throw_internal_error();
+struct vm_object *vm_object_alloc_primitive_array(int type, int count)
+{
+	struct vm_class *vmc;
 
-	res->array_length = count;
+	vmc = vm_primitive_array_class(type);
+	if (!vmc)
+		return throw_internal_error();
 
-	return &res->object;
+	return vm_object_alloc_primitive_array_class(vmc, count);
 }
 
-static struct vm_object *
-do_vm_object_alloc_multi_array(struct vm_class *class, int nr_dimensions, va_list ap)
+struct vm_object *
+vm_object_alloc_multi_array_a(struct vm_class *class, int nr_dimensions,
+			      const int *counts)
 {
 	struct vm_class *elem_class;
 	struct vm_array *res;
@@ -161,14 +194,14 @@ do_vm_object_alloc_multi_array(struct vm_class *class, int nr_dimensions, va_lis
 	elem_class = vm_class_get_array_element_class(class);
 	elem_size  = vmtype_get_size(vm_class_get_storage_vmtype(elem_class));
 
-	len = va_arg(ap, int);
+	len = counts[0];
 
 	if (len < 0) {
 		signal_new_exception(vm_java_lang_NegativeArraySizeException, NULL);
 		return NULL;
 	}
 
-	res = gc_alloc(sizeof(*res) + elem_size * len);
+	res = tlab_alloc(sizeof(*res) + elem_size * len);
 	if (!res)
 		return throw_oom_error();
 
@@ -182,11 +215,15 @@ do_vm_object_alloc_multi_array(struct vm_class *class, int nr_dimensions, va_lis
 
 	struct vm_object **elems = vm_array_elems(&res->object);
 	for (int i = 0; i < res->array_length; ++i) {
-		va_list dup_ap;
+		struct vm_object *elem;
 
-		va_copy(dup_ap, ap);
+		elem = vm_object_alloc_multi_array_a(elem_class, nr_dimensions - 1, counts + 1);
+		if (!elem)
+			return NULL;
 
-		elems[i] = do_vm_object_alloc_multi_array(elem_class, nr_dimensions - 1, dup_ap);
+		/* @res might have been promoted while @elem was allocated. */
+		gc_write_barrier(&elems[i]);
+		elems[i] = elem;
 	}
 
 	return &res->object;
@@ -195,15 +232,17 @@ do_vm_object_alloc_multi_array(struct vm_class *class, int nr_dimensions, va_lis
 struct vm_object *
 vm_object_alloc_multi_array(struct vm_class *class, int nr_dimensions, ...)
 {
-	va_list ap, dup_ap;
+	int counts[nr_dimensions];
+	va_list ap;
 
 	va_start(ap, nr_dimensions);
 
-	va_copy(dup_ap, ap);
+	for (int i = 0; i < nr_dimensions; i++)
+		counts[i] = va_arg(ap, int);
 
 	va_end(ap);
 
-	return do_vm_object_alloc_multi_array(class, nr_dimensions, ap);
+	return vm_object_alloc_multi_array_a(class, nr_dimensions, counts);
 }
 
 struct vm_object *vm_object_alloc_array(struct vm_class *class, int count)
@@ -213,7 +252,7 @@ struct vm_object *vm_object_alloc_array(struct vm_class *class, int count)
 	if (vm_class_ensure_init(class))
 		return rethrow_exception();
 
-	res = gc_alloc(sizeof(*res) + sizeof(struct vm_object *) * count);
+	res = tlab_alloc(sizeof(*res) + sizeof(struct vm_object *) * count);
 	if (!res)
 		return throw_oom_error();
 
@@ -246,10 +285,28 @@ static struct vm_object *clone_regular(struct vm_object *obj)
 {
 	struct vm_class *vmc = obj->class;
 	struct vm_object *new = vm_object_alloc(vmc);
+	unsigned long nr_words;
 
 	/* XXX: What do we do about exceptions? */
-	if (new)
+	if (!new)
+		return NULL;
+
+	if (!heap_enabled()) {
 		memcpy(new + 1, obj + 1, vmc->object_size);
+		return new;
+	}
+
+	/*
+	 * Primitive fields are copied with the references. Reference fields
+	 * are word aligned so only primitive fields can be in the tail.
+	 */
+	nr_words = vmc->object_size / sizeof(void *);
+
+	gc_write_barrier_range(new + 1, vmc->object_size);
+	gc_copy_refs(new + 1, obj + 1, nr_words);
+	memcpy((void **) (new + 1) + nr_words, (void **) (obj + 1) + nr_words,
+	       vmc->object_size % sizeof(void *));
+	gc_write_barrier_range(new + 1, vmc->object_size);
 
 	return new;
 }
@@ -279,8 +336,12 @@ static struct vm_object *clone_array(struct vm_object *obj)
 		struct vm_object *new;
 
 		new = vm_object_alloc_array(vmc, count);
-		if (new)
-			memcpy(vm_array_elems(new), vm_array_elems(obj), sizeof(struct vm_object *) * count);
+		if (!new)
+			return NULL;
+
+		gc_write_barrier_range(vm_array_elems(new), sizeof(struct vm_object *) * count);
+		gc_copy_refs(vm_array_elems(new), vm_array_elems(obj), count);
+		gc_write_barrier_range(vm_array_elems(new), sizeof(struct vm_object *) * count);
 
 		return new;
 	}
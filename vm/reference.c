@@ -10,6 +10,7 @@
 #include "vm/reference.h"
 #include "vm/call.h"
 #include "vm/errors.h"
+#include "vm/heap.h"
 #include "vm/object.h"
 
 /*
@@ -51,12 +52,22 @@ static void vm_reference_clear(struct vm_reference *ref)
 	vm_reference_unlock();
 }
 
+/*
+ * The referents of weak references are not moved by -Xnewgc minor
+ * collections because they are keys of reference_map. Memory from
+ * vm_alloc() is scanned conservatively, which pins them.
+ */
+static bool vm_reference_is_gc_visible(enum vm_reference_type type)
+{
+	return type == VM_REFERENCE_STRONG || heap_enabled();
+}
+
 struct vm_reference *
 vm_reference_alloc(struct vm_object *referent, enum vm_reference_type type)
 {
 	struct vm_reference *ref;
 
-	if (type == VM_REFERENCE_STRONG)
+	if (vm_reference_is_gc_visible(type))
 		ref = vm_alloc(sizeof *ref);
 	else
 		ref = malloc(sizeof *ref);
@@ -97,7 +108,7 @@ vm_reference_alloc(struct vm_object *referent, enum vm_reference_type type)
  out_free_ref_list:
 	free(ref_list);
  out_free_ref:
-	if (type == VM_REFERENCE_STRONG)
+	if (vm_reference_is_gc_visible(type))
 		vm_free(ref);
 	else
 		free(ref);
@@ -110,7 +121,7 @@ void vm_reference_free(struct vm_reference *reference)
 {
 	vm_reference_clear(reference);
 
-	if (reference->type == VM_REFERENCE_STRONG)
+	if (vm_reference_is_gc_visible(reference->type))
 		vm_free(reference);
 	else
 		free(reference);
@@ -114,6 +114,7 @@ static void sigsegv_handler(int sig, siginfo_t *si, void *ctx)
 
 		save_signal_registers(&(vm_get_exec_env()->thread_register_state), &uc->uc_mcontext);
 		gc_safepoint(&(vm_get_exec_env()->thread_register_state));
+		restore_signal_registers(&uc->uc_mcontext, &(vm_get_exec_env()->thread_register_state));
 		return;
 	}
 
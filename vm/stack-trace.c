@@ -27,6 +27,7 @@
 #include "jit/cu-mapping.h"
 #include "jit/exception.h"
 #include "jit/compiler.h"
+#include "jit/inliner.h"
 
 #include "lib/symbol.h"
 
@@ -430,7 +431,7 @@ void print_java_stack_trace_elem(struct stack_trace_elem *elem)
 			goto out;
 	}
 
-	int line_no = bytecode_offset_to_line_no(vmm, bc_offset);
+	int line_no = cu_bytecode_offset_to_line_no(cu, bc_offset);
 	if (line_no == -1)
 		goto out;
 
@@ -442,11 +443,10 @@ void print_java_stack_trace_elem(struct stack_trace_elem *elem)
 
 /**
  * new_stack_trace_element - creates new instance of
- *     java.lang.StackTraceElement for given method and bytecode
- *     offset.
+ *     java.lang.StackTraceElement for given method and line number.
  */
 static struct vm_object *
-new_stack_trace_element(struct vm_method *mb, unsigned long bc_offset)
+new_stack_trace_element(struct vm_method *mb, int line_no)
 {
 	struct vm_object *method_name;
 	struct vm_object *class_name;
@@ -455,11 +455,9 @@ new_stack_trace_element(struct vm_method *mb, unsigned long bc_offset)
 	struct vm_object *ste;
 	char *class_dot_name;
 	bool is_native;
-	int line_no;
 
 	cb = mb->class;
 
-	line_no = bytecode_offset_to_line_no(mb, bc_offset);
 	is_native = vm_method_is_native(mb);
 
 	if (!is_native && cb->source_file_name)
@@ -482,6 +480,29 @@ new_stack_trace_element(struct vm_method *mb, unsigned long bc_offset)
 	return ste;
 }
 
+static struct compilation_unit *
+get_intermediate_stack_trace_elem(struct vm_object *array, int i,
+				  unsigned long *bc_offset)
+{
+	enum stack_trace_elem_type type;
+	struct compilation_unit *cu;
+
+	type = (enum stack_trace_elem_type) array_get_field_ptr(array, i * 2);
+	if (type == STACK_TRACE_ELEM_TYPE_JNI) {
+		cu = array_get_field_ptr(array, i * 2 + 1);
+		*bc_offset = BC_OFFSET_UNKNOWN;
+	} else {
+		void *addr = array_get_field_ptr(array, i * 2 + 1);
+		cu = jit_lookup_cu((unsigned long) addr);
+		if (!cu)
+			error("no compilation_unit mapping for %p", addr);
+
+		*bc_offset = jit_lookup_bc_offset(cu, addr);
+	}
+
+	return cu;
+}
+
 /**
  * convert_intermediate_stack_trace - returns
  *     java.lang.StackTraceElement[] array filled in using data from
@@ -493,43 +514,56 @@ new_stack_trace_element(struct vm_method *mb, unsigned long bc_offset)
 static struct vm_object *
 convert_intermediate_stack_trace(struct vm_object *array)
 {
+	struct inline_frame *frame;
 	struct vm_object *ste_array;
+	int nr_elems;
 	int depth;
 	int i;
 	int j;
 
-	depth = vm_array_length(array);
+	nr_elems = vm_array_length(array) / 2;
+
+	/* Methods inlined into compiled code have elements of their own. */
+	depth = 0;
+	for (i = 0; i < nr_elems; i++) {
+		struct compilation_unit *cu;
+		unsigned long bc_offset;
+
+		cu = get_intermediate_stack_trace_elem(array, i, &bc_offset);
+
+		for (frame = cu_inline_frame(cu, bc_offset); frame; frame = frame->caller)
+			depth++;
+
+		depth++;
+	}
 
 	ste_array = vm_object_alloc_array(
-		vm_array_of_java_lang_StackTraceElement, depth / 2);
+		vm_array_of_java_lang_StackTraceElement, depth);
 	if (!ste_array)
 		return NULL;
 
-	for(i = 0, j = 0; i < depth; j++) {
-		enum stack_trace_elem_type type;
+	for(i = 0, j = 0; i < nr_elems; i++) {
 		struct compilation_unit *cu;
 		unsigned long bc_offset;
+		struct vm_object *ste;
 
-		type = (enum stack_trace_elem_type) array_get_field_ptr(array, i++);
-		if (type == STACK_TRACE_ELEM_TYPE_JNI) {
-			cu = array_get_field_ptr(array, i++);
-			bc_offset = BC_OFFSET_UNKNOWN;
-		} else {
-			void *addr = array_get_field_ptr(array, i++);
-			cu = jit_lookup_cu((unsigned long) addr);
-			if (!cu)
-				error("no compilation_unit mapping for %p", addr);
+		cu = get_intermediate_stack_trace_elem(array, i, &bc_offset);
 
-			bc_offset = jit_lookup_bc_offset(cu, addr);
-		}
+		for (frame = cu_inline_frame(cu, bc_offset); frame; frame = frame->caller) {
+			ste = new_stack_trace_element(frame->method,
+				bytecode_offset_to_line_no(frame->method, frame->bc_offset));
+			if(ste == NULL || exception_occurred())
+				return NULL;
 
-		struct vm_object *ste
-			= new_stack_trace_element(cu->method, bc_offset);
+			array_set_field_ptr(ste_array, j++, ste);
+		}
 
+		ste = new_stack_trace_element(cu->method,
+			cu_bytecode_offset_to_line_no(cu, bc_offset));
 		if(ste == NULL || exception_occurred())
 			return NULL;
 
-		array_set_field_ptr(ste_array, j, ste);
+		array_set_field_ptr(ste_array, j++, ste);
 	}
 
 	return ste_array;
@@ -215,6 +215,7 @@ int init_threading(void)
 	field_set_object(thread, vm_java_lang_Thread_group, main_thread_group);
 
 	vm_thread_attach_thread(main_thread);
+	main_thread->ee->bias_enabled = true;
 
 	/* We must manually add main thread to InheritableThreadLocal. */
 	/* It must be called after all threading structures are set.   */
@@ -237,8 +238,15 @@ static struct vm_exec_env *alloc_exec_env(void)
 	ee->exception			= NULL;
 	ee->trace_classloader_level	= 0;
 	INIT_LIST_HEAD(&ee->free_monitor_recs);
+	ee->spare_monitor_rec = NULL;
 	ee->in_safepoint	= false;
+	ee->bias_enabled	= false;
+	ee->in_bias_update	= false;
 	ee->trace_buffer = NULL;
+	ee->stack_end = NULL;
+	tlab_init(&ee->tlab);
+	heap_chunk_init(&ee->eden_chunk);
+	heap_roots_init(&ee->heap_roots);
 
 	return ee;
 }
@@ -247,14 +255,50 @@ static void free_exec_env(struct vm_exec_env *env)
 {
 	struct vm_monitor_record *this, *next;
 
+	if (verbose_gc)
+		tlab_print_stats(env);
+
 	struct list_head *list = &env->free_monitor_recs;
 	list_for_each_entry_safe(this, next, list, ee_free_list_node) {
 		vm_monitor_record_free(this);
 	}
 
+	if (env->spare_monitor_rec)
+		vm_monitor_record_free(env->spare_monitor_rec);
+
+	heap_roots_release(&env->heap_roots);
 	vm_free(env);
 }
 
+static void *current_stack_end(void)
+{
+	pthread_attr_t attr;
+	void *addr = NULL;
+	size_t size = 0;
+
+	if (pthread_getattr_np(pthread_self(), &attr) != 0)
+		return NULL;
+
+	if (pthread_attr_getstack(&attr, &addr, &size) != 0)
+		addr = NULL;
+
+	pthread_attr_destroy(&attr);
+
+	if (!addr)
+		return NULL;
+
+	return addr + size;
+}
+
+static void set_exec_env(struct vm_exec_env *ee)
+{
+	pthread_setspecific(current_exec_env_key, ee);
+
+	current_exec_env = ee;
+
+	ee->stack_end = current_stack_end();
+}
+
 void init_exec_env(void)
 {
 	if (pthread_key_create(&current_exec_env_key, NULL) != 0)
@@ -264,7 +308,50 @@ void init_exec_env(void)
 	if (!vm_exec_env)
 		error("out of memory");
 
-	pthread_setspecific(current_exec_env_key, vm_exec_env);
+	set_exec_env(vm_exec_env);
+}
+
+/**
+ * Sets up execution environment for a VM internal thread, such as a
+ * compiler thread, which has no java.lang.Thread associated with it.
+ *
+ * The thread is put on the thread list so that the collector stops it
+ * and scans its stack like that of any java thread, because it can read
+ * and allocate heap objects. It has no VMThread and vm_thread_self()
+ * keeps returning NULL in it. Internal threads run until the VM exits.
+ */
+int vm_thread_init_internal(void)
+{
+	struct vm_exec_env *ee;
+	struct vm_thread *thread;
+
+	ee = alloc_exec_env();
+	if (!ee)
+		return -ENOMEM;
+
+	thread = vm_thread_alloc();
+	if (!thread) {
+		free_exec_env(ee);
+		return -ENOMEM;
+	}
+
+	set_exec_env(ee);
+
+	setup_signal_handlers();
+	thread_init_exceptions();
+
+	atomic_set(&thread->state, VM_THREAD_STATE_RUNNABLE);
+	thread->posix_id = pthread_self();
+	thread->ee = ee;
+
+	pthread_mutex_lock(&threads_mutex);
+	while (thread_count_locked)
+		pthread_cond_wait(&thread_count_lock_cond, &threads_mutex);
+
+	vm_thread_attach_thread(thread);
+	pthread_mutex_unlock(&threads_mutex);
+
+	return 0;
 }
 
 /**
@@ -275,7 +362,7 @@ static void *vm_thread_entry(void *arg)
 	struct vm_exec_env *ee = arg;
 	struct vm_thread *thread = ee->thread;
 
-	pthread_setspecific(current_exec_env_key, ee);
+	set_exec_env(ee);
 
 	setup_signal_handlers();
 	thread_init_exceptions();
@@ -365,6 +452,7 @@ int vm_thread_start(struct vm_object *vmthread)
 
 	thread->ee = ee;
 	thread->ee->thread = thread;
+	thread->ee->bias_enabled = true;
 
 	if (pthread_create(&thread->posix_id, &attr, &vm_thread_entry, thread->ee)) {
 		vm_thread_detach_thread(thread);
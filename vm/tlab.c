@@ -0,0 +1,148 @@
+/*
+ * Thread-local allocation buffers
+ * Copyright (c) 2026  Jato contributors
+ *
+ * This file is released under the 2-clause BSD license. Please refer to the
+ * file LICENSE for details.
+ *
+ * Small collectable objects are allocated from per-thread free lists that
+ * are refilled in batches with gc_alloc_many(). The JIT inlines the list
+ * pop for "new" of initialized classes that have no GC descriptor and
+ * calls tlab_refill() when the list is empty.
+ */
+
+#include "vm/thread.h"
+#include "vm/errors.h"
+#include "vm/tlab.h"
+#include "vm/gc.h"
+
+#include <string.h>
+#include <stdio.h>
+
+bool opt_use_tlab = true;
+
+bool tlab_enabled(void)
+{
+	return opt_use_tlab && gc_ops.gc_alloc_many;
+}
+
+/*
+ * Returns true if objects of @size are allocated from thread-local
+ * allocation buffers.
+ */
+bool tlab_can_alloc(size_t size)
+{
+	return tlab_enabled() && size <= TLAB_MAX_SIZE;
+}
+
+void tlab_init(struct vm_tlab *tlab)
+{
+	memset(tlab, 0, sizeof(*tlab));
+}
+
+static void *tlab_next(void *obj)
+{
+	return *(void **) obj;
+}
+
+static void *__tlab_refill(struct vm_tlab *tlab, unsigned long size_class)
+{
+	void *list, *obj;
+
+	list = gc_alloc_many(tlab_class_size(size_class));
+	if (!list)
+		return NULL;
+
+	tlab->free_lists[size_class] = list;
+	tlab->nr_refills++;
+
+	for (obj = list; obj; obj = tlab_next(obj))
+		tlab->nr_refill_objects++;
+
+	return list;
+}
+
+/*
+ * Refills the empty free list of @size_class of the current thread and
+ * returns its head. The caller must unlink the object from the list and
+ * clear its first word.
+ */
+void *tlab_refill(unsigned long size_class)
+{
+	struct vm_exec_env *ee = vm_get_exec_env();
+	void *list;
+
+	list = __tlab_refill(&ee->tlab, size_class);
+	if (!list)
+		return throw_oom_error();
+
+	return list;
+}
+
+void *tlab_alloc(size_t size)
+{
+	unsigned long size_class;
+	struct vm_exec_env *ee;
+	struct vm_tlab *tlab;
+	void *obj;
+
+	if (!tlab_can_alloc(size))
+		return gc_alloc(size);
+
+	ee = vm_get_exec_env();
+	if (!ee)
+		return gc_alloc(size);
+
+	tlab = &ee->tlab;
+	size_class = tlab_size_class(size);
+
+	obj = tlab->free_lists[size_class];
+	if (!obj) {
+		obj = __tlab_refill(tlab, size_class);
+		if (!obj)
+			return NULL;
+	}
+
+	tlab->free_lists[size_class] = tlab_next(obj);
+	*(void **) obj = NULL;
+
+	return obj;
+}
+
+/*
+ * Drops the free objects of @tlab. The generational heap calls this while
+ * the thread is stopped for a collection.
+ */
+void tlab_flush(struct vm_tlab *tlab)
+{
+	for (unsigned long i = 0; i < TLAB_NR_SIZE_CLASSES; i++) {
+		void *obj;
+
+		for (obj = tlab->free_lists[i]; obj; obj = tlab_next(obj))
+			tlab->nr_refill_objects--;
+
+		tlab->free_lists[i] = NULL;
+	}
+}
+
+unsigned long tlab_nr_allocs(struct vm_tlab *tlab)
+{
+	unsigned long nr_free = 0;
+
+	for (unsigned long i = 0; i < TLAB_NR_SIZE_CLASSES; i++) {
+		void *obj;
+
+		for (obj = tlab->free_lists[i]; obj; obj = tlab_next(obj))
+			nr_free++;
+	}
+
+	return tlab->nr_refill_objects - nr_free;
+}
+
+void tlab_print_stats(struct vm_exec_env *ee)
+{
+	struct vm_tlab *tlab = &ee->tlab;
+
+	fprintf(stderr, "[TLAB: thread %lu, %lu allocations, %lu refills]\n",
+		(unsigned long) pthread_self(), tlab_nr_allocs(tlab), tlab->nr_refills);
+}